@@ -0,0 +1,212 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Reference implementation of the process side of the framed SocketBridge
+ * protocol, for the ns-3 platform of Contiki or any other process spawned
+ * by a SocketBridge with the Protocol attribute set to FRAMED.  It is not
+ * built by ns-3; copy it next to model/socket-bridge-protocol.h or compile
+ * it with -I pointing there.
+ *
+ * A typical radio driver writes frames with sbp_send_data(), configures the
+ * simulated radio with sbp_send_control() and, from its poll handler, feeds
+ * whatever it reads from the socket to sbp_reader_feed():
+ *
+ *   static void
+ *   message (void *context, uint8_t type, const uint8_t *payload, uint8_t len)
+ *   {
+ *     if (type == SBP_TYPE_DATA)
+ *       {
+ *         deliver the frame to the MAC layer
+ *       }
+ *   }
+ *
+ *   n = read (0, buf, sizeof (buf));
+ *   sbp_reader_feed (&reader, buf, n, message, NULL);
+ *
+ * To support checkpointing, read with sbp_recv() instead and call
+ * sbp_fork() when the SBP_CTRL_FORK control message arrives, passing the
+ * socket sbp_recv() returned with it:
+ *
+ *   n = sbp_recv (0, buf, sizeof (buf), &passed_fd);
+ *   sbp_reader_feed (&reader, buf, n, message, &passed_fd);
+ *
+ *   in message(), for a control message with payload[0] == SBP_CTRL_FORK:
+ *     sbp_fork (0, *(int *)context);
+ */
+
+#include "socket-bridge-protocol.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+void
+sbp_reader_init (struct sbp_reader *reader)
+{
+  reader->len = 0;
+}
+
+int
+sbp_reader_feed (struct sbp_reader *reader, const uint8_t *data, int len,
+                 sbp_message_callback callback, void *context)
+{
+  int messages = 0;
+
+  while (len > 0)
+    {
+      /* Complete the header first, then the payload it announces */
+      uint16_t want = SBP_HEADER_LEN;
+      if (reader->len >= SBP_HEADER_LEN)
+        {
+          want += sbp_header_length (reader->buf);
+        }
+      uint16_t n = want - reader->len;
+      if (n > len)
+        {
+          n = len;
+        }
+      memcpy (reader->buf + reader->len, data, n);
+      reader->len += n;
+      data += n;
+      len -= n;
+
+      if (reader->len < SBP_HEADER_LEN
+          || reader->len < SBP_HEADER_LEN + sbp_header_length (reader->buf))
+        {
+          continue;
+        }
+      if (sbp_header_version (reader->buf) == SBP_VERSION)
+        {
+          callback (context, sbp_header_type (reader->buf), reader->buf + SBP_HEADER_LEN,
+                    sbp_header_length (reader->buf));
+          messages++;
+        }
+      reader->len = 0;
+    }
+  return messages;
+}
+
+int
+sbp_send (int fd, uint8_t type, const uint8_t *payload, uint8_t len)
+{
+  uint8_t header[SBP_HEADER_LEN];
+  struct iovec iov[2];
+  ssize_t total = SBP_HEADER_LEN + len;
+  ssize_t n;
+
+  sbp_write_header (header, type, len);
+  iov[0].iov_base = header;
+  iov[0].iov_len = SBP_HEADER_LEN;
+  iov[1].iov_base = (void *)payload;
+  iov[1].iov_len = len;
+
+  /* Messages are far smaller than the socket buffer, so short writes only
+     happen when interrupted before anything was written */
+  do
+    {
+      n = writev (fd, iov, len ? 2 : 1);
+    }
+  while (n < 0 && errno == EINTR);
+  return n == total ? 0 : -1;
+}
+
+int
+sbp_send_data (int fd, const uint8_t *frame, uint8_t len)
+{
+  return sbp_send (fd, SBP_TYPE_DATA, frame, len);
+}
+
+int
+sbp_send_control (int fd, uint8_t subtype, const uint8_t *args, uint8_t len)
+{
+  uint8_t payload[SBP_MAX_PAYLOAD];
+
+  if (len > SBP_MAX_PAYLOAD - 1)
+    {
+      return -1;
+    }
+  payload[0] = subtype;
+  memcpy (payload + 1, args, len);
+  return sbp_send (fd, SBP_TYPE_CONTROL, payload, len + 1);
+}
+
+int
+sbp_send_time_request (int fd)
+{
+  return sbp_send (fd, SBP_TYPE_TIME, NULL, 0);
+}
+
+int
+sbp_recv (int fd, uint8_t *buf, int len, int *passed_fd)
+{
+  char control[CMSG_SPACE (sizeof (int))];
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  ssize_t n;
+
+  iov.iov_base = buf;
+  iov.iov_len = len;
+  memset (&msg, 0, sizeof (msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof (control);
+
+  *passed_fd = -1;
+  do
+    {
+      n = recvmsg (fd, &msg, 0);
+    }
+  while (n < 0 && errno == EINTR);
+
+  for (cmsg = CMSG_FIRSTHDR (&msg); n >= 0 && cmsg != NULL; cmsg = CMSG_NXTHDR (&msg, cmsg))
+    {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+          memcpy (passed_fd, CMSG_DATA (cmsg), sizeof (int));
+        }
+    }
+  return n;
+}
+
+int
+sbp_fork (int fd, int passed_fd)
+{
+  uint8_t pid[4];
+  int child;
+
+  if (passed_fd < 0)
+    {
+      return -1;
+    }
+  /* Forked processes are left to exit on their own */
+  signal (SIGCHLD, SIG_IGN);
+
+  child = fork ();
+  if (child != 0)
+    {
+      close (passed_fd);
+      return child;
+    }
+  dup2 (passed_fd, fd);
+  close (passed_fd);
+  sbp_put_u32 (pid, getpid ());
+  return sbp_send_control (fd, SBP_CTRL_FORKED, pid, sizeof (pid)) == 0 ? 0 : -1;
+}
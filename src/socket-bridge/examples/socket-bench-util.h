@@ -0,0 +1,119 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+//
+// Helpers shared by the benchmarks of the socket-bridge examples.  Every
+// benchmark is a single source file including this header once.
+//
+// A benchmark defining SOCKET_BENCH_COUNT_ALLOCATIONS before the include
+// replaces the global operator new with one counting the allocations of
+// all threads in g_allocations.
+//
+
+#ifndef SOCKET_BENCH_UTIL_H
+#define SOCKET_BENCH_UTIL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef SOCKET_BENCH_COUNT_ALLOCATIONS
+
+static volatile uint64_t g_allocations = 0;
+
+void *
+operator new (size_t size)
+{
+  __sync_fetch_and_add (&g_allocations, 1);
+  void *p = malloc (size ? size : 1);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void *p) throw ()
+{
+  free (p);
+}
+
+#endif /* SOCKET_BENCH_COUNT_ALLOCATIONS */
+
+/* Monotonic wall-clock time in seconds */
+static double
+WallClockSeconds (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* The non-empty items of a comma separated command line value */
+static std::vector<std::string>
+Split (std::string list)
+{
+  std::vector<std::string> items;
+  std::istringstream iss (list);
+  std::string item;
+  while (std::getline (iss, item, ','))
+    {
+      if (!item.empty ())
+        {
+          items.push_back (item);
+        }
+    }
+  return items;
+}
+
+/*
+ * The stream to write the JSON results to: the given file opened in file,
+ * or stdout if the name is empty.
+ */
+static std::ostream &
+OpenJson (std::string filename, std::ofstream &file)
+{
+  if (filename.empty ())
+    {
+      return std::cout;
+    }
+  file.open (filename.c_str ());
+  return file;
+}
+
+/* Open the JSON object of the results of the named benchmark */
+static void
+BeginJson (std::ostream &os, std::string benchmark)
+{
+  os << "{" << std::endl;
+  os << "  \"benchmark\": \"" << benchmark << "\"," << std::endl;
+}
+
+/* Close the JSON object opened by BeginJson */
+static void
+EndJson (std::ostream &os)
+{
+  os << "}" << std::endl;
+}
+
+#endif /* SOCKET_BENCH_UTIL_H */
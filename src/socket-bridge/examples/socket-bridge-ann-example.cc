@@ -1,9 +1,13 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 #include <stdio.h>
+#include <vector>
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/mobility-module.h"
 //#include "ns3/wifi-module.h"
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#endif
 #include "ns3/socket-bridge-module.h"
 #include "ns3/socket-bridge-helper.h"
 #include "ns3/propagation-loss-model.h"
@@ -13,23 +17,104 @@ using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("SocketBridgeANNExample");
 
-int 
+/*
+ * 70 Contiki nodes running the ns3-ann application on a 10 x 7 grid, 5 m
+ * apart, all within range of each other.  By default the example runs in
+ * realtime in one process.
+ *
+ * With --distributed (ns-3 configured with --enable-mpi) the nodes are
+ * partitioned across exactly 4 MPI ranks:
+ *
+ *   mpirun -np 4 ./waf --run "socket-bridge-ann-example --distributed"
+ *
+ * Every rank builds the whole topology, owns a vertical strip of the grid and
+ * spawns the Contiki processes of its strip only.  The distributed simulator
+ * is not realtime; SocketBridgeHelper::Install paces every rank to the wall
+ * clock instead, and the inbox is polled every --pollInterval microseconds.
+ *
+ * With --islands=N the nodes are split into N grids (buildings) placed --gap
+ * meters apart and partitioned by radio reachability instead.  The gap has to
+ * exceed the range of the PHYs, about 2.8 km at the default TxPowerDbm of
+ * SocketContikiPhy and the default LogDistancePropagationLossModel, or the
+ * grids form one island.
+ */
+int
 main (int argc, char *argv[])
 {
-  GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::RealtimeSimulatorImpl"));
+  /* Remember to adjust the NTABLE value of ns3-ann to the nodes - 1 */
+  const uint32_t nodeCount = 70;
+  const uint32_t columns = 10;
+  const double spacing = 5.0;
+  const uint32_t ranks = 4;
+  bool distributed = false;
+  uint32_t islands = 0;
+  double gap = 5000.0;
+  uint32_t pollInterval = 100;
+  std::string path = "/cn8801/contiki/examples/ns3-ann/ns3-ann.ns3";
+
+  CommandLine cmd;
+  cmd.AddValue ("distributed", "Partition the nodes across 4 MPI ranks", distributed);
+  cmd.AddValue ("islands", "Number of separate grids, 0 for one grid split into strips", islands);
+  cmd.AddValue ("gap", "Distance in meters between the separate grids", gap);
+  cmd.AddValue ("pollInterval", "Inbox poll and pacing interval of distributed runs in microseconds", pollInterval);
+  cmd.AddValue ("path", "Path to the Contiki executable", path);
+  cmd.Parse (argc, argv);
+
   GlobalValue::Bind ("ChecksumEnabled", BooleanValue (true));
+  if (distributed)
+    {
+#ifdef NS3_MPI
+      GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::DistributedSimulatorImpl"));
+      MpiInterface::Enable (&argc, &argv);
+      NS_ABORT_MSG_UNLESS (MpiInterface::GetSize () == ranks,
+                           "the distributed ANN example runs on " << ranks << " ranks (mpirun -np " << ranks <<
+                           "), not " << MpiInterface::GetSize ());
+#else
+      NS_FATAL_ERROR ("--distributed needs ns-3 configured with --enable-mpi");
+#endif
+    }
+  else
+    {
+      GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::RealtimeSimulatorImpl"));
+    }
 
-  /* Create 70 nodes - Remember to adjust NTABLE value to Nodes - 1 */
-  NodeContainer nodes;
-  nodes.Create(70);
+  /* Grid layout - node ids follow the grid */
+  std::vector<Vector> positions;
+  for (uint32_t i = 0; i < nodeCount; i++)
+    {
+      uint32_t island = islands ? i % islands : 0;
+      uint32_t j = islands ? i / islands : i;
+      positions.push_back (Vector (island * gap + (j % columns) * spacing, (j / columns) * spacing, 0.0));
+    }
 
-  /* Bridge nodes to Contiki processes */ 
   SocketBridgeHelper socketBridgeHelper;
-  socketBridgeHelper.Install(nodes, "/cn8801/contiki/examples/ns3-ann/ns3-ann.ns3");
+  if (distributed)
+    {
+      socketBridgeHelper.SetAttribute ("PollInterval", TimeValue (MicroSeconds (pollInterval)));
+    }
+  /* Without MPI every node is on rank 0 */
+  NodeContainer nodes;
+  if (islands)
+    {
+      nodes = socketBridgeHelper.CreateIslandNodes (positions);
+    }
+  else
+    {
+      nodes = socketBridgeHelper.CreatePartitionedNodes (positions);
+    }
+
+  /* Bridge nodes to Contiki processes */
+  socketBridgeHelper.Install (nodes, path, "PHYOVERLAY");
 
   Simulator::Stop (Seconds (1000));
   Simulator::Run ();
   Simulator::Destroy ();
-  
+
+#ifdef NS3_MPI
+  if (distributed)
+    {
+      MpiInterface::Disable ();
+    }
+#endif
   return 0;
 }
@@ -0,0 +1,276 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+//
+// Data path benchmark of SocketBridge.
+//
+// For every combination of node count and mode the benchmark bridges that
+// many instances of socket-bridge-standin (a Contiki stand-in flooding
+// broadcast frames, see socket-bridge-standin.cc) on one SocketChannel, runs
+// the realtime simulator for a fixed duration and measures the frames read
+// from and written to the sockets per second of wall-clock time, together
+// with the end-to-end latency percentiles recorded by the
+// LatencyInstrumentation of the bridges.  The results are written as JSON.
+//
+//   ./waf --run "socket-bridge-bench --nodes=1,10,100 --duration=5 --json=bench.json"
+//
+// --rate is the total number of frames per second offered by all nodes;
+// every frame is delivered to all other nodes.  --protocol=FRAMED runs the
+// bridges and stand-ins with the framed protocol of socket-bridge-protocol.h.
+//
+// The heap allocations per frame read (operator new plus the buffers the
+// bridges allocate for frames read from the sockets) are reported as well;
+// --poolSize=0 disables the IngressPoolSize buffer pool of the bridges for
+// comparison.
+//
+// --backends runs every combination with each IoBackend of the bridges
+// (THREAD, EPOLL, URING) and reports the system calls per frame read or
+// written.  For EPOLL and URING these are counted by the SocketIoService
+// (plus the writes the bridges make themselves); for THREAD they are
+// estimated as the select() and read() of the reader thread per frame read
+// plus the writes of the bridges.
+//
+// With --protocol=FRAMED the bridges coalesce the frames written at one
+// simulation time into one write (see the Coalesce attribute of
+// SocketBridge); --coalesceWindow sets the CoalesceWindow in microseconds
+// and --coalesce=false writes every frame on its own.  The writes per frame
+// written are reported.
+//
+
+#include <stdlib.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/socket-bridge-module.h"
+#include "ns3/socket-bridge-helper.h"
+
+/* Counted from the reader threads as well */
+#define SOCKET_BENCH_COUNT_ALLOCATIONS
+#include "socket-bench-util.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SocketBridgeBench");
+
+struct BenchResult
+{
+  uint32_t nodes;
+  std::string mode;
+  std::string backend;
+  double wallSeconds;
+  uint64_t framesSent;
+  uint64_t framesDelivered;
+  uint64_t framesRead;
+  uint64_t framesWritten;
+  uint64_t socketWrites;
+  uint64_t syscalls;
+  uint64_t allocations;
+  SocketLatencyHistogram latency;
+};
+
+static uint64_t g_framesSent = 0;
+
+static void
+CountTx (Ptr<const Packet> packet)
+{
+  g_framesSent++;
+}
+
+static BenchResult
+RunOnce (uint32_t nodeCount, std::string mode, std::string backend, std::string standin, double duration, double rate,
+         std::string protocol, uint32_t poolSize, bool coalesce, double coalesceWindow)
+{
+  /* The stand-ins inherit their configuration from the environment */
+  std::ostringstream nodeRate;
+  nodeRate << rate / nodeCount;
+  setenv ("SOCKET_BRIDGE_STANDIN_RATE", nodeRate.str ().c_str (), 1);
+
+  /* Lay the nodes out on a square grid with 5 m spacing */
+  uint32_t columns = 1;
+  while (columns * columns < nodeCount)
+    {
+      columns++;
+    }
+  std::vector<Vector> positions;
+  for (uint32_t i = 0; i < nodeCount; i++)
+    {
+      positions.push_back (Vector (5.0 * (i % columns), 5.0 * (i / columns), 0.0));
+    }
+
+  SocketBridgeHelper socketBridgeHelper;
+  socketBridgeHelper.SetAttribute ("LatencyInstrumentation", BooleanValue (true));
+  socketBridgeHelper.SetAttribute ("Protocol", StringValue (protocol));
+  socketBridgeHelper.SetAttribute ("IngressPoolSize", UintegerValue (poolSize));
+  socketBridgeHelper.SetAttribute ("IoBackend", StringValue (backend));
+  socketBridgeHelper.SetAttribute ("Coalesce", BooleanValue (coalesce));
+  socketBridgeHelper.SetAttribute ("CoalesceWindow", TimeValue (MicroSeconds (coalesceWindow)));
+  NodeContainer nodes = socketBridgeHelper.CreatePartitionedNodes (positions);
+  socketBridgeHelper.Install (nodes, standin, mode);
+
+  std::vector<Ptr<SocketBridge> > bridges;
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> (nodes.Get (i)->GetDevice (0));
+      bridge->GetMac ()->TraceConnectWithoutContext ("MacTx", MakeCallback (&CountTx));
+      /* Kill the stand-ins before the next run */
+      bridge->Stop (Seconds (duration));
+      bridges.push_back (bridge);
+    }
+
+  SocketIoService *io = 0;
+  if (backend != "THREAD")
+    {
+      io = SocketIoService::Get (backend == "URING" ? SocketIoService::URING : SocketIoService::EPOLL);
+      backend = io->GetBackend () == SocketIoService::URING ? "URING" : "EPOLL";
+    }
+  uint64_t syscalls = io ? io->GetSyscalls () : 0;
+
+  g_framesSent = 0;
+  uint64_t allocations = g_allocations;
+  uint64_t start = SocketLatencyTag::GetWallClockNs ();
+  Simulator::Stop (Seconds (duration) + MilliSeconds (1));
+  Simulator::Run ();
+
+  BenchResult result;
+  result.nodes = nodeCount;
+  result.mode = mode;
+  result.backend = backend;
+  result.wallSeconds = (SocketLatencyTag::GetWallClockNs () - start) / 1e9;
+  result.framesSent = g_framesSent;
+  result.allocations = g_allocations - allocations;
+  result.framesRead = 0;
+  result.framesWritten = 0;
+  result.socketWrites = 0;
+  for (uint32_t i = 0; i < bridges.size (); i++)
+    {
+      result.latency.Merge (bridges[i]->GetLatencyHistogram (SocketLatencyTag::READ));
+      result.framesRead += bridges[i]->GetFramesRead ();
+      result.framesWritten += bridges[i]->GetFramesWritten ();
+      result.socketWrites += bridges[i]->GetSocketWrites ();
+      result.allocations += bridges[i]->GetBufferAllocations ();
+    }
+  result.framesDelivered = result.latency.GetCount ();
+  result.syscalls = (io ? io->GetSyscalls () - syscalls : 2 * result.framesRead) + result.socketWrites;
+
+  Simulator::Destroy ();
+  return result;
+}
+
+static void
+WriteJson (std::ostream &os, const std::vector<BenchResult> &results, double duration, double rate, uint32_t size, std::string pattern, std::string protocol,
+           uint32_t poolSize, bool coalesce, double coalesceWindow)
+{
+  BeginJson (os, "socket-bridge");
+  os << "  \"duration_s\": " << duration << "," << std::endl;
+  os << "  \"offered_frames_per_s\": " << rate << "," << std::endl;
+  os << "  \"frame_size\": " << size << "," << std::endl;
+  os << "  \"pattern\": \"" << pattern << "\"," << std::endl;
+  os << "  \"protocol\": \"" << protocol << "\"," << std::endl;
+  os << "  \"ingress_pool_size\": " << poolSize << "," << std::endl;
+  os << "  \"coalesce\": " << (coalesce ? "true" : "false") << "," << std::endl;
+  os << "  \"coalesce_window_us\": " << coalesceWindow << "," << std::endl;
+  os << "  \"results\": [" << std::endl;
+  for (uint32_t i = 0; i < results.size (); i++)
+    {
+      const BenchResult &r = results[i];
+      os << "    {\"nodes\": " << r.nodes
+         << ", \"mode\": \"" << r.mode << "\""
+         << ", \"io_backend\": \"" << r.backend << "\""
+         << ", \"wall_s\": " << r.wallSeconds
+         << ", \"frames_sent\": " << r.framesSent
+         << ", \"frames_delivered\": " << r.framesDelivered
+         << ", \"sent_per_s\": " << r.framesSent / r.wallSeconds
+         << ", \"delivered_per_s\": " << r.framesDelivered / r.wallSeconds
+         << ", \"syscalls_per_frame\": " << (r.framesRead + r.framesWritten ? (double)r.syscalls / (r.framesRead + r.framesWritten) : 0.0)
+         << ", \"writes_per_frame_written\": " << (r.framesWritten ? (double)r.socketWrites / r.framesWritten : 0.0)
+         << ", \"allocations_per_frame_read\": " << (r.framesRead ? (double)r.allocations / r.framesRead : 0.0)
+         << ", \"latency_ns\": {\"p50\": " << r.latency.GetPercentile (50)
+         << ", \"p99\": " << r.latency.GetPercentile (99)
+         << ", \"max\": " << r.latency.GetMax ()
+         << ", \"mean\": " << r.latency.GetMean () << "}}"
+         << (i + 1 < results.size () ? "," : "") << std::endl;
+    }
+  os << "  ]" << std::endl;
+  EndJson (os);
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string nodeList = "1,10,100,1000";
+  std::string modeList = "PHYOVERLAY,MACPHYOVERLAY";
+  std::string backendList = "THREAD";
+  std::string standin = "build/src/socket-bridge/examples/socket-bridge-standin";
+  std::string json = "";
+  std::string pattern = "flood";
+  std::string protocol = "RAW";
+  double duration = 10.0;
+  double rate = 100.0;
+  uint32_t size = 40;
+  uint32_t poolSize = 16;
+  bool coalesce = true;
+  double coalesceWindow = 0.0;
+
+  CommandLine cmd;
+  cmd.AddValue ("nodes", "Comma separated node counts", nodeList);
+  cmd.AddValue ("modes", "Comma separated bridge modes", modeList);
+  cmd.AddValue ("backends", "Comma separated IoBackend settings of the bridges", backendList);
+  cmd.AddValue ("standin", "Path of the socket-bridge-standin executable", standin);
+  cmd.AddValue ("duration", "Seconds to run each combination", duration);
+  cmd.AddValue ("rate", "Frames per second offered by all nodes together", rate);
+  cmd.AddValue ("size", "Frame size in bytes", size);
+  cmd.AddValue ("pattern", "flood, or echo to also answer every received frame", pattern);
+  cmd.AddValue ("protocol", "RAW or FRAMED", protocol);
+  cmd.AddValue ("poolSize", "IngressPoolSize of the bridges, 0 to allocate a buffer per frame", poolSize);
+  cmd.AddValue ("coalesce", "Coalesce the frames written to the socket (FRAMED)", coalesce);
+  cmd.AddValue ("coalesceWindow", "CoalesceWindow of the bridges in microseconds", coalesceWindow);
+  cmd.AddValue ("json", "File to write the results to (default stdout)", json);
+  cmd.Parse (argc, argv);
+
+  std::ostringstream frameSize;
+  frameSize << size;
+  setenv ("SOCKET_BRIDGE_STANDIN_SIZE", frameSize.str ().c_str (), 1);
+  setenv ("SOCKET_BRIDGE_STANDIN_MODE", pattern.c_str (), 1);
+
+  GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::RealtimeSimulatorImpl"));
+
+  std::vector<BenchResult> results;
+  std::vector<std::string> counts = Split (nodeList);
+  std::vector<std::string> modes = Split (modeList);
+  std::vector<std::string> backends = Split (backendList);
+  for (uint32_t i = 0; i < counts.size (); i++)
+    {
+      for (uint32_t j = 0; j < modes.size (); j++)
+        {
+          for (uint32_t k = 0; k < backends.size (); k++)
+            {
+              uint32_t nodeCount = atoi (counts[i].c_str ());
+              NS_LOG_UNCOND ("Running " << nodeCount << " nodes in " << modes[j] << " with " << backends[k]);
+              results.push_back (RunOnce (nodeCount, modes[j], backends[k], standin, duration, rate, protocol, poolSize,
+                                          coalesce, coalesceWindow));
+            }
+        }
+    }
+
+  std::ofstream file;
+  WriteJson (OpenJson (json, file), results, duration, rate, size, pattern, protocol, poolSize, coalesce, coalesceWindow);
+
+  return 0;
+}
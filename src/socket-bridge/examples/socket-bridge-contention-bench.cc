@@ -0,0 +1,207 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+//
+// Ingress contention benchmark of SocketBridge.
+//
+// Bridges many busy instances of socket-bridge-standin (see
+// socket-bridge-standin.cc) so that their reader threads compete for the
+// realtime simulator, once with the Inbox attribute of the bridges set and
+// once with an event scheduled per frame.  The nodes are 1 km apart and
+// transmit at 0 dBm with RangeCulling, so no frame is delivered and the run
+// measures the path from the sockets into the simulation alone.  For every
+// setting the frames read and forwarded per second of wall-clock time, the
+// frames still pending at the end, how far the simulator fell behind the
+// wall clock, and the number and mean size of the inbox drains are written
+// as JSON.
+//
+//   ./waf --run "socket-bridge-contention-bench --bridges=500 --rate=50000 --json=contention.json"
+//
+
+#include <stdlib.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/socket-bridge-module.h"
+#include "ns3/socket-bridge-helper.h"
+#include "socket-bench-util.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SocketBridgeContentionBench");
+
+struct ContentionResult
+{
+  bool inbox;
+  double wallSeconds;
+  uint64_t framesRead;
+  uint64_t framesForwarded;
+  uint64_t framesShed;
+  uint32_t backlog;
+  uint64_t batches;
+  uint64_t batchedFrames;
+};
+
+static uint64_t g_framesForwarded = 0;
+static uint32_t g_backlog = 0;
+
+static void
+CountTx (Ptr<const Packet> packet)
+{
+  g_framesForwarded++;
+}
+
+static void
+SampleBacklog (std::vector<Ptr<SocketBridge> > bridges)
+{
+  g_backlog = 0;
+  for (uint32_t i = 0; i < bridges.size (); i++)
+    {
+      g_backlog += bridges[i]->GetPendingFrames ();
+    }
+}
+
+static ContentionResult
+RunOnce (uint32_t bridgeCount, bool inbox, std::string standin, double duration, std::string protocol)
+{
+  std::vector<Vector> positions;
+  for (uint32_t i = 0; i < bridgeCount; i++)
+    {
+      positions.push_back (Vector (1000.0 * i, 0.0, 0.0));
+    }
+
+  SocketBridgeHelper socketBridgeHelper;
+  socketBridgeHelper.SetAttribute ("Inbox", BooleanValue (inbox));
+  socketBridgeHelper.SetAttribute ("Protocol", StringValue (protocol));
+  NodeContainer nodes = socketBridgeHelper.CreatePartitionedNodes (positions);
+  socketBridgeHelper.Install (nodes, standin, "PHYOVERLAY");
+
+  std::vector<Ptr<SocketBridge> > bridges;
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> (nodes.Get (i)->GetDevice (0));
+      bridge->GetMac ()->TraceConnectWithoutContext ("MacTx", MakeCallback (&CountTx));
+      /* Kill the stand-ins before the next run */
+      bridge->Stop (Seconds (duration));
+      bridges.push_back (bridge);
+    }
+
+  const SocketBridgeInbox *stats = SocketBridgeInbox::Get ();
+  uint64_t batches = stats->GetBatches ();
+  uint64_t batchedFrames = stats->GetFrames ();
+  g_framesForwarded = 0;
+  g_backlog = 0;
+  Simulator::Schedule (Seconds (duration) - MilliSeconds (1), &SampleBacklog, bridges);
+  uint64_t start = SocketLatencyTag::GetWallClockNs ();
+  Simulator::Stop (Seconds (duration) + MilliSeconds (1));
+  Simulator::Run ();
+
+  ContentionResult result;
+  result.inbox = inbox;
+  result.wallSeconds = (SocketLatencyTag::GetWallClockNs () - start) / 1e9;
+  result.framesForwarded = g_framesForwarded;
+  result.backlog = g_backlog;
+  result.batches = stats->GetBatches () - batches;
+  result.batchedFrames = stats->GetFrames () - batchedFrames;
+  result.framesRead = 0;
+  result.framesShed = 0;
+  for (uint32_t i = 0; i < bridges.size (); i++)
+    {
+      result.framesRead += bridges[i]->GetFramesRead ();
+      result.framesShed += bridges[i]->GetShedFrames ();
+    }
+
+  Simulator::Destroy ();
+  return result;
+}
+
+static void
+WriteJson (std::ostream &os, const std::vector<ContentionResult> &results, uint32_t bridges, double duration, double rate, std::string protocol)
+{
+  BeginJson (os, "socket-bridge-contention");
+  os << "  \"bridges\": " << bridges << "," << std::endl;
+  os << "  \"duration_s\": " << duration << "," << std::endl;
+  os << "  \"offered_frames_per_s\": " << rate << "," << std::endl;
+  os << "  \"protocol\": \"" << protocol << "\"," << std::endl;
+  os << "  \"results\": [" << std::endl;
+  for (uint32_t i = 0; i < results.size (); i++)
+    {
+      const ContentionResult &r = results[i];
+      os << "    {\"inbox\": " << (r.inbox ? "true" : "false")
+         << ", \"wall_s\": " << r.wallSeconds
+         << ", \"lag_s\": " << (r.wallSeconds > duration ? r.wallSeconds - duration : 0.0)
+         << ", \"frames_read\": " << r.framesRead
+         << ", \"frames_forwarded\": " << r.framesForwarded
+         << ", \"frames_shed\": " << r.framesShed
+         << ", \"backlog\": " << r.backlog
+         << ", \"read_per_s\": " << r.framesRead / r.wallSeconds
+         << ", \"forwarded_per_s\": " << r.framesForwarded / r.wallSeconds
+         << ", \"drains\": " << r.batches
+         << ", \"frames_per_drain\": " << (r.batches ? (double)r.batchedFrames / r.batches : 0.0) << "}"
+         << (i + 1 < results.size () ? "," : "") << std::endl;
+    }
+  os << "  ]" << std::endl;
+  EndJson (os);
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t bridges = 500;
+  std::string inboxList = "true,false";
+  std::string standin = "build/src/socket-bridge/examples/socket-bridge-standin";
+  std::string json = "";
+  std::string protocol = "RAW";
+  double duration = 10.0;
+  double rate = 50000.0;
+
+  CommandLine cmd;
+  cmd.AddValue ("bridges", "Number of bridges", bridges);
+  cmd.AddValue ("inbox", "Comma separated Inbox settings of the bridges", inboxList);
+  cmd.AddValue ("standin", "Path of the socket-bridge-standin executable", standin);
+  cmd.AddValue ("duration", "Seconds to run each setting", duration);
+  cmd.AddValue ("rate", "Frames per second offered by all bridges together", rate);
+  cmd.AddValue ("protocol", "RAW or FRAMED", protocol);
+  cmd.AddValue ("json", "File to write the results to (default stdout)", json);
+  cmd.Parse (argc, argv);
+
+  /* The stand-ins inherit their configuration from the environment */
+  std::ostringstream bridgeRate;
+  bridgeRate << rate / bridges;
+  setenv ("SOCKET_BRIDGE_STANDIN_RATE", bridgeRate.str ().c_str (), 1);
+  setenv ("SOCKET_BRIDGE_STANDIN_MODE", "flood", 1);
+
+  GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::RealtimeSimulatorImpl"));
+  Config::SetDefault ("ns3::SocketContikiPhy::TxPowerDbm", DoubleValue (0.0));
+  Config::SetDefault ("ns3::SocketChannel::RangeCulling", BooleanValue (true));
+
+  std::vector<ContentionResult> results;
+  std::vector<std::string> inboxes = Split (inboxList);
+  for (uint32_t i = 0; i < inboxes.size (); i++)
+    {
+      NS_LOG_UNCOND ("Running " << bridges << " bridges with Inbox " << inboxes[i]);
+      results.push_back (RunOnce (bridges, inboxes[i] == "true", standin, duration, protocol));
+    }
+
+  std::ofstream file;
+  WriteJson (OpenJson (json, file), results, bridges, duration, rate, protocol);
+
+  return 0;
+}
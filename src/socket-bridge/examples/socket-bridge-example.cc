@@ -13,10 +13,30 @@ using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("SocketBridgeExample");
 
+/*
+ * Two Contiki nodes pinging each other.  --record=<prefix> records the
+ * frames read from the Contiki processes; --replay=<prefix> feeds a recording
+ * back without spawning the processes, as fast as the simulator can, e.g.
+ * to profile or to compare runs:
+ *
+ *   ./waf --run "socket-bridge-example --record=ping6"
+ *   ./waf --run "socket-bridge-example --replay=ping6"
+ */
 int 
 main (int argc, char *argv[])
 {
-  GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::RealtimeSimulatorImpl"));
+  std::string record = "";
+  std::string replay = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("record", "Record the frames read by the bridges to <prefix>-<node>.sbrl", record);
+  cmd.AddValue ("replay", "Replay <prefix>-<node>.sbrl instead of running Contiki", replay);
+  cmd.Parse (argc, argv);
+
+  if (replay.empty ())
+    {
+      GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::RealtimeSimulatorImpl"));
+    }
   GlobalValue::Bind ("ChecksumEnabled", BooleanValue (true));
 
   /* Create 2 nodes */
@@ -26,6 +46,14 @@ main (int argc, char *argv[])
   /* Bridge nodes to Contiki processes */ 
   SocketBridgeHelper socketBridgeHelper;
   socketBridgeHelper.Install(nodes, "/cn8801/contiki/examples/ns3-ping6/example-ping6.ns3", "PHYOVERLAY");
+  if (!record.empty ())
+    {
+      socketBridgeHelper.EnableRecording (record, nodes);
+    }
+  if (!replay.empty ())
+    {
+      socketBridgeHelper.EnableReplay (replay, nodes);
+    }
 
   Simulator::Stop (Seconds (1000));
   Simulator::Run ();
@@ -0,0 +1,116 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+//
+// Checkpoint and fork of a warmed-up network.
+//
+// A grid of socket-bridge-standin nodes (see socket-bridge-bench.cc) runs in
+// real time for --warmup seconds.  The simulation is then forked into --runs
+// runs with SocketBridgeHelper::Fork; each run continues from the warmed-up
+// state with its own copies of the processes, uses its own transmit power
+// and reports the frames its bridges read.
+//
+//   ./waf --run "socket-bridge-fork-example --nodes=9 --warmup=5 --runs=4"
+//
+
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/socket-bridge-module.h"
+#include "ns3/socket-bridge-helper.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SocketBridgeForkExample");
+
+static uint32_t g_run = 0;
+
+static void
+ForkRuns (NodeContainer nodes, uint32_t runs)
+{
+  g_run = SocketBridgeHelper::Fork (nodes, runs);
+
+  /* The parameter point of this run */
+  double txPower = 0.0 - 5.0 * g_run;
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> (nodes.Get (i)->GetDevice (0));
+      bridge->GetPhy ()->SetTxPowerDbm (txPower);
+    }
+  NS_LOG_UNCOND ("Run " << g_run << " continues at " << Simulator::Now ().GetSeconds () << "s with " << txPower << " dBm");
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t nodeCount = 9;
+  uint32_t runs = 4;
+  double warmup = 5.0;
+  double duration = 5.0;
+  std::string standin = "build/src/socket-bridge/examples/socket-bridge-standin";
+
+  CommandLine cmd;
+  cmd.AddValue ("nodes", "Number of nodes", nodeCount);
+  cmd.AddValue ("runs", "Number of runs forked from the warmed-up state", runs);
+  cmd.AddValue ("warmup", "Seconds to run before forking", warmup);
+  cmd.AddValue ("duration", "Seconds each run continues after the fork", duration);
+  cmd.AddValue ("standin", "Path of the socket-bridge-standin executable", standin);
+  cmd.Parse (argc, argv);
+
+  GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::RealtimeSimulatorImpl"));
+
+  uint32_t columns = 1;
+  while (columns * columns < nodeCount)
+    {
+      columns++;
+    }
+  std::vector<Vector> positions;
+  for (uint32_t i = 0; i < nodeCount; i++)
+    {
+      positions.push_back (Vector (5.0 * (i % columns), 5.0 * (i / columns), 0.0));
+    }
+
+  /* Forking needs the control messages of the framed protocol */
+  SocketBridgeHelper socketBridgeHelper;
+  socketBridgeHelper.SetAttribute ("Protocol", StringValue ("FRAMED"));
+  NodeContainer nodes = socketBridgeHelper.CreatePartitionedNodes (positions);
+  socketBridgeHelper.Install (nodes, standin, "PHYOVERLAY");
+
+  Simulator::Schedule (Seconds (warmup), &ForkRuns, nodes, runs);
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      DynamicCast<SocketBridge> (nodes.Get (i)->GetDevice (0))->Stop (Seconds (warmup + duration));
+    }
+  Simulator::Stop (Seconds (warmup + duration) + MilliSeconds (1));
+  Simulator::Run ();
+
+  uint64_t framesRead = 0;
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      framesRead += DynamicCast<SocketBridge> (nodes.Get (i)->GetDevice (0))->GetFramesRead ();
+    }
+  NS_LOG_UNCOND ("Run " << g_run << ": " << framesRead << " frames read");
+
+  Simulator::Destroy ();
+  SocketBridgeHelper::WaitForRuns ();
+  return 0;
+}
@@ -0,0 +1,295 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+//
+// Lightweight stand-in for a Contiki node, to be used as the executable of a
+// SocketBridge (see socket-bridge-bench).  It does not link against ns-3.
+//
+// Like a Contiki ns-3 node it is started with the bridge socket on stdin and
+// its address as "-a<mac64>", followed by "-f" when the bridge speaks the
+// framed protocol of socket-bridge-protocol.h.  It floods 802.15.4 broadcast data frames at a
+// fixed rate and drains every frame it is sent.  In echo mode it also
+// answers every request frame it receives with an echo frame.  With the framed
+// protocol it forks itself on SBP_CTRL_FORK (see SocketBridgeHelper::Fork).
+//
+// Configuration comes from the environment so that the bridge does not need
+// to pass extra arguments:
+//
+//   SOCKET_BRIDGE_STANDIN_RATE   frames per second to send (default 10, 0 disables)
+//   SOCKET_BRIDGE_STANDIN_SIZE   frame size in bytes (default 40, 17 to 127)
+//   SOCKET_BRIDGE_STANDIN_MODE   "flood" (default) or "echo"
+//
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../model/socket-bridge-protocol.h"
+
+static const int SOCKET_FD = 0;
+static const uint8_t REQUEST = 'R';
+static const uint8_t ECHO = 'E';
+
+/* FCF: data frame, PAN ID compression, short destination, extended source */
+static const uint8_t FCF_LOW = 0x41;
+static const uint8_t FCF_HIGH = 0xc8;
+static const uint32_t HEADER_SIZE = 15;
+static const uint32_t FCS_SIZE = 2;
+
+static uint64_t
+NowNs (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+ParseAddress (const char *arg, uint8_t address[8])
+{
+  /* "-a00:00:00:00:00:00:00:01" */
+  memset (address, 0, 8);
+  if (arg == NULL || strncmp (arg, "-a", 2) != 0)
+    {
+      return;
+    }
+  unsigned int bytes[8];
+  if (sscanf (arg + 2, "%x:%x:%x:%x:%x:%x:%x:%x", &bytes[0], &bytes[1], &bytes[2], &bytes[3],
+              &bytes[4], &bytes[5], &bytes[6], &bytes[7]) == 8)
+    {
+      for (int i = 0; i < 8; i++)
+        {
+          address[i] = bytes[i];
+        }
+    }
+}
+
+static uint32_t
+BuildFrame (uint8_t *frame, uint32_t size, uint8_t seq, const uint8_t address[8], uint8_t kind)
+{
+  frame[0] = FCF_LOW;
+  frame[1] = FCF_HIGH;
+  frame[2] = seq;
+  frame[3] = 0xcd;              /* destination PAN 0xabcd */
+  frame[4] = 0xab;
+  frame[5] = 0xff;              /* broadcast */
+  frame[6] = 0xff;
+  for (int i = 0; i < 8; i++)
+    {
+      /* extended addresses are sent least significant byte first */
+      frame[7 + i] = address[7 - i];
+    }
+  frame[HEADER_SIZE] = kind;
+  memset (frame + HEADER_SIZE + 1, 0x5a, size - HEADER_SIZE - 1 - FCS_SIZE);
+  frame[size - 2] = 0;
+  frame[size - 1] = 0;
+  return size;
+}
+
+static bool
+WriteAll (const uint8_t *buf, uint32_t len)
+{
+  while (len > 0)
+    {
+      ssize_t n = write (SOCKET_FD, buf, len);
+      if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      if (n <= 0)
+        {
+          return false;
+        }
+      buf += n;
+      len -= n;
+    }
+  return true;
+}
+
+static bool
+WriteFrame (const uint8_t *frame, uint32_t len, bool framed)
+{
+  if (!framed)
+    {
+      return WriteAll (frame, len);
+    }
+  uint8_t message[SBP_HEADER_LEN + 128];
+  sbp_write_header (message, SBP_TYPE_DATA, len);
+  memcpy (message + SBP_HEADER_LEN, frame, len);
+  return WriteAll (message, SBP_HEADER_LEN + len);
+}
+
+/* read() that also returns a socket passed with SBP_CTRL_FORK, -1 if none */
+static ssize_t
+ReadSocket (uint8_t *buf, uint32_t len, int *passedFd)
+{
+  char control[CMSG_SPACE (sizeof (int))];
+  struct iovec iov;
+  iov.iov_base = buf;
+  iov.iov_len = len;
+  struct msghdr msg;
+  memset (&msg, 0, sizeof (msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof (control);
+
+  *passedFd = -1;
+  ssize_t n = recvmsg (SOCKET_FD, &msg, 0);
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (&msg); n > 0 && cmsg != NULL; cmsg = CMSG_NXTHDR (&msg, cmsg))
+    {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+          memcpy (passedFd, CMSG_DATA (cmsg), sizeof (int));
+        }
+    }
+  return n;
+}
+
+/* Fork onto the passed socket; returns false in the new process if it cannot announce itself */
+static bool
+Fork (int passedFd)
+{
+  pid_t child = fork ();
+  if (child != 0)
+    {
+      close (passedFd);
+      return true;
+    }
+  dup2 (passedFd, SOCKET_FD);
+  close (passedFd);
+  uint8_t message[SBP_HEADER_LEN + 5];
+  sbp_write_header (message, SBP_TYPE_CONTROL, 5);
+  message[SBP_HEADER_LEN] = SBP_CTRL_FORKED;
+  sbp_put_u32 (message + SBP_HEADER_LEN + 1, getpid ());
+  return WriteAll (message, sizeof (message));
+}
+
+int
+main (int argc, char *argv[])
+{
+  signal (SIGPIPE, SIG_IGN);
+  signal (SIGCHLD, SIG_IGN);
+
+  const char *env = getenv ("SOCKET_BRIDGE_STANDIN_RATE");
+  double rate = env ? atof (env) : 10.0;
+  env = getenv ("SOCKET_BRIDGE_STANDIN_SIZE");
+  uint32_t size = env ? atoi (env) : 40;
+  if (size < HEADER_SIZE + 1 + FCS_SIZE)
+    {
+      size = HEADER_SIZE + 1 + FCS_SIZE;
+    }
+  if (size > 127)
+    {
+      size = 127;
+    }
+  env = getenv ("SOCKET_BRIDGE_STANDIN_MODE");
+  bool echo = env && strcmp (env, "echo") == 0;
+
+  uint8_t address[8];
+  ParseAddress (argc > 1 ? argv[1] : NULL, address);
+  bool framed = argc > 2 && strcmp (argv[2], "-f") == 0;
+  uint32_t offset = framed ? SBP_HEADER_LEN : 0;
+
+  uint64_t period = rate > 0 ? (uint64_t)(1e9 / rate) : 0;
+  /* Spread the first frames of all nodes over one period */
+  uint64_t next = NowNs () + (period ? ((uint64_t)getpid () * 7919) % period : 0);
+  uint8_t seq = 0;
+  uint8_t frame[128];
+  uint8_t buf[4096];
+
+  for (;;)
+    {
+      int timeout = -1;
+      if (period)
+        {
+          uint64_t now = NowNs ();
+          while (next <= now)
+            {
+              uint32_t len = BuildFrame (frame, size, seq++, address, REQUEST);
+              if (!WriteFrame (frame, len, framed))
+                {
+                  return 0;
+                }
+              next += period;
+            }
+          timeout = (int)((next - now) / 1000000);
+        }
+
+      struct pollfd pfd;
+      pfd.fd = SOCKET_FD;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      int ready = poll (&pfd, 1, timeout);
+      if (ready < 0 && errno != EINTR)
+        {
+          return 1;
+        }
+      if (ready <= 0)
+        {
+          continue;
+        }
+
+      int passedFd;
+      ssize_t n = ReadSocket (buf, sizeof (buf), &passedFd);
+      if (n <= 0)
+        {
+          /* The bridge has gone away */
+          return 0;
+        }
+      /* The bridge sends nothing else while waiting for the forked process */
+      if (passedFd >= 0)
+        {
+          if (!Fork (passedFd))
+            {
+              return 0;
+            }
+          continue;
+        }
+      //
+      // A RAW read holds one frame; a FRAMED read may hold several messages
+      // written together by the bridge (a message split across reads is
+      // not inspected).
+      //
+      ssize_t pos = 0;
+      while (echo && n - pos > (ssize_t)(offset + HEADER_SIZE))
+        {
+          const uint8_t *message = buf + pos;
+          if (message[offset + HEADER_SIZE] == REQUEST
+              && (!framed || sbp_header_type (message) == SBP_TYPE_DATA))
+            {
+              uint32_t len = BuildFrame (frame, size, seq++, address, ECHO);
+              if (!WriteFrame (frame, len, framed))
+                {
+                  return 0;
+                }
+            }
+          if (!framed)
+            {
+              break;
+            }
+          pos += SBP_HEADER_LEN + sbp_header_length (message);
+        }
+    }
+  return 0;
+}
@@ -0,0 +1,243 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+//
+// Headless scaling benchmark of SocketChannel and SocketContikiPhy.
+//
+// No SocketBridge and no external process is involved: every node is a
+// SocketNullMac on top of a SocketContikiPhy attached to one SocketChannel.
+// Synthetic frames are injected through SocketNullMac::Enqueue and the
+// default (non realtime) simulator runs as fast as it can.  For every node
+// count the benchmark reports
+//
+//   - frames transmitted and deliveries to MACs,
+//   - events per second of wall-clock time, counting the transmission and
+//     the receive start and end of every delivery,
+//   - heap allocations per transmitted frame (operator new is counted),
+//   - wall-clock time per simulated second.
+//
+//   ./waf --run "socket-channel-bench --nodes=100,1000,10000 --layout=random"
+//
+// --txPower sets the transmit power of every PHY and --culling enables the
+// RangeCulling of the channel, e.g. to compare 65 dBm against a realistic
+// 0 dBm.
+//
+
+#include <stdlib.h>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/socket-bridge-module.h"
+
+#define SOCKET_BENCH_COUNT_ALLOCATIONS
+#include "socket-bench-util.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SocketChannelBench");
+
+struct ChannelBenchResult
+{
+  uint32_t nodes;
+  double wallSeconds;
+  uint64_t framesSent;
+  uint64_t deliveries;
+  uint64_t allocations;
+};
+
+static uint64_t g_framesSent = 0;
+static uint64_t g_deliveries = 0;
+
+static void
+CountTx (Ptr<const Packet> packet)
+{
+  g_framesSent++;
+}
+
+static void
+CountRx (Ptr<const Packet> packet)
+{
+  g_deliveries++;
+}
+
+static Vector
+GetPosition (std::string layout, uint32_t i, uint32_t nodeCount, double spacing, UniformVariable &random)
+{
+  uint32_t columns = (uint32_t)ceil (sqrt ((double)nodeCount));
+  if (layout == "line")
+    {
+      return Vector (spacing * i, 0.0, 0.0);
+    }
+  else if (layout == "random")
+    {
+      /* Same density as the grid */
+      double side = spacing * columns;
+      return Vector (random.GetValue (0.0, side), random.GetValue (0.0, side), 0.0);
+    }
+  return Vector (spacing * (i % columns), spacing * (i / columns), 0.0);
+}
+
+static void
+SendFrame (Ptr<SocketNullMac> mac, uint32_t size, Time interval, Time stop)
+{
+  mac->Enqueue (Create<Packet> (size));
+  if (Simulator::Now () + interval < stop)
+    {
+      Simulator::Schedule (interval, &SendFrame, mac, size, interval, stop);
+    }
+}
+
+static ChannelBenchResult
+RunOnce (uint32_t nodeCount, std::string layout, double spacing, std::string loss,
+         double rate, uint32_t size, double simTime)
+{
+  Ptr<SocketChannel> channel = CreateObject<SocketChannel> ();
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+  ObjectFactory lossFactory;
+  lossFactory.SetTypeId (loss);
+  channel->SetPropagationLossModel (lossFactory.Create<PropagationLossModel> ());
+
+  UniformVariable random;
+  std::vector<Ptr<SocketNullMac> > macs;
+  for (uint32_t i = 0; i < nodeCount; i++)
+    {
+      Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+      mobility->SetPosition (GetPosition (layout, i, nodeCount, spacing, random));
+
+      Ptr<SocketNullMac> mac = CreateObject<SocketNullMac> ();
+      Ptr<SocketContikiPhy> phy = CreateObject<SocketContikiPhy> ();
+      mac->SetPhy (phy);
+      phy->SetMode (SocketContikiPhy::DSSS_O_QPSK_GHz);
+      phy->SetMobility (mobility);
+      phy->SetChannel (channel);
+      mac->TraceConnectWithoutContext ("MacTx", MakeCallback (&CountTx));
+      mac->TraceConnectWithoutContext ("MacRx", MakeCallback (&CountRx));
+      macs.push_back (mac);
+    }
+
+  /* Every node sends rate / nodeCount frames per second, starting at a random offset */
+  Time interval = Seconds (nodeCount / rate);
+  Time stop = Seconds (simTime);
+  for (uint32_t i = 0; i < nodeCount; i++)
+    {
+      Time start = Seconds (random.GetValue (0.0, interval.GetSeconds ()));
+      if (start < stop)
+        {
+          Simulator::Schedule (start, &SendFrame, macs[i], size, interval, stop);
+        }
+    }
+
+  g_framesSent = 0;
+  g_deliveries = 0;
+  uint64_t allocations = g_allocations;
+  double start = WallClockSeconds ();
+  Simulator::Stop (stop);
+  Simulator::Run ();
+
+  ChannelBenchResult result;
+  result.nodes = nodeCount;
+  result.wallSeconds = WallClockSeconds () - start;
+  result.allocations = g_allocations - allocations;
+  result.framesSent = g_framesSent;
+  result.deliveries = g_deliveries;
+
+  Simulator::Destroy ();
+  return result;
+}
+
+static void
+WriteJson (std::ostream &os, const std::vector<ChannelBenchResult> &results, std::string layout,
+           double spacing, std::string loss, double rate, uint32_t size, double simTime,
+           double txPower, bool culling)
+{
+  BeginJson (os, "socket-channel");
+  os << "  \"layout\": \"" << layout << "\"," << std::endl;
+  os << "  \"spacing_m\": " << spacing << "," << std::endl;
+  os << "  \"loss\": \"" << loss << "\"," << std::endl;
+  os << "  \"offered_frames_per_s\": " << rate << "," << std::endl;
+  os << "  \"frame_size\": " << size << "," << std::endl;
+  os << "  \"sim_time_s\": " << simTime << "," << std::endl;
+  os << "  \"tx_power_dbm\": " << txPower << "," << std::endl;
+  os << "  \"range_culling\": " << (culling ? "true" : "false") << "," << std::endl;
+  os << "  \"results\": [" << std::endl;
+  for (uint32_t i = 0; i < results.size (); i++)
+    {
+      const ChannelBenchResult &r = results[i];
+      uint64_t events = r.framesSent + 2 * r.deliveries;
+      os << "    {\"nodes\": " << r.nodes
+         << ", \"wall_s\": " << r.wallSeconds
+         << ", \"frames_sent\": " << r.framesSent
+         << ", \"deliveries\": " << r.deliveries
+         << ", \"events_per_s\": " << events / r.wallSeconds
+         << ", \"allocations_per_frame\": " << (r.framesSent ? (double)r.allocations / r.framesSent : 0.0)
+         << ", \"allocations_per_delivery\": " << (r.deliveries ? (double)r.allocations / r.deliveries : 0.0)
+         << ", \"wall_s_per_sim_s\": " << r.wallSeconds / simTime << "}"
+         << (i + 1 < results.size () ? "," : "") << std::endl;
+    }
+  os << "  ]" << std::endl;
+  EndJson (os);
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string nodeList = "10,100,1000,10000";
+  std::string layout = "grid";
+  std::string loss = "ns3::LogDistancePropagationLossModel";
+  std::string json = "";
+  double spacing = 5.0;
+  double rate = 100.0;
+  double simTime = 1.0;
+  uint32_t size = 40;
+  double txPower = 65.0;
+  bool culling = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("nodes", "Comma separated node counts", nodeList);
+  cmd.AddValue ("layout", "Node layout: grid, line or random", layout);
+  cmd.AddValue ("spacing", "Distance between neighbouring nodes in meters", spacing);
+  cmd.AddValue ("loss", "TypeId of the propagation loss model", loss);
+  cmd.AddValue ("rate", "Frames per simulated second offered by all nodes together", rate);
+  cmd.AddValue ("size", "Frame size in bytes", size);
+  cmd.AddValue ("simTime", "Simulated seconds per node count", simTime);
+  cmd.AddValue ("txPower", "Transmit power of every node in dBm", txPower);
+  cmd.AddValue ("culling", "Skip receivers out of range before evaluating the loss model", culling);
+  cmd.AddValue ("json", "File to write the results to (default stdout)", json);
+  cmd.Parse (argc, argv);
+
+  Config::SetDefault ("ns3::SocketContikiPhy::TxPowerDbm", DoubleValue (txPower));
+  Config::SetDefault ("ns3::SocketChannel::RangeCulling", BooleanValue (culling));
+
+  std::vector<ChannelBenchResult> results;
+  std::vector<std::string> counts = Split (nodeList);
+  for (uint32_t i = 0; i < counts.size (); i++)
+    {
+      uint32_t nodeCount = atoi (counts[i].c_str ());
+      NS_LOG_UNCOND ("Running " << nodeCount << " nodes");
+      results.push_back (RunOnce (nodeCount, layout, spacing, loss, rate, size, simTime));
+    }
+
+  std::ofstream file;
+  WriteJson (OpenJson (json, file), results, layout, spacing, loss, rate, size, simTime, txPower, culling);
+
+  return 0;
+}
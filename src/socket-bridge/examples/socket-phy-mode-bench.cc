@@ -0,0 +1,191 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+//
+// Benchmark of the per-frame work of the SocketContikiPhy receive path.
+//
+// For every PhyMode the receive decision (energy detection threshold and
+// frame duration) is made for a mix of frame sizes and receive powers in
+// three ways:
+//
+//   formula      the mode is switched on and the duration computed for
+//                every frame, as SocketContikiPhy used to do
+//   table        the duration is looked up with the mode of the PHY, as
+//                SocketContikiPhy::CalculateTxDuration does
+//   specialised  every frame goes through a member function pointer to a
+//                decision instantiated for the mode and compares against
+//                the threshold of the PHY read at run time, as
+//                StartReceivePacket does with the path selected by SetMode
+//
+// and the frames per second are reported as JSON.
+//
+//   ./waf --run "socket-phy-mode-bench --frames=100000000"
+//
+
+#include <iostream>
+
+#include "ns3/core-module.h"
+#include "ns3/socket-contiki-phy.h"
+#include "socket-bench-util.h"
+
+using namespace ns3;
+
+/* Frame sizes and receive powers cycled through by every loop */
+static const uint32_t g_sizes[8] = { 5, 21, 40, 64, 80, 102, 127, 11 };
+static const double g_powers[8] = { -60.0, -95.0, -70.0, -88.0, -80.0, -100.0, -50.0, -86.0 };
+
+static uint64_t
+RunFormula (SocketContikiPhy::PhyMode mode, double threshold, uint32_t frames)
+{
+  uint64_t checksum = 0;
+  for (uint32_t i = 0; i < frames; i++)
+    {
+      if (g_powers[i & 7] > threshold)
+        {
+          checksum += SocketContikiPhy::CalculateReferenceTxDuration (mode, g_sizes[i & 7]);
+        }
+    }
+  return checksum;
+}
+
+static uint64_t
+RunTable (Ptr<SocketContikiPhy> phy, uint32_t frames)
+{
+  uint64_t checksum = 0;
+  double threshold = phy->GetEdThreshold ();
+  for (uint32_t i = 0; i < frames; i++)
+    {
+      if (g_powers[i & 7] > threshold)
+        {
+          checksum += phy->CalculateTxDuration (g_sizes[i & 7]).GetMicroSeconds ();
+        }
+    }
+  return checksum;
+}
+
+/*
+ * The receive decision of SocketContikiPhy::StartReceivePacket without the
+ * scheduling: a call through the member pointer selected for the mode of
+ * the PHY, comparing against its energy detection threshold.
+ */
+class ReceivePath
+{
+public:
+  ReceivePath (Ptr<SocketContikiPhy> phy)
+    : m_edThresholdDbm (phy->GetEdThreshold ()),
+      m_checksum (0)
+  {
+    switch (phy->GetMode ())
+      {
+      case SocketContikiPhy::DSSS_BPSK:
+        m_startReceive = &ReceivePath::DoStartReceive<SocketContikiPhy::DSSS_BPSK>;
+        break;
+      case SocketContikiPhy::DSSS_O_QPSK_MHz:
+        m_startReceive = &ReceivePath::DoStartReceive<SocketContikiPhy::DSSS_O_QPSK_MHz>;
+        break;
+      case SocketContikiPhy::PSSS_ASK:
+        m_startReceive = &ReceivePath::DoStartReceive<SocketContikiPhy::PSSS_ASK>;
+        break;
+      default:
+        m_startReceive = &ReceivePath::DoStartReceive<SocketContikiPhy::DSSS_O_QPSK_GHz>;
+        break;
+      }
+  }
+
+  void StartReceive (uint32_t size, double rxPowerDbm)
+  {
+    (this->*m_startReceive)(size, rxPowerDbm);
+  }
+
+  uint64_t GetChecksum (void) const
+  {
+    return m_checksum;
+  }
+
+private:
+  typedef void (ReceivePath::*StartReceiveFn)(uint32_t, double);
+
+  template <SocketContikiPhy::PhyMode mode>
+  void DoStartReceive (uint32_t size, double rxPowerDbm)
+  {
+    if (rxPowerDbm > m_edThresholdDbm)
+      {
+        m_checksum += SocketContikiPhy::GetTxDurationUs<mode> (size);
+      }
+  }
+
+  StartReceiveFn m_startReceive;
+  double m_edThresholdDbm;
+  uint64_t m_checksum;
+};
+
+static uint64_t
+RunSpecialised (Ptr<SocketContikiPhy> phy, uint32_t frames)
+{
+  ReceivePath path (phy);
+  for (uint32_t i = 0; i < frames; i++)
+    {
+      path.StartReceive (g_sizes[i & 7], g_powers[i & 7]);
+    }
+  return path.GetChecksum ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t frames = 50000000;
+
+  CommandLine cmd;
+  cmd.AddValue ("frames", "Number of frames per mode and variant", frames);
+  cmd.Parse (argc, argv);
+
+  static const char *names[4] = { "DSSS_BPSK", "DSSS_O_QPSK_MHz", "DSSS_O_QPSK_GHz", "PSSS_ASK" };
+  Ptr<SocketContikiPhy> phy = CreateObject<SocketContikiPhy> ();
+  uint64_t checksum = 0;
+
+  BeginJson (std::cout, "socket-phy-mode");
+  std::cout << "  \"frames\": " << frames << "," << std::endl;
+  std::cout << "  \"results\": [" << std::endl;
+  for (uint32_t m = SocketContikiPhy::DSSS_BPSK; m <= SocketContikiPhy::PSSS_ASK; m++)
+    {
+      SocketContikiPhy::PhyMode mode = (SocketContikiPhy::PhyMode)m;
+      phy->SetMode (mode);
+
+      double start = WallClockSeconds ();
+      checksum += RunFormula (mode, phy->GetEdThreshold (), frames);
+      double formula = WallClockSeconds () - start;
+
+      start = WallClockSeconds ();
+      checksum += RunTable (phy, frames);
+      double table = WallClockSeconds () - start;
+
+      start = WallClockSeconds ();
+      checksum += RunSpecialised (phy, frames);
+      double specialised = WallClockSeconds () - start;
+
+      std::cout << "    {\"mode\": \"" << names[m] << "\""
+                << ", \"formula_frames_per_s\": " << frames / formula
+                << ", \"table_frames_per_s\": " << frames / table
+                << ", \"specialised_frames_per_s\": " << frames / specialised << "}"
+                << (m < SocketContikiPhy::PSSS_ASK ? "," : "") << std::endl;
+    }
+  std::cout << "  ]," << std::endl;
+  /* Keeps the compiler from dropping the work */
+  std::cout << "  \"checksum\": " << checksum << std::endl;
+  EndJson (std::cout);
+
+  return 0;
+}
@@ -0,0 +1,445 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+//
+// Offline analysis of a binary event trace written by SocketEventTrace (see
+// SocketBridgeHelper::EnableEventTrace and socket-event-trace-format.h).  It
+// does not link against ns-3.
+//
+// The trace is mapped into memory and split between threads, which compute
+// per-node throughput, packet delivery ratio (frames sent by the node that
+// were received by at least one other node), drops, queue lengths and the
+// distribution of the wall-clock latency.  The results are written as JSON.
+//
+//   socket-trace-analyzer [--threads=N] [--json=results.json] trace.sbet
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../model/socket-event-trace-format.h"
+
+/* Log-linear latency buckets: 8 per power of two */
+static const uint32_t SUB_BUCKETS = 8;
+static const uint32_t BUCKETS = 64 * SUB_BUCKETS;
+
+static uint32_t
+Bucket (uint64_t value)
+{
+  if (value < SUB_BUCKETS)
+    {
+      return value;
+    }
+  uint32_t exponent = 63 - __builtin_clzll (value);
+  return exponent * SUB_BUCKETS + ((value >> (exponent - 3)) & (SUB_BUCKETS - 1));
+}
+
+/* The middle of a bucket */
+static uint64_t
+BucketValue (uint32_t bucket)
+{
+  if (bucket < SUB_BUCKETS)
+    {
+      return bucket;
+    }
+  uint32_t exponent = bucket / SUB_BUCKETS;
+  return ((uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << (exponent - 3)) + ((uint64_t)1 << (exponent - 4));
+}
+
+struct NodeStats
+{
+  uint64_t txFrames;
+  uint64_t txBytes;
+  uint64_t rxFrames;
+  uint64_t rxBytes;
+  uint64_t drops;
+  uint64_t shed;
+  uint64_t delivered;
+  uint64_t queueEvents;
+  uint64_t queueSum;
+  uint64_t queueMax;
+  uint64_t latencyCount;
+  uint64_t latencyMax;
+  uint64_t latency[BUCKETS];
+};
+
+struct Worker
+{
+  pthread_t thread;
+  const struct set_record *begin;
+  const struct set_record *end;
+  /* Pass 1 */
+  uint32_t maxNode;
+  uint32_t maxUid;
+  int64_t firstNs;
+  int64_t lastNs;
+  /* Pass 2 */
+  uint32_t nodes;
+  uint32_t *sender;
+  uint8_t *received;
+  std::vector<NodeStats> stats;
+  /* Pass 3, over UIDs rather than records */
+  uint32_t uidBegin;
+  uint32_t uidEnd;
+};
+
+static void *
+ScanRange (void *arg)
+{
+  Worker *w = (Worker *)arg;
+  w->maxNode = 0;
+  w->maxUid = 0;
+  w->firstNs = std::numeric_limits<int64_t>::max ();
+  w->lastNs = std::numeric_limits<int64_t>::min ();
+  for (const struct set_record *r = w->begin; r < w->end; r++)
+    {
+      if (r->node > w->maxNode)
+        {
+          w->maxNode = r->node;
+        }
+      if (r->uid > w->maxUid)
+        {
+          w->maxUid = r->uid;
+        }
+      if (r->time_ns < w->firstNs)
+        {
+          w->firstNs = r->time_ns;
+        }
+      if (r->time_ns > w->lastNs)
+        {
+          w->lastNs = r->time_ns;
+        }
+    }
+  return 0;
+}
+
+static void *
+CountRange (void *arg)
+{
+  Worker *w = (Worker *)arg;
+  w->stats.assign (w->nodes, NodeStats ());
+  for (const struct set_record *r = w->begin; r < w->end; r++)
+    {
+      NodeStats &s = w->stats[r->node];
+      switch (r->type)
+        {
+        case SET_EVENT_TX:
+          s.txFrames++;
+          s.txBytes += r->size;
+          if (r->uid != 0)
+            {
+              /* Every UID is sent once, so no two threads write the same entry */
+              w->sender[r->uid] = r->node + 1;
+            }
+          break;
+        case SET_EVENT_RX:
+          s.rxFrames++;
+          s.rxBytes += r->size;
+          if (r->uid != 0)
+            {
+              __sync_lock_test_and_set (&w->received[r->uid], 1);
+            }
+          break;
+        case SET_EVENT_DROP:
+          if (r->uid == 0)
+            {
+              s.shed++;
+            }
+          else
+            {
+              s.drops++;
+            }
+          break;
+        case SET_EVENT_QUEUE:
+          s.queueEvents++;
+          s.queueSum += r->value;
+          if (r->value > s.queueMax)
+            {
+              s.queueMax = r->value;
+            }
+          break;
+        case SET_EVENT_LATENCY:
+          s.latencyCount++;
+          s.latency[Bucket (r->value)]++;
+          if (r->value > s.latencyMax)
+            {
+              s.latencyMax = r->value;
+            }
+          break;
+        }
+    }
+  return 0;
+}
+
+static void *
+DeliverRange (void *arg)
+{
+  Worker *w = (Worker *)arg;
+  for (uint32_t uid = w->uidBegin; uid < w->uidEnd; uid++)
+    {
+      if (w->received[uid] && w->sender[uid])
+        {
+          w->stats[w->sender[uid] - 1].delivered++;
+        }
+    }
+  return 0;
+}
+
+static void
+RunWorkers (std::vector<Worker> &workers, void *(*fn) (void *))
+{
+  for (uint32_t i = 0; i < workers.size (); i++)
+    {
+      pthread_create (&workers[i].thread, NULL, fn, &workers[i]);
+    }
+  for (uint32_t i = 0; i < workers.size (); i++)
+    {
+      pthread_join (workers[i].thread, NULL);
+    }
+}
+
+static uint64_t
+Percentile (const NodeStats &s, double percentile)
+{
+  if (s.latencyCount == 0)
+    {
+      return 0;
+    }
+  uint64_t rank = (uint64_t)(s.latencyCount * percentile / 100.0);
+  if (rank >= s.latencyCount)
+    {
+      rank = s.latencyCount - 1;
+    }
+  uint64_t seen = 0;
+  for (uint32_t b = 0; b < BUCKETS; b++)
+    {
+      seen += s.latency[b];
+      if (seen > rank)
+        {
+          return std::min (BucketValue (b), s.latencyMax);
+        }
+    }
+  return s.latencyMax;
+}
+
+static void
+Merge (NodeStats &to, const NodeStats &from)
+{
+  to.txFrames += from.txFrames;
+  to.txBytes += from.txBytes;
+  to.rxFrames += from.rxFrames;
+  to.rxBytes += from.rxBytes;
+  to.drops += from.drops;
+  to.shed += from.shed;
+  to.delivered += from.delivered;
+  to.queueEvents += from.queueEvents;
+  to.queueSum += from.queueSum;
+  if (from.queueMax > to.queueMax)
+    {
+      to.queueMax = from.queueMax;
+    }
+  to.latencyCount += from.latencyCount;
+  if (from.latencyMax > to.latencyMax)
+    {
+      to.latencyMax = from.latencyMax;
+    }
+  for (uint32_t b = 0; b < BUCKETS; b++)
+    {
+      to.latency[b] += from.latency[b];
+    }
+}
+
+static void
+WriteStats (std::ostream &os, const NodeStats &s, double duration)
+{
+  os << "\"tx_frames\": " << s.txFrames
+     << ", \"tx_bytes_per_s\": " << (duration > 0 ? s.txBytes / duration : 0.0)
+     << ", \"rx_frames\": " << s.rxFrames
+     << ", \"rx_bytes_per_s\": " << (duration > 0 ? s.rxBytes / duration : 0.0)
+     << ", \"pdr\": " << (s.txFrames ? (double)s.delivered / s.txFrames : 0.0)
+     << ", \"drops\": " << s.drops
+     << ", \"shed\": " << s.shed
+     << ", \"queue_mean\": " << (s.queueEvents ? (double)s.queueSum / s.queueEvents : 0.0)
+     << ", \"queue_max\": " << s.queueMax
+     << ", \"latency_ns\": {\"count\": " << s.latencyCount
+     << ", \"p50\": " << Percentile (s, 50)
+     << ", \"p99\": " << Percentile (s, 99)
+     << ", \"max\": " << s.latencyMax << "}";
+}
+
+static double
+NowSeconds (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+main (int argc, char *argv[])
+{
+  long threads = sysconf (_SC_NPROCESSORS_ONLN);
+  std::string json = "";
+  std::string filename = "";
+  for (int i = 1; i < argc; i++)
+    {
+      if (strncmp (argv[i], "--threads=", 10) == 0)
+        {
+          threads = atol (argv[i] + 10);
+        }
+      else if (strncmp (argv[i], "--json=", 7) == 0)
+        {
+          json = argv[i] + 7;
+        }
+      else
+        {
+          filename = argv[i];
+        }
+    }
+  if (filename.empty () || threads < 1)
+    {
+      std::cerr << "usage: " << argv[0] << " [--threads=N] [--json=results.json] trace.sbet" << std::endl;
+      return 1;
+    }
+
+  double start = NowSeconds ();
+  int fd = open (filename.c_str (), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat (fd, &st) < 0 || st.st_size < SET_HEADER_LEN)
+    {
+      std::cerr << filename << ": " << strerror (errno) << std::endl;
+      return 1;
+    }
+  const uint8_t *map = (const uint8_t *)mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED)
+    {
+      std::cerr << filename << ": mmap: " << strerror (errno) << std::endl;
+      return 1;
+    }
+  madvise ((void *)map, st.st_size, MADV_SEQUENTIAL);
+
+  const struct set_header *header = (const struct set_header *)map;
+  if (memcmp (header->magic, "SBET", 4) != 0 || header->version != SET_VERSION
+      || header->record_len != sizeof (struct set_record))
+    {
+      std::cerr << filename << ": not an event trace of this version" << std::endl;
+      return 1;
+    }
+  const struct set_record *records = (const struct set_record *)(map + SET_HEADER_LEN);
+  uint64_t count = (st.st_size - SET_HEADER_LEN) / sizeof (struct set_record);
+
+  std::vector<Worker> workers (threads);
+  for (long i = 0; i < threads; i++)
+    {
+      workers[i].begin = records + count * i / threads;
+      workers[i].end = records + count * (i + 1) / threads;
+    }
+
+  /* Pass 1: extent of the node ids, UIDs and time */
+  RunWorkers (workers, ScanRange);
+  uint32_t maxNode = 0;
+  uint32_t maxUid = 0;
+  int64_t firstNs = std::numeric_limits<int64_t>::max ();
+  int64_t lastNs = std::numeric_limits<int64_t>::min ();
+  for (long i = 0; i < threads; i++)
+    {
+      maxNode = std::max (maxNode, workers[i].maxNode);
+      maxUid = std::max (maxUid, workers[i].maxUid);
+      firstNs = std::min (firstNs, workers[i].firstNs);
+      lastNs = std::max (lastNs, workers[i].lastNs);
+    }
+  uint32_t nodes = count ? maxNode + 1 : 0;
+  double duration = count ? (lastNs - firstNs) / 1e9 : 0.0;
+
+  /* Pass 2: per-node counters, senders and receptions of every UID */
+  std::vector<uint32_t> sender (maxUid + 1, 0);
+  std::vector<uint8_t> received (maxUid + 1, 0);
+  for (long i = 0; i < threads; i++)
+    {
+      workers[i].nodes = nodes;
+      workers[i].sender = &sender[0];
+      workers[i].received = &received[0];
+    }
+  RunWorkers (workers, CountRange);
+
+  /* Pass 3: frames received by at least one node, per sender */
+  for (long i = 0; i < threads; i++)
+    {
+      workers[i].uidBegin = (uint64_t)(maxUid + 1) * i / threads;
+      workers[i].uidEnd = (uint64_t)(maxUid + 1) * (i + 1) / threads;
+    }
+  RunWorkers (workers, DeliverRange);
+
+  std::vector<NodeStats> stats (nodes, NodeStats ());
+  NodeStats total = NodeStats ();
+  for (long i = 0; i < threads; i++)
+    {
+      for (uint32_t n = 0; n < nodes; n++)
+        {
+          Merge (stats[n], workers[i].stats[n]);
+        }
+    }
+  for (uint32_t n = 0; n < nodes; n++)
+    {
+      Merge (total, stats[n]);
+    }
+  double elapsed = NowSeconds () - start;
+
+  std::ofstream file;
+  if (!json.empty ())
+    {
+      file.open (json.c_str ());
+    }
+  std::ostream &os = json.empty () ? std::cout : file;
+  os << "{" << std::endl;
+  os << "  \"trace\": \"" << filename << "\"," << std::endl;
+  os << "  \"records\": " << count << "," << std::endl;
+  os << "  \"threads\": " << threads << "," << std::endl;
+  os << "  \"analysis_s\": " << elapsed << "," << std::endl;
+  os << "  \"duration_s\": " << duration << "," << std::endl;
+  os << "  \"total\": {";
+  WriteStats (os, total, duration);
+  os << "}," << std::endl;
+  os << "  \"nodes\": [" << std::endl;
+  for (uint32_t n = 0; n < nodes; n++)
+    {
+      os << "    {\"node\": " << n << ", ";
+      WriteStats (os, stats[n], duration);
+      os << "}" << (n + 1 < nodes ? "," : "") << std::endl;
+    }
+  os << "  ]" << std::endl;
+  os << "}" << std::endl;
+
+  munmap ((void *)map, st.st_size);
+  close (fd);
+  return 0;
+}
@@ -20,18 +20,43 @@
 #include "ns3/node.h"
 #include "ns3/node-container.h"
 #include "ns3/enum.h"
+#include "ns3/boolean.h"
 #include "ns3/names.h"
 #include "ns3/mobility-module.h"
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#include "ns3/mpi-receiver.h"
+#include "ns3/point-to-point-helper.h"
+#endif
 #include "socket-bridge-helper.h"
 #include "socket-null-mac-helper.h"
 #include "socket-contiki-phy-helper.h"
 #include "socket-channel-helper.h"
+#include "socket-latency-tag.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/wait.h>
 
 NS_LOG_COMPONENT_DEFINE ("SocketBridgeHelper");
 
 namespace ns3 {
 
+/* The index of the run of this process, set by Fork in the forked runs */
+static uint32_t g_run = 0;
+
+/* The outputs kept open by the helper, which Fork gives to every run */
+static std::vector<Ptr<SocketPcapWriter> > g_pcapWriters;
+static std::vector<std::pair<Ptr<SocketEventTrace>, std::string> > g_eventTraces;
+
 SocketBridgeHelper::SocketBridgeHelper ()
+  : m_islands (false)
 {
   NS_LOG_FUNCTION_NOARGS ();
   m_deviceFactory.SetTypeId ("ns3::SocketBridge");
@@ -66,16 +91,128 @@ SocketBridgeHelper::Install (Ptr<Node> node, Ptr<NetDevice> nd)
   return bridge;
 }
 
+/* The number of ranks of the simulation; 1 unless running under MPI */
+static uint32_t
+GetRankCount (void)
+{
+#ifdef NS3_MPI
+  return MpiInterface::IsEnabled () ? MpiInterface::GetSize () : 1;
+#else
+  return 1;
+#endif
+}
+
+static bool
+ComparePositionX (const std::pair<Vector, uint32_t> &a, const std::pair<Vector, uint32_t> &b)
+{
+  return a.first.x < b.first.x;
+}
+
+NodeContainer
+SocketBridgeHelper::CreatePartitionedNodes (const std::vector<Vector> &positions)
+{
+  uint32_t nodeCount = positions.size ();
+  uint32_t ranks = GetRankCount ();
+
+  /* Sort by x co-ordinate so that each rank owns a contiguous strip */
+  std::vector<std::pair<Vector, uint32_t> > order;
+  for (uint32_t i = 0; i < nodeCount; i++)
+    {
+      order.push_back (std::make_pair (positions[i], i));
+    }
+  std::stable_sort (order.begin (), order.end (), ComparePositionX);
+
+  std::vector<uint32_t> systemId (nodeCount);
+  for (uint32_t i = 0; i < nodeCount; i++)
+    {
+      systemId[order[i].second] = (uint64_t)i * ranks / nodeCount;
+    }
+
+  return CreateNodes (positions, systemId);
+}
+
+static bool
+CompareIslandSize (const std::pair<uint32_t, uint32_t> &a, const std::pair<uint32_t, uint32_t> &b)
+{
+  return a.first > b.first;
+}
+
+NodeContainer
+SocketBridgeHelper::CreateIslandNodes (const std::vector<Vector> &positions)
+{
+  uint32_t nodeCount = positions.size ();
+  uint32_t ranks = GetRankCount ();
+
+  /* The range of the channel and PHYs Install creates */
+  Ptr<SocketChannel> channel = CreateObject<SocketChannel> ();
+  channel->SetPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  Ptr<SocketContikiPhy> phy = CreateObject<SocketContikiPhy> ();
+  phy->SetChannel (channel);
+  double range = channel->GetMaxRange (phy->GetTxPowerDbm ());
+  channel->Dispose ();
+
+  std::vector<uint32_t> islands = SocketChannel::FindIslands (positions, range);
+  uint32_t islandCount = 0;
+  for (uint32_t i = 0; i < nodeCount; i++)
+    {
+      islandCount = std::max (islandCount, islands[i] + 1);
+    }
+  std::vector<std::pair<uint32_t, uint32_t> > sizes (islandCount, std::make_pair (0, 0));
+  for (uint32_t k = 0; k < islandCount; k++)
+    {
+      sizes[k].second = k;
+    }
+  for (uint32_t i = 0; i < nodeCount; i++)
+    {
+      sizes[islands[i]].first++;
+    }
+  std::stable_sort (sizes.begin (), sizes.end (), CompareIslandSize);
+
+  std::vector<uint32_t> islandRank (islandCount);
+  std::vector<uint32_t> load (ranks, 0);
+  for (uint32_t k = 0; k < islandCount; k++)
+    {
+      uint32_t rank = std::min_element (load.begin (), load.end ()) - load.begin ();
+      islandRank[sizes[k].second] = rank;
+      load[rank] += sizes[k].first;
+    }
+  NS_LOG_INFO (islandCount << " islands within " << range << "m on " << ranks << " ranks");
+  if (islandCount < ranks)
+    {
+      NS_LOG_WARN ("only " << islandCount << " islands within " << range << "m, " <<
+                   (ranks - islandCount) << " ranks get no nodes");
+    }
+
+  std::vector<uint32_t> systemId (nodeCount);
+  for (uint32_t i = 0; i < nodeCount; i++)
+    {
+      systemId[i] = islandRank[islands[i]];
+    }
+  m_islands = true;
+  return CreateNodes (positions, systemId);
+}
+
+NodeContainer
+SocketBridgeHelper::CreateNodes (const std::vector<Vector> &positions, const std::vector<uint32_t> &systemId)
+{
+  /* Create nodes in the order of the positions so node ids match the caller's indices */
+  NodeContainer nodes;
+  for (uint32_t i = 0; i < positions.size (); i++)
+    {
+      Ptr<Node> node = CreateObject<Node> (systemId[i]);
+      Ptr<MobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+      mobility->SetPosition (positions[i]);
+      node->AggregateObject (mobility);
+      nodes.Add (node);
+    }
+  return nodes;
+}
+
 void
 SocketBridgeHelper::Install (NodeContainer nodes, std::string path, std::string mode)
 {
   uint32_t nodeCount = nodes.GetN();
 
-  /* Create Pointers */
-  Ptr<SocketBridge> bridge [nodeCount + 1];
-  Ptr<SocketNullMac> mac [nodeCount + 1];
-  Ptr<SocketContikiPhy> phy [nodeCount + 1];
-
   /* Create Helpers */
   SocketNullMacHelper socketNullMacHelper;
   SocketContikiPhyHelper socketContikiPhyHelper;
@@ -86,30 +223,591 @@ SocketBridgeHelper::Install (NodeContainer nodes, std::string path, std::string
   channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
   Ptr<LogDistancePropagationLossModel> log = CreateObject<LogDistancePropagationLossModel> ();
   channel->SetPropagationLossModel (log);
+  if (m_islands)
+    {
+      channel->SetAttribute ("RangeCulling", BooleanValue (true));
+    }
 
-  /* Create Position of all Nodes */
+  /* Default position for nodes without a mobility model */
   Ptr<MobilityModel> pos = CreateObject<ConstantPositionMobilityModel> ();
   pos->SetPosition (Vector (0.0, 0.0, 0.0));
 
   /* Build Network Stack for all Nodes */
-  for (uint8_t i = 0; i < nodeCount; i++)
+  Ptr<SocketBridge> bridge;
+  for (uint32_t i = 0; i < nodeCount; i++)
   {
-    bridge[i] =  m_deviceFactory.Create<SocketBridge> (); 
-    bridge[i]->SetExecPath(path);
-    bridge[i]->SetMode(mode);
+    bridge = m_deviceFactory.Create<SocketBridge> (); 
+    bridge->SetExecPath(path);
+    bridge->SetMode(mode);
     /* Add Socket Bridge to Node (Spawns Contiki Process */
-    nodes.Get(i)->AddDevice(bridge[i]);
-    bridge[i]->SetBridgedNetDevice(bridge[i]); 
+    nodes.Get(i)->AddDevice(bridge);
+    bridge->SetBridgedNetDevice(bridge); 
     /* Add MAC layer to SocketBridge */
-    mac[i] = socketNullMacHelper.Install(bridge[i]);
+    Ptr<SocketNullMac> mac = socketNullMacHelper.Install(bridge);
     /* Add PHY to SocketBridge and NullMac */
-    phy[i] = socketContikiPhyHelper.Install(bridge[i], mac[i], SocketContikiPhy::DSSS_O_QPSK_GHz); 
+    Ptr<SocketContikiPhy> phy = socketContikiPhyHelper.Install(bridge, mac, SocketContikiPhy::DSSS_O_QPSK_GHz); 
 
     /* Add Physical Components (Channel and Position) */
-    socketChannelHelper.Install(channel, bridge[i]);
-    phy[i]->SetMobility(pos);
+    socketChannelHelper.Install(channel, bridge);
+    Ptr<MobilityModel> mobility = nodes.Get(i)->GetObject<MobilityModel> ();
+    phy->SetMobility(mobility != 0 ? mobility : pos);
+
+#ifdef NS3_MPI
+    if (MpiInterface::IsEnabled ())
+    {
+      /* Receive frames transmitted by PHYs on other ranks */
+      Ptr<MpiReceiver> mpiReceiver = CreateObject<MpiReceiver> ();
+      mpiReceiver->SetReceiveCallback (MakeCallback (&SocketContikiPhy::ReceiveRemote, phy));
+      bridge->AggregateObject (mpiReceiver);
+    }
+#endif
+  }
+
+#ifdef NS3_MPI
+  if (MpiInterface::IsEnabled () && MpiInterface::GetSize () > 1)
+  {
+    ConnectPartitions (channel);
+    if (bridge != 0)
+      {
+        TimeValue pollInterval;
+        bridge->GetAttribute ("PollInterval", pollInterval);
+        PaceToWallClock (pollInterval.Get ());
+      }
   }
+#endif
+}
+
+static void
+ClosePcapWriter (Ptr<SocketPcapWriter> writer)
+{
+  writer->Close ();
+  g_pcapWriters.erase (std::find (g_pcapWriters.begin (), g_pcapWriters.end (), writer));
+}
+
+Ptr<SocketPcapWriter>
+SocketBridgeHelper::GetPcapWriter (void)
+{
+  if (m_pcapWriter == 0)
+    {
+      m_pcapWriter = CreateObject<SocketPcapWriter> ();
+      g_pcapWriters.push_back (m_pcapWriter);
+      /* Flush the capture files when the simulation is torn down */
+      Simulator::ScheduleDestroy (&ClosePcapWriter, m_pcapWriter);
+    }
+  return m_pcapWriter;
+}
+
+void
+SocketBridgeHelper::EnablePcap (std::string prefix, NodeContainer nodes)
+{
+  Ptr<SocketPcapWriter> writer = GetPcapWriter ();
+  for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+    {
+      for (uint32_t i = 0; i < (*n)->GetNDevices (); i++)
+        {
+          Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> ((*n)->GetDevice (i));
+          if (bridge == 0 || bridge->GetMac () == 0)
+            {
+              continue;
+            }
+          std::ostringstream oss;
+          oss << prefix << "-" << (*n)->GetId ();
+          Ptr<SocketPcapFile> file = writer->CreateFile (oss.str ());
+          bridge->GetMac ()->TraceConnectWithoutContext ("Sniffer", MakeCallback (&SocketPcapFile::Write, file));
+        }
+    }
+}
+
+void
+SocketBridgeHelper::EnablePcapChannel (std::string prefix, NodeContainer nodes)
+{
+  Ptr<SocketPcapWriter> writer = GetPcapWriter ();
+  std::set<uint32_t> captured;
+  for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+    {
+      for (uint32_t i = 0; i < (*n)->GetNDevices (); i++)
+        {
+          Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> ((*n)->GetDevice (i));
+          if (bridge == 0 || bridge->GetPhy () == 0 || bridge->GetPhy ()->GetChannel () == 0)
+            {
+              continue;
+            }
+          Ptr<SocketChannel> channel = bridge->GetPhy ()->GetChannel ();
+          if (!captured.insert (channel->GetId ()).second)
+            {
+              continue;
+            }
+          std::ostringstream oss;
+          oss << prefix << "-channel-" << channel->GetId ();
+          Ptr<SocketPcapFile> file = writer->CreateFile (oss.str ());
+          channel->TraceConnectWithoutContext ("Tx", MakeCallback (&SocketPcapFile::Write, file));
+        }
+    }
+}
+
+static void
+WriteLatencyReport (NodeContainer nodes, std::string filename)
+{
+  filename = SocketBridgeHelper::GetRunFilename (filename);
+  static const char *stageNames[SocketLatencyTag::STAGES] = {
+    "total", "read-forward", "forward-rxstart", "rxstart-rxend", "rxend-write"
+  };
+
+  std::ofstream os (filename.c_str ());
+  NS_ABORT_MSG_UNLESS (os.is_open (), "SocketBridgeHelper: unable to open " << filename);
+  os << "# latency in ns per node and stage" << std::endl;
+  for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+    {
+      for (uint32_t i = 0; i < (*n)->GetNDevices (); i++)
+        {
+          Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> ((*n)->GetDevice (i));
+          if (bridge == 0)
+            {
+              continue;
+            }
+          for (uint32_t stage = 0; stage < SocketLatencyTag::STAGES; stage++)
+            {
+              os << "node " << (*n)->GetId () << " " << stageNames[stage] << " ";
+              bridge->GetLatencyHistogram ((SocketLatencyTag::Stage)stage).Print (os);
+              os << std::endl;
+            }
+        }
+    }
+}
+
+void
+SocketBridgeHelper::EnableLatencyInstrumentation (NodeContainer nodes, std::string filename)
+{
+  for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+    {
+      for (uint32_t i = 0; i < (*n)->GetNDevices (); i++)
+        {
+          Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> ((*n)->GetDevice (i));
+          if (bridge != 0)
+            {
+              bridge->SetAttribute ("LatencyInstrumentation", BooleanValue (true));
+            }
+        }
+    }
+  Simulator::ScheduleDestroy (&WriteLatencyReport, nodes, filename);
+}
+
+static void
+CloseEventTrace (Ptr<SocketEventTrace> trace, std::vector<Ptr<SocketBridge> > bridges)
+{
+  //
+  // The readers only stop when the bridges are destroyed, after this runs;
+  // stop them first so that no event is lost while the trace closes.
+  //
+  for (uint32_t i = 0; i < bridges.size (); i++)
+    {
+      bridges[i]->Suspend ();
+    }
+  trace->Close ();
+  for (uint32_t i = 0; i < g_eventTraces.size (); i++)
+    {
+      if (g_eventTraces[i].first == trace)
+        {
+          g_eventTraces.erase (g_eventTraces.begin () + i);
+          break;
+        }
+    }
+}
+
+Ptr<SocketEventTrace>
+SocketBridgeHelper::EnableEventTrace (NodeContainer nodes, std::string filename)
+{
+  Ptr<SocketEventTrace> trace = CreateObject<SocketEventTrace> ();
+  NS_ABORT_MSG_UNLESS (trace->Open (filename), "SocketBridgeHelper: unable to open " << filename);
+  std::vector<Ptr<SocketBridge> > bridges;
+  for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+    {
+      for (uint32_t i = 0; i < (*n)->GetNDevices (); i++)
+        {
+          Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> ((*n)->GetDevice (i));
+          if (bridge == 0)
+            {
+              continue;
+            }
+          bridges.push_back (bridge);
+          Ptr<SocketEventProbe> probe = trace->CreateProbe ((*n)->GetId ());
+          bridge->TraceConnectWithoutContext ("Read", MakeCallback (&SocketEventProbe::Queue, probe));
+          bridge->TraceConnectWithoutContext ("Shed", MakeCallback (&SocketEventProbe::Shed, probe));
+          bridge->TraceConnectWithoutContext ("Latency", MakeCallback (&SocketEventProbe::Latency, probe));
+          Ptr<SocketNullMac> mac = bridge->GetMac ();
+          if (mac != 0)
+            {
+              mac->TraceConnectWithoutContext ("MacTx", MakeCallback (&SocketEventProbe::Tx, probe));
+              mac->TraceConnectWithoutContext ("MacRx", MakeCallback (&SocketEventProbe::Rx, probe));
+              mac->TraceConnectWithoutContext ("MacTxDrop", MakeCallback (&SocketEventProbe::Drop, probe));
+              mac->TraceConnectWithoutContext ("MacRxDrop", MakeCallback (&SocketEventProbe::Drop, probe));
+            }
+        }
+    }
+  g_eventTraces.push_back (std::make_pair (trace, filename));
+  Simulator::ScheduleDestroy (&CloseEventTrace, trace, bridges);
+  return trace;
+}
+
+static void
+WriteEnergyReport (DeviceEnergyModelContainer models, std::vector<uint32_t> nodeIds, std::string filename)
+{
+  filename = SocketBridgeHelper::GetRunFilename (filename);
+  static const char *stateNames[] = { "idle", "tx", "rx", "sleep" };
+
+  std::ofstream os (filename.c_str ());
+  NS_ABORT_MSG_UNLESS (os.is_open (), "SocketBridgeHelper: unable to open " << filename);
+  os << "# node total_J";
+  for (uint32_t state = SocketContikiPhy::IDLE; state <= SocketContikiPhy::SLEEP; state++)
+    {
+      os << " " << stateNames[state] << "_s " << stateNames[state] << "_J";
+    }
+  os << std::endl;
+  for (uint32_t i = 0; i < models.GetN (); i++)
+    {
+      Ptr<SocketRadioEnergyModel> model = DynamicCast<SocketRadioEnergyModel> (models.Get (i));
+      os << nodeIds[i] << " " << model->GetTotalEnergyConsumption ();
+      for (uint32_t state = SocketContikiPhy::IDLE; state <= SocketContikiPhy::SLEEP; state++)
+        {
+          os << " " << model->GetStateTime ((SocketContikiPhy::State)state).GetSeconds ()
+             << " " << model->GetStateEnergy ((SocketContikiPhy::State)state);
+        }
+      os << std::endl;
+    }
+}
+
+DeviceEnergyModelContainer
+SocketBridgeHelper::EnableEnergyModel (NodeContainer nodes, std::string filename)
+{
+  DeviceEnergyModelContainer models;
+  std::vector<uint32_t> nodeIds;
+  for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+    {
+      for (uint32_t i = 0; i < (*n)->GetNDevices (); i++)
+        {
+          Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> ((*n)->GetDevice (i));
+          if (bridge == 0 || bridge->GetPhy () == 0)
+            {
+              continue;
+            }
+          Ptr<SocketRadioEnergyModel> model = CreateObject<SocketRadioEnergyModel> ();
+          model->SetPhy (bridge->GetPhy ());
+          models.Add (model);
+          nodeIds.push_back ((*n)->GetId ());
+        }
+    }
+  Simulator::ScheduleDestroy (&WriteEnergyReport, models, nodeIds, filename);
+  return models;
+}
+
+static void
+WriteMemoryReport (NodeContainer nodes, std::string filename)
+{
+  filename = SocketBridgeHelper::GetRunFilename (filename);
+  std::ofstream os (filename.c_str ());
+  NS_ABORT_MSG_UNLESS (os.is_open (), "SocketBridgeHelper: unable to open " << filename);
+  os << "# bytes held by the bridge on the ns-3 side per node, reader stack included" << std::endl;
+  uint64_t bytes = 0;
+  uint64_t stack = 0;
+  uint32_t bridges = 0;
+  for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+    {
+      for (uint32_t i = 0; i < (*n)->GetNDevices (); i++)
+        {
+          Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> ((*n)->GetDevice (i));
+          if (bridge == 0)
+            {
+              continue;
+            }
+          os << "node " << (*n)->GetId ()
+             << " bytes " << bridge->GetMemoryUsage ()
+             << " reader-stack " << bridge->GetReaderStackSize () << std::endl;
+          bytes += bridge->GetMemoryUsage ();
+          stack += bridge->GetReaderStackSize ();
+          bridges++;
+        }
+    }
+  os << "total bytes " << bytes << " reader-stack " << stack << " bridges " << bridges << std::endl;
+}
+
+void
+SocketBridgeHelper::EnableMemoryReport (NodeContainer nodes, std::string filename)
+{
+  Simulator::ScheduleDestroy (&WriteMemoryReport, nodes, filename);
+}
+
+static void
+SetBridgeFiles (std::string prefix, NodeContainer nodes, std::string attribute)
+{
+  for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+    {
+      for (uint32_t i = 0; i < (*n)->GetNDevices (); i++)
+        {
+          Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> ((*n)->GetDevice (i));
+          if (bridge != 0)
+            {
+              std::ostringstream oss;
+              oss << prefix << "-" << (*n)->GetId () << ".sbrl";
+              bridge->SetAttribute (attribute, StringValue (oss.str ()));
+            }
+        }
+    }
+}
+
+void
+SocketBridgeHelper::EnableRecording (std::string prefix, NodeContainer nodes)
+{
+  SetBridgeFiles (prefix, nodes, "RecordFile");
+}
+
+void
+SocketBridgeHelper::EnableReplay (std::string prefix, NodeContainer nodes)
+{
+  SetBridgeFiles (prefix, nodes, "ReplayFile");
+}
+
+/* The runs forked from this process */
+static std::vector<pid_t> g_runs;
+
+uint32_t
+SocketBridgeHelper::Fork (NodeContainer nodes, uint32_t runs)
+{
+  NS_LOG_FUNCTION (runs);
+  NS_ABORT_MSG_IF (GetRankCount () > 1, "SocketBridgeHelper::Fork(): distributed simulations cannot be forked");
+
+  std::vector<Ptr<SocketBridge> > bridges;
+  for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+    {
+      for (uint32_t i = 0; i < (*n)->GetNDevices (); i++)
+        {
+          Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> ((*n)->GetDevice (i));
+          if (bridge != 0)
+            {
+              bridges.push_back (bridge);
+            }
+        }
+    }
+
+  //
+  // Reader threads do not survive fork, so all of them are stopped first and
+  // started again in every run.
+  //
+  for (uint32_t i = 0; i < bridges.size (); i++)
+    {
+      bridges[i]->Suspend ();
+    }
+
+  //
+  // So are the threads writing capture files, and the events and frames
+  // buffered so far are written out once, by the original process.
+  //
+  for (uint32_t i = 0; i < g_pcapWriters.size (); i++)
+    {
+      g_pcapWriters[i]->PrepareFork ();
+    }
+  for (uint32_t i = 0; i < g_eventTraces.size (); i++)
+    {
+      g_eventTraces[i].first->Flush ();
+    }
+
+  uint32_t run = 0;
+  for (uint32_t k = 1; k < runs && run == 0; k++)
+    {
+      for (uint32_t i = 0; i < bridges.size (); i++)
+        {
+          bridges[i]->ForkProcess ();
+        }
+
+      /* Output buffered so far belongs to the original process only */
+      fflush (NULL);
+      std::cout.flush ();
+      std::cerr.flush ();
+
+      pid_t pid = fork ();
+      NS_ABORT_MSG_IF (pid < 0, "SocketBridgeHelper::Fork(): Unix fork error, errno = " << strerror (errno));
+      for (uint32_t i = 0; i < bridges.size (); i++)
+        {
+          bridges[i]->CompleteFork (pid == 0);
+        }
+      if (pid == 0)
+        {
+          run = k;
+          g_run = k;
+          g_runs.clear ();
+        }
+      else
+        {
+          NS_LOG_INFO ("Forked run " << k << " as process " << pid);
+          g_runs.push_back (pid);
+        }
+    }
+
+  //
+  // Every run writes its own capture files, event traces and reports (see
+  // GetRunFilename) from here on.
+  //
+  std::ostringstream suffix;
+  if (run != 0)
+    {
+      suffix << "-run" << run;
+    }
+  for (uint32_t i = 0; i < g_pcapWriters.size (); i++)
+    {
+      g_pcapWriters[i]->CompleteFork (suffix.str ());
+    }
+  for (uint32_t i = 0; run != 0 && i < g_eventTraces.size (); i++)
+    {
+      std::string filename = GetRunFilename (g_eventTraces[i].second);
+      NS_ABORT_MSG_UNLESS (g_eventTraces[i].first->Open (filename),
+                           "SocketBridgeHelper::Fork(): unable to open " << filename);
+    }
+
+  for (uint32_t i = 0; i < bridges.size (); i++)
+    {
+      bridges[i]->Resume ();
+    }
+  return run;
+}
+
+std::string
+SocketBridgeHelper::GetRunFilename (std::string filename)
+{
+  if (g_run == 0)
+    {
+      return filename;
+    }
+  std::ostringstream oss;
+  oss << "-run" << g_run;
+  std::string::size_type slash = filename.rfind ('/');
+  std::string::size_type dot = filename.rfind ('.');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash) || dot == slash + 1)
+    {
+      return filename + oss.str ();
+    }
+  return filename.substr (0, dot) + oss.str () + filename.substr (dot);
+}
+
+void
+SocketBridgeHelper::WaitForRuns (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  for (uint32_t i = 0; i < g_runs.size (); i++)
+    {
+      waitpid (g_runs[i], NULL, 0);
+    }
+  g_runs.clear ();
+}
+
+static void
+PrintMonitorSummary (Ptr<SocketRealtimeMonitor> monitor)
+{
+  monitor->PrintSummary (std::cout);
+}
+
+Ptr<SocketRealtimeMonitor>
+SocketBridgeHelper::EnableRealtimeMonitor (NodeContainer nodes)
+{
+  Ptr<SocketRealtimeMonitor> monitor = CreateObject<SocketRealtimeMonitor> ();
+  for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+    {
+      for (uint32_t i = 0; i < (*n)->GetNDevices (); i++)
+        {
+          Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> ((*n)->GetDevice (i));
+          if (bridge != 0)
+            {
+              monitor->AddBridge (bridge);
+            }
+        }
+    }
+  monitor->Start ();
+  Simulator::ScheduleDestroy (&PrintMonitorSummary, monitor);
+  return monitor;
+}
+
+#ifdef NS3_MPI
+/* The wall clock in nanoseconds at simulation time 0 of a paced rank */
+static uint64_t g_paceStart = 0;
+static EventId g_paceEvent;
+
+/*
+ * Hold the simulation back until the wall clock has caught up with it, and
+ * check again after interval.  A rank lagging behind the wall clock is not
+ * held back.
+ */
+static void
+PaceRank (Time interval)
+{
+  uint64_t wallClock = SocketLatencyTag::GetWallClockNs ();
+  if (g_paceStart == 0)
+    {
+      g_paceStart = wallClock - Simulator::Now ().GetNanoSeconds ();
+    }
+  int64_t ahead = Simulator::Now ().GetNanoSeconds () - (int64_t)(wallClock - g_paceStart);
+  if (ahead > 0)
+    {
+      struct timespec ts;
+      ts.tv_sec = ahead / 1000000000;
+      ts.tv_nsec = ahead % 1000000000;
+      while (nanosleep (&ts, &ts) == -1 && errno == EINTR)
+        {
+        }
+    }
+  g_paceEvent = Simulator::Schedule (interval, &PaceRank, interval);
+}
+
+void
+SocketBridgeHelper::PaceToWallClock (Time interval)
+{
+  //
+  // The external processes run in wall-clock time, but the distributed
+  // simulator runs as fast as it can.  Every rank paces itself; the ranks
+  // stay within the lookahead of each other anyway.  Frames from the
+  // processes enter the simulation at the inbox polls, so the pacing
+  // follows the same interval.
+  //
+  NS_LOG_INFO ("Pacing rank " << Simulator::GetSystemId () << " to the wall clock every " << interval);
+  Simulator::Cancel (g_paceEvent);
+  g_paceStart = 0;
+  g_paceEvent = Simulator::Schedule (Seconds (0), &PaceRank, interval);
+}
+
+void
+SocketBridgeHelper::ConnectPartitions (Ptr<SocketChannel> channel)
+{
+  Time lookAhead = channel->GetLookAhead ();
+  NS_LOG_INFO ("SocketChannel lookahead is " << lookAhead);
+  if (lookAhead >= Simulator::GetMaximumSimulationTime ())
+    {
+      /* No PHY pair crosses a rank boundary */
+      return;
+    }
+  NS_ABORT_MSG_UNLESS (lookAhead.IsStrictlyPositive (),
+                       "SocketBridgeHelper::ConnectPartitions(): co-located nodes on different ranks give a zero lookahead");
+
+  //
+  // The distributed simulator derives its lookahead from the remote
+  // point-to-point channels it finds in the topology.  Link one idle anchor
+  // node per rank with channels whose delay is the SocketChannel lookahead;
+  // no traffic is ever sent over them.
+  //
+  uint32_t ranks = MpiInterface::GetSize ();
+  NodeContainer anchors;
+  for (uint32_t r = 0; r < ranks; r++)
+    {
+      anchors.Create (1, r);
+    }
+
+  PointToPointHelper p2p;
+  p2p.SetChannelAttribute ("Delay", TimeValue (lookAhead));
+  for (uint32_t a = 0; a < ranks; a++)
+    {
+      for (uint32_t b = a + 1; b < ranks; b++)
+        {
+          p2p.Install (anchors.Get (a), anchors.Get (b));
+        }
+    }
 }
 
+#endif /* NS3_MPI */
 
 } // namespace ns3
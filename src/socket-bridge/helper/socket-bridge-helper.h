@@ -21,8 +21,16 @@
 
 #include "ns3/net-device-container.h"
 #include "ns3/object-factory.h"
+#include "ns3/node-container.h"
+#include "ns3/vector.h"
 #include "ns3/socket-bridge.h"
+#include "ns3/socket-pcap-writer.h"
+#include "ns3/socket-realtime-monitor.h"
+#include "ns3/socket-radio-energy-model.h"
+#include "ns3/socket-event-trace.h"
+#include "ns3/device-energy-model-container.h"
 #include <string.h>
+#include <vector>
 
 namespace ns3 {
 
@@ -73,9 +81,47 @@ public:
    */
   Ptr<SocketBridge> Install (Ptr<Node> node);
 
+  /**
+   * This method creates one Node per position, partitioning them spatially
+   * across the ranks of a distributed simulation.  The nodes are split into
+   * contiguous strips along the x axis holding the same number of nodes each,
+   * and every node gets a ConstantPositionMobilityModel at its position.
+   * Without MPI all nodes are assigned to rank 0.
+   *
+   * \param positions The positions of the nodes to create.
+   * \returns The created nodes, in the order of the positions.
+   */
+  NodeContainer CreatePartitionedNodes (const std::vector<Vector> &positions);
+  /**
+   * This method creates one Node per position like CreatePartitionedNodes,
+   * but assigns whole islands to the ranks of a distributed simulation.  An
+   * island is a group of nodes that cannot hear any node outside of it with
+   * the transmit power and loss model Install uses (see
+   * SocketChannel::FindIslands), e.g. the nodes of one building.  Islands
+   * are handed out largest first to the rank with the fewest nodes so far.
+   *
+   * Install then enables RangeCulling on the channel, so that ranks holding
+   * different islands only synchronize every IslandLookAhead and run in
+   * parallel.  Nodes that later move into range of another island still
+   * exchange frames, delayed to the lookahead when on different ranks.
+   *
+   * \param positions The positions of the nodes to create.
+   * \returns The created nodes, in the order of the positions.
+   */
+  NodeContainer CreateIslandNodes (const std::vector<Vector> &positions);
+
   /**
    * This method installs the entire Network Stack to a collection of Nodes.
-   * All nodes are located on the same vector co-ordinate and use the same executable for fork/exec.
+   * Nodes that already aggregate a MobilityModel keep it; all other nodes are
+   * located on the same vector co-ordinate.  All nodes use the same executable
+   * for fork/exec.
+   *
+   * In a distributed simulation the whole NodeContainer must be installed on
+   * every rank.  Only the rank owning a node spawns its external process, and
+   * the ranks are linked with the channel lookahead (see SocketChannel::GetLookAhead).
+   * The distributed simulator is not realtime, so every rank is also paced
+   * to the wall clock at the PollInterval of the bridges, the external
+   * processes running in wall-clock time.
    *
    * \param node The NodeContainer to install the various SocketBridge objects.
    * \param path The path used to locate the executable for the fork/exec call.
@@ -84,8 +130,171 @@ public:
   void Install (NodeContainer nodes, std::string path, std::string mode);
 
 
+  /**
+   * Capture the frames sent and delivered by each of the given nodes into a
+   * per-node PCAP file named <prefix>-<node id>.pcap.  Must be called after
+   * Install.
+   *
+   * Frames are written by a background thread (see SocketPcapWriter) so that
+   * capturing does not slow down the realtime loop.
+   *
+   * \param prefix The file name prefix.
+   * \param nodes The nodes to capture.
+   */
+  void EnablePcap (std::string prefix, NodeContainer nodes);
+
+  /**
+   * Capture every frame transmitted on the channels the given nodes are
+   * attached to into one PCAP file per channel named
+   * <prefix>-channel-<channel id>.pcap.  Must be called after Install.
+   *
+   * \param prefix The file name prefix.
+   * \param nodes Nodes attached to the channels to capture.
+   */
+  void EnablePcapChannel (std::string prefix, NodeContainer nodes);
+
+  /**
+   * \returns the writer used by EnablePcap and EnablePcapChannel, e.g. to
+   * set its attributes before enabling capture.
+   */
+  Ptr<SocketPcapWriter> GetPcapWriter (void);
+
+  /**
+   * Enable the LatencyInstrumentation attribute of the bridges of the given
+   * nodes and write their per-stage latency percentiles to a file when the
+   * simulation is destroyed.  Must be called after Install.
+   *
+   * \param nodes The nodes to instrument.
+   * \param filename The report file name.
+   */
+  void EnableLatencyInstrumentation (NodeContainer nodes, std::string filename);
+
+  /**
+   * Write the tx, rx, drop, queue and latency events of the given nodes to
+   * a binary trace (see SocketEventTrace), closed when the simulation is
+   * destroyed.  Latency events are only written for bridges with the
+   * LatencyInstrumentation attribute set.  Must be called after Install.
+   *
+   * \param nodes The nodes to trace.
+   * \param filename The trace file name.
+   * \returns the trace
+   */
+  Ptr<SocketEventTrace> EnableEventTrace (NodeContainer nodes, std::string filename);
+
+  /**
+   * Monitor how far the simulation lags behind the wall clock and the frames
+   * pending in the bridges of the given nodes, and print a summary to
+   * std::cout when the simulation is destroyed.  Must be called after
+   * Install.
+   *
+   * \param nodes The nodes whose bridges are monitored.
+   * \returns the monitor, already started, e.g. to set its attributes or
+   *          connect to its trace sources
+   */
+  Ptr<SocketRealtimeMonitor> EnableRealtimeMonitor (NodeContainer nodes);
+
+  /**
+   * Attach a SocketRadioEnergyModel to the PHY of each of the given nodes
+   * and write the energy consumed per node and PHY state to a file when the
+   * simulation is destroyed.  Must be called after Install.
+   *
+   * \param nodes The nodes to account.
+   * \param filename The report file name.
+   * \returns the energy models, e.g. to set their currents or attach them to
+   *          an EnergySource
+   */
+  DeviceEnergyModelContainer EnableEnergyModel (NodeContainer nodes, std::string filename);
+
+  /**
+   * Write the memory held on the ns-3 side by the bridge of each of the
+   * given nodes, reader stack included (see SocketBridge::GetMemoryUsage),
+   * and the stack size of its reader thread to a file when the simulation
+   * is destroyed.
+   *
+   * \param nodes The nodes to report.
+   * \param filename The report file name.
+   */
+  void EnableMemoryReport (NodeContainer nodes, std::string filename);
+
+  /**
+   * Record the frames read by the bridge of each of the given nodes to
+   * prefix-<node id>.sbrl (see the RecordFile attribute of SocketBridge).
+   *
+   * \param prefix The file name prefix.
+   * \param nodes The nodes to record.
+   */
+  void EnableRecording (std::string prefix, NodeContainer nodes);
+
+  /**
+   * Replay the frames recorded with EnableRecording into the bridge of
+   * each of the given nodes instead of spawning its process (see the
+   * ReplayFile attribute of SocketBridge).  Use the default simulator to
+   * replay as fast as possible.
+   *
+   * \param prefix The file name prefix given to EnableRecording.
+   * \param nodes The nodes to replay.
+   */
+  void EnableReplay (std::string prefix, NodeContainer nodes);
+
+  /**
+   * \brief Fork the simulation into runs that continue from the current
+   * state, e.g. once a network has converged.
+   *
+   * Meant to be called from a scheduled event.  The external process of
+   * every bridge on the given nodes forks itself (FRAMED protocol only, see
+   * SocketBridge::ForkProcess), then ns-3 forks, once per additional run.
+   * Every run continues with the same channel, PHY and MAC state and
+   * pending events and with its own processes; the runs proceed
+   * concurrently.  Like fork(), the call returns in every run.
+   *
+   * Capture files, event traces and the reports of the helper are written
+   * by every run to files of its own, named by GetRunFilename; those of the
+   * original run keep their names.  Bridges recording to a RecordFile
+   * cannot be forked.
+   *
+   * \param nodes The nodes whose processes to fork.
+   * \param runs The number of runs including the original one.
+   * \returns the index of the run, 0 in the original process
+   */
+  static uint32_t Fork (NodeContainer nodes, uint32_t runs);
+
+  /**
+   * \param filename a file name
+   * \returns the file name with the index of the run of this process
+   *          inserted before the extension (e.g. energy-run2.txt) in a run
+   *          forked by Fork, or unchanged in the original run
+   */
+  static std::string GetRunFilename (std::string filename);
+
+  /**
+   * Wait for the runs forked by Fork to exit.  Returns at once in a forked
+   * run.
+   */
+  static void WaitForRuns (void);
+
 private:
+  /**
+   * Link the ranks of a distributed simulation so that the simulator
+   * derives the lookahead of the given channel.
+   */
+  void ConnectPartitions (Ptr<SocketChannel> channel);
+  /**
+   * Hold the simulation of this rank back to the wall clock, checking every
+   * interval from simulation time 0.
+   */
+  void PaceToWallClock (Time interval);
+  /**
+   * Create one Node per position on the given rank, with a
+   * ConstantPositionMobilityModel at its position.
+   */
+  NodeContainer CreateNodes (const std::vector<Vector> &positions, const std::vector<uint32_t> &systemId);
+
   ObjectFactory m_deviceFactory;
+  Ptr<SocketPcapWriter> m_pcapWriter;
+  /**
+   * Set by CreateIslandNodes to enable RangeCulling on the channel
+   */
+  bool m_islands;
 };
 
 } // namespace ns3
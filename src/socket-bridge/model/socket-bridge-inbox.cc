@@ -0,0 +1,92 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "socket-bridge-inbox.h"
+
+namespace ns3 {
+
+const uint32_t SocketBridgeInbox::CAPACITY;
+
+SocketBridgeInbox *
+SocketBridgeInbox::Get (void)
+{
+  /* Created by the simulator thread before any reader starts */
+  static SocketBridgeInbox inbox;
+  return &inbox;
+}
+
+SocketBridgeInbox::SocketBridgeInbox ()
+  : m_frames (CAPACITY),
+    m_armed (0),
+    m_batches (0),
+    m_forwarded (0)
+{
+}
+
+bool
+SocketBridgeInbox::Push (const Frame &frame)
+{
+  return m_frames.Push (frame);
+}
+
+bool
+SocketBridgeInbox::Arm (void)
+{
+  return __sync_bool_compare_and_swap (&m_armed, 0, 1);
+}
+
+void
+SocketBridgeInbox::Disarm (void)
+{
+  __sync_lock_release (&m_armed);
+  __sync_synchronize ();
+}
+
+bool
+SocketBridgeInbox::Pop (Frame &frame)
+{
+  return m_frames.Pop (frame);
+}
+
+void
+SocketBridgeInbox::AddBatch (uint32_t frames)
+{
+  if (frames > 0)
+    {
+      m_batches++;
+      m_forwarded += frames;
+    }
+}
+
+uint32_t
+SocketBridgeInbox::GetSize (void) const
+{
+  return m_frames.GetSize ();
+}
+
+uint64_t
+SocketBridgeInbox::GetBatches (void) const
+{
+  return m_batches;
+}
+
+uint64_t
+SocketBridgeInbox::GetFrames (void) const
+{
+  return m_forwarded;
+}
+
+} // namespace ns3
@@ -0,0 +1,132 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_BRIDGE_INBOX_H
+#define SOCKET_BRIDGE_INBOX_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "socket-mpsc-queue.h"
+
+namespace ns3 {
+
+class SocketBridge;
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Hands the frames read by the reader threads of all SocketBridges
+ * to the simulator thread.
+ *
+ * There is one inbox per simulator (i.e. per process).  Reader threads push
+ * frames without taking a lock, and a single drain event on the simulator
+ * thread forwards everything queued in one go.  Only the reader that finds
+ * the drain idle schedules it (see Arm), so the lock of the realtime
+ * simulator is taken once per batch of frames instead of once per frame.
+ *
+ * Push and Arm may be called from any thread; all other methods must only
+ * be called from the simulator thread.
+ */
+class SocketBridgeInbox
+{
+public:
+  /**
+   * The number of frames the inbox can hold
+   */
+  static const uint32_t CAPACITY = 65536;
+
+  /**
+   * A frame read from the socket of a bridge and the wall-clock time it was
+   * read at (0 unless LatencyInstrumentation is set).
+   */
+  struct Frame
+  {
+    SocketBridge *bridge;
+    uint8_t *buf;
+    ssize_t len;
+    uint64_t readNs;
+  };
+
+  /**
+   * \returns the inbox of the simulator
+   */
+  static SocketBridgeInbox *Get (void);
+
+  /**
+   * \param frame the frame to append
+   * \returns false if the inbox is full
+   */
+  bool Push (const Frame &frame);
+
+  /**
+   * Mark the drain as scheduled.  Called by a reader after Push.
+   *
+   * \returns true if the drain was idle, in which case the caller must
+   *          schedule it
+   */
+  bool Arm (void);
+
+  /**
+   * Mark the drain as idle.  Called by the drain before it pops the first
+   * frame, so that a frame pushed while the drain runs arms a new one.
+   */
+  void Disarm (void);
+
+  /**
+   * \param frame receives the oldest frame
+   * \returns false if the inbox is empty
+   */
+  bool Pop (Frame &frame);
+
+  /**
+   * Count a drain that forwarded the given number of frames.
+   *
+   * \param frames the number of frames forwarded
+   */
+  void AddBatch (uint32_t frames);
+
+  /**
+   * \returns an estimate of the number of queued frames
+   */
+  uint32_t GetSize (void) const;
+
+  /**
+   * \returns the number of drains that forwarded at least one frame
+   */
+  uint64_t GetBatches (void) const;
+
+  /**
+   * \returns the number of frames forwarded by all drains
+   */
+  uint64_t GetFrames (void) const;
+
+private:
+  SocketBridgeInbox ();
+  SocketBridgeInbox (const SocketBridgeInbox &);
+  SocketBridgeInbox &operator = (const SocketBridgeInbox &);
+
+  SocketMpscQueue<Frame> m_frames;
+  /* written by the readers, keep it away from the queue positions */
+  char m_pad[64];
+  volatile uint32_t m_armed;
+  uint64_t m_batches;
+  uint64_t m_forwarded;
+};
+
+} // namespace ns3
+
+#endif /* SOCKET_BRIDGE_INBOX_H */
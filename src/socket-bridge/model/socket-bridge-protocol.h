@@ -0,0 +1,227 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Framed message protocol on the SocketBridge IPC socket.
+ *
+ * This header is plain C and shared by the ns-3 SocketBridge (Protocol
+ * attribute set to FRAMED) and the external process; see
+ * contiki/socket-bridge-protocol.c for a reference implementation of the
+ * process side.
+ *
+ * Every message starts with a two byte header:
+ *
+ *    0                   1
+ *    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
+ *   +-----+---------+---------------+
+ *   | ver |  type   |    length     |
+ *   +-----+---------+---------------+
+ *
+ * followed by length bytes of payload.  Multi-byte fields in payloads are
+ * in network byte order.
+ *
+ *   SBP_TYPE_DATA     an 802.15.4 frame, exactly as in the RAW protocol
+ *   SBP_TYPE_CONTROL  one subtype byte followed by its arguments
+ *   SBP_TYPE_TIME     from the process: a request with no payload; from
+ *                     ns-3: the simulation time in microseconds (8 bytes)
+ *
+ * Control messages sent by the process:
+ *
+ *   SBP_CTRL_SET_PAN_ID       PAN ID (2 bytes)
+ *   SBP_CTRL_SET_SHORT_ADDR   short address (2 bytes), 0xffff for none
+ *   SBP_CTRL_SET_AUTO_ACK     0 or 1 (1 byte)
+ *   SBP_CTRL_SET_PROMISCUOUS  0 or 1 (1 byte)
+ *   SBP_CTRL_SET_CHANNEL      802.15.4 channel number (1 byte)
+ *   SBP_CTRL_SET_TX_POWER     transmit power of the following frames in
+ *                             dBm (1 byte, signed)
+ *   SBP_CTRL_SET_RADIO        0 to turn the radio off, 1 to turn it on
+ *                             (1 byte); no frames are delivered while off
+ *   SBP_CTRL_SET_CCA          clear channel assessment mode (1 byte: 1
+ *                             energy above threshold, 2 carrier sense, 3
+ *                             carrier sense with energy above threshold)
+ *                             and threshold in dBm (1 byte, signed)
+ *   SBP_CTRL_CCA_REQUEST      no arguments, answered by SBP_CTRL_CCA
+ *   SBP_CTRL_STATS_REQUEST    no arguments, answered by SBP_CTRL_STATS
+ *   SBP_CTRL_FORKED           PID of the process (4 bytes), sent first by a
+ *                             process forked on SBP_CTRL_FORK
+ *
+ * Control messages sent by ns-3:
+ *
+ *   SBP_CTRL_ADDRESS          the extended address of the node (8 bytes),
+ *                             sent first on every connection
+ *   SBP_CTRL_CCA              1 if the channel is clear, 0 if it is busy
+ *                             or the radio is off or transmitting (1 byte)
+ *   SBP_CTRL_STATS            frames read, written and dropped by the
+ *                             bridge (3 x 4 bytes)
+ *   SBP_CTRL_FORK             no arguments; a new socket is passed along
+ *                             (SCM_RIGHTS) with the message.  The process
+ *                             forks, the new process continues on the new
+ *                             socket and the original on the old one.
+ *
+ * Messages with an unknown version, type or subtype, and control messages
+ * with arguments of the wrong length, are ignored.
+ */
+
+#ifndef SOCKET_BRIDGE_PROTOCOL_H
+#define SOCKET_BRIDGE_PROTOCOL_H
+
+#include <stdint.h>
+
+#define SBP_VERSION 1
+#define SBP_HEADER_LEN 2
+#define SBP_MAX_PAYLOAD 255
+
+#define SBP_TYPE_DATA 0
+#define SBP_TYPE_CONTROL 1
+#define SBP_TYPE_TIME 2
+
+#define SBP_CTRL_ADDRESS 0x01
+#define SBP_CTRL_FORK 0x02
+#define SBP_CTRL_SET_PAN_ID 0x10
+#define SBP_CTRL_SET_SHORT_ADDR 0x11
+#define SBP_CTRL_SET_AUTO_ACK 0x12
+#define SBP_CTRL_SET_PROMISCUOUS 0x13
+#define SBP_CTRL_SET_CHANNEL 0x14
+#define SBP_CTRL_SET_TX_POWER 0x15
+#define SBP_CTRL_SET_RADIO 0x16
+#define SBP_CTRL_FORKED 0x17
+#define SBP_CTRL_SET_CCA 0x18
+#define SBP_CTRL_STATS_REQUEST 0x20
+#define SBP_CTRL_STATS 0x21
+#define SBP_CTRL_CCA_REQUEST 0x22
+#define SBP_CTRL_CCA 0x23
+
+static inline void
+sbp_write_header (uint8_t *buf, uint8_t type, uint8_t len)
+{
+  buf[0] = (uint8_t)((SBP_VERSION << 5) | (type & 0x1f));
+  buf[1] = len;
+}
+
+static inline uint8_t
+sbp_header_version (const uint8_t *buf)
+{
+  return buf[0] >> 5;
+}
+
+static inline uint8_t
+sbp_header_type (const uint8_t *buf)
+{
+  return buf[0] & 0x1f;
+}
+
+static inline uint8_t
+sbp_header_length (const uint8_t *buf)
+{
+  return buf[1];
+}
+
+static inline void
+sbp_put_u16 (uint8_t *buf, uint16_t value)
+{
+  buf[0] = value >> 8;
+  buf[1] = value & 0xff;
+}
+
+static inline uint16_t
+sbp_get_u16 (const uint8_t *buf)
+{
+  return (uint16_t)((buf[0] << 8) | buf[1]);
+}
+
+static inline void
+sbp_put_u32 (uint8_t *buf, uint32_t value)
+{
+  sbp_put_u16 (buf, value >> 16);
+  sbp_put_u16 (buf + 2, value & 0xffff);
+}
+
+static inline uint32_t
+sbp_get_u32 (const uint8_t *buf)
+{
+  return ((uint32_t)sbp_get_u16 (buf) << 16) | sbp_get_u16 (buf + 2);
+}
+
+static inline void
+sbp_put_u64 (uint8_t *buf, uint64_t value)
+{
+  sbp_put_u32 (buf, value >> 32);
+  sbp_put_u32 (buf + 4, value & 0xffffffff);
+}
+
+static inline uint64_t
+sbp_get_u64 (const uint8_t *buf)
+{
+  return ((uint64_t)sbp_get_u32 (buf) << 32) | sbp_get_u32 (buf + 4);
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Reassembles messages from a byte stream, for processes that read the
+ * socket without blocking.
+ */
+struct sbp_reader
+{
+  uint8_t buf[SBP_HEADER_LEN + SBP_MAX_PAYLOAD];
+  uint16_t len;
+};
+
+typedef void (*sbp_message_callback) (void *context, uint8_t type, const uint8_t *payload, uint8_t len);
+
+void sbp_reader_init (struct sbp_reader *reader);
+
+/*
+ * Append data read from the socket and call the callback for every complete
+ * message.  Returns the number of messages delivered.
+ */
+int sbp_reader_feed (struct sbp_reader *reader, const uint8_t *data, int len,
+                     sbp_message_callback callback, void *context);
+
+/*
+ * Write one message with a single system call.  Returns 0 on success, -1 on
+ * error.
+ */
+int sbp_send (int fd, uint8_t type, const uint8_t *payload, uint8_t len);
+
+int sbp_send_data (int fd, const uint8_t *frame, uint8_t len);
+
+int sbp_send_control (int fd, uint8_t subtype, const uint8_t *args, uint8_t len);
+
+int sbp_send_time_request (int fd);
+
+/*
+ * Read from the socket like read(), but also return a socket passed along
+ * with SBP_CTRL_FORK in *passed_fd (-1 if none).  Processes that support
+ * SBP_CTRL_FORK must read with this function.
+ */
+int sbp_recv (int fd, uint8_t *buf, int len, int *passed_fd);
+
+/*
+ * Handle SBP_CTRL_FORK: fork the process, move the new process onto the
+ * passed socket as fd and announce it with SBP_CTRL_FORKED.  Returns 0 in
+ * the new process, the PID of the new process in the original one and -1
+ * on error, like fork().
+ */
+int sbp_fork (int fd, int passed_fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SOCKET_BRIDGE_PROTOCOL_H */
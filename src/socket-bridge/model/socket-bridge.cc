@@ -22,26 +22,269 @@ NS_LOG_COMPONENT_DEFINE ("SocketBridge");
 
 namespace ns3 {
 
-FdReader::Data SocketBridgeFdReader::DoRead (void)
+const uint32_t SocketBridgeFdReader::RAW_READ_SIZE;
+const uint32_t SocketBridge::COALESCE_FRAMES;
+const uint32_t SocketBridge::COALESCE_LIMIT;
+
+/* The bridges whose reader threads use the inbox, and the inbox poll */
+static uint32_t g_inboxBridges = 0;
+static EventId g_inboxPoll;
+
+SocketBridgeFdReader::SocketBridgeFdReader ()
+  : m_fd (-1),
+    m_stackSize (0),
+    m_running (false),
+    m_stop (false),
+    m_framed (false),
+    m_pool (0),
+    m_allocations (0)
+{
+  m_evpipe[0] = -1;
+  m_evpipe[1] = -1;
+}
+
+SocketBridgeFdReader::~SocketBridgeFdReader ()
+{
+  Stop ();
+}
+
+void
+SocketBridgeFdReader::Start (int fd, Callback<void, uint8_t *, ssize_t> readCallback, uint32_t stackSize)
+{
+  NS_LOG_FUNCTION (fd << stackSize);
+  NS_ASSERT_MSG (!m_running, "read thread already exists");
+
+  m_fd = fd;
+  m_readCallback = readCallback;
+  m_stop = false;
+
+  /* The pipe wakes the thread up from poll() when it is stopped */
+  NS_ABORT_MSG_IF (pipe (m_evpipe) == -1, "SocketBridgeFdReader::Start(): pipe() failed, errno = " << strerror (errno));
+
+  pthread_attr_t attr;
+  pthread_attr_init (&attr);
+  size_t size = stackSize;
+  if (stackSize != 0)
+    {
+      size = stackSize < (size_t)PTHREAD_STACK_MIN ? (size_t)PTHREAD_STACK_MIN : stackSize;
+      NS_ABORT_MSG_IF (pthread_attr_setstacksize (&attr, size) != 0,
+                       "SocketBridgeFdReader::Start(): invalid stack size " << size);
+    }
+  else
+    {
+      pthread_attr_getstacksize (&attr, &size);
+    }
+  m_stackSize = size;
+  int error = pthread_create (&m_thread, &attr, &SocketBridgeFdReader::RunThread, this);
+  pthread_attr_destroy (&attr);
+  NS_ABORT_MSG_IF (error != 0, "SocketBridgeFdReader::Start(): pthread_create() failed, error = " << strerror (error));
+  m_running = true;
+}
+
+void
+SocketBridgeFdReader::Stop (void)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
-  uint32_t bufferSize = 65536;
-  uint8_t *buf = (uint8_t *)malloc (bufferSize);
+  if (!m_running)
+    {
+      return;
+    }
+  m_stop = true;
+  char zero = 0;
+  ssize_t len = write (m_evpipe[1], &zero, sizeof (zero));
+  if (len != sizeof (zero))
+    {
+      NS_LOG_WARN ("SocketBridgeFdReader::Stop(): incomplete write(), errno = " << strerror (errno));
+    }
+  pthread_join (m_thread, 0);
+  m_running = false;
+
+  close (m_evpipe[1]);
+  close (m_evpipe[0]);
+  m_evpipe[0] = -1;
+  m_evpipe[1] = -1;
+  m_fd = -1;
+  m_readCallback.Nullify ();
+}
+
+uint32_t
+SocketBridgeFdReader::GetStackSize (void) const
+{
+  return m_stackSize;
+}
+
+void *
+SocketBridgeFdReader::RunThread (void *reader)
+{
+  static_cast<SocketBridgeFdReader *> (reader)->Run ();
+  return 0;
+}
+
+void
+SocketBridgeFdReader::Run (void)
+{
+  struct pollfd fds[2];
+  fds[0].fd = m_fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = m_evpipe[0];
+  fds[1].events = POLLIN;
+
+  while (!m_stop)
+    {
+      if (poll (fds, 2, -1) == -1)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+          NS_FATAL_ERROR ("SocketBridgeFdReader::Run(): poll() failed, errno = " << strerror (errno));
+        }
+      if (fds[1].revents != 0 || m_stop)
+        {
+          break;
+        }
+      if (fds[0].revents != 0)
+        {
+          Data data = DoRead ();
+          if (data.m_len <= 0)
+            {
+              /* The process is gone; nothing more will be read */
+              break;
+            }
+          if (m_stop)
+            {
+              FreeBuffer (data.m_buf);
+              break;
+            }
+          m_readCallback (data.m_buf, data.m_len);
+        }
+    }
+}
+
+void
+SocketBridgeFdReader::SetBufferPool (SocketBufferPool *pool)
+{
+  m_pool = pool;
+}
+
+uint64_t
+SocketBridgeFdReader::GetAllocations (void) const
+{
+  return m_allocations;
+}
+
+uint8_t *
+SocketBridgeFdReader::AllocateBuffer (uint32_t len)
+{
+  if (m_pool != 0)
+    {
+      return m_pool->Allocate ();
+    }
+  uint8_t *buf = (uint8_t *)malloc (len);
   NS_ABORT_MSG_IF (buf == 0, "malloc() failed");
+  m_allocations++;
+  return buf;
+}
+
+void
+SocketBridgeFdReader::FreeBuffer (uint8_t *buf)
+{
+  if (m_pool != 0)
+    {
+      m_pool->Free (buf);
+      return;
+    }
+  free (buf);
+}
+
+void
+SocketBridgeFdReader::SetFramed (bool framed)
+{
+  m_framed = framed;
+}
+
+bool
+SocketBridgeFdReader::ReadAll (uint8_t *buf, uint32_t len)
+{
+  while (len > 0)
+    {
+      ssize_t n = read (m_fd, buf, len);
+      if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      if (n <= 0)
+        {
+          return false;
+        }
+      buf += n;
+      len -= n;
+    }
+  return true;
+}
+
+SocketBridgeFdReader::Data SocketBridgeFdReader::DoRead (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  if (m_framed)
+    {
+      //
+      // Read exactly one message, so that every callback gets a whole
+      // message and nothing is left buffered when the reader goes back to
+      // select() on the socket.
+      //
+      uint8_t header[SBP_HEADER_LEN];
+      NS_LOG_LOGIC ("Reading message header on IPC socket fd " << m_fd);
+      if (!ReadAll (header, SBP_HEADER_LEN))
+        {
+          NS_LOG_INFO ("SocketBridgeFdReader::DoRead(): done");
+          return Data (0, 0);
+        }
+      uint32_t len = SBP_HEADER_LEN + sbp_header_length (header);
+      uint8_t *buf = AllocateBuffer (len);
+      memcpy (buf, header, SBP_HEADER_LEN);
+      if (!ReadAll (buf + SBP_HEADER_LEN, len - SBP_HEADER_LEN))
+        {
+          NS_LOG_INFO ("SocketBridgeFdReader::DoRead(): done in the middle of a message");
+          FreeBuffer (buf);
+          return Data (0, 0);
+        }
+      return Data (buf, len);
+    }
+
+  if (m_pool != 0)
+    {
+      //
+      // Read straight into a pooled buffer; it holds the largest 802.15.4
+      // frame with room to spare.
+      //
+      uint8_t *buf = m_pool->Allocate ();
+      NS_LOG_LOGIC ("Calling read on IPC socket fd " << m_fd);
+      ssize_t len = read (m_fd, buf, SocketBufferPool::BUFFER_SIZE);
+      if (len <= 0)
+        {
+          NS_LOG_INFO ("SocketBridgeFdReader::DoRead(): done");
+          m_pool->Free (buf);
+          return Data (0, 0);
+        }
+      return Data (buf, len);
+    }
+
+  uint8_t chunk[RAW_READ_SIZE];
 
   NS_LOG_LOGIC ("Calling read on IPC socket fd " << m_fd);
-  ssize_t len = read (m_fd, buf, bufferSize);
-//NS_LOG_UNCOND ("Contiki -> NS3: " << len << " Bytes Read on IPC socket fd " << m_fd);
+  ssize_t len = read (m_fd, chunk, RAW_READ_SIZE);
   if (len <= 0)
     {
       NS_LOG_INFO ("SocketBridgeFdReader::DoRead(): done");
-      free (buf);
-      buf = 0;
-      len = 0;
+      return Data (0, 0);
     }
 
-  return FdReader::Data (buf, len);
+  uint8_t *buf = AllocateBuffer (len);
+  memcpy (buf, chunk, len);
+  return Data (buf, len);
 }
 
 NS_OBJECT_ENSURE_REGISTERED (SocketBridge);
@@ -62,6 +305,96 @@ SocketBridge::GetTypeId (void)
                    TimeValue (Seconds (0.)),
                    MakeTimeAccessor (&SocketBridge::m_tStop),
                    MakeTimeChecker ())
+    .AddAttribute ("PollInterval",
+                   "The interval at which frames read from the socket are forwarded when the "
+                   "simulator implementation is not thread safe (e.g. DistributedSimulatorImpl).",
+                   TimeValue (MilliSeconds (1)),
+                   MakeTimeAccessor (&SocketBridge::m_pollInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("Inbox",
+                   "Pass the frames read from the socket to the simulator through the lock-free "
+                   "SocketBridgeInbox shared by all bridges, drained once per batch, instead of "
+                   "scheduling an event per frame.  Always used when the simulator implementation "
+                   "is not thread safe.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&SocketBridge::m_inbox),
+                   MakeBooleanChecker ())
+    .AddAttribute ("LatencyInstrumentation",
+                   "Carry per-stage wall-clock timestamps with every frame read from the socket "
+                   "and record latency histograms for every frame written to it.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&SocketBridge::m_latencyEnabled),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Protocol",
+                   "The protocol spoken on the IPC socket: RAW 802.15.4 frames, or FRAMED "
+                   "data, control and time messages (see socket-bridge-protocol.h).",
+                   EnumValue (SocketBridge::RAW),
+                   MakeEnumAccessor (&SocketBridge::m_protocol),
+                   MakeEnumChecker (SocketBridge::RAW, "RAW",
+                                    SocketBridge::FRAMED, "FRAMED"))
+    .AddAttribute ("IoBackend",
+                   "How the IPC socket is read and written: a reader THREAD per bridge, or one "
+                   "SocketIoService thread for all bridges waiting with EPOLL or reaping the "
+                   "completions of an io_uring (URING, falls back to EPOLL when unsupported).",
+                   EnumValue (SocketBridge::THREAD),
+                   MakeEnumAccessor (&SocketBridge::m_ioBackend),
+                   MakeEnumChecker (SocketBridge::THREAD, "THREAD",
+                                    SocketBridge::EPOLL, "EPOLL",
+                                    SocketBridge::URING, "URING"))
+    .AddAttribute ("Coalesce",
+                   "Gather the FRAMED messages written to the socket at one simulation time, or "
+                   "within the adaptive coalescing window, and write them with a single write().",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&SocketBridge::m_coalesce),
+                   MakeBooleanChecker ())
+    .AddAttribute ("CoalesceWindow",
+                   "The longest simulation time a frame written to the socket waits for others "
+                   "when frames arrive faster than that; 0 to only gather the frames of one "
+                   "simulation time.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&SocketBridge::m_coalesceWindow),
+                   MakeTimeChecker ())
+    .AddAttribute ("ReaderStackSize",
+                   "The stack size in bytes of the thread reading the socket, 0 for the "
+                   "default of the system (usually 8 MiB of address space).",
+                   UintegerValue (65536),
+                   MakeUintegerAccessor (&SocketBridge::m_readerStackSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("IngressPoolSize",
+                   "The number of free buffers kept for frames read from the socket, so that "
+                   "they are recycled instead of allocated per frame; 0 for no pool.",
+                   UintegerValue (16),
+                   MakeUintegerAccessor (&SocketBridge::m_ingressPoolSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ForkTimeout",
+                   "The wall-clock time to wait for the external process to fork itself "
+                   "(see SocketBridgeHelper::Fork).",
+                   TimeValue (Seconds (5)),
+                   MakeTimeAccessor (&SocketBridge::m_forkTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("RecordFile",
+                   "The file to record every frame and message read from the socket to, with "
+                   "the simulation time it entered the simulation; empty for no recording.",
+                   StringValue (""),
+                   MakeStringAccessor (&SocketBridge::m_recordFile),
+                   MakeStringChecker ())
+    .AddAttribute ("ReplayFile",
+                   "A file recorded with RecordFile to feed into the simulation at the recorded "
+                   "times instead of spawning the external process; empty to spawn it.",
+                   StringValue (""),
+                   MakeStringAccessor (&SocketBridge::m_replayFile),
+                   MakeStringChecker ())
+    .AddTraceSource ("Latency",
+                     "A frame carrying a SocketLatencyTag has been written to the socket.",
+                     MakeTraceSourceAccessor (&SocketBridge::m_latencyTrace))
+    .AddTraceSource ("Read",
+                     "A frame has been read from the socket and queued for the simulator, with its "
+                     "length and the frames pending; fired from the reader thread.",
+                     MakeTraceSourceAccessor (&SocketBridge::m_readTrace))
+    .AddTraceSource ("Shed",
+                     "A frame read from the socket has been dropped while shedding load, with its "
+                     "length; fired from the reader thread.",
+                     MakeTraceSourceAccessor (&SocketBridge::m_shedTrace))
   ;
   return tid;
 }
@@ -72,10 +405,37 @@ SocketBridge::SocketBridge ()
     m_sock (-1),
     m_startEvent (),
     m_stopEvent (),
-    m_fdReader (0)
+    m_fdReader (0),
+    m_ioBackend (THREAD),
+    m_io (0),
+    m_ioId (0),
+    m_threadSafeSchedule (true),
+    m_inbox (true),
+    m_inboxStarted (false),
+    m_protocol (RAW),
+    child (-1),
+    m_readerStackSize (65536),
+    m_latencyEnabled (false),
+    m_pendingFrames (0),
+    m_shedLoad (false),
+    m_shedFrames (0),
+    m_framesRead (0),
+    m_framesWritten (0),
+    m_oversizeFrames (0),
+    m_socketWrites (0),
+    m_coalesce (true),
+    m_coalesceWindow (Seconds (0)),
+    m_ingressPoolSize (16),
+    m_bufferPool (0),
+    m_bufferAllocations (0),
+    m_forkTimeout (Seconds (5)),
+    m_forkSock (-1),
+    m_forkChild (-1),
+    m_record (0),
+    m_replay (0),
+    m_replayBuf (0)
 {
   NS_LOG_FUNCTION_NOARGS ();
-  m_packetBuffer = new uint8_t[65536];
   Start (m_tStart);
 }
 
@@ -85,8 +445,6 @@ SocketBridge::~SocketBridge()
 
   StopSocketDevice ();
 
-  delete [] m_packetBuffer;
-  m_packetBuffer = 0;
   m_bridgedDevice = 0;
 }
 
@@ -129,61 +487,375 @@ SocketBridge::StartSocketDevice (void)
 
   m_nodeId = GetNode ()->GetId ();
 
+  if (GetNode ()->GetSystemId () != Simulator::GetSystemId ())
+    {
+      //
+      // In a distributed simulation every rank holds the complete topology,
+      // but only the rank owning the node spawns its external process.
+      //
+      NS_LOG_LOGIC ("Node " << m_nodeId << " belongs to rank " << GetNode ()->GetSystemId () << ", not spawning");
+      return;
+    }
+
+  if (!m_replayFile.empty ())
+    {
+      StartReplay ();
+      return;
+    }
+
+  m_threadSafeSchedule = (DynamicCast<RealtimeSimulatorImpl> (Simulator::GetImplementation ()) != 0);
+  if (g_inboxBridges++ == 0)
+    {
+      //
+      // A drain armed by a previous simulation never ran.
+      //
+      SocketBridgeInbox::Get ()->Disarm ();
+      g_inboxPoll = EventId ();
+    }
+  m_inboxStarted = true;
+  if (!m_threadSafeSchedule && !g_inboxPoll.IsRunning ())
+    {
+      NS_LOG_LOGIC ("Simulator implementation is not thread safe, polling every " << m_pollInterval);
+      g_inboxPoll = Simulator::Schedule (m_pollInterval, &SocketBridge::PollInbox, m_pollInterval);
+    }
+
   //
   // Spin up the Socket bridge and start receiving packets.
   //
   NS_LOG_LOGIC ("Creating IPC Socket");
 
-  CreateSocket ();
+  Mac64Address address = Mac64Address::Allocate ();
+  AssignAddress (address);
+  CreateSocket (address);
+
+  if (!m_recordFile.empty ())
+    {
+      m_record = new SocketRecordLog;
+      NS_ABORT_MSG_UNLESS (m_record->Open (m_recordFile, m_protocol, address),
+                           "SocketBridge::StartSocketDevice(): cannot create " << m_recordFile);
+    }
 
   //
   // Now spin up a read thread to read packets from the tap device.
   //
-  NS_ABORT_MSG_IF (m_fdReader != 0,"SocketBridge::StartSocketDevice(): Receive thread is already running");
+  NS_ABORT_MSG_IF (m_fdReader != 0 || m_io != 0,"SocketBridge::StartSocketDevice(): Receive thread is already running");
   NS_LOG_LOGIC ("Spinning up read thread");
 
+  if (m_ingressPoolSize != 0)
+    {
+      m_bufferPool = new SocketBufferPool (m_ingressPoolSize);
+    }
+  StartReader ();
+}
+
+void
+SocketBridge::StartReader (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  if (m_ioBackend != THREAD)
+    {
+      m_io = SocketIoService::Get (m_ioBackend == URING ? SocketIoService::URING : SocketIoService::EPOLL);
+      m_ioId = m_io->Add (m_sock, m_protocol == FRAMED, m_bufferPool,
+                          MakeCallback (&SocketBridge::ReadCallback, this));
+      return;
+    }
+
   m_fdReader = Create<SocketBridgeFdReader> ();
-  m_fdReader->Start (m_sock, MakeCallback (&SocketBridge::ReadCallback, this));
+  m_fdReader->SetFramed (m_protocol == FRAMED);
+  if (m_bufferPool != 0)
+    {
+      m_fdReader->SetBufferPool (m_bufferPool);
+    }
+
+  m_fdReader->Start (m_sock, MakeCallback (&SocketBridge::ReadCallback, this), m_readerStackSize);
 }
 
 void
-SocketBridge::StopSocketDevice (void)
+SocketBridge::Suspend (void)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
+  FlushOutbound ();
   if (m_fdReader != 0)
     {
       m_fdReader->Stop ();
+      m_bufferAllocations += m_fdReader->GetAllocations ();
       m_fdReader = 0;
     }
+  if (m_io != 0)
+    {
+      m_io->Remove (m_ioId);
+      m_io = 0;
+    }
+}
+
+void
+SocketBridge::Resume (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  if (m_sock != -1 && m_fdReader == 0 && m_io == 0)
+    {
+      /* Frames gathered while suspended go out before the URING backend takes over writes */
+      FlushOutbound ();
+      StartReader ();
+    }
+}
+
+bool
+SocketBridge::ForkProcess (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  if (m_sock == -1)
+    {
+      return false;
+    }
+  NS_ABORT_MSG_IF (m_protocol != FRAMED, "SocketBridge::ForkProcess(): the process can only be forked with the FRAMED protocol");
+  NS_ABORT_MSG_IF (m_fdReader != 0 || m_io != 0, "SocketBridge::ForkProcess(): the reader is not suspended");
+  NS_ABORT_MSG_IF (m_forkSock != -1, "SocketBridge::ForkProcess(): previous fork not completed");
+  NS_ABORT_MSG_IF (m_record != 0, "SocketBridge::ForkProcess(): a recording bridge cannot be forked");
+
+  int sockets[2];
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets) < 0)
+    NS_ABORT_MSG ("SocketBridge::ForkProcess(): Unix socket creation error, errno = " << strerror (errno));
+
+  //
+  // The new socket travels with the request, as ancillary data of its first
+  // byte.
+  //
+  uint8_t request[SBP_HEADER_LEN + 1];
+  sbp_write_header (request, SBP_TYPE_CONTROL, 1);
+  request[SBP_HEADER_LEN] = SBP_CTRL_FORK;
+
+  struct iovec iov;
+  iov.iov_base = request;
+  iov.iov_len = sizeof (request);
+  char control[CMSG_SPACE (sizeof (int))];
+  memset (control, 0, sizeof (control));
+  struct msghdr msg;
+  memset (&msg, 0, sizeof (msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof (control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (sizeof (int));
+  memcpy (CMSG_DATA (cmsg), &sockets[1], sizeof (int));
+
+  ssize_t bytesWritten = sendmsg (m_sock, &msg, 0);
+  close (sockets[1]);
+  NS_ABORT_MSG_IF (bytesWritten != sizeof (request), "SocketBridge::ForkProcess(): Write error.");
+
+  //
+  // The forked process announces itself before anything else on the new
+  // socket.
+  //
+  uint8_t reply[SBP_HEADER_LEN + 5];
+  uint32_t received = 0;
+  while (received < sizeof (reply))
+    {
+      struct pollfd pfd;
+      pfd.fd = sockets[0];
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      int ready = poll (&pfd, 1, m_forkTimeout.GetMilliSeconds ());
+      if (ready < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      NS_ABORT_MSG_IF (ready <= 0, "SocketBridge::ForkProcess(): process " << child << " did not fork");
+      ssize_t n = read (sockets[0], reply + received, sizeof (reply) - received);
+      NS_ABORT_MSG_IF (n <= 0, "SocketBridge::ForkProcess(): forked process closed the socket");
+      received += n;
+    }
+  NS_ABORT_MSG_IF (sbp_header_type (reply) != SBP_TYPE_CONTROL || sbp_header_length (reply) != 5
+                   || reply[SBP_HEADER_LEN] != SBP_CTRL_FORKED,
+                   "SocketBridge::ForkProcess(): unexpected reply from the forked process");
+
+  m_forkSock = sockets[0];
+  m_forkChild = sbp_get_u32 (reply + SBP_HEADER_LEN + 1);
+  NS_LOG_LOGIC ("Process " << child << " of node " << m_nodeId << " forked process " << m_forkChild);
+  return true;
+}
+
+void
+SocketBridge::CompleteFork (bool adopt)
+{
+  NS_LOG_FUNCTION (adopt);
+
+  if (m_forkSock == -1)
+    {
+      return;
+    }
+  if (adopt)
+    {
+      //
+      // The original process stays with the original ns-3 process.  The
+      // forked one is not a child of this process, so StopSocketDevice can
+      // kill it but not wait for it.
+      //
+      close (m_sock);
+      m_sock = m_forkSock;
+      child = m_forkChild;
+    }
+  else
+    {
+      close (m_forkSock);
+    }
+  m_forkSock = -1;
+  m_forkChild = -1;
+}
+
+void
+SocketBridge::StopSocketDevice (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  Suspend ();
+  CompleteFork (false);
+
+  Simulator::Cancel (m_replayEvent);
+  if (m_replayBuf != 0)
+    {
+      FreeBuffer (m_replayBuf);
+      m_replayBuf = 0;
+    }
+  delete m_replay;
+  m_replay = 0;
+  if (m_record != 0 && m_record->GetRejected () > 0)
+    {
+      NS_LOG_WARN ("Node " << m_nodeId << ": " << m_record->GetRejected () << " buffers longer than " <<
+                   SocketReplayFormat::MAX_RECORD << " bytes were not recorded");
+    }
+  delete m_record;
+  m_record = 0;
+
+  if (m_inboxStarted)
+    {
+      PurgeInbox ();
+      m_inboxStarted = false;
+      if (--g_inboxBridges == 0)
+        {
+          Simulator::Cancel (g_inboxPoll);
+        }
+    }
+
+  //
+  // Frames still scheduled for forwarding release their buffers with free
+  // once the pool is gone.
+  //
+  if (m_bufferPool != 0)
+    {
+      m_bufferAllocations += m_bufferPool->GetAllocations ();
+      delete m_bufferPool;
+      m_bufferPool = 0;
+    }
 
   if (m_sock != -1)
     {
       close (m_sock);
       m_sock = -1;
     }
-NS_LOG_UNCOND("Killing Child");
-  kill(child,SIGKILL);
+
+  if (child > 0)
+    {
+      NS_LOG_UNCOND("Killing Child");
+      kill(child,SIGKILL);
+      waitpid(child, NULL, 0);
+      child = -1;
+    }
 }
 
 void
-SocketBridge::CreateSocket (void)
+SocketBridge::AssignAddress (Mac64Address address)
+{
+  NS_LOG_FUNCTION (address);
+
+  Ptr<NetDevice> nd = GetBridgedNetDevice ();
+  nd->SetAddress (Address (address));
+  if (m_macLayer != 0)
+    {
+      /* The extended address the external process is started with */
+      m_macLayer->SetAddress (address);
+    }
+}
+
+void
+SocketBridge::StartReplay (void)
+{
+  NS_LOG_FUNCTION (m_replayFile);
+
+  m_replay = new SocketReplayLog;
+  NS_ABORT_MSG_UNLESS (m_replay->Open (m_replayFile), "SocketBridge::StartReplay(): cannot read " << m_replayFile);
+  NS_ABORT_MSG_IF (m_replay->GetProtocol () != m_protocol,
+                   "SocketBridge::StartReplay(): " << m_replayFile << " was recorded with another Protocol");
+  AssignAddress (m_replay->GetAddress ());
+
+  if (m_ingressPoolSize != 0)
+    {
+      m_bufferPool = new SocketBufferPool (m_ingressPoolSize);
+    }
+  ScheduleReplay ();
+}
+
+void
+SocketBridge::ScheduleReplay (void)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
+  if (m_bufferPool != 0)
+    {
+      m_replayBuf = m_bufferPool->Allocate ();
+    }
+  else
+    {
+      m_replayBuf = (uint8_t *)malloc (SocketBufferPool::BUFFER_SIZE);
+      NS_ABORT_MSG_IF (m_replayBuf == 0, "malloc() failed");
+      m_bufferAllocations++;
+    }
+
+  Time time;
+  uint32_t len;
+  if (!m_replay->Next (time, m_replayBuf, len) || len == 0)
+    {
+      NS_LOG_LOGIC ("End of " << m_replayFile << " on node " << m_nodeId);
+      FreeBuffer (m_replayBuf);
+      m_replayBuf = 0;
+      return;
+    }
+  Time now = Simulator::Now ();
+  m_replayEvent = Simulator::Schedule (time > now ? time - now : Seconds (0.0), &SocketBridge::ReplayFrame, this, len);
+}
+
+void
+SocketBridge::ReplayFrame (uint32_t len)
+{
+  NS_LOG_FUNCTION (len);
+
+  uint8_t *buf = m_replayBuf;
+  m_replayBuf = 0;
+  if (m_protocol == RAW || sbp_header_type (buf) == SBP_TYPE_DATA)
+    {
+      __sync_fetch_and_add (&m_framesRead, 1);
+    }
+  __sync_fetch_and_add (&m_pendingFrames, 1);
+  ForwardToBridgedDevice (buf, len, 0);
+  ScheduleReplay ();
+}
+
+void
+SocketBridge::CreateSocket (Mac64Address mac64Address)
+{
+  NS_LOG_FUNCTION (mac64Address);
+
   int sockets[2];
   if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) < 0)
     NS_ABORT_MSG ("SocketBridge::CreateSocket(): Unix socket creation error, errno = " << strerror (errno));
 
-  Ptr<NetDevice> nd = GetBridgedNetDevice ();
-  Ptr<Node> n = nd->GetNode ();
-
-  /* Generate MAC address, assign to Node */ 
-  Mac64Address mac64Address = Mac64Address::Allocate();
-
-  Address ndAddress = Address(mac64Address);
-  nd->SetAddress(ndAddress); 
-  
   if ((child = fork()) == -1)
     NS_ABORT_MSG ("SocketBridge::CreateSockete(): Unix fork error, errno = " << strerror (errno));
   else if (child) {   /*  This is the parent. */
@@ -192,6 +864,14 @@ SocketBridge::CreateSocket (void)
     NS_LOG_INFO ("Got the socket from the socket creator = " << sockets[0]);
     m_sock = sockets[0];
 //NS_LOG_UNCOND("Child PID: " << child);
+    if (m_protocol == FRAMED)
+      {
+        /* The address is also announced in band, ahead of any frame */
+        uint8_t address[9];
+        address[0] = SBP_CTRL_ADDRESS;
+        mac64Address.CopyTo (address + 1);
+        SendMessage (SBP_TYPE_CONTROL, address, sizeof (address));
+      }
   } else {            /*  This is the child. */
     close(sockets[0]);
    
@@ -207,6 +887,7 @@ SocketBridge::CreateSocket (void)
     ::execlp (path, 
               path,                       // argv[0] (filename)
               ossMac.str ().c_str (),     // argv[1] (-m<MAC address>)
+              m_protocol == FRAMED ? "-f" : (char *)NULL, // argv[2] (-f for the framed protocol)
               (char *)NULL);
     //
     // If the execlp successfully completes, it never returns.  If it returns it failed or the OS is
@@ -225,53 +906,233 @@ SocketBridge::ReadCallback (uint8_t *buf, ssize_t len)
   NS_ASSERT_MSG (len > 0, "invalid len argument");
 
   NS_LOG_INFO ("SocketBridge::ReadCallback(): Received packet on node " << m_nodeId);
-  NS_LOG_INFO ("SocketBridge::ReadCallback(): Scheduling handler");
-  Simulator::ScheduleWithContext (m_nodeId, Seconds (0.0), MakeEvent (&SocketBridge::ForwardToBridgedDevice, this, buf, len));
+  bool data = true;
+  if (m_protocol == FRAMED)
+    {
+      if (sbp_header_version (buf) != SBP_VERSION)
+        {
+          NS_LOG_INFO ("SocketBridge::ReadCallback(): Dropping message of protocol version " << (uint32_t)sbp_header_version (buf));
+          FreeBuffer (buf);
+          return;
+        }
+      data = sbp_header_type (buf) == SBP_TYPE_DATA;
+    }
+  if (data)
+    {
+      __sync_fetch_and_add (&m_framesRead, 1);
+    }
+  if (m_shedLoad && data)
+    {
+      NS_LOG_INFO ("SocketBridge::ReadCallback(): Shedding load, dropping packet");
+      FreeBuffer (buf);
+      __sync_fetch_and_add (&m_shedFrames, 1);
+      m_shedTrace (len);
+      return;
+    }
+
+  uint64_t readNs = m_latencyEnabled ? SocketLatencyTag::GetWallClockNs () : 0;
+  uint32_t pending = __sync_add_and_fetch (&m_pendingFrames, 1);
+  if (data)
+    {
+      m_readTrace (len, pending);
+    }
+
+  if (m_threadSafeSchedule && !m_inbox)
+    {
+      NS_LOG_INFO ("SocketBridge::ReadCallback(): Scheduling handler");
+      Simulator::ScheduleWithContext (m_nodeId, Seconds (0.0), MakeEvent (&SocketBridge::ForwardToBridgedDevice, this, buf, len, readNs));
+      return;
+    }
+
+  SocketBridgeInbox *inbox = SocketBridgeInbox::Get ();
+  SocketBridgeInbox::Frame frame;
+  frame.bridge = this;
+  frame.buf = buf;
+  frame.len = len;
+  frame.readNs = readNs;
+  if (!inbox->Push (frame))
+    {
+      NS_LOG_INFO ("SocketBridge::ReadCallback(): Inbox full, dropping packet");
+      FreeBuffer (buf);
+      __sync_fetch_and_sub (&m_pendingFrames, 1);
+      __sync_fetch_and_add (&m_shedFrames, 1);
+      m_shedTrace (len);
+      return;
+    }
+  //
+  // Only the first frame after a drain schedules the next one, so that the
+  // simulator lock is taken once per batch.  Otherwise PollInbox picks the
+  // frame up.
+  //
+  if (m_threadSafeSchedule && inbox->Arm ())
+    {
+      NS_LOG_INFO ("SocketBridge::ReadCallback(): Scheduling inbox drain");
+      Simulator::ScheduleWithContext (m_nodeId, Seconds (0.0), MakeEvent (&SocketBridge::DrainInbox));
+    }
 }
 
 void
-SocketBridge::ForwardToBridgedDevice (uint8_t *buf, ssize_t len)
+SocketBridge::DrainInbox (void)
 {
-  NS_LOG_FUNCTION (buf << len);
+  NS_LOG_FUNCTION_NOARGS ();
+
+  SocketBridgeInbox *inbox = SocketBridgeInbox::Get ();
+  inbox->Disarm ();
 
   //
-  // First, create a packet out of the byte buffer we received and free that
-  // buffer.
+  // Frames pushed from now on arm the next drain, so only forward those
+  // already queued rather than chase the readers.
   //
-  Ptr<Packet> packet = Create<Packet> (reinterpret_cast<const uint8_t *> (buf), len);
-  free (buf);
-  buf = 0;
+  uint32_t queued = inbox->GetSize ();
+  uint32_t forwarded = 0;
+  SocketBridgeInbox::Frame frame;
+  while (forwarded < queued && inbox->Pop (frame))
+    {
+      ForwardFrame (frame);
+      forwarded++;
+    }
+  inbox->AddBatch (forwarded);
+}
+
+void
+SocketBridge::ForwardFrame (const SocketBridgeInbox::Frame &frame)
+{
+  //
+  // The drain runs in the context of the bridge that armed it.  Frames of
+  // other bridges are handed to their own node so that the traces and
+  // events they cause carry the right context.
+  //
+  if (frame.bridge->m_nodeId == Simulator::GetContext ())
+    {
+      frame.bridge->ForwardToBridgedDevice (frame.buf, frame.len, frame.readNs);
+      return;
+    }
+  Simulator::ScheduleWithContext (frame.bridge->m_nodeId, Seconds (0.0),
+                                  MakeEvent (&SocketBridge::ForwardToBridgedDevice, frame.bridge,
+                                             frame.buf, frame.len, frame.readNs));
+}
+
+void
+SocketBridge::PollInbox (Time interval)
+{
+  NS_LOG_FUNCTION (interval);
+
+  DrainInbox ();
+  g_inboxPoll = Simulator::Schedule (interval, &SocketBridge::PollInbox, interval);
+}
+
+void
+SocketBridge::PurgeInbox (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  //
+  // Once the simulation is over the frames of the other bridges are of no
+  // use either; they are released with the buffers of their own bridge.
+  //
+  bool forward = !Simulator::IsFinished ();
+  SocketBridgeInbox *inbox = SocketBridgeInbox::Get ();
+  uint32_t queued = inbox->GetSize ();
+  SocketBridgeInbox::Frame frame;
+  for (uint32_t i = 0; i < queued; i++)
+    {
+      //
+      // Every frame counted has been claimed by a reader and is about to
+      // be published.
+      //
+      while (!inbox->Pop (frame))
+        {
+          sched_yield ();
+        }
+      if (frame.bridge != this && forward)
+        {
+          ForwardFrame (frame);
+        }
+      else
+        {
+          frame.bridge->FreeBuffer (frame.buf);
+          __sync_fetch_and_sub (&frame.bridge->m_pendingFrames, 1);
+        }
+    }
+}
+
+void
+SocketBridge::ForwardToBridgedDevice (uint8_t *buf, ssize_t len, uint64_t readNs)
+{
+  NS_LOG_FUNCTION (buf << len);
 
   Address src, dst;
-  uint16_t type;
+  uint16_t type = 0;
 
   NS_LOG_LOGIC ("Received packet from socket");
-  
-  // Pull source, destination and type information from packet
-  Ptr<Packet> p = Filter (packet, &src, &dst, &type);
 
-  if (p == 0)
+  if (m_record != 0)
     {
-      NS_LOG_LOGIC ("SocketBridge::ForwardToBridgedDevice:  Discarding packet as unfit for ns-3 consumption");
-      return;
+      m_record->Append (Simulator::Now (), buf, len);
+    }
+
+  uint8_t *frame = buf;
+  if (m_protocol == FRAMED)
+    {
+      uint8_t messageType = sbp_header_type (buf);
+      if (messageType != SBP_TYPE_DATA)
+        {
+          HandleMessage (messageType, buf + SBP_HEADER_LEN, sbp_header_length (buf));
+          FreeBuffer (buf);
+          __sync_fetch_and_sub (&m_pendingFrames, 1);
+          return;
+        }
+      frame = buf + SBP_HEADER_LEN;
+      len -= SBP_HEADER_LEN;
     }
 
-  NS_LOG_LOGIC ("Pkt source is " << src);
-  NS_LOG_LOGIC ("Pkt destination is " << dst);
-  NS_LOG_LOGIC ("Pkt LengthType is " << type);
-  NS_LOG_LOGIC ("Forwarding packet from external socket to simulated network");
+  //
+  // Pull source, destination and type information from the 802.15.4 header
+  // while the frame is still in the byte buffer.  Only the MAC overlay needs
+  // them.
+  //
+  bool parsed = (m_mode == MACPHYOVERLAY) && Filter (frame, len, &src, &dst, &type);
+
+  //
+  // Then, create a packet out of the byte buffer we received and free that
+  // buffer.
+  //
+  Ptr<Packet> packet = Create<Packet> (reinterpret_cast<const uint8_t *> (frame), len);
+  FreeBuffer (buf);
+  buf = 0;
+  __sync_fetch_and_sub (&m_pendingFrames, 1);
+
+  if (m_latencyEnabled)
+    {
+      SocketLatencyTag tag;
+      tag.SetSource (m_nodeId);
+      tag.SetTimestamp (SocketLatencyTag::READ, readNs);
+      tag.SetTimestamp (SocketLatencyTag::FORWARD, SocketLatencyTag::GetWallClockNs ());
+      packet->AddPacketTag (tag);
+    }
 
   if (m_mode == MACPHYOVERLAY)
     {
-      if (m_ns3AddressRewritten == false)
+      if (!parsed)
+        {
+          NS_LOG_LOGIC ("SocketBridge::ForwardToBridgedDevice:  Discarding packet as unfit for ns-3 consumption");
+          return;
+        }
+
+      NS_LOG_LOGIC ("Pkt source is " << src);
+      NS_LOG_LOGIC ("Pkt destination is " << dst);
+      NS_LOG_LOGIC ("Pkt LengthType is " << type);
+      NS_LOG_LOGIC ("Forwarding packet from external socket to simulated network");
+
+      if (m_ns3AddressRewritten == false && Mac64Address::IsMatchingType (src))
         {
           //
           // Set the ns-3 device's mac address to the overlying container's
           // mac address
           //
-          Mac48Address learnedMac = Mac48Address::ConvertFrom (src);
+          Mac64Address learnedMac = Mac64Address::ConvertFrom (src);
           NS_LOG_LOGIC ("Learned MacAddr is " << learnedMac << ": setting ns-3 device to use this address");
-          m_bridgedDevice->SetAddress (Mac48Address::ConvertFrom (learnedMac));
+          m_bridgedDevice->SetAddress (learnedMac);
           m_ns3AddressRewritten = true;
         }
 
@@ -286,13 +1147,228 @@ SocketBridge::ForwardToBridgedDevice (uint8_t *buf, ssize_t len)
   }
 }
 
-Ptr<Packet>
-SocketBridge::Filter (Ptr<Packet> p, Address *src, Address *dst, uint16_t *type)
+bool
+SocketBridge::Filter (const uint8_t *buf, uint32_t len, Address *src, Address *dst, uint16_t *type)
+{
+  NS_LOG_FUNCTION (buf << len);
+
+  SocketFrame frame;
+  if (!SocketFrameParser::Parse (buf, len, frame))
+    {
+      NS_LOG_LOGIC ("SocketBridge::Filter(): malformed 802.15.4 frame of " << len << " bytes");
+      return false;
+    }
+  *src = SocketFrameParser::GetSource (frame);
+  *dst = SocketFrameParser::GetDestination (frame);
+  *type = SocketFrameParser::GetProtocol (frame);
+  return true;
+}
+
+/* Length of the arguments of the control messages accepted from the process */
+static int
+ControlArgumentLength (uint8_t subtype)
+{
+  switch (subtype)
+    {
+    case SBP_CTRL_SET_PAN_ID:
+    case SBP_CTRL_SET_SHORT_ADDR:
+    case SBP_CTRL_SET_CCA:
+      return 2;
+    case SBP_CTRL_SET_AUTO_ACK:
+    case SBP_CTRL_SET_PROMISCUOUS:
+    case SBP_CTRL_SET_CHANNEL:
+    case SBP_CTRL_SET_TX_POWER:
+    case SBP_CTRL_SET_RADIO:
+      return 1;
+    case SBP_CTRL_STATS_REQUEST:
+    case SBP_CTRL_CCA_REQUEST:
+      return 0;
+    default:
+      return -1;
+    }
+}
+
+void
+SocketBridge::HandleMessage (uint8_t type, const uint8_t *payload, uint8_t len)
+{
+  NS_LOG_FUNCTION (this << (uint32_t)type << (uint32_t)len);
+
+  if (type == SBP_TYPE_TIME)
+    {
+      uint8_t now[8];
+      sbp_put_u64 (now, Simulator::Now ().GetMicroSeconds ());
+      SendMessage (SBP_TYPE_TIME, now, sizeof (now));
+      return;
+    }
+  if (type != SBP_TYPE_CONTROL || len < 1)
+    {
+      NS_LOG_LOGIC ("SocketBridge::HandleMessage(): ignoring message of type " << (uint32_t)type);
+      return;
+    }
+
+  uint8_t subtype = payload[0];
+  const uint8_t *args = payload + 1;
+  if (ControlArgumentLength (subtype) != len - 1)
+    {
+      NS_LOG_LOGIC ("SocketBridge::HandleMessage(): ignoring control message " << (uint32_t)subtype <<
+                    " with " << len - 1 << " bytes of arguments");
+      return;
+    }
+
+  switch (subtype)
+    {
+    case SBP_CTRL_SET_PAN_ID:
+      NS_ASSERT (m_macLayer != 0);
+      m_macLayer->SetPanId (sbp_get_u16 (args));
+      break;
+    case SBP_CTRL_SET_SHORT_ADDR:
+      NS_ASSERT (m_macLayer != 0);
+      m_macLayer->SetShortAddress (sbp_get_u16 (args));
+      break;
+    case SBP_CTRL_SET_AUTO_ACK:
+      NS_ASSERT (m_macLayer != 0);
+      m_macLayer->SetAutoAck (args[0] != 0);
+      break;
+    case SBP_CTRL_SET_PROMISCUOUS:
+      NS_ASSERT (m_macLayer != 0);
+      m_macLayer->SetPromiscuous (args[0] != 0);
+      break;
+    case SBP_CTRL_SET_CHANNEL:
+      NS_ASSERT (m_phy != 0);
+      m_phy->SetChannelNumber (args[0]);
+      break;
+    case SBP_CTRL_SET_TX_POWER:
+      NS_ASSERT (m_phy != 0);
+      m_phy->SetTxPowerDbm ((int8_t)args[0]);
+      break;
+    case SBP_CTRL_SET_RADIO:
+      NS_ASSERT (m_phy != 0);
+      m_phy->SetRadioOn (args[0] != 0);
+      break;
+    case SBP_CTRL_SET_CCA:
+      NS_ASSERT (m_phy != 0);
+      if (args[0] < SocketContikiPhy::CCA_ENERGY || args[0] > SocketContikiPhy::CCA_CARRIER_AND_ENERGY)
+        {
+          NS_LOG_LOGIC ("SocketBridge::HandleMessage(): ignoring CCA mode " << (uint32_t)args[0]);
+          break;
+        }
+      m_phy->SetCcaMode ((SocketContikiPhy::CcaMode)args[0]);
+      m_phy->SetCcaThreshold ((int8_t)args[1]);
+      break;
+    case SBP_CTRL_CCA_REQUEST:
+      {
+        NS_ASSERT (m_phy != 0);
+        uint8_t cca[2];
+        cca[0] = SBP_CTRL_CCA;
+        cca[1] = m_phy->IsChannelClear () ? 1 : 0;
+        SendMessage (SBP_TYPE_CONTROL, cca, sizeof (cca));
+      }
+      break;
+    case SBP_CTRL_STATS_REQUEST:
+      {
+        uint8_t stats[13];
+        stats[0] = SBP_CTRL_STATS;
+        sbp_put_u32 (stats + 1, m_framesRead);
+        sbp_put_u32 (stats + 5, m_framesWritten);
+        sbp_put_u32 (stats + 9, m_shedFrames);
+        SendMessage (SBP_TYPE_CONTROL, stats, sizeof (stats));
+      }
+      break;
+    }
+}
+
+void
+SocketBridge::SendMessage (uint8_t type, const uint8_t *payload, uint8_t len)
+{
+  NS_LOG_FUNCTION (this << (uint32_t)type << (uint32_t)len);
+
+  if (m_sock == -1)
+    {
+      /* Replaying, there is no process to answer */
+      return;
+    }
+
+  uint8_t message[SBP_HEADER_LEN + SBP_MAX_PAYLOAD];
+  sbp_write_header (message, type, len);
+  memcpy (message + SBP_HEADER_LEN, payload, len);
+
+  if (IsCoalescing ())
+    {
+      //
+      // Replies are not held back, but the frames gathered before them go
+      // out first and in the same write.
+      //
+      m_outbound.AddMessage (message, SBP_HEADER_LEN + len);
+      FlushOutbound ();
+      return;
+    }
+  NS_ABORT_MSG_IF (!WriteSocket (message, SBP_HEADER_LEN + len), "SocketBridge::SendMessage(): Write error.");
+}
+
+bool
+SocketBridge::WriteSocket (const uint8_t *buf, uint32_t len)
+{
+  if (m_io != 0 && m_io->Send (m_ioId, buf, len))
+    {
+      return true;
+    }
+  m_socketWrites++;
+  return write (m_sock, buf, len) == (ssize_t)len;
+}
+
+bool
+SocketBridge::IsCoalescing (void) const
 {
-  NS_LOG_FUNCTION (p);
-  /* Fill out src, dst and maybe type for the Send() function 
- *   This needs to be completed for MACOVERLAY mode to function - currently crashes because improper src/dst assigned */
-  return p;
+  return m_coalesce && m_protocol == FRAMED && m_sock != -1
+         && (m_io == 0 || m_io->GetBackend () != SocketIoService::URING);
+}
+
+void
+SocketBridge::QueueOutbound (const uint8_t *buf, uint32_t len)
+{
+  NS_LOG_FUNCTION (this << len);
+
+  if (m_outbound.AddFrame (Simulator::Now (), buf, len))
+    {
+      FlushOutbound ();
+    }
+  else if (!m_outboundEvent.IsRunning ())
+    {
+      m_outboundEvent = Simulator::Schedule (m_outbound.GetDelay (m_coalesceWindow), &SocketBridge::FlushOutbound, this);
+    }
+}
+
+void
+SocketBridge::FlushOutbound (void)
+{
+  Simulator::Cancel (m_outboundEvent);
+  if (m_outbound.IsEmpty ())
+    {
+      return;
+    }
+  NS_LOG_LOGIC ("Writing " << m_outbound.GetSize () << " bytes of coalesced messages to socket");
+
+  NS_ABORT_MSG_IF (!WriteSocket (m_outbound.GetData (), m_outbound.GetSize ()), "SocketBridge::FlushOutbound(): Write error.");
+  m_outbound.Clear ();
+
+  uint64_t now = m_outboundTags.empty () ? 0 : SocketLatencyTag::GetWallClockNs ();
+  for (std::vector<SocketLatencyTag>::iterator i = m_outboundTags.begin (); i != m_outboundTags.end (); ++i)
+    {
+      i->SetTimestamp (SocketLatencyTag::WRITE, now);
+      RecordLatency (*i);
+    }
+  m_outboundTags.clear ();
+}
+
+void
+SocketBridge::RecordLatency (SocketLatencyTag &tag)
+{
+  m_latency[SocketLatencyTag::READ].Record (tag.GetInterval (SocketLatencyTag::READ, SocketLatencyTag::WRITE));
+  for (uint32_t stage = SocketLatencyTag::FORWARD; stage < SocketLatencyTag::STAGES; stage++)
+    {
+      m_latency[stage].Record (tag.GetInterval ((SocketLatencyTag::Stage)(stage - 1), (SocketLatencyTag::Stage)stage));
+    }
+  m_latencyTrace (tag);
 }
 
 Ptr<NetDevice>
@@ -364,11 +1440,53 @@ SocketBridge::ReceiveFromBridgedDevice (Ptr<NetDevice> device, Ptr<const Packet>
   /* Forward packet to socket */
   Ptr<Packet> p = packet->Copy ();
   NS_LOG_LOGIC ("Writing packet to socket");
-  p->CopyData (m_packetBuffer, p->GetSize ());
 
-  uint32_t bytesWritten = write (m_sock, m_packetBuffer, p->GetSize ());
-  NS_ABORT_MSG_IF (bytesWritten != p->GetSize (), "SocketBridge::ReceiveFromBridgedDevice(): Write error.");
-//NS_LOG_UNCOND("NS3 -> Contiki: Wrote " << bytesWritten << " bytes to socket " << m_sock);
+  //
+  // With the framed protocol the frame goes out as a data message: the
+  // header is put in front of the frame so that both leave in one write.
+  // 802.15.4 frames are at most 127 bytes, so the buffer is on the stack
+  // rather than held by every bridge.
+  //
+  uint8_t buffer[SBP_HEADER_LEN + SBP_MAX_PAYLOAD];
+  if (p->GetSize () > SBP_MAX_PAYLOAD)
+    {
+      NS_LOG_WARN ("SocketBridge::ReceiveFromBridgedDevice(): node " << m_nodeId << " dropping frame of " <<
+                   p->GetSize () << " bytes");
+      m_oversizeFrames++;
+      return true;
+    }
+  uint32_t headerLength = 0;
+  if (m_protocol == FRAMED)
+    {
+      sbp_write_header (buffer, SBP_TYPE_DATA, p->GetSize ());
+      headerLength = SBP_HEADER_LEN;
+    }
+  p->CopyData (buffer + headerLength, p->GetSize ());
+
+  /* While replaying, frames are only counted */
+  m_framesWritten++;
+
+  SocketLatencyTag tag;
+  bool tagged = p->PeekPacketTag (tag);
+  if (IsCoalescing ())
+    {
+      /* The latency is recorded once the frame is written */
+      if (tagged)
+        {
+          m_outboundTags.push_back (tag);
+        }
+      QueueOutbound (buffer, headerLength + p->GetSize ());
+      return true;
+    }
+  if (m_sock != -1)
+    {
+      NS_ABORT_MSG_IF (!WriteSocket (buffer, headerLength + p->GetSize ()), "SocketBridge::ReceiveFromBridgedDevice(): Write error.");
+    }
+  if (tagged)
+    {
+      tag.SetTimestamp (SocketLatencyTag::WRITE, SocketLatencyTag::GetWallClockNs ());
+      RecordLatency (tag);
+    }
   NS_LOG_LOGIC ("End of receive packet handling on node " << m_node->GetId ());
   return true;
 }
@@ -408,6 +1526,127 @@ SocketBridge::GetAddress (void) const
   return m_address;
 }
 
+const SocketLatencyHistogram &
+SocketBridge::GetLatencyHistogram (SocketLatencyTag::Stage stage) const
+{
+  NS_ASSERT (stage < SocketLatencyTag::STAGES);
+  return m_latency[stage];
+}
+
+uint32_t
+SocketBridge::GetPendingFrames (void) const
+{
+  return m_pendingFrames;
+}
+
+void
+SocketBridge::SetShedLoad (bool shed)
+{
+  NS_LOG_FUNCTION (this << shed);
+  m_shedLoad = shed;
+}
+
+bool
+SocketBridge::GetShedLoad (void) const
+{
+  return m_shedLoad;
+}
+
+uint64_t
+SocketBridge::GetShedFrames (void) const
+{
+  return m_shedFrames;
+}
+
+uint32_t
+SocketBridge::GetFramesRead (void) const
+{
+  return m_framesRead;
+}
+
+uint32_t
+SocketBridge::GetFramesWritten (void) const
+{
+  return m_framesWritten;
+}
+
+uint32_t
+SocketBridge::GetOversizeFrames (void) const
+{
+  return m_oversizeFrames;
+}
+
+uint64_t
+SocketBridge::GetSocketWrites (void) const
+{
+  return m_socketWrites;
+}
+
+uint32_t
+SocketBridge::GetMemoryUsage (void) const
+{
+  uint32_t bytes = sizeof (SocketBridge);
+  if (m_phy != 0)
+    {
+      bytes += sizeof (SocketContikiPhy);
+    }
+  if (m_macLayer != 0)
+    {
+      bytes += sizeof (SocketNullMac);
+    }
+  if (m_fdReader != 0)
+    {
+      bytes += sizeof (SocketBridgeFdReader) + m_fdReader->GetStackSize ();
+    }
+  if (m_io != 0)
+    {
+      bytes += m_io->GetSocketMemoryUsage ();
+    }
+  bytes += m_pendingFrames * (sizeof (SocketBridgeInbox::Frame) + SBP_HEADER_LEN + SBP_MAX_PAYLOAD);
+  bytes += m_outbound.GetMemoryUsage () + m_outboundTags.capacity () * sizeof (SocketLatencyTag);
+  if (m_bufferPool != 0)
+    {
+      bytes += m_bufferPool->GetPrimedMemoryUsage ();
+    }
+  for (uint32_t stage = 0; stage < SocketLatencyTag::STAGES; stage++)
+    {
+      bytes += m_latency[stage].GetMemoryUsage ();
+    }
+  return bytes;
+}
+
+uint32_t
+SocketBridge::GetReaderStackSize (void) const
+{
+  return m_readerStackSize;
+}
+
+uint64_t
+SocketBridge::GetBufferAllocations (void) const
+{
+  uint64_t allocations = m_bufferAllocations;
+  if (m_fdReader != 0)
+    {
+      allocations += m_fdReader->GetAllocations ();
+    }
+  if (m_bufferPool != 0)
+    {
+      allocations += m_bufferPool->GetAllocations ();
+    }
+  return allocations;
+}
+
+void
+SocketBridge::FreeBuffer (uint8_t *buf)
+{
+  if (m_bufferPool != 0)
+    {
+      m_bufferPool->Free (buf);
+      return;
+    }
+  free (buf);
+}
+
 void
 SocketBridge::SetMode (std::string mode)
 {
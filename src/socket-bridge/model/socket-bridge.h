@@ -30,7 +30,7 @@
 #include "ns3/ptr.h"
 #include "ns3/mac48-address.h"
 #include "ns3/mac64-address.h"
-#include "ns3/unix-fd-reader.h"
+#include "ns3/simple-ref-count.h"
 #include "ns3/channel.h"
 #include "ns3/log.h"
 #include "ns3/abort.h"
@@ -40,24 +40,162 @@
 #include "ns3/simulator.h"
 #include "ns3/realtime-simulator-impl.h"
 #include "ns3/uinteger.h"
+#include "ns3/string.h"
+#include "ns3/system-mutex.h"
 
 #include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/wait.h>
 #include <errno.h>
 #include <unistd.h>
 #include <signal.h>
 #include <string.h>
+#include <pthread.h>
+#include <limits.h>
+#include <poll.h>
+#include <sched.h>
+#include <list>
+#include <utility>
+#include <vector>
 
 #include "socket-null-mac.h"
 #include "socket-contiki-phy.h"
+#include "socket-latency-tag.h"
+#include "socket-latency-histogram.h"
+#include "socket-frame-parser.h"
+#include "socket-bridge-protocol.h"
+#include "socket-buffer-pool.h"
+#include "socket-outbound-queue.h"
+#include "socket-bridge-inbox.h"
+#include "socket-io-service.h"
+#include "socket-replay-log.h"
 
 namespace ns3 {
 
-class SocketBridgeFdReader : public FdReader
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief The thread reading the IPC socket of a SocketBridge.
+ *
+ * Like FdReader, but the thread is created with its own attributes, so
+ * that its stack size can be set without touching the default of the
+ * process, which other threads are created with.
+ */
+class SocketBridgeFdReader : public SimpleRefCount<SocketBridgeFdReader>
 {
+public:
+  SocketBridgeFdReader ();
+  ~SocketBridgeFdReader ();
+
+  /**
+   * Start the thread.  It calls readCallback with every buffer read until
+   * Stop is called or the socket is closed.
+   *
+   * \param fd the socket to read
+   * \param readCallback the callback taking the buffers read, to be released
+   *        by the callee
+   * \param stackSize the stack size of the thread in bytes, 0 for the
+   *        default of the system
+   */
+  void Start (int fd, Callback<void, uint8_t *, ssize_t> readCallback, uint32_t stackSize);
+
+  /**
+   * Stop the thread and wait for it to finish.
+   */
+  void Stop (void);
+
+  /**
+   * \returns the stack size of the thread in bytes, as set by Start
+   */
+  uint32_t GetStackSize (void) const;
+
+  /**
+   * \param framed true to read one message of socket-bridge-protocol.h per
+   *        callback instead of whatever the socket holds
+   */
+  void SetFramed (bool framed);
+
+  /**
+   * \param pool the pool to take the buffers of RAW reads and messages
+   *        from, or 0 to allocate each buffer with malloc
+   */
+  void SetBufferPool (SocketBufferPool *pool);
+
+  /**
+   * \returns the number of buffers allocated with malloc, i.e. without a
+   *          pool
+   */
+  uint64_t GetAllocations (void) const;
+
+  /**
+   * Size of the buffer a RAW read goes into, on the stack of the reader
+   * thread.  Frames are copied out to a heap buffer of their own length.
+   */
+  static const uint32_t RAW_READ_SIZE = 1024;
+
 private:
-  FdReader::Data DoRead (void);
+  SocketBridgeFdReader (const SocketBridgeFdReader &);
+  SocketBridgeFdReader &operator = (const SocketBridgeFdReader &);
+
+  /**
+   * The start routine of the thread
+   */
+  static void *RunThread (void *reader);
+
+  /**
+   * Wait for the socket or Stop and read until either ends.
+   */
+  void Run (void);
+
+  /**
+   * A buffer read and its length
+   */
+  struct Data
+  {
+    Data () : m_buf (0), m_len (0) {}
+    Data (uint8_t *buf, ssize_t len) : m_buf (buf), m_len (len) {}
+    uint8_t *m_buf;
+    ssize_t m_len;
+  };
+
+  /**
+   * Read one message, or whatever the socket holds with the RAW protocol.
+   *
+   * \returns the buffer read and its length, or a length of 0 once the
+   *          socket is closed
+   */
+  Data DoRead (void);
+
+  /**
+   * Read exactly len bytes, blocking until they have arrived.
+   *
+   * \returns false if the socket was closed or failed first
+   */
+  bool ReadAll (uint8_t *buf, uint32_t len);
+
+  /**
+   * \param len the bytes needed
+   * \returns a buffer from the pool, or from malloc without a pool
+   */
+  uint8_t *AllocateBuffer (uint32_t len);
+
+  /**
+   * \param buf a buffer returned by AllocateBuffer
+   */
+  void FreeBuffer (uint8_t *buf);
+
+  int m_fd;
+  Callback<void, uint8_t *, ssize_t> m_readCallback;
+  pthread_t m_thread;
+  uint32_t m_stackSize;
+  bool m_running;
+  volatile bool m_stop;
+  int m_evpipe[2];
+
+  bool m_framed;
+  SocketBufferPool *m_pool;
+  uint64_t m_allocations;
 };
 
 class Node;
@@ -86,6 +224,32 @@ public:
     MACPHYOVERLAY,    /**< ns-3 MAC-layer stack participation with medium emulation */
   };
 
+  /**
+   * Enumeration of the protocols spoken on the IPC socket.
+   */
+  enum Protocol {
+    RAW,              /**< bare 802.15.4 frames */
+    FRAMED,           /**< data, control and time messages of socket-bridge-protocol.h */
+  };
+
+  /**
+   * Enumeration of the ways the IPC socket is read and written.
+   */
+  enum IoBackend {
+    THREAD,           /**< a reader thread per bridge, blocking reads and writes */
+    EPOLL,            /**< a SocketIoService thread for all bridges, epoll() readiness */
+    URING,            /**< a SocketIoService thread for all bridges, io_uring completions */
+  };
+
+  /**
+   * The number of frames the adaptive coalescing window is sized to gather
+   */
+  static const uint32_t COALESCE_FRAMES = SocketOutboundQueue::FRAMES;
+  /**
+   * The bytes of coalesced frames that are written without waiting further
+   */
+  static const uint32_t COALESCE_LIMIT = SocketOutboundQueue::LIMIT;
+
   SocketBridge ();
   virtual ~SocketBridge ();
 
@@ -209,6 +373,123 @@ public:
    */
   SocketBridge::Mode  GetMode (void);
 
+  /**
+   * Get the wall-clock latency histogram of the frames written to the
+   * socket of this bridge.  Only populated when the LatencyInstrumentation
+   * attribute is set.
+   *
+   * \param stage SocketLatencyTag::READ for the end-to-end latency from the
+   *              sender's read to the write on this bridge, or any later stage
+   *              for the latency from the previous stage to that stage.
+   * \returns the histogram in nanoseconds
+   */
+  const SocketLatencyHistogram &GetLatencyHistogram (SocketLatencyTag::Stage stage) const;
+
+  /**
+   * \returns the number of frames read from the socket that have not been
+   * forwarded into the simulation yet
+   */
+  uint32_t GetPendingFrames (void) const;
+
+  /**
+   * Drop frames as they are read from the socket instead of forwarding them
+   * into the simulation, e.g. while a SocketRealtimeMonitor finds the
+   * simulation overloaded.
+   *
+   * \param shed true to drop frames, false to forward them again
+   */
+  void SetShedLoad (bool shed);
+
+  /**
+   * \returns true while frames read from the socket are dropped
+   */
+  bool GetShedLoad (void) const;
+
+  /**
+   * \returns the number of frames dropped while shedding load
+   */
+  uint64_t GetShedFrames (void) const;
+
+  /**
+   * \returns the number of frames read from the socket
+   */
+  uint32_t GetFramesRead (void) const;
+
+  /**
+   * \returns the number of frames written to the socket
+   */
+  uint32_t GetFramesWritten (void) const;
+
+  /**
+   * \returns the number of frames not written to the socket because they
+   *          do not fit in a message of socket-bridge-protocol.h
+   */
+  uint32_t GetOversizeFrames (void) const;
+
+  /**
+   * \returns the number of write() calls made for the socket; with Coalesce
+   *          set these are fewer than the frames written.  Writes taken over
+   *          by the URING backend are counted by its SocketIoService.
+   */
+  uint64_t GetSocketWrites (void) const;
+
+  /**
+   * \returns the bytes held by the bridge on the ns-3 side: the object
+   *          itself, its PHY and MAC, its reader thread with its stack or
+   *          its entry in the SocketIoService, the ingress pool once primed,
+   *          an upper bound of the frames waiting to be forwarded and the
+   *          latency histograms.
+   */
+  uint32_t GetMemoryUsage (void) const;
+
+  /**
+   * \returns the stack size of the reader thread in bytes, 0 for the
+   *          default of the system
+   */
+  uint32_t GetReaderStackSize (void) const;
+
+  /**
+   * \returns the number of heap allocations made for buffers of frames and
+   *          messages read from the socket; with the IngressPoolSize
+   *          attribute set these are only the buffers added to the pool
+   */
+  uint64_t GetBufferAllocations (void) const;
+
+  /**
+   * Stop reading from the socket, e.g. while ns-3 forks.  Frames already
+   * read stay queued.
+   */
+  void Suspend (void);
+
+  /**
+   * Start reading from the socket again after Suspend.
+   */
+  void Resume (void);
+
+  /**
+   * \brief Ask the external process to fork itself.
+   *
+   * Sends SBP_CTRL_FORK with a new socket and waits up to ForkTimeout for
+   * the forked process to announce itself on it.  The forked process is
+   * held until CompleteFork.  Requires the FRAMED protocol and a suspended
+   * reader.
+   *
+   * \returns false if the bridge has no process of its own
+   *
+   * \see SocketBridgeHelper::Fork
+   */
+  bool ForkProcess (void);
+
+  /**
+   * \brief Adopt or let go of the process forked by ForkProcess, once ns-3
+   * itself has forked.
+   *
+   * \param adopt true in the new ns-3 process, which switches to the forked
+   *              process and leaves the original one to the original ns-3
+   *              process; false in the original ns-3 process
+   */
+  void CompleteFork (bool adopt);
+
   //
   // The following methods are inherited from NetDevice base class and are
   // documented there.
@@ -252,8 +533,41 @@ private:
    * Create a pair of sockets and spawn a new process passing one socket to it for IPC.
    * If this method returns, we'll have a socket waiting for us in m_sock that we can use
    * to talk to the process on the other end of the socket.
+   *
+   * \param address the extended address the process is started with
+   */
+  void CreateSocket (Mac64Address address);
+
+  /**
+   * \internal
+   *
+   * Give the bridged device and the MAC layer the extended address of the
+   * external process.
+   */
+  void AssignAddress (Mac64Address address);
+
+  /**
+   * \internal
+   *
+   * Open m_replayFile and schedule its first record instead of spawning
+   * the external process.
    */
-  void CreateSocket (void);
+  void StartReplay (void);
+
+  /**
+   * \internal
+   *
+   * Read the next record of m_replay and schedule ReplayFrame at its time.
+   */
+  void ScheduleReplay (void);
+
+  /**
+   * \internal
+   *
+   * Forward the record read by ScheduleReplay as if it had been read from
+   * the socket.
+   */
+  void ReplayFrame (uint32_t len);
 
   /**
    * \internal
@@ -262,6 +576,23 @@ private:
    */
   void StartSocketDevice (void);
 
+  /**
+   * \internal
+   *
+   * Create m_fdReader and start it with a stack of m_readerStackSize bytes,
+   * or add the socket to the SocketIoService of m_ioBackend.
+   */
+  void StartReader (void);
+
+  /**
+   * \internal
+   *
+   * Release a buffer passed to ReadCallback.
+   *
+   * \param buf the buffer
+   */
+  void FreeBuffer (uint8_t *buf);
+
   /**
    * \internal
    *
@@ -276,6 +607,45 @@ private:
    */
   void ReadCallback (uint8_t *buf, ssize_t len);
 
+  /**
+   * \internal
+   *
+   * Forward the frames queued in the SocketBridgeInbox by the reader
+   * threads of all bridges.  Scheduled by the reader that finds the drain
+   * idle, or by PollInbox.
+   */
+  static void DrainInbox (void);
+
+  /**
+   * \internal
+   *
+   * Forward a frame taken from the SocketBridgeInbox in the context of the
+   * node of its bridge: at once if the current event has that context,
+   * otherwise from an event scheduled now with it.
+   *
+   * \param frame the frame and the bridge that read it
+   */
+  static void ForwardFrame (const SocketBridgeInbox::Frame &frame);
+
+  /**
+   * \internal
+   *
+   * Periodic event used when the simulator implementation is not thread
+   * safe (e.g. DistributedSimulatorImpl).  Drains the inbox every interval.
+   *
+   * \param interval the time until the next poll
+   */
+  static void PollInbox (Time interval);
+
+  /**
+   * \internal
+   *
+   * Release the frames of this bridge still in the inbox and forward those
+   * of other bridges, so that the inbox no longer refers to this bridge.
+   * The reader thread must be stopped.
+   */
+  void PurgeInbox (void);
+
   /*
    * \internal
    *
@@ -285,27 +655,102 @@ private:
    * \param buf A character buffer containing the actual packet bits that were
    *            received from the host.
    * \param buf The length of the buffer.
+   * \param readNs The wall-clock time the buffer was read at, or 0.
    */
-  void ForwardToBridgedDevice (uint8_t *buf, ssize_t len);
+  void ForwardToBridgedDevice (uint8_t *buf, ssize_t len, uint64_t readNs);
 
   /**
    * \internal
    *
    * Sanity checking and information extraction from the packet to aid propogation
-   * through the ns-3 medium.
+   * through the ns-3 medium.  The 802.15.4 MAC header is parsed in place by
+   * SocketFrameParser.
    *
-   * \param packet The packet we received from the host, and which we need 
+   * \param buf    The frame we received from the host, and which we need
    *               to check.
+   * \param len    The length of the frame.
    * \param src    A pointer to the data structure that will get the source
-   *               address of the packet (extracted from the packet Layer 2 
+   *               address of the packet (extracted from the packet Layer 2
    *               header).
    * \param dst    A pointer to the data structure that will get the destination
-   *               address of the packet (extracted from the packet Layer 2 
+   *               address of the packet (extracted from the packet Layer 2
    *               header).
-   * \param type   A pointer to the variable that will get the packet type from 
-   *               the Layer 2 header.
+   * \param type   A pointer to the variable that will get the packet type from
+   *               the 6LoWPAN dispatch.
+   * \returns false if the frame is not a valid 802.15.4 frame
+   */
+  bool Filter (const uint8_t *buf, uint32_t len, Address *src, Address *dst, uint16_t *type);
+
+  /**
+   * \internal
+   *
+   * Handle a control or time message read from the socket when the
+   * Protocol attribute is FRAMED.
+   *
+   * \param type SBP_TYPE_CONTROL or SBP_TYPE_TIME
+   * \param payload the payload of the message
+   * \param len the length of the payload
+   */
+  void HandleMessage (uint8_t type, const uint8_t *payload, uint8_t len);
+
+  /**
+   * \internal
+   *
+   * Write one message of socket-bridge-protocol.h to the socket.
+   *
+   * \param type the message type
+   * \param payload the payload of the message
+   * \param len the length of the payload
    */
-  Ptr<Packet> Filter (Ptr<Packet> packet, Address *src, Address *dst, uint16_t *type);
+  void SendMessage (uint8_t type, const uint8_t *payload, uint8_t len);
+
+  /**
+   * \internal
+   *
+   * Write a buffer to the socket, through m_io if it takes over writes.
+   *
+   * \param buf the buffer
+   * \param len the length of the buffer
+   * \returns false on a short write or an error
+   */
+  bool WriteSocket (const uint8_t *buf, uint32_t len);
+
+  /**
+   * \internal
+   *
+   * \returns true if messages for the socket are gathered in m_outbound:
+   *          Coalesce is set, the protocol is FRAMED (RAW frames have no
+   *          boundaries in a stream) and the URING backend, which submits
+   *          the writes of a simulation time together anyway, is not used.
+   */
+  bool IsCoalescing (void) const;
+
+  /**
+   * \internal
+   *
+   * Append a frame to m_outbound and schedule FlushOutbound after the
+   * coalescing delay, or call it right away once COALESCE_LIMIT is reached.
+   *
+   * \param buf the message
+   * \param len the length of the message
+   */
+  void QueueOutbound (const uint8_t *buf, uint32_t len);
+
+  /**
+   * \internal
+   *
+   * Write m_outbound to the socket in one go.
+   */
+  void FlushOutbound (void);
+
+  /**
+   * \internal
+   *
+   * Record the latency of a frame written to the socket.
+   *
+   * \param tag the tag of the frame, stamped with the time of the write
+   */
+  void RecordLatency (SocketLatencyTag &tag);
 
   /**
    * \internal
@@ -383,6 +828,53 @@ private:
    */
   Ptr<SocketBridgeFdReader> m_fdReader;
 
+  /**
+   * \internal
+   *
+   * How the IPC socket is read and written.
+   */
+  IoBackend m_ioBackend;
+
+  /**
+   * \internal
+   *
+   * The service reading the socket instead of m_fdReader unless m_ioBackend
+   * is THREAD, and the id of the socket with it.
+   */
+  SocketIoService *m_io;
+  uint32_t m_ioId;
+
+  /**
+   * \internal
+   *
+   * True if the simulator implementation accepts events scheduled from the
+   * read thread (RealtimeSimulatorImpl).  Otherwise the inbox is drained
+   * every PollInterval.
+   */
+  bool m_threadSafeSchedule;
+
+  /**
+   * \internal
+   *
+   * Pass the frames read by the read thread through the SocketBridgeInbox
+   * instead of scheduling an event per frame.
+   */
+  bool m_inbox;
+
+  /**
+   * \internal
+   *
+   * True while the read thread may have frames in the inbox.
+   */
+  bool m_inboxStarted;
+
+  /**
+   * \internal
+   *
+   * Interval between two polls of the inbox.
+   */
+  Time m_pollInterval;
+
   /**
    * \internal
    *
@@ -390,6 +882,13 @@ private:
    */
   Mode m_mode;
 
+  /**
+   * \internal
+   *
+   * The protocol spoken on the IPC socket.
+   */
+  Protocol m_protocol;
+
   /**
    * \internal
    *
@@ -457,9 +956,11 @@ private:
   pid_t child;
  
   /**
-   * A 64K buffer to hold packet data while it is being sent.
+   * \internal
+   *
+   * The stack size of the reader thread.
    */
-  uint8_t *m_packetBuffer;
+  uint32_t m_readerStackSize;
   /*
    * a copy of the node id so the read thread doesn't have to GetNode() in
    * in order to find the node ID.  Thread unsafe reference counting in 
@@ -476,6 +977,205 @@ private:
    */
   bool m_ns3AddressRewritten;
 
+  /**
+   * \internal
+   *
+   * Tag frames read from the socket with a SocketLatencyTag and record the
+   * latency of frames written to it.
+   */
+  bool m_latencyEnabled;
+
+  /**
+   * \internal
+   *
+   * Latency histograms of the frames written to the socket, indexed by
+   * SocketLatencyTag::Stage.
+   */
+  SocketLatencyHistogram m_latency[SocketLatencyTag::STAGES];
+
+  /**
+   * The trace source fired when a frame carrying a SocketLatencyTag has been
+   * written to the socket.
+   *
+   * \see class CallBackTraceSource
+   */
+  TracedCallback<const SocketLatencyTag &> m_latencyTrace;
+
+  /**
+   * The trace source fired from the reader thread when a frame has been
+   * read from the socket, with its length and the frames pending.
+   *
+   * \see class CallBackTraceSource
+   */
+  TracedCallback<uint32_t, uint32_t> m_readTrace;
+
+  /**
+   * The trace source fired from the reader thread when a frame has been
+   * dropped while shedding load, with its length.
+   *
+   * \see class CallBackTraceSource
+   */
+  TracedCallback<uint32_t> m_shedTrace;
+
+  /**
+   * \internal
+   *
+   * Frames read by the reader thread and not yet forwarded by the simulator
+   * thread.  Updated atomically from both threads.
+   */
+  volatile uint32_t m_pendingFrames;
+
+  /**
+   * \internal
+   *
+   * Set by the simulator thread while the reader thread is to drop frames.
+   */
+  volatile bool m_shedLoad;
+
+  /**
+   * \internal
+   *
+   * Frames dropped by the reader thread while shedding load.
+   */
+  volatile uint64_t m_shedFrames;
+
+  /**
+   * \internal
+   *
+   * Frames read from the socket, counted by the reader thread.
+   */
+  volatile uint32_t m_framesRead;
+
+  /**
+   * \internal
+   *
+   * Frames written to the socket.
+   */
+  uint32_t m_framesWritten;
+
+  /**
+   * \internal
+   *
+   * Frames too long to be written to the socket.
+   */
+  uint32_t m_oversizeFrames;
+
+  /**
+   * \internal
+   *
+   * write() calls made for the socket.
+   */
+  uint64_t m_socketWrites;
+
+  /**
+   * \internal
+   *
+   * Gather the messages for the socket and write them together.
+   */
+  bool m_coalesce;
+
+  /**
+   * \internal
+   *
+   * The longest time a frame waits for others to be written with.
+   */
+  Time m_coalesceWindow;
+
+  /**
+   * \internal
+   *
+   * The messages gathered for the socket, the latency tags of their frames,
+   * and the event writing them.
+   */
+  SocketOutboundQueue m_outbound;
+  std::vector<SocketLatencyTag> m_outboundTags;
+  EventId m_outboundEvent;
+
+  /**
+   * \internal
+   *
+   * The number of free buffers kept by m_bufferPool, 0 for no pool.
+   */
+  uint32_t m_ingressPoolSize;
+
+  /**
+   * \internal
+   *
+   * The buffers read by m_fdReader, while the socket device is running.
+   */
+  SocketBufferPool *m_bufferPool;
+
+  /**
+   * \internal
+   *
+   * Buffer allocations of readers and pools already stopped.
+   */
+  uint64_t m_bufferAllocations;
+
+  /**
+   * \internal
+   *
+   * How long ForkProcess waits for the forked process.
+   */
+  Time m_forkTimeout;
+
+  /**
+   * \internal
+   *
+   * The socket of the process forked by ForkProcess, -1 if none.
+   */
+  int m_forkSock;
+
+  /**
+   * \internal
+   *
+   * The PID of the process forked by ForkProcess.
+   */
+  pid_t m_forkChild;
+
+  /**
+   * \internal
+   *
+   * The file to record the frames read from the socket to, empty for none.
+   */
+  std::string m_recordFile;
+
+  /**
+   * \internal
+   *
+   * The file to replay frames from instead of spawning the process, empty
+   * for none.
+   */
+  std::string m_replayFile;
+
+  /**
+   * \internal
+   *
+   * The log of m_recordFile, while the socket device is running.
+   */
+  SocketRecordLog *m_record;
+
+  /**
+   * \internal
+   *
+   * The log of m_replayFile, while the socket device is running.
+   */
+  SocketReplayLog *m_replay;
+
+  /**
+   * \internal
+   *
+   * The buffer of the record scheduled for replay.
+   */
+  uint8_t *m_replayBuf;
+
+  /**
+   * \internal
+   *
+   * The event forwarding the record scheduled for replay.
+   */
+  EventId m_replayEvent;
+
 };
 
 } // namespace ns3
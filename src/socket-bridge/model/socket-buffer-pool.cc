@@ -0,0 +1,85 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h>
+
+#include "ns3/abort.h"
+#include "socket-buffer-pool.h"
+
+namespace ns3 {
+
+const uint32_t SocketBufferPool::BUFFER_SIZE;
+
+SocketBufferPool::SocketBufferPool (uint32_t capacity)
+  : m_free (capacity),
+    m_allocations (0)
+{
+}
+
+SocketBufferPool::~SocketBufferPool ()
+{
+  uint8_t *buf;
+  while (m_free.Pop (buf))
+    {
+      free (buf);
+    }
+}
+
+uint8_t *
+SocketBufferPool::Allocate (void)
+{
+  uint8_t *buf;
+  if (m_free.Pop (buf))
+    {
+      return buf;
+    }
+  buf = (uint8_t *)malloc (BUFFER_SIZE);
+  NS_ABORT_MSG_IF (buf == 0, "malloc() failed");
+  __sync_fetch_and_add (&m_allocations, 1);
+  return buf;
+}
+
+void
+SocketBufferPool::Free (uint8_t *buf)
+{
+  if (!m_free.Push (buf))
+    {
+      free (buf);
+    }
+}
+
+uint64_t
+SocketBufferPool::GetAllocations (void) const
+{
+  return m_allocations;
+}
+
+uint32_t
+SocketBufferPool::GetMemoryUsage (void) const
+{
+  return sizeof (SocketBufferPool)
+         + m_free.GetCapacity () * (sizeof (uint32_t) + sizeof (uint8_t *))
+         + m_free.GetSize () * BUFFER_SIZE;
+}
+
+uint32_t
+SocketBufferPool::GetPrimedMemoryUsage (void) const
+{
+  return sizeof (SocketBufferPool)
+         + m_free.GetCapacity () * (sizeof (uint32_t) + sizeof (uint8_t *) + BUFFER_SIZE);
+}
+
+} // namespace ns3
@@ -0,0 +1,97 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_BUFFER_POOL_H
+#define SOCKET_BUFFER_POOL_H
+
+#include <stdint.h>
+
+#include "socket-mpsc-queue.h"
+#include "socket-bridge-protocol.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Recycles the buffers the reader thread of a SocketBridge reads
+ * frames into.
+ *
+ * Every buffer holds one message of socket-bridge-protocol.h, which is
+ * large enough for any 802.15.4 frame.  Buffers are allocated on demand by
+ * the reader thread and kept on a free list when the simulator thread is
+ * done with them, so that in steady state no frame costs a malloc and a
+ * free.  The pool only grows with the frames in flight and keeps at most
+ * its capacity of free buffers.
+ *
+ * Allocate must only be called from a single thread (the reader); Free may
+ * be called from any thread.
+ */
+class SocketBufferPool
+{
+public:
+  /**
+   * The size of every buffer
+   */
+  static const uint32_t BUFFER_SIZE = SBP_HEADER_LEN + SBP_MAX_PAYLOAD;
+
+  /**
+   * \param capacity the number of free buffers to keep
+   */
+  explicit SocketBufferPool (uint32_t capacity);
+  ~SocketBufferPool ();
+
+  /**
+   * \returns a buffer of BUFFER_SIZE bytes, to be released with Free
+   */
+  uint8_t *Allocate (void);
+
+  /**
+   * Return a buffer to the free list, or to the heap if the free list is
+   * full.  Buffers are allocated with malloc, so a buffer may also be
+   * released with free once the pool is gone.
+   *
+   * \param buf a buffer returned by Allocate
+   */
+  void Free (uint8_t *buf);
+
+  /**
+   * \returns the number of buffers allocated from the heap so far
+   */
+  uint64_t GetAllocations (void) const;
+
+  /**
+   * \returns the bytes of heap held by the pool and its free buffers
+   */
+  uint32_t GetMemoryUsage (void) const;
+
+  /**
+   * \returns the bytes of heap held by the pool once its free list is
+   *          full, as it stays after a burst of frames
+   */
+  uint32_t GetPrimedMemoryUsage (void) const;
+
+private:
+  SocketBufferPool (const SocketBufferPool &);
+  SocketBufferPool &operator = (const SocketBufferPool &);
+
+  SocketMpscQueue<uint8_t *> m_free;
+  volatile uint64_t m_allocations;
+};
+
+} // namespace ns3
+
+#endif /* SOCKET_BUFFER_POOL_H */
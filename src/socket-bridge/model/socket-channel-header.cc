@@ -0,0 +1,106 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+
+#include "socket-channel-header.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (SocketChannelHeader);
+
+SocketChannelHeader::SocketChannelHeader ()
+  : m_rxPowerDbm (0.0),
+    m_channelNumber (0)
+{
+}
+
+SocketChannelHeader::~SocketChannelHeader ()
+{
+}
+
+TypeId
+SocketChannelHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SocketChannelHeader")
+    .SetParent<Header> ()
+    .AddConstructor<SocketChannelHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+SocketChannelHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+SocketChannelHeader::Print (std::ostream &os) const
+{
+  os << "rxPower=" << m_rxPowerDbm << "dBm channel=" << (uint32_t)m_channelNumber;
+}
+
+uint32_t
+SocketChannelHeader::GetSerializedSize (void) const
+{
+  return sizeof (uint64_t) + sizeof (uint8_t);
+}
+
+void
+SocketChannelHeader::Serialize (Buffer::Iterator start) const
+{
+  /* Ranks run on the same host, so the raw IEEE 754 bits are portable */
+  uint64_t bits;
+  memcpy (&bits, &m_rxPowerDbm, sizeof (bits));
+  start.WriteHtonU64 (bits);
+  start.WriteU8 (m_channelNumber);
+}
+
+uint32_t
+SocketChannelHeader::Deserialize (Buffer::Iterator start)
+{
+  uint64_t bits = start.ReadNtohU64 ();
+  memcpy (&m_rxPowerDbm, &bits, sizeof (bits));
+  m_channelNumber = start.ReadU8 ();
+  return GetSerializedSize ();
+}
+
+void
+SocketChannelHeader::SetRxPowerDbm (double rxPowerDbm)
+{
+  m_rxPowerDbm = rxPowerDbm;
+}
+
+double
+SocketChannelHeader::GetRxPowerDbm (void) const
+{
+  return m_rxPowerDbm;
+}
+
+void
+SocketChannelHeader::SetChannelNumber (uint8_t channelNumber)
+{
+  m_channelNumber = channelNumber;
+}
+
+uint8_t
+SocketChannelHeader::GetChannelNumber (void) const
+{
+  return m_channelNumber;
+}
+
+} // namespace ns3
@@ -0,0 +1,76 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_CHANNEL_HEADER_H
+#define SOCKET_CHANNEL_HEADER_H
+
+#include "ns3/header.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Header carrying the receive power and the 802.15.4 channel of a
+ * frame sent to a PHY that lives on another simulator rank.
+ *
+ * The propagation loss is computed by the sending rank, which owns the
+ * transmitter, so the resulting receive power has to travel with the
+ * remote event.  The header is added by SocketChannel::Send and removed
+ * again by SocketContikiPhy::ReceiveRemote before the frame is handed to
+ * the receiving PHY.
+ */
+class SocketChannelHeader : public Header
+{
+public:
+  SocketChannelHeader ();
+  virtual ~SocketChannelHeader ();
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+  /**
+   * \param rxPowerDbm the receive power computed by the sending rank
+   */
+  void SetRxPowerDbm (double rxPowerDbm);
+
+  /**
+   * \returns the receive power computed by the sending rank
+   */
+  double GetRxPowerDbm (void) const;
+
+  /**
+   * \param channelNumber the channel the sending PHY is tuned to
+   */
+  void SetChannelNumber (uint8_t channelNumber);
+
+  /**
+   * \returns the channel the sending PHY is tuned to
+   */
+  uint8_t GetChannelNumber (void) const;
+
+private:
+  double m_rxPowerDbm;
+  uint8_t m_channelNumber;
+};
+
+} // namespace ns3
+
+#endif /* SOCKET_CHANNEL_HEADER_H */
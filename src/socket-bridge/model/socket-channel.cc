@@ -19,6 +19,7 @@
  */
 
 #include "socket-channel.h"
+#include "socket-channel-header.h"
 
 NS_LOG_COMPONENT_DEFINE ("SocketChannel");
 
@@ -40,23 +41,111 @@ SocketChannel::GetTypeId (void)
                    PointerValue (),
                    MakePointerAccessor (&SocketChannel::m_delay),
                    MakePointerChecker<PropagationDelayModel> ())
+    .AddAttribute ("RangeCulling",
+                   "Skip receivers farther away than the range of the transmit power before "
+                   "evaluating the propagation loss model.  Only valid for deterministic loss "
+                   "models whose loss grows with distance.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&SocketChannel::m_rangeCulling),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxRangeSearch",
+                   "The largest range in meters considered by RangeCulling.",
+                   DoubleValue (100000.0),
+                   MakeDoubleAccessor (&SocketChannel::m_maxRangeSearch),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("IslandLookAhead",
+                   "With RangeCulling, the largest lookahead between simulator ranks.  Frames "
+                   "between nodes that move into range of another rank arrive at most this late.",
+                   TimeValue (MilliSeconds (10)),
+                   MakeTimeAccessor (&SocketChannel::m_islandLookAhead),
+                   MakeTimeChecker ())
+    .AddTraceSource ("Tx",
+                     "A frame has been transmitted on the channel.",
+                     MakeTraceSourceAccessor (&SocketChannel::m_txTrace))
   ;
   return tid;
 }
 
 SocketChannel::SocketChannel ()
+  : m_rangeCulling (false),
+    m_maxRangeSearch (100000.0),
+    m_islandLookAhead (MilliSeconds (10)),
+    m_lookAhead (Seconds (0.0)),
+    m_lateFrames (0)
 {
 }
 SocketChannel::~SocketChannel ()
 {
   NS_LOG_FUNCTION_NOARGS ();
+  ClearMobility ();
   m_phyList.clear ();
 }
 
+void
+SocketChannel::DoDispose (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  ClearMobility ();
+  m_phyList.clear ();
+  Channel::DoDispose ();
+}
+
+void
+SocketChannel::ClearMobility (void)
+{
+  for (uint32_t i = 0; i < m_mobility.size (); i++)
+    {
+      if (m_mobility[i]->model != 0)
+        {
+          m_mobility[i]->model->TraceDisconnectWithoutContext ("CourseChange",
+                                                               MakeBoundCallback (&SocketChannel::CourseChanged, m_mobility[i]));
+        }
+      delete m_mobility[i];
+    }
+  m_mobility.clear ();
+}
+
+SocketChannel::MobilityRecord *
+SocketChannel::GetMobilityRecord (uint32_t i)
+{
+  MobilityRecord *record = m_mobility[i];
+  if (record->model == 0)
+    {
+      record->model = m_phyList[i]->GetMobility ()->GetObject<MobilityModel> ();
+      NS_ASSERT (record->model != 0);
+      record->model->TraceConnectWithoutContext ("CourseChange",
+                                                 MakeBoundCallback (&SocketChannel::CourseChanged, record));
+      CourseChanged (record, record->model);
+    }
+  return record;
+}
+
+void
+SocketChannel::CourseChanged (MobilityRecord *record, Ptr<const MobilityModel> model)
+{
+  record->position = model->GetPosition ();
+  record->velocity = model->GetVelocity ();
+  record->updated = Simulator::Now ();
+}
+
+Vector
+SocketChannel::GetPosition (const MobilityRecord *record, Time now)
+{
+  if (record->velocity.x == 0 && record->velocity.y == 0 && record->velocity.z == 0)
+    {
+      return record->position;
+    }
+  double t = (now - record->updated).GetSeconds ();
+  return Vector (record->position.x + record->velocity.x * t,
+                 record->position.y + record->velocity.y * t,
+                 record->position.z + record->velocity.z * t);
+}
+
 void
 SocketChannel::SetPropagationLossModel (Ptr<PropagationLossModel> loss)
 {
   m_loss = loss;
+  m_maxRange.clear ();
 }
 void
 SocketChannel::SetPropagationDelayModel (Ptr<PropagationDelayModel> delay)
@@ -67,20 +156,57 @@ SocketChannel::SetPropagationDelayModel (Ptr<PropagationDelayModel> delay)
 void
 SocketChannel::Send (Ptr<SocketContikiPhy> sender, Ptr<const Packet> packet, double txPowerDbm)
 {
-  Ptr<MobilityModel> senderMobility = sender->GetMobility ()->GetObject<MobilityModel> ();
-  NS_ASSERT (senderMobility != 0);
+  uint32_t senderIndex = sender->GetChannelIndex ();
+  NS_ASSERT_MSG (senderIndex < m_phyList.size () && m_phyList[senderIndex] == sender,
+                 "SocketChannel::Send(): sender is not on the channel");
+  Ptr<MobilityModel> senderMobility = GetMobilityRecord (senderIndex)->model;
+  m_txTrace (packet);
+  double maxRange = m_rangeCulling ? GetMaxRange (txPowerDbm) : 0;
+  Time now = Simulator::Now ();
+  Vector senderPosition;
+  if (m_rangeCulling)
+    {
+      senderPosition = GetPosition (m_mobility[senderIndex], now);
+    }
   uint32_t j = 0;
   for (PhyList::const_iterator i = m_phyList.begin (); i != m_phyList.end (); i++, j++)
     {
-      if (sender != (*i))
+      if (j != senderIndex)
         {
 
-          Ptr<MobilityModel> receiverMobility = (*i)->GetMobility()->GetObject<MobilityModel>();
-          Time delay = m_delay->GetDelay (senderMobility, receiverMobility);
+          if (!(*i)->IsRadioOn ())
+            {
+              /* Checked again on arrival, but most sleeping receivers are skipped here */
+              continue;
+            }
+          MobilityRecord *receiverRecord = GetMobilityRecord (j);
+          if (m_rangeCulling && CalculateDistance (senderPosition, GetPosition (receiverRecord, now)) > maxRange)
+            {
+              continue;
+            }
+          Ptr<MobilityModel> receiverMobility = receiverRecord->model;
           double rxPowerDbm = m_loss->CalcRxPower (txPowerDbm, senderMobility, receiverMobility);
+          if (rxPowerDbm <= (*i)->GetEdThreshold ())
+            {
+              /* The receiver would drop it; save the copy and the event */
+              continue;
+            }
+          Time delay = m_delay->GetDelay (senderMobility, receiverMobility);
           NS_LOG_DEBUG ("propagation: txPower=" << txPowerDbm << "dbm, rxPower=" << rxPowerDbm << "dbm, " <<
                         "distance=" << senderMobility->GetDistanceFrom (receiverMobility) << "m, delay=" << delay);
           Ptr<Packet> copy = packet->Copy ();
+          if (GetSystemId (j) != Simulator::GetSystemId ())
+            {
+              /* Receiver is owned by another rank; hand the frame over as a remote event */
+              if (delay < m_lookAhead)
+                {
+                  NS_LOG_WARN ("frame to another rank delayed from " << delay << " to the lookahead " << m_lookAhead);
+                  delay = m_lookAhead;
+                  m_lateFrames++;
+                }
+              SendRemote (j, copy, delay, rxPowerDbm, sender->GetChannelNumber ());
+              continue;
+            }
           Ptr<Object> dstNetDevice = m_phyList[j]->GetDevice ();
           uint32_t dstNode;
           if (dstNetDevice == 0)
@@ -93,17 +219,266 @@ SocketChannel::Send (Ptr<SocketContikiPhy> sender, Ptr<const Packet> packet, dou
             }
           Simulator::ScheduleWithContext (dstNode,
                                           delay, &SocketChannel::Receive, this,
-                                          j, copy, rxPowerDbm);
+                                          j, copy, rxPowerDbm, sender->GetChannelNumber ());
         }
     }
 }
 
 void
-SocketChannel::Receive (uint32_t i, Ptr<Packet> packet, double rxPowerDbm) const
+SocketChannel::SendRemote (uint32_t i, Ptr<Packet> packet, Time delay, double rxPowerDbm, uint8_t channelNumber) const
+{
+  Ptr<NetDevice> dstNetDevice = m_phyList[i]->GetDevice ()->GetObject<NetDevice> ();
+  NS_ASSERT_MSG (dstNetDevice != 0, "SocketChannel::SendRemote(): remote PHY has no device");
+
+  SocketChannelHeader header;
+  header.SetRxPowerDbm (rxPowerDbm);
+  header.SetChannelNumber (channelNumber);
+  packet->AddHeader (header);
+
+  NS_LOG_LOGIC ("Sending frame to node " << dstNetDevice->GetNode ()->GetId () <<
+                " on rank " << GetSystemId (i));
+  if (!m_remoteSend.IsNull ())
+    {
+      m_remoteSend (packet, Simulator::Now () + delay,
+                    dstNetDevice->GetNode ()->GetId (), dstNetDevice->GetIfIndex ());
+      return;
+    }
+#ifdef NS3_MPI
+  MpiInterface::SendPacket (packet, Simulator::Now () + delay,
+                            dstNetDevice->GetNode ()->GetId (), dstNetDevice->GetIfIndex ());
+#else
+  NS_FATAL_ERROR ("SocketChannel::SendRemote(): node " << dstNetDevice->GetNode ()->GetId () <<
+                  " is on rank " << GetSystemId (i) << " but ns-3 was built without MPI");
+#endif
+}
+
+void
+SocketChannel::SetRemoteSendCallback (RemoteSendCallback callback)
+{
+  m_remoteSend = callback;
+}
+
+uint32_t
+SocketChannel::GetSystemId (uint32_t i) const
 {
+  Ptr<Object> device = m_phyList[i]->GetDevice ();
+  if (device == 0)
+    {
+      return Simulator::GetSystemId ();
+    }
+  return device->GetObject<NetDevice> ()->GetNode ()->GetSystemId ();
+}
+
+Time
+SocketChannel::GetLookAhead (void)
+{
+  Time lookAhead = Simulator::GetMaximumSimulationTime ();
+  bool crossing = false;
+  double range = m_rangeCulling ? GetMaxRange () : 0;
+  for (uint32_t i = 0; i < m_phyList.size (); i++)
+    {
+      Ptr<MobilityModel> a = GetMobilityRecord (i)->model;
+      for (uint32_t j = i + 1; j < m_phyList.size (); j++)
+        {
+          if (GetSystemId (i) == GetSystemId (j))
+            {
+              continue;
+            }
+          crossing = true;
+          Ptr<MobilityModel> b = GetMobilityRecord (j)->model;
+          if (m_rangeCulling && a->GetDistanceFrom (b) > range)
+            {
+              continue;
+            }
+          Time delay = m_delay->GetDelay (a, b);
+          if (delay < lookAhead)
+            {
+              lookAhead = delay;
+            }
+        }
+    }
+  if (m_rangeCulling && crossing && m_islandLookAhead < lookAhead)
+    {
+      /* Islands on different ranks; keep them loosely synchronized so they can merge */
+      lookAhead = m_islandLookAhead;
+    }
+  m_lookAhead = lookAhead;
+  return lookAhead;
+}
+
+uint64_t
+SocketChannel::GetLateFrames (void) const
+{
+  return m_lateFrames;
+}
+
+double
+SocketChannel::GetMaxRange (void)
+{
+  double txPowerDbm = 0;
+  for (uint32_t i = 0; i < m_phyList.size (); i++)
+    {
+      if (i == 0 || m_phyList[i]->GetTxPowerDbm () > txPowerDbm)
+        {
+          txPowerDbm = m_phyList[i]->GetTxPowerDbm ();
+        }
+    }
+  return GetMaxRange (txPowerDbm);
+}
+
+std::vector<uint32_t>
+SocketChannel::GetIslands (void)
+{
+  std::vector<Vector> positions;
+  Time now = Simulator::Now ();
+  for (uint32_t i = 0; i < m_phyList.size (); i++)
+    {
+      positions.push_back (GetPosition (GetMobilityRecord (i), now));
+    }
+  return FindIslands (positions, GetMaxRange ());
+}
+
+static uint32_t
+FindRoot (std::vector<uint32_t> &parent, uint32_t i)
+{
+  while (parent[i] != i)
+    {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+  return i;
+}
+
+std::vector<uint32_t>
+SocketChannel::FindIslands (const std::vector<Vector> &positions, double range)
+{
+  //
+  // Union-find over the pairs within range.  Positions are hashed into
+  // square cells of the size of the range, so only positions in the same
+  // or a neighbouring cell need to be compared.
+  //
+  uint32_t n = positions.size ();
+  std::vector<uint32_t> parent (n);
+  std::map<std::pair<int64_t, int64_t>, std::vector<uint32_t> > cells;
+  double cell = range > 0 ? range : 1.0;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      parent[i] = i;
+      int64_t cx = (int64_t)floor (positions[i].x / cell);
+      int64_t cy = (int64_t)floor (positions[i].y / cell);
+      cells[std::make_pair (cx, cy)].push_back (i);
+    }
+  for (uint32_t i = 0; i < n; i++)
+    {
+      int64_t cx = (int64_t)floor (positions[i].x / cell);
+      int64_t cy = (int64_t)floor (positions[i].y / cell);
+      for (int64_t dx = -1; dx <= 1; dx++)
+        {
+          for (int64_t dy = -1; dy <= 1; dy++)
+            {
+              std::map<std::pair<int64_t, int64_t>, std::vector<uint32_t> >::const_iterator c =
+                cells.find (std::make_pair (cx + dx, cy + dy));
+              if (c == cells.end ())
+                {
+                  continue;
+                }
+              for (uint32_t k = 0; k < c->second.size (); k++)
+                {
+                  uint32_t j = c->second[k];
+                  if (j <= i || CalculateDistance (positions[i], positions[j]) > range)
+                    {
+                      continue;
+                    }
+                  parent[FindRoot (parent, j)] = FindRoot (parent, i);
+                }
+            }
+        }
+    }
+
+  /* Number the islands in the order of their first position */
+  std::vector<uint32_t> islands (n);
+  std::map<uint32_t, uint32_t> numbers;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      uint32_t root = FindRoot (parent, i);
+      std::map<uint32_t, uint32_t>::const_iterator number = numbers.find (root);
+      if (number == numbers.end ())
+        {
+          number = numbers.insert (std::make_pair (root, (uint32_t)numbers.size ())).first;
+        }
+      islands[i] = number->second;
+    }
+  return islands;
+}
+
+void
+SocketChannel::Receive (uint32_t i, Ptr<Packet> packet, double rxPowerDbm, uint8_t channelNumber) const
+{
+  /* The receiver may have been retuned while the frame was in flight */
+  if (m_phyList[i]->GetChannelNumber () != channelNumber)
+    {
+      NS_LOG_DEBUG ("receiver on channel " << (uint32_t)m_phyList[i]->GetChannelNumber () <<
+                    ", frame on channel " << (uint32_t)channelNumber);
+      return;
+    }
   m_phyList[i]->StartReceivePacket (packet, rxPowerDbm);
 }
 
+double
+SocketChannel::GetMaxRange (double txPowerDbm)
+{
+  std::map<double, double>::const_iterator cached = m_maxRange.find (txPowerDbm);
+  if (cached != m_maxRange.end ())
+    {
+      return cached->second;
+    }
+
+  double threshold = 0;
+  for (uint32_t i = 0; i < m_phyList.size (); i++)
+    {
+      if (i == 0 || m_phyList[i]->GetEdThreshold () < threshold)
+        {
+          threshold = m_phyList[i]->GetEdThreshold ();
+        }
+    }
+
+  //
+  // Bisect for the distance at which the receive power drops to the
+  // threshold, probing the loss model with two fixed positions.
+  //
+  Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+  Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+  a->SetPosition (Vector (0.0, 0.0, 0.0));
+  double low = 0;
+  double high = m_maxRangeSearch;
+  b->SetPosition (Vector (high, 0.0, 0.0));
+  if (m_loss->CalcRxPower (txPowerDbm, a, b) <= threshold)
+    {
+      for (uint32_t k = 0; k < 64 && high - low > 0.01; k++)
+        {
+          double middle = (low + high) / 2;
+          b->SetPosition (Vector (middle, 0.0, 0.0));
+          if (m_loss->CalcRxPower (txPowerDbm, a, b) > threshold)
+            {
+              low = middle;
+            }
+          else
+            {
+              high = middle;
+            }
+        }
+    }
+  NS_LOG_DEBUG ("range at " << txPowerDbm << "dBm is " << high << "m (threshold " << threshold << "dBm)");
+  m_maxRange[txPowerDbm] = high;
+  return high;
+}
+
+void
+SocketChannel::NotifyEdThresholdChanged (void)
+{
+  m_maxRange.clear ();
+}
+
 uint32_t
 SocketChannel::GetNDevices (void) const
 {
@@ -115,10 +490,14 @@ SocketChannel::GetDevice (uint32_t i) const
   return m_phyList[i]->GetDevice ()->GetObject<NetDevice> ();
 }
 
-void
+uint32_t
 SocketChannel::Add (Ptr<SocketContikiPhy> phy)
 {
   m_phyList.push_back (phy);
+  /* The mobility model may be set after the channel, see GetMobilityRecord */
+  m_mobility.push_back (new MobilityRecord);
+  m_maxRange.clear ();
+  return m_phyList.size () - 1;
 }
 
 } // namespace ns3
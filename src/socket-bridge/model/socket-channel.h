@@ -31,8 +31,15 @@
 #include "ns3/object-factory.h"
 #include "ns3/propagation-loss-model.h"
 #include "ns3/propagation-delay-model.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/traced-callback.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/vector.h"
 
 #include <vector>
+#include <map>
 #include <stdint.h>
 
 #include "socket-contiki-phy.h"
@@ -68,7 +75,12 @@ public:
   virtual uint32_t GetNDevices (void) const;
   virtual Ptr<NetDevice> GetDevice (uint32_t i) const;
 
-  void Add (Ptr<SocketContikiPhy> phy);
+  /**
+   * \param phy the PHY to attach to the channel
+   * \returns the index of the PHY on the channel, which the PHY keeps so
+   *          that Send finds its sender without a search
+   */
+  uint32_t Add (Ptr<SocketContikiPhy> phy);
 
   /**
    * \param loss the new propagation loss model.
@@ -80,7 +92,8 @@ public:
   void SetPropagationDelayModel (Ptr<PropagationDelayModel> delay);
 
   /**
-   * \param sender the device from which the packet is originating.
+   * \param sender the device from which the packet is originating, attached
+   *        to this channel with Add.
    * \param packet the packet to send
    * \param txPowerDbm the transmit power
    *
@@ -89,14 +102,154 @@ public:
    */
   void Send (Ptr<SocketContikiPhy> sender, Ptr<const Packet> packet, double txPowerDbm);
 
+  /**
+   * \returns the smallest propagation delay between any two PHYs whose nodes
+   * belong to different simulator ranks, or Simulator::GetMaximumSimulationTime
+   * if no PHY pair crosses a rank boundary.
+   *
+   * With RangeCulling, PHY pairs farther apart than the range of the highest
+   * transmit power on the channel are ignored, since they never exchange
+   * frames; the lookahead is then at most IslandLookAhead.
+   *
+   * This is the lookahead a distributed simulator can safely use for the
+   * remote events generated by this channel.  Frames sent later to another
+   * rank with a shorter propagation delay, e.g. after nodes moved closer,
+   * are delivered after the lookahead instead (see GetLateFrames).
+   */
+  Time GetLookAhead (void);
+
+  /**
+   * \returns the number of frames delivered to another rank later than their
+   *          propagation delay because it was below the lookahead
+   */
+  uint64_t GetLateFrames (void) const;
+
+  /**
+   * The callback taking a frame for a PHY owned by another rank, with the
+   * SocketChannelHeader added: the packet, its receive time, and the id of
+   * the destination node and the interface index of its device.
+   */
+  typedef Callback<void, Ptr<Packet>, Time, uint32_t, uint32_t> RemoteSendCallback;
+
+  /**
+   * Hand the frames for other ranks to a callback instead of
+   * MpiInterface::SendPacket, e.g. to check them or to carry them over
+   * another transport.  The receiving rank passes them to
+   * SocketContikiPhy::ReceiveRemote.
+   *
+   * \param callback the callback, or a null callback for MPI
+   */
+  void SetRemoteSendCallback (RemoteSendCallback callback);
+
+  /**
+   * Group positions into islands: two positions are in the same island if
+   * a chain of positions at most range apart connects them.  Radios in
+   * different islands never hear each other.
+   *
+   * \param positions the positions
+   * \param range the largest distance at which two radios hear each other
+   * \returns the island of each position, numbered from 0 in the order of
+   *          the first position of each island
+   */
+  static std::vector<uint32_t> FindIslands (const std::vector<Vector> &positions, double range);
+
+  /**
+   * \returns the island of each PHY on the channel, by FindIslands on the
+   *          current positions and the range of the highest transmit power
+   *          on the channel
+   */
+  std::vector<uint32_t> GetIslands (void);
+
+  /**
+   * \param txPowerDbm a transmit power
+   * \returns the largest distance at which a frame sent with that power is
+   * received above the lowest energy detection threshold of the PHYs on the
+   * channel, according to the propagation loss model.  Computed once per
+   * transmit power; only meaningful for deterministic loss models whose
+   * loss grows with distance.
+   */
+  double GetMaxRange (double txPowerDbm);
+
+  /**
+   * Forget the ranges found by GetMaxRange.  Called by a PHY on the channel
+   * whose energy detection threshold changed.
+   */
+  void NotifyEdThresholdChanged (void);
+
 private:
   SocketChannel& operator = (const SocketChannel&);
   SocketChannel (const SocketChannel &);
 
+  /**
+   * The mobility model of a PHY, with its position and velocity as of its
+   * last CourseChange.  Between course changes a node moves at constant
+   * velocity, so its position is extrapolated instead of asked for.
+   */
+  struct MobilityRecord
+  {
+    Ptr<MobilityModel> model;
+    Vector position;
+    Vector velocity;
+    Time updated;
+  };
+
   typedef std::vector<Ptr<SocketContikiPhy> > PhyList;
-  void Receive (uint32_t i, Ptr<Packet> packet, double rxPowerDbm) const;
+  virtual void DoDispose (void);
+  /**
+   * Unsubscribe from and forget the mobility models of all PHYs.
+   */
+  void ClearMobility (void);
+  /**
+   * \param i the index of a PHY
+   * \returns the record of its mobility model, subscribed to CourseChange
+   *          when first used
+   */
+  MobilityRecord *GetMobilityRecord (uint32_t i);
+  static void CourseChanged (MobilityRecord *record, Ptr<const MobilityModel> model);
+  static Vector GetPosition (const MobilityRecord *record, Time now);
+  void Receive (uint32_t i, Ptr<Packet> packet, double rxPowerDbm, uint8_t channelNumber) const;
+  void SendRemote (uint32_t i, Ptr<Packet> packet, Time delay, double rxPowerDbm, uint8_t channelNumber) const;
+  uint32_t GetSystemId (uint32_t i) const;
+  /**
+   * \returns the range of the highest transmit power of the PHYs
+   */
+  double GetMaxRange (void);
 
   PhyList m_phyList;
+  /**
+   * Mobility records indexed as m_phyList.
+   */
+  std::vector<MobilityRecord *> m_mobility;
+  /**
+   * Skip receivers beyond GetMaxRange of the transmit power before
+   * evaluating the loss model.
+   */
+  bool m_rangeCulling;
+  /**
+   * Upper bound of the range search in meters.
+   */
+  double m_maxRangeSearch;
+  /**
+   * GetMaxRange by transmit power; cleared when a PHY is added, the
+   * threshold of a PHY changes or the loss model is replaced.
+   */
+  std::map<double, double> m_maxRange;
+  /**
+   * Upper bound of the lookahead between ranks, see GetLookAhead.
+   */
+  Time m_islandLookAhead;
+  /**
+   * The lookahead last returned by GetLookAhead.
+   */
+  Time m_lookAhead;
+  uint64_t m_lateFrames;
+  RemoteSendCallback m_remoteSend;
+  /**
+   * The trace source fired once for every frame transmitted on the channel.
+   *
+   * \see class CallBackTraceSource
+   */
+  TracedCallback<Ptr<const Packet> > m_txTrace;
   Ptr<PropagationLossModel> m_loss;
   Ptr<PropagationDelayModel> m_delay;
 };
@@ -19,6 +19,8 @@
  */
 
 #include "socket-contiki-phy.h"
+#include "socket-channel-header.h"
+#include "socket-latency-tag.h"
 
 NS_LOG_COMPONENT_DEFINE ("SocketContikiPhy");
 
@@ -26,19 +28,62 @@ namespace ns3 {
 
 NS_OBJECT_ENSURE_REGISTERED (SocketContikiPhy);
 
+const uint32_t SocketContikiPhy::MAX_PSDU_SIZE;
+uint32_t SocketContikiPhy::g_txDurationUs[4][SocketContikiPhy::MAX_PSDU_SIZE + 1];
+
 TypeId
 SocketContikiPhy::GetTypeId (void)
 {
   static TypeId tid = TypeId ("ns3::SocketContikiPhy")
     .SetParent<Object> ()
     .AddConstructor<SocketContikiPhy> ()
+    .AddAttribute ("TxPowerDbm",
+                   "The transmit power in dBm.",
+                   DoubleValue (65.0),
+                   MakeDoubleAccessor (&SocketContikiPhy::m_txPowerDbm),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("ChannelNumber",
+                   "The 802.15.4 channel the radio is tuned to.",
+                   UintegerValue (26),
+                   MakeUintegerAccessor (&SocketContikiPhy::m_channelNumber),
+                   MakeUintegerChecker<uint8_t> ())
+    .AddAttribute ("CcaMode",
+                   "How clear channel assessment decides that the channel is busy.",
+                   EnumValue (SocketContikiPhy::CCA_ENERGY),
+                   MakeEnumAccessor (&SocketContikiPhy::m_ccaMode),
+                   MakeEnumChecker (SocketContikiPhy::CCA_ENERGY, "Energy",
+                                    SocketContikiPhy::CCA_CARRIER, "Carrier",
+                                    SocketContikiPhy::CCA_CARRIER_AND_ENERGY, "CarrierAndEnergy"))
+    .AddAttribute ("CcaThreshold",
+                   "The power in dBm at or above which arriving energy makes the channel busy.",
+                   DoubleValue (-77.0),
+                   MakeDoubleAccessor (&SocketContikiPhy::m_ccaThresholdDbm),
+                   MakeDoubleChecker<double> ())
+    .AddTraceSource ("PhyState",
+                     "The radio changed from the first to the second state.",
+                     MakeTraceSourceAccessor (&SocketContikiPhy::m_stateTrace))
+    .AddTraceSource ("PhyMode",
+                     "The radio was set from the first to the second mode.",
+                     MakeTraceSourceAccessor (&SocketContikiPhy::m_modeTrace))
   ;
   return tid;
 }
 
 SocketContikiPhy::SocketContikiPhy ()
+  : m_channelIndex (0),
+    m_mode (DSSS_O_QPSK_GHz),
+    m_edThresholdDbm (-85.0),
+    m_txPowerDbm (65.0),
+    m_channelNumber (26),
+    m_ccaMode (CCA_ENERGY),
+    m_ccaThresholdDbm (-77.0),
+    m_state (IDLE),
+    m_radioOn (true),
+    m_rxEpoch (0)
 {
   NS_LOG_FUNCTION (this);
+  InitTxDurationTable ();
+  SetMode (DSSS_O_QPSK_GHz);
 }
 
 SocketContikiPhy::~SocketContikiPhy ()
@@ -54,6 +99,7 @@ SocketContikiPhy::DoDispose (void)
   m_mobility = 0;
   m_channel = 0;
   m_mode = DSSS_O_QPSK_GHz; 
+  Simulator::Cancel (m_endTxEvent);
 }
 
 void
@@ -78,92 +124,123 @@ SocketContikiPhy::GetMobility (void)
   return m_mobility;
 }
 
-Time
-SocketContikiPhy::CalculateTxDuration (uint32_t size)
+void
+SocketContikiPhy::InitTxDurationTable (void)
 {
-  uint32_t duration, symbolRate, preambleDuration;
-  uint8_t bitsPerSymbol, sfdSymbols;
+  static bool initialized = false;
+  if (initialized)
+    {
+      return;
+    }
+  for (uint32_t mode = DSSS_BPSK; mode <= PSSS_ASK; mode++)
+    {
+      for (uint32_t size = 0; size <= MAX_PSDU_SIZE; size++)
+        {
+          g_txDurationUs[mode][size] = CalculateReferenceTxDuration ((PhyMode)mode, size);
+        }
+    }
+  initialized = true;
+}
 
+Time
+SocketContikiPhy::CalculateTxDuration (uint32_t size) const
+{
+  if (size <= MAX_PSDU_SIZE)
+    {
+      return MicroSeconds (g_txDurationUs[m_mode][size]);
+    }
+  return MicroSeconds (CalculateReferenceTxDuration (m_mode, size));
+}
 
-  switch (m_mode)
+uint32_t
+SocketContikiPhy::CalculateReferenceTxDuration (PhyMode mode, uint32_t size)
+{
+  switch (mode)
   {
     case DSSS_BPSK:
-      // IEEE Std 802.15.4-2006 section 6.6.3.3 (868 MHz)
-      symbolRate = 20000;
-      // IEEE Std 802.15.4-2006 section 6.6.2.3
-      bitsPerSymbol = 1;
-      // IEEE Std 802.15.4-2006 section 6.3.1 Table 19
-      preambleDuration = 1600;
-      // IEEE Std 802.15.4-2006 section 6.3.2 Table 20 
-      sfdSymbols = 8;
-      break;
+      return CalculateReferenceTxDuration<DSSS_BPSK> (size);
     case DSSS_O_QPSK_MHz:
-      // IEEE Std 802.15.4-2006 section 6.8.3.3 (868 MHz)
-      symbolRate = 25000;
-      // IEEE Std 802.15.4-2006 section 6.8.2.2
-      bitsPerSymbol = 4;
-      // IEEE Std 802.15.4-2006 section 6.3.1 Table 19
-      preambleDuration = 320;
-      // IEEE Std 802.15.4-2006 section 6.3.2 Table 20 
-      sfdSymbols = 2;
-      break;
+      return CalculateReferenceTxDuration<DSSS_O_QPSK_MHz> (size);
     case PSSS_ASK:
-      // IEEE Std 802.15.4-2006 section 6.7.3.3 (868 MHz)
-      symbolRate = 12500;
-      // IEEE Std 802.15.4-2006 section 6.7.2.2
-      bitsPerSymbol = 20;
-      // IEEE Std 802.15.4-2006 section 6.3.1 Table 19
-      preambleDuration = 160;
-      // IEEE Std 802.15.4-2006 section 6.3.2 Table 20 
-      sfdSymbols = 1;
-      break;
+      return CalculateReferenceTxDuration<PSSS_ASK> (size);
     default:
-      // IEEE Std 802.15.4-2006 section 6.5.3.2
-      symbolRate = 62500;
-      // IEEE Std 802.15.4-2006 section 6.5.2.2
-      bitsPerSymbol = 4;
-      // IEEE Std 802.15.4-2006 section 6.3.1 Table 19
-      preambleDuration = 128;
-      // IEEE Std 802.15.4-2006 section 6.3.2 Table 20 
-      sfdSymbols = 2;
-  } 
-
-  /* Synchronization Header + PHY Header + PHY Payload */
-  duration = preambleDuration +
-             lrint( ((ceil ((size * 8) / bitsPerSymbol)) + sfdSymbols) / 
-             (symbolRate * 1e-6) );
-  // Duration = Preamble plus 
-  // number of symbols to transmit (ceil/size*8/bitsPerSymbol/sfdSymbols)
-  // divided by duration of symbol (symbolRate * 1e-6)
-
-  return MicroSeconds(duration);
+      return CalculateReferenceTxDuration<DSSS_O_QPSK_GHz> (size);
+  }
 }
 
 void
 SocketContikiPhy::StartReceivePacket (Ptr<Packet> packet, double rxPowerDbm) 
 { 
+  (this->*m_startReceive)(packet, rxPowerDbm);
+}
+
+template <SocketContikiPhy::PhyMode mode>
+void
+SocketContikiPhy::DoStartReceivePacket (Ptr<Packet> packet, double rxPowerDbm)
+{
   NS_LOG_FUNCTION (this << packet << rxPowerDbm);
+  if (!m_radioOn)
+    {
+      NS_LOG_DEBUG ("drop packet because the radio is off");
+      return;
+    }
+  SocketLatencyTag::Stamp (packet, SocketLatencyTag::RX_START);
   //rxPowerDbm += m_rxGainDb;
-  double rxPowerW = DbmToW (rxPowerDbm);
-  Time rxDuration = CalculateTxDuration (packet->GetSize ());
+  Time rxDuration = MicroSeconds (GetTxDurationUs<mode> (packet->GetSize ()));
+  if (rxPowerDbm >= m_ccaThresholdDbm && Simulator::Now () + rxDuration > m_ccaEnd)
+    {
+      m_ccaEnd = Simulator::Now () + rxDuration;
+    }
 
-  if (rxPowerW > m_edThresholdW)
+  if (rxPowerDbm > m_edThresholdDbm)
   {
-    NS_LOG_DEBUG ("sync to signal (power=" << rxPowerW << "W)");
-    Simulator::Schedule (rxDuration, &SocketContikiPhy::EndReceive, this, packet);
+    NS_LOG_DEBUG ("sync to signal (power=" << rxPowerDbm << "dBm)");
+    Simulator::Schedule (rxDuration, &SocketContikiPhy::EndReceive, this, packet, m_rxEpoch);
+    if (Simulator::Now () + rxDuration > m_rxEnd)
+      {
+        m_rxEnd = Simulator::Now () + rxDuration;
+      }
+    if (m_state == IDLE)
+      {
+        SwitchState (RX);
+      }
   }
   else
   {
     NS_LOG_DEBUG ("drop packet because signal power too Small (" <<
-                  rxPowerW << "<" << m_edThresholdW << ")");
+                  rxPowerDbm << "<=" << m_edThresholdDbm << "dBm)");
     //NotifyRxDrop (packet);
   }
 }
 
 void
-SocketContikiPhy::EndReceive (Ptr<Packet> packet)
+SocketContikiPhy::ReceiveRemote (Ptr<Packet> packet)
 {
   NS_LOG_FUNCTION (this << packet);
+  SocketChannelHeader header;
+  packet->RemoveHeader (header);
+  if (header.GetChannelNumber () != m_channelNumber)
+    {
+      NS_LOG_DEBUG ("drop packet sent on channel " << (uint32_t)header.GetChannelNumber ());
+      return;
+    }
+  StartReceivePacket (packet, header.GetRxPowerDbm ());
+}
+
+void
+SocketContikiPhy::EndReceive (Ptr<Packet> packet, uint32_t rxEpoch)
+{
+  NS_LOG_FUNCTION (this << packet);
+  if (rxEpoch != m_rxEpoch)
+    {
+      NS_LOG_DEBUG ("drop packet because the radio was turned off while receiving it");
+      return;
+    }
+  SocketLatencyTag::Stamp (packet, SocketLatencyTag::RX_END);
+  if (m_state == RX && m_rxEnd <= Simulator::Now ())
+    {
+      SwitchState (IDLE);
+    }
   /*  If SNR and Packet Error Rate are acceptable */
   //if (m_random.GetValue (0, 1) > 0.1)
   if (1)
@@ -178,6 +255,19 @@ SocketContikiPhy::EndReceive (Ptr<Packet> packet)
     }
 }
 
+void
+SocketContikiPhy::SetChannelNumber (uint8_t channelNumber)
+{
+  NS_LOG_FUNCTION (this << (uint32_t)channelNumber);
+  m_channelNumber = channelNumber;
+}
+
+uint8_t
+SocketContikiPhy::GetChannelNumber (void) const
+{
+  return m_channelNumber;
+}
+
 void
 SocketContikiPhy::RegisterListener (SocketNullMac *listener)
 {
@@ -195,7 +285,115 @@ SocketContikiPhy::SendPacket (Ptr<const Packet> packet)
 {
   Ptr<SocketContikiPhy> ptr = this;
   NS_LOG_FUNCTION (this << packet);
-  m_channel->Send (ptr, packet, 65);
+  SwitchState (TX);
+  Simulator::Cancel (m_endTxEvent);
+  m_endTxEvent = Simulator::Schedule (CalculateTxDuration (packet->GetSize ()), &SocketContikiPhy::EndTx, this);
+  m_channel->Send (ptr, packet, m_txPowerDbm);
+}
+
+void
+SocketContikiPhy::EndTx (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_radioOn)
+    {
+      SwitchState (SLEEP);
+      return;
+    }
+  SwitchState (m_rxEnd > Simulator::Now () ? RX : IDLE);
+}
+
+void
+SocketContikiPhy::SetRadioOn (bool on)
+{
+  NS_LOG_FUNCTION (this << on);
+  if (on == m_radioOn)
+    {
+      return;
+    }
+  m_radioOn = on;
+  if (!on)
+    {
+      m_rxEpoch++;
+      m_rxEnd = Simulator::Now ();
+    }
+  /* A transmission in progress completes first, see EndTx */
+  if (m_state != TX)
+    {
+      SwitchState (on ? IDLE : SLEEP);
+    }
+}
+
+bool
+SocketContikiPhy::IsRadioOn (void) const
+{
+  return m_radioOn;
+}
+
+void
+SocketContikiPhy::SetCcaMode (CcaMode mode)
+{
+  NS_LOG_FUNCTION (this << mode);
+  m_ccaMode = mode;
+}
+
+SocketContikiPhy::CcaMode
+SocketContikiPhy::GetCcaMode (void) const
+{
+  return m_ccaMode;
+}
+
+void
+SocketContikiPhy::SetCcaThreshold (double thresholdDbm)
+{
+  NS_LOG_FUNCTION (this << thresholdDbm);
+  m_ccaThresholdDbm = thresholdDbm;
+}
+
+double
+SocketContikiPhy::GetCcaThreshold (void) const
+{
+  return m_ccaThresholdDbm;
+}
+
+bool
+SocketContikiPhy::IsChannelClear (void) const
+{
+  if (!m_radioOn || m_state == TX)
+    {
+      return false;
+    }
+  Time now = Simulator::Now ();
+  bool energy = m_ccaEnd > now;
+  bool carrier = m_rxEnd > now;
+  switch (m_ccaMode)
+    {
+    case CCA_CARRIER:
+      return !carrier;
+    case CCA_CARRIER_AND_ENERGY:
+      return !(carrier && energy);
+    default:
+      return !energy;
+    }
+}
+
+void
+SocketContikiPhy::SwitchState (State state)
+{
+  if (state == m_state)
+    {
+      return;
+    }
+  NS_LOG_LOGIC ("state " << m_state << " -> " << state);
+  State old = m_state;
+  m_state = state;
+  m_stateTrace (old, state);
+}
+
+SocketContikiPhy::State
+SocketContikiPhy::GetState (void) const
+{
+  return m_state;
 }
 
 Ptr<SocketChannel>
@@ -209,13 +407,47 @@ SocketContikiPhy::SetChannel (Ptr<SocketChannel> channel)
 {
   Ptr<SocketContikiPhy> ptr = this;
   m_channel = channel;
-  channel->Add (ptr);
+  m_channelIndex = channel->Add (ptr);
+}
+
+uint32_t
+SocketContikiPhy::GetChannelIndex (void) const
+{
+  return m_channelIndex;
 }
 
 void
 SocketContikiPhy::SetEdThreshold (double edThreshold)
 {
-  m_edThresholdW = edThreshold;
+  if (edThreshold == m_edThresholdDbm)
+    {
+      return;
+    }
+  m_edThresholdDbm = edThreshold;
+  /* The range of RangeCulling depends on the lowest threshold */
+  if (m_channel != 0)
+    {
+      m_channel->NotifyEdThresholdChanged ();
+    }
+}
+
+double
+SocketContikiPhy::GetEdThreshold (void) const
+{
+  return m_edThresholdDbm;
+}
+
+void
+SocketContikiPhy::SetTxPowerDbm (double txPowerDbm)
+{
+  NS_LOG_FUNCTION (this << txPowerDbm);
+  m_txPowerDbm = txPowerDbm;
+}
+
+double
+SocketContikiPhy::GetTxPowerDbm (void) const
+{
+  return m_txPowerDbm;
 }
 
 uint64_t
@@ -236,43 +468,52 @@ SocketContikiPhy::GetMode (void)
   return m_mode;
 }
 
+template <SocketContikiPhy::PhyMode mode>
 void
-SocketContikiPhy::SetMode (PhyMode mode)
+SocketContikiPhy::DoSetMode (void)
 {
+  typedef SocketPhyModeTraits<mode> Traits;
   m_mode = mode;
-  switch (m_mode)
+  m_startReceive = &SocketContikiPhy::DoStartReceivePacket<mode>;
+  SetDataRate (Traits::DATA_RATE);
+  SetEdThreshold (Traits::ED_THRESHOLD_DBM);
+}
+
+void
+SocketContikiPhy::SetMode (PhyMode mode)
+{
+  PhyMode old = m_mode;
+  switch (mode)
   {
     case DSSS_BPSK:
-      // IEEE Std 802.15.4-2006 section 6.1.1 Table 1 (868 MHz)
-      SetDataRate(20000);
-      // IEEE Std 802.15.4-2006 section 6.6.3.4
-      SetEdThreshold(-92);
+      DoSetMode<DSSS_BPSK> ();
       break;
     case DSSS_O_QPSK_MHz:
-      // IEEE Std 802.15.4-2006 section 6.1.1 Table 1 (868 MHz)
-      SetDataRate(100000);
-      // IEEE Std 802.15.4-2006 section 6.8.3.4
-      SetEdThreshold(-85);
+      DoSetMode<DSSS_O_QPSK_MHz> ();
       break;
     case PSSS_ASK:
-      // IEEE Std 802.15.4-2006 section 6.1.1 Table 1 (868 MHz)
-      SetDataRate(250000);
-      // IEEE Std 802.15.4-2006 section 6.7.3.4
-      SetEdThreshold(-85);
+      DoSetMode<PSSS_ASK> ();
       break;
     default:
-      // IEEE Std 802.15.4-2006 section 6.1.1 Table 1 (868 MHz)
-      SetDataRate(250000);
-      // IEEE Std 802.15.4-2006 section 6.5.3.3
-      SetEdThreshold(-85);
+      DoSetMode<DSSS_O_QPSK_GHz> ();
   }
+  m_modeTrace (old, m_mode);
 }
 
-double
-SocketContikiPhy::DbmToW (double dBm) const
+Time
+SocketContikiPhy::GetSymbolDuration (void) const
 {
-  double mW = pow (10.0,dBm / 10.0);
-  return mW / 1000.0;
+  switch (m_mode)
+  {
+    case DSSS_BPSK:
+      return MicroSeconds (SocketPhyModeTraits<DSSS_BPSK>::SYMBOL_DURATION_US);
+    case DSSS_O_QPSK_MHz:
+      return MicroSeconds (SocketPhyModeTraits<DSSS_O_QPSK_MHz>::SYMBOL_DURATION_US);
+    case PSSS_ASK:
+      return MicroSeconds (SocketPhyModeTraits<PSSS_ASK>::SYMBOL_DURATION_US);
+    default:
+      return MicroSeconds (SocketPhyModeTraits<DSSS_O_QPSK_GHz>::SYMBOL_DURATION_US);
+  }
 }
 
 } // namespace ns3
@@ -72,20 +72,178 @@ public:
     PSSS_ASK
   };
 
+  /**
+   * States of the radio, e.g. for a SocketRadioEnergyModel.  The PHY is in
+   * TX for the duration of every frame it sends and in RX while it receives
+   * a frame above its energy detection threshold; TX takes precedence.
+   */
+  enum State
+  {
+    IDLE,
+    TX,
+    RX,
+    SLEEP
+  };
+
+  /**
+   * Clear channel assessment modes, IEEE Std 802.15.4-2006 section 6.9.9
+   */
+  enum CcaMode
+  {
+    /**
+     * Busy while energy at or above the CCA threshold arrives
+     */
+    CCA_ENERGY = 1,
+    /**
+     * Busy while an 802.15.4 frame is received
+     */
+    CCA_CARRIER = 2,
+    /**
+     * Busy while an 802.15.4 frame at or above the CCA threshold is
+     * received
+     */
+    CCA_CARRIER_AND_ENERGY = 3
+  };
+
 
   SocketContikiPhy ();
   virtual ~SocketContikiPhy ();
 
   void StartReceivePacket (Ptr<Packet> packet, double rxPowerDbm);
+  /**
+   * Entry point for frames transmitted on another simulator rank.  The
+   * frame carries a SocketChannelHeader holding the receive power computed
+   * by the sending rank.
+   *
+   * \param packet the frame delivered by the MpiReceiver of the bridge
+   */
+  void ReceiveRemote (Ptr<Packet> packet);
   void SetDevice (Ptr<Object> device);
   void SetMobility (Ptr<Object> mobility);
+  /**
+   * \param threshold the energy detection threshold in dBm; frames received
+   *        at or below it are dropped
+   */
   void SetEdThreshold (double threshold);
+  /**
+   * \returns the energy detection threshold in dBm
+   */
+  double GetEdThreshold (void) const;
+  /**
+   * Set the power of the following transmissions, e.g. from the power
+   * control of the radio driver in the external process.
+   *
+   * \param txPowerDbm the transmit power in dBm
+   */
+  void SetTxPowerDbm (double txPowerDbm);
+  /**
+   * \returns the transmit power in dBm
+   */
+  double GetTxPowerDbm (void) const;
   void SetDataRate (uint64_t dataRate);
   void SetMode (PhyMode mode);
   Ptr<Object> GetDevice (void) const;
   Ptr<Object> GetMobility (void);
   uint64_t GetDataRate (void);
   PhyMode GetMode (void);
+  /**
+   * \returns the duration of one symbol in the current mode
+   */
+  Time GetSymbolDuration (void) const;
+  /**
+   * \param size the PSDU size in bytes
+   * \returns the time it takes to send a frame of that size in the current
+   *          mode, synchronization and PHY header included; looked up in a
+   *          table for sizes up to aMaxPHYPacketSize
+   */
+  Time CalculateTxDuration (uint32_t size) const;
+  /**
+   * Compute the duration of a frame from the parameters of the mode, as
+   * CalculateTxDuration did before it used tables.
+   *
+   * \param mode the PHY mode
+   * \param size the PSDU size in bytes
+   * \returns the duration in microseconds
+   */
+  static uint32_t CalculateReferenceTxDuration (PhyMode mode, uint32_t size);
+  /**
+   * As CalculateReferenceTxDuration, with the parameters of the mode taken
+   * from SocketPhyModeTraits at compile time.
+   *
+   * \param size the PSDU size in bytes
+   * \returns the duration in microseconds
+   */
+  template <PhyMode mode>
+  static uint32_t CalculateReferenceTxDuration (uint32_t size);
+  /**
+   * As CalculateTxDuration, for a mode known at compile time.
+   *
+   * \param size the PSDU size in bytes
+   * \returns the duration in microseconds
+   */
+  template <PhyMode mode>
+  static uint32_t GetTxDurationUs (uint32_t size);
+  /**
+   * aMaxPHYPacketSize, IEEE Std 802.15.4-2006 section 6.4.1
+   */
+  static const uint32_t MAX_PSDU_SIZE = 127;
+  /**
+   * Tune the radio.  Frames are only delivered between PHYs tuned to the
+   * same channel.
+   *
+   * \param channelNumber the 802.15.4 channel number
+   */
+  void SetChannelNumber (uint8_t channelNumber);
+  /**
+   * \returns the 802.15.4 channel number the radio is tuned to
+   */
+  uint8_t GetChannelNumber (void) const;
+  /**
+   * \returns the current state of the radio
+   */
+  State GetState (void) const;
+  /**
+   * Turn the radio on or off, e.g. as the duty cycling MAC of the external
+   * process does.  While the radio is off the PHY is in SLEEP and frames
+   * are neither received nor forwarded to the process; receptions in
+   * progress are aborted.
+   *
+   * \param on true to turn the radio on
+   */
+  void SetRadioOn (bool on);
+  /**
+   * \returns true unless the radio has been turned off
+   */
+  bool IsRadioOn (void) const;
+  /**
+   * \param mode how IsChannelClear assesses the channel
+   */
+  void SetCcaMode (CcaMode mode);
+  /**
+   * \returns how IsChannelClear assesses the channel
+   */
+  CcaMode GetCcaMode (void) const;
+  /**
+   * \param thresholdDbm the power in dBm at or above which arriving energy
+   *        makes the channel busy.  Frames at or below the energy detection
+   *        threshold never reach the PHY, so a lower CCA threshold acts as
+   *        the energy detection threshold.
+   */
+  void SetCcaThreshold (double thresholdDbm);
+  /**
+   * \returns the CCA threshold in dBm
+   */
+  double GetCcaThreshold (void) const;
+  /**
+   * Clear channel assessment, e.g. for the CSMA of the MAC of the external
+   * process.  The channel is never clear while the radio is off or
+   * transmitting.  Energy is accounted for the frames that started arriving
+   * while the radio was on, including those whose reception was aborted
+   * by turning the radio off.
+   *
+   * \returns true if the channel is clear according to the CCA mode
+   */
+  bool IsChannelClear (void) const;
   virtual void SendPacket (Ptr<const Packet> packet);
 
   virtual void RegisterListener (SocketNullMac *listener);
@@ -93,28 +251,177 @@ public:
 
   void SetChannel (Ptr<SocketChannel> channel);
   Ptr<SocketChannel> GetChannel (void) const;
+  /**
+   * \returns the index of this PHY on its channel, as returned by
+   *          SocketChannel::Add
+   */
+  uint32_t GetChannelIndex (void) const;
 
 
 private:
+  typedef void (SocketContikiPhy::*StartReceiveFn)(Ptr<Packet>, double);
+
   virtual void DoDispose (void);
-  virtual void EndReceive (Ptr<Packet> packet);
-  double DbmToW (double dBm) const;
+  /* The receive path, instantiated for each mode and selected by SetMode */
+  template <PhyMode mode>
+  void DoStartReceivePacket (Ptr<Packet> packet, double rxPowerDbm);
+  template <PhyMode mode>
+  void DoSetMode (void);
+  virtual void EndReceive (Ptr<Packet> packet, uint32_t rxEpoch);
+  void EndTx (void);
+  void SwitchState (State state);
 
-  Time CalculateTxDuration (uint32_t size);
+  /* Frame durations in microseconds per mode and PSDU size */
+  static uint32_t g_txDurationUs[4][MAX_PSDU_SIZE + 1];
+  static void InitTxDurationTable (void);
 
   Ptr<Object> m_device;
   Ptr<Object> m_mobility;
   Ptr<SocketChannel> m_channel;
+  uint32_t m_channelIndex;
   Listeners m_listeners;
   uint64_t m_dataRate;
   PhyMode m_mode;
-  double m_edThresholdW;
+  StartReceiveFn m_startReceive;
+  double m_edThresholdDbm;
+  double m_txPowerDbm;
+  uint8_t m_channelNumber;
+  CcaMode m_ccaMode;
+  double m_ccaThresholdDbm;
+
+  State m_state;
+  /* End of the last reception in progress */
+  Time m_rxEnd;
+  /* End of the last arrival at or above the CCA threshold */
+  Time m_ccaEnd;
+  bool m_radioOn;
+  /* Incremented whenever the radio is turned off, aborting receptions */
+  uint32_t m_rxEpoch;
+  EventId m_endTxEvent;
+  /**
+   * The trace source fired with the old and the new state whenever the
+   * state of the radio changes.
+   *
+   * \see class CallBackTraceSource
+   */
+  TracedCallback<State, State> m_stateTrace;
+  /**
+   * The trace source fired with the old and the new mode whenever the
+   * mode of the radio is set.
+   */
+  TracedCallback<PhyMode, PhyMode> m_modeTrace;
 
   RxOkCallback m_rxOkCallback;
   EventId m_endRxEvent;
   UniformVariable m_random;
 };
 
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief The parameters of an 802.15.4 PHY, one specialisation per
+ * SocketContikiPhy::PhyMode.
+ *
+ * All durations are in microseconds, rates in symbols or bits per second
+ * and the energy detection threshold in dBm.
+ */
+template <SocketContikiPhy::PhyMode mode>
+struct SocketPhyModeTraits;
+
+template <>
+struct SocketPhyModeTraits<SocketContikiPhy::DSSS_BPSK>
+{
+  // IEEE Std 802.15.4-2006 section 6.6.3.3 (868 MHz)
+  static const uint32_t SYMBOL_RATE = 20000;
+  static const uint32_t SYMBOL_DURATION_US = 50;
+  // IEEE Std 802.15.4-2006 section 6.6.2.3
+  static const uint32_t BITS_PER_SYMBOL = 1;
+  // IEEE Std 802.15.4-2006 section 6.3.1 Table 19
+  static const uint32_t PREAMBLE_US = 1600;
+  // IEEE Std 802.15.4-2006 section 6.3.2 Table 20
+  static const uint32_t SFD_SYMBOLS = 8;
+  // IEEE Std 802.15.4-2006 section 6.1.1 Table 1 (868 MHz)
+  static const uint64_t DATA_RATE = 20000;
+  // IEEE Std 802.15.4-2006 section 6.6.3.4
+  static const int32_t ED_THRESHOLD_DBM = -92;
+};
+
+template <>
+struct SocketPhyModeTraits<SocketContikiPhy::DSSS_O_QPSK_MHz>
+{
+  // IEEE Std 802.15.4-2006 section 6.8.3.3 (868 MHz)
+  static const uint32_t SYMBOL_RATE = 25000;
+  static const uint32_t SYMBOL_DURATION_US = 40;
+  // IEEE Std 802.15.4-2006 section 6.8.2.2
+  static const uint32_t BITS_PER_SYMBOL = 4;
+  // IEEE Std 802.15.4-2006 section 6.3.1 Table 19
+  static const uint32_t PREAMBLE_US = 320;
+  // IEEE Std 802.15.4-2006 section 6.3.2 Table 20
+  static const uint32_t SFD_SYMBOLS = 2;
+  // IEEE Std 802.15.4-2006 section 6.1.1 Table 1 (868 MHz)
+  static const uint64_t DATA_RATE = 100000;
+  // IEEE Std 802.15.4-2006 section 6.8.3.4
+  static const int32_t ED_THRESHOLD_DBM = -85;
+};
+
+template <>
+struct SocketPhyModeTraits<SocketContikiPhy::DSSS_O_QPSK_GHz>
+{
+  // IEEE Std 802.15.4-2006 section 6.5.3.2
+  static const uint32_t SYMBOL_RATE = 62500;
+  static const uint32_t SYMBOL_DURATION_US = 16;
+  // IEEE Std 802.15.4-2006 section 6.5.2.2
+  static const uint32_t BITS_PER_SYMBOL = 4;
+  // IEEE Std 802.15.4-2006 section 6.3.1 Table 19
+  static const uint32_t PREAMBLE_US = 128;
+  // IEEE Std 802.15.4-2006 section 6.3.2 Table 20
+  static const uint32_t SFD_SYMBOLS = 2;
+  // IEEE Std 802.15.4-2006 section 6.1.1 Table 1 (2450 MHz)
+  static const uint64_t DATA_RATE = 250000;
+  // IEEE Std 802.15.4-2006 section 6.5.3.3
+  static const int32_t ED_THRESHOLD_DBM = -85;
+};
+
+template <>
+struct SocketPhyModeTraits<SocketContikiPhy::PSSS_ASK>
+{
+  // IEEE Std 802.15.4-2006 section 6.7.3.3 (868 MHz)
+  static const uint32_t SYMBOL_RATE = 12500;
+  static const uint32_t SYMBOL_DURATION_US = 80;
+  // IEEE Std 802.15.4-2006 section 6.7.2.2
+  static const uint32_t BITS_PER_SYMBOL = 20;
+  // IEEE Std 802.15.4-2006 section 6.3.1 Table 19
+  static const uint32_t PREAMBLE_US = 160;
+  // IEEE Std 802.15.4-2006 section 6.3.2 Table 20
+  static const uint32_t SFD_SYMBOLS = 1;
+  // IEEE Std 802.15.4-2006 section 6.1.1 Table 1 (868 MHz)
+  static const uint64_t DATA_RATE = 250000;
+  // IEEE Std 802.15.4-2006 section 6.7.3.4
+  static const int32_t ED_THRESHOLD_DBM = -85;
+};
+
+template <SocketContikiPhy::PhyMode mode>
+uint32_t
+SocketContikiPhy::CalculateReferenceTxDuration (uint32_t size)
+{
+  typedef SocketPhyModeTraits<mode> Traits;
+  /* Synchronization Header + PHY Header + PHY Payload */
+  return Traits::PREAMBLE_US +
+         lrint ( ((ceil ((size * 8) / Traits::BITS_PER_SYMBOL)) + Traits::SFD_SYMBOLS) /
+         (Traits::SYMBOL_RATE * 1e-6) );
+}
+
+template <SocketContikiPhy::PhyMode mode>
+uint32_t
+SocketContikiPhy::GetTxDurationUs (uint32_t size)
+{
+  if (size <= MAX_PSDU_SIZE)
+    {
+      return g_txDurationUs[mode][size];
+    }
+  return CalculateReferenceTxDuration<mode> (size);
+}
+
 } // namespace ns3
 
 
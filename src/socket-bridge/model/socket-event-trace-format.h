@@ -0,0 +1,79 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Binary event trace written by SocketEventTrace and read by
+ * examples/socket-trace-analyzer.cc.
+ *
+ * This header is plain C so that analysis tools need not link against ns-3.
+ * A trace is a header of SET_HEADER_LEN bytes followed by fixed records of
+ * SET_RECORD_LEN bytes, both in the byte order of the host that wrote the
+ * trace:
+ *
+ *   struct set_header:  magic "SBET", version, record length
+ *   struct set_record:  simulation time (ns), value, node, packet UID,
+ *                       size, event type
+ *
+ * The value depends on the event type:
+ *
+ *   SET_EVENT_TX       a frame was sent by the process of the node; 0
+ *   SET_EVENT_RX       a frame was received by the node; 0
+ *   SET_EVENT_DROP     a frame was dropped by the MAC or, with an UID of 0,
+ *                      shed by the bridge; 0
+ *   SET_EVENT_QUEUE    a frame was read from the socket; the frames pending
+ *                      in the bridge including it
+ *   SET_EVENT_LATENCY  a frame was written to the socket; the wall-clock
+ *                      latency from the read on the sending bridge in ns
+ *
+ * Records are grouped per writing thread, so they are not in time order.
+ */
+
+#ifndef SOCKET_EVENT_TRACE_FORMAT_H
+#define SOCKET_EVENT_TRACE_FORMAT_H
+
+#include <stdint.h>
+
+#define SET_VERSION 1
+#define SET_HEADER_LEN 16
+#define SET_RECORD_LEN 32
+
+#define SET_EVENT_TX 0
+#define SET_EVENT_RX 1
+#define SET_EVENT_DROP 2
+#define SET_EVENT_QUEUE 3
+#define SET_EVENT_LATENCY 4
+#define SET_EVENTS 5
+
+struct set_header
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t record_len;
+  uint32_t reserved;
+};
+
+struct set_record
+{
+  int64_t time_ns;
+  uint64_t value;
+  uint32_t node;
+  uint32_t uid;
+  uint16_t size;
+  uint8_t type;
+  uint8_t reserved[5];
+};
+
+#endif /* SOCKET_EVENT_TRACE_FORMAT_H */
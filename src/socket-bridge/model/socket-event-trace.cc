@@ -0,0 +1,300 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+
+#include <string.h>
+
+#include "socket-event-trace.h"
+
+NS_LOG_COMPONENT_DEFINE ("SocketEventTrace");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (SocketEventTrace);
+NS_OBJECT_ENSURE_REGISTERED (SocketEventProbe);
+
+const uint32_t SocketEventTrace::BUFFER_RECORDS;
+
+/* Ids of the traces, so that a thread can tell whose buffer it holds */
+static uint32_t g_traceIds = 0;
+
+/* The buffer of the calling thread and the id of the trace it belongs to */
+static __thread void *t_buffer = 0;
+static __thread uint32_t t_owner = 0;
+
+TypeId
+SocketEventTrace::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SocketEventTrace")
+    .SetParent<Object> ()
+    .AddConstructor<SocketEventTrace> ()
+  ;
+  return tid;
+}
+
+SocketEventTrace::SocketEventTrace ()
+  : m_fp (0),
+    m_open (false),
+    m_id (__sync_add_and_fetch (&g_traceIds, 1)),
+    m_records (0)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+}
+
+SocketEventTrace::~SocketEventTrace ()
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  Close ();
+  for (uint32_t i = 0; i < m_buffers.size (); i++)
+    {
+      delete m_buffers[i];
+    }
+  m_buffers.clear ();
+}
+
+void
+SocketEventTrace::DoDispose (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  Close ();
+  Object::DoDispose ();
+}
+
+bool
+SocketEventTrace::Open (std::string filename)
+{
+  NS_LOG_FUNCTION (filename);
+
+  Close ();
+  CriticalSection cs (m_mutex);
+  m_fp = fopen (filename.c_str (), "wb");
+  if (m_fp == 0)
+    {
+      return false;
+    }
+  /* Buffers are written whole, stdio need not buffer them again */
+  setvbuf (m_fp, NULL, _IONBF, 0);
+
+  struct set_header header;
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, "SBET", 4);
+  header.version = SET_VERSION;
+  header.record_len = sizeof (struct set_record);
+  fwrite (&header, sizeof (header), 1, m_fp);
+  m_records = 0;
+  m_open = true;
+  return true;
+}
+
+void
+SocketEventTrace::Close (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  //
+  // The buffers stay allocated: a thread still writing an event holds its
+  // buffer without the lock, and finds the trace closed when it flushes.
+  //
+  CriticalSection cs (m_mutex);
+  m_open = false;
+  WriteBuffers ();
+  if (m_fp != 0)
+    {
+      fclose (m_fp);
+      m_fp = 0;
+      NS_LOG_INFO ("Wrote " << m_records << " records");
+    }
+}
+
+void
+SocketEventTrace::Flush (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  CriticalSection cs (m_mutex);
+  WriteBuffers ();
+}
+
+void
+SocketEventTrace::WriteBuffers (void)
+{
+  for (uint32_t i = 0; i < m_buffers.size (); i++)
+    {
+      if (m_fp != 0 && m_buffers[i]->used != 0)
+        {
+          fwrite (m_buffers[i]->records, sizeof (struct set_record), m_buffers[i]->used, m_fp);
+          m_records += m_buffers[i]->used;
+        }
+      m_buffers[i]->used = 0;
+    }
+}
+
+Ptr<SocketEventProbe>
+SocketEventTrace::CreateProbe (uint32_t node)
+{
+  return CreateObject<SocketEventProbe> (this, node);
+}
+
+SocketEventTrace::Buffer *
+SocketEventTrace::GetBuffer (void)
+{
+  if (t_owner == m_id)
+    {
+      return static_cast<Buffer *> (t_buffer);
+    }
+
+  //
+  // First event of this thread, or the thread last wrote to another trace.
+  //
+  CriticalSection cs (m_mutex);
+  if (m_fp == 0)
+    {
+      return 0;
+    }
+  Buffer *buffer = 0;
+  for (uint32_t i = 0; i < m_buffers.size (); i++)
+    {
+      if (pthread_equal (m_buffers[i]->thread, pthread_self ()))
+        {
+          buffer = m_buffers[i];
+          break;
+        }
+    }
+  if (buffer == 0)
+    {
+      buffer = new Buffer;
+      buffer->thread = pthread_self ();
+      buffer->used = 0;
+      m_buffers.push_back (buffer);
+    }
+  t_buffer = buffer;
+  t_owner = m_id;
+  return buffer;
+}
+
+void
+SocketEventTrace::Flush (Buffer *buffer)
+{
+  CriticalSection cs (m_mutex);
+  if (m_fp != 0)
+    {
+      fwrite (buffer->records, sizeof (struct set_record), buffer->used, m_fp);
+      m_records += buffer->used;
+    }
+  buffer->used = 0;
+}
+
+void
+SocketEventTrace::Write (uint8_t type, uint32_t node, uint32_t uid, uint32_t size, uint64_t value)
+{
+  if (!m_open)
+    {
+      return;
+    }
+  Buffer *buffer = GetBuffer ();
+  if (buffer == 0)
+    {
+      return;
+    }
+  struct set_record &record = buffer->records[buffer->used];
+  record.time_ns = Simulator::Now ().GetNanoSeconds ();
+  record.value = value;
+  record.node = node;
+  record.uid = uid;
+  record.size = size;
+  record.type = type;
+  memset (record.reserved, 0, sizeof (record.reserved));
+  if (++buffer->used == BUFFER_RECORDS)
+    {
+      Flush (buffer);
+    }
+}
+
+uint64_t
+SocketEventTrace::GetRecords (void) const
+{
+  return m_records;
+}
+
+TypeId
+SocketEventProbe::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SocketEventProbe")
+    .SetParent<Object> ()
+    .AddConstructor<SocketEventProbe> ()
+  ;
+  return tid;
+}
+
+SocketEventProbe::SocketEventProbe ()
+  : m_trace (0),
+    m_node (0)
+{
+}
+
+SocketEventProbe::SocketEventProbe (Ptr<SocketEventTrace> trace, uint32_t node)
+  : m_trace (trace),
+    m_node (node)
+{
+}
+
+void
+SocketEventProbe::DoDispose (void)
+{
+  m_trace = 0;
+  Object::DoDispose ();
+}
+
+void
+SocketEventProbe::Tx (Ptr<const Packet> packet)
+{
+  m_trace->Write (SET_EVENT_TX, m_node, packet->GetUid (), packet->GetSize (), 0);
+}
+
+void
+SocketEventProbe::Rx (Ptr<const Packet> packet)
+{
+  m_trace->Write (SET_EVENT_RX, m_node, packet->GetUid (), packet->GetSize (), 0);
+}
+
+void
+SocketEventProbe::Drop (Ptr<const Packet> packet)
+{
+  m_trace->Write (SET_EVENT_DROP, m_node, packet->GetUid (), packet->GetSize (), 0);
+}
+
+void
+SocketEventProbe::Shed (uint32_t len)
+{
+  m_trace->Write (SET_EVENT_DROP, m_node, 0, len, 0);
+}
+
+void
+SocketEventProbe::Queue (uint32_t len, uint32_t pending)
+{
+  m_trace->Write (SET_EVENT_QUEUE, m_node, 0, len, pending);
+}
+
+void
+SocketEventProbe::Latency (const SocketLatencyTag &tag)
+{
+  m_trace->Write (SET_EVENT_LATENCY, m_node, 0, 0, tag.GetInterval (SocketLatencyTag::READ, SocketLatencyTag::WRITE));
+}
+
+} // namespace ns3
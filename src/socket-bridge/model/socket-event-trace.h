@@ -0,0 +1,197 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_EVENT_TRACE_H
+#define SOCKET_EVENT_TRACE_H
+
+#include "ns3/object.h"
+#include "ns3/packet.h"
+#include "ns3/ptr.h"
+#include "ns3/system-mutex.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include "socket-event-trace-format.h"
+#include "socket-latency-tag.h"
+
+namespace ns3 {
+
+class SocketEventProbe;
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Writes tx, rx, drop, queue and latency events to a binary trace
+ * of fixed records (see socket-event-trace-format.h).
+ *
+ * Every thread writing events (the simulator thread and the reader threads
+ * of the bridges) fills a buffer of its own without locking; a full buffer
+ * is written to the file with a single fwrite under a mutex.  Events are
+ * written through the SocketEventProbe of each node, whose methods can be
+ * connected to the trace sources of the MAC and the bridge.
+ *
+ * examples/socket-trace-analyzer.cc computes per-node throughput, packet
+ * delivery ratio and latency distributions from a trace.
+ */
+class SocketEventTrace : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * Records in the buffer of each thread
+   */
+  static const uint32_t BUFFER_RECORDS = 4096;
+
+  SocketEventTrace ();
+  virtual ~SocketEventTrace ();
+
+  /**
+   * Create the trace file and write its header.
+   *
+   * \param filename the trace file name
+   * \returns false if the file cannot be created
+   */
+  bool Open (std::string filename);
+
+  /**
+   * Write out the buffers of all threads and close the file.  Events
+   * written by other threads meanwhile or afterwards are dropped; the
+   * buffers are only released with the trace.
+   */
+  void Close (void);
+
+  /**
+   * Write out the buffers of all threads, e.g. before ns-3 forks.  No other
+   * thread may write events during the call.
+   */
+  void Flush (void);
+
+  /**
+   * \param node the node id of the events
+   * \returns a probe writing the events of the node to this trace
+   */
+  Ptr<SocketEventProbe> CreateProbe (uint32_t node);
+
+  /**
+   * Write an event stamped with the current simulation time.  Safe to call
+   * from any thread.
+   *
+   * \param type one of the SET_EVENT_* types
+   * \param node the node id
+   * \param uid the UID of the packet, 0 if none
+   * \param size the size of the frame in bytes
+   * \param value the value of the event, see socket-event-trace-format.h
+   */
+  void Write (uint8_t type, uint32_t node, uint32_t uid, uint32_t size, uint64_t value);
+
+  /**
+   * \returns the number of records written to the file so far
+   */
+  uint64_t GetRecords (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  struct Buffer
+  {
+    pthread_t thread;
+    uint32_t used;
+    struct set_record records[BUFFER_RECORDS];
+  };
+
+  /**
+   * \returns the buffer of the calling thread, or 0 if the trace is closed
+   */
+  Buffer *GetBuffer (void);
+  void Flush (Buffer *buffer);
+  /**
+   * Write out and empty the buffers of all threads, with m_mutex held.
+   */
+  void WriteBuffers (void);
+
+  FILE *m_fp;
+  /* set and cleared under m_mutex, read without it as a hint */
+  volatile bool m_open;
+  uint32_t m_id;
+  SystemMutex m_mutex;
+  std::vector<Buffer *> m_buffers;
+  uint64_t m_records;
+};
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Writes the events of one node to a SocketEventTrace.
+ *
+ * The methods match the signatures of the trace sources they are meant to
+ * be connected to.
+ */
+class SocketEventProbe : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  SocketEventProbe ();
+  SocketEventProbe (Ptr<SocketEventTrace> trace, uint32_t node);
+
+  /**
+   * \param packet a frame sent by the process, e.g. from MacTx of SocketNullMac
+   */
+  void Tx (Ptr<const Packet> packet);
+
+  /**
+   * \param packet a frame received by the node, e.g. from MacRx of SocketNullMac
+   */
+  void Rx (Ptr<const Packet> packet);
+
+  /**
+   * \param packet a dropped frame, e.g. from MacTxDrop or MacRxDrop of SocketNullMac
+   */
+  void Drop (Ptr<const Packet> packet);
+
+  /**
+   * \param len the length of a frame shed by the bridge (Shed of SocketBridge)
+   */
+  void Shed (uint32_t len);
+
+  /**
+   * \param len the length of a frame read from the socket
+   * \param pending the frames pending in the bridge (Read of SocketBridge)
+   */
+  void Queue (uint32_t len, uint32_t pending);
+
+  /**
+   * \param tag the timestamps of a frame written to the socket (Latency of SocketBridge)
+   */
+  void Latency (const SocketLatencyTag &tag);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  Ptr<SocketEventTrace> m_trace;
+  uint32_t m_node;
+};
+
+} // namespace ns3
+
+#endif /* SOCKET_EVENT_TRACE_H */
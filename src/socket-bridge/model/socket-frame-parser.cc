@@ -0,0 +1,225 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "socket-frame-parser.h"
+
+namespace ns3 {
+
+const uint16_t SocketFrameParser::BROADCAST_SHORT;
+const uint16_t SocketFrameParser::NO_SHORT_ADDRESS;
+const uint16_t SocketFrameParser::PROT_NUMBER_IPV6;
+const uint32_t SocketFrameParser::MAX_HEADER_LENGTH;
+
+/* Length of the address field for each addressing mode */
+static const uint8_t g_addressLength[4] = { 0, 0, 2, 8 };
+
+/* Length of the key identifier field for each key identifier mode */
+static const uint8_t g_keyIdLength[4] = { 0, 1, 5, 9 };
+
+/* All multi-byte fields are sent least significant byte first */
+static inline uint64_t
+ReadAddress (const uint8_t *p, uint8_t length)
+{
+  uint64_t address = 0;
+  for (uint8_t i = length; i > 0; i--)
+    {
+      address = (address << 8) | p[i - 1];
+    }
+  return address;
+}
+
+static inline uint8_t
+ClassifyDispatch (uint8_t dispatch)
+{
+  if (dispatch < 0x40)
+    {
+      return SocketFrame::DISPATCH_NALP;
+    }
+  if (dispatch == 0x41)
+    {
+      return SocketFrame::DISPATCH_IPV6;
+    }
+  if (dispatch == 0x42)
+    {
+      return SocketFrame::DISPATCH_HC1;
+    }
+  if (dispatch == 0x50)
+    {
+      return SocketFrame::DISPATCH_BC0;
+    }
+  if ((dispatch & 0xe0) == 0x60)
+    {
+      return SocketFrame::DISPATCH_IPHC;
+    }
+  if ((dispatch & 0xc0) == 0x80)
+    {
+      return SocketFrame::DISPATCH_MESH;
+    }
+  if ((dispatch & 0xf8) == 0xc0)
+    {
+      return SocketFrame::DISPATCH_FRAG1;
+    }
+  if ((dispatch & 0xf8) == 0xe0)
+    {
+      return SocketFrame::DISPATCH_FRAGN;
+    }
+  return SocketFrame::DISPATCH_RESERVED;
+}
+
+bool
+SocketFrameParser::Parse (const uint8_t *buf, uint32_t len, SocketFrame &frame)
+{
+  /* Frame control and sequence number */
+  if (len < 3)
+    {
+      return false;
+    }
+  uint16_t fcf = buf[0] | (buf[1] << 8);
+  frame.frameType = fcf & 0x07;
+  frame.security = (fcf >> 3) & 0x01;
+  frame.framePending = (fcf >> 4) & 0x01;
+  frame.ackRequest = (fcf >> 5) & 0x01;
+  frame.panIdCompression = (fcf >> 6) & 0x01;
+  frame.dstMode = (fcf >> 10) & 0x03;
+  frame.version = (fcf >> 12) & 0x03;
+  frame.srcMode = (fcf >> 14) & 0x03;
+  frame.sequence = buf[2];
+
+  if (frame.dstMode == 1 || frame.srcMode == 1)
+    {
+      /* Reserved addressing mode */
+      return false;
+    }
+
+  uint8_t dstLength = g_addressLength[frame.dstMode];
+  uint8_t srcLength = g_addressLength[frame.srcMode];
+  bool srcPanPresent = frame.srcMode != SocketFrame::ADDR_NONE
+    && !(frame.panIdCompression && frame.dstMode != SocketFrame::ADDR_NONE);
+  uint32_t offset = 3;
+  uint32_t end = offset + (dstLength ? 2 + dstLength : 0) + (srcPanPresent ? 2 : 0) + srcLength;
+  if (end > len)
+    {
+      return false;
+    }
+
+  frame.dstPan = 0;
+  frame.dstAddress = 0;
+  if (dstLength)
+    {
+      frame.dstPan = buf[offset] | (buf[offset + 1] << 8);
+      frame.dstAddress = ReadAddress (buf + offset + 2, dstLength);
+      offset += 2 + dstLength;
+    }
+  frame.srcPan = frame.dstPan;
+  if (srcPanPresent)
+    {
+      frame.srcPan = buf[offset] | (buf[offset + 1] << 8);
+      offset += 2;
+    }
+  frame.srcAddress = ReadAddress (buf + offset, srcLength);
+  offset += srcLength;
+
+  if (frame.security)
+    {
+      /* Auxiliary security header: control, frame counter and key identifier */
+      if (offset + 5 > len)
+        {
+          return false;
+        }
+      offset += 5 + g_keyIdLength[(buf[offset] >> 3) & 0x03];
+      if (offset > len)
+        {
+          return false;
+        }
+    }
+  frame.headerLength = offset;
+
+  /* The payload of secured frames is encrypted */
+  frame.dispatch = SocketFrame::DISPATCH_NONE;
+  if (frame.frameType == SocketFrame::DATA && !frame.security && offset < len)
+    {
+      frame.dispatch = ClassifyDispatch (buf[offset]);
+    }
+  return true;
+}
+
+uint16_t
+SocketFrameParser::GetProtocol (const SocketFrame &frame)
+{
+  switch (frame.dispatch)
+    {
+    case SocketFrame::DISPATCH_IPV6:
+    case SocketFrame::DISPATCH_HC1:
+    case SocketFrame::DISPATCH_IPHC:
+    case SocketFrame::DISPATCH_BC0:
+    case SocketFrame::DISPATCH_MESH:
+    case SocketFrame::DISPATCH_FRAG1:
+    case SocketFrame::DISPATCH_FRAGN:
+      return PROT_NUMBER_IPV6;
+    default:
+      return 0;
+    }
+}
+
+Mac64Address
+SocketFrameParser::GetMac64Address (uint16_t pan, uint8_t mode, uint64_t address)
+{
+  uint8_t buf[8];
+  if (mode == SocketFrame::ADDR_EXTENDED)
+    {
+      for (int i = 7; i >= 0; i--)
+        {
+          buf[i] = address & 0xff;
+          address >>= 8;
+        }
+    }
+  else if (mode == SocketFrame::ADDR_SHORT && address == BROADCAST_SHORT)
+    {
+      for (int i = 0; i < 8; i++)
+        {
+          buf[i] = 0xff;
+        }
+    }
+  else
+    {
+      /* RFC 4944 section 6: PAN:00ff:fe00:short; no address gives PAN:00ff:fe00:0000 */
+      buf[0] = pan >> 8;
+      buf[1] = pan & 0xff;
+      buf[2] = 0x00;
+      buf[3] = 0xff;
+      buf[4] = 0xfe;
+      buf[5] = 0x00;
+      buf[6] = (address >> 8) & 0xff;
+      buf[7] = address & 0xff;
+    }
+  Mac64Address mac;
+  mac.CopyFrom (buf);
+  return mac;
+}
+
+Mac64Address
+SocketFrameParser::GetSource (const SocketFrame &frame)
+{
+  return GetMac64Address (frame.srcPan, frame.srcMode, frame.srcAddress);
+}
+
+Mac64Address
+SocketFrameParser::GetDestination (const SocketFrame &frame)
+{
+  return GetMac64Address (frame.dstPan, frame.dstMode, frame.dstAddress);
+}
+
+} // namespace ns3
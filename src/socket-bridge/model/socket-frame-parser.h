@@ -0,0 +1,168 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_FRAME_PARSER_H
+#define SOCKET_FRAME_PARSER_H
+
+#include "ns3/mac64-address.h"
+
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief The fields of an 802.15.4 MAC header and the 6LoWPAN dispatch of
+ * its payload, as found by SocketFrameParser.
+ */
+struct SocketFrame
+{
+  /**
+   * IEEE Std 802.15.4-2006 section 7.2.1.1.1 Table 79
+   */
+  enum FrameType {
+    BEACON = 0,
+    DATA = 1,
+    ACK = 2,
+    COMMAND = 3
+  };
+
+  /**
+   * IEEE Std 802.15.4-2006 section 7.2.1.1.6 Table 80
+   */
+  enum AddressMode {
+    ADDR_NONE = 0,
+    ADDR_SHORT = 2,
+    ADDR_EXTENDED = 3
+  };
+
+  /**
+   * 6LoWPAN dispatch of the payload (RFC 4944 section 5.1, RFC 6282)
+   */
+  enum Dispatch {
+    DISPATCH_NONE,      /**< no payload, not a data frame or secured */
+    DISPATCH_NALP,      /**< not a LoWPAN frame */
+    DISPATCH_IPV6,      /**< uncompressed IPv6 */
+    DISPATCH_HC1,       /**< LOWPAN_HC1 compressed IPv6 */
+    DISPATCH_IPHC,      /**< LOWPAN_IPHC compressed IPv6 */
+    DISPATCH_BC0,       /**< broadcast header */
+    DISPATCH_MESH,      /**< mesh header */
+    DISPATCH_FRAG1,     /**< first fragment header */
+    DISPATCH_FRAGN,     /**< subsequent fragment header */
+    DISPATCH_RESERVED   /**< reserved dispatch value */
+  };
+
+  uint8_t frameType;
+  bool security;
+  bool framePending;
+  bool ackRequest;
+  bool panIdCompression;
+  uint8_t version;
+  uint8_t sequence;
+  uint8_t dstMode;
+  uint8_t srcMode;
+  uint16_t dstPan;
+  uint16_t srcPan;
+  /** Short address in the low 16 bits, or the extended address with its
+   *  most significant byte first as printed by Mac64Address */
+  uint64_t dstAddress;
+  uint64_t srcAddress;
+  /** Length of the MAC header, including any auxiliary security header */
+  uint32_t headerLength;
+  uint8_t dispatch;
+};
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Parses 802.15.4 MAC headers in place.
+ *
+ * The parser reads the frame control field, sequence number, PAN
+ * identifiers and addresses straight from the buffer read from the socket,
+ * without creating a Packet or any Header object, and classifies the
+ * 6LoWPAN dispatch of the payload of data frames.
+ */
+class SocketFrameParser
+{
+public:
+  /**
+   * Short destination address used for broadcast
+   */
+  static const uint16_t BROADCAST_SHORT = 0xffff;
+
+  /**
+   * Short address of a node that only uses its extended address
+   */
+  static const uint16_t NO_SHORT_ADDRESS = 0xfffe;
+
+  /**
+   * EtherType reported for frames carrying 6LoWPAN compressed IPv6
+   */
+  static const uint16_t PROT_NUMBER_IPV6 = 0x86DD;
+
+  /**
+   * Longest MAC header: extended addresses, both PAN IDs and an auxiliary
+   * security header with a 9 byte key identifier, plus the dispatch byte
+   */
+  static const uint32_t MAX_HEADER_LENGTH = 3 + 2 + 8 + 2 + 8 + 14 + 1;
+
+  /**
+   * \param buf the frame, starting with the frame control field; the FCS
+   *        is neither required nor checked
+   * \param len the number of bytes in buf
+   * \param frame the parsed fields
+   * \returns false if the frame is too short for its header or uses a
+   *          reserved addressing mode
+   */
+  static bool Parse (const uint8_t *buf, uint32_t len, SocketFrame &frame);
+
+  /**
+   * \param frame a parsed frame
+   * \returns the EtherType of the payload: PROT_NUMBER_IPV6 for 6LoWPAN
+   *          frames, 0 otherwise
+   */
+  static uint16_t GetProtocol (const SocketFrame &frame);
+
+  /**
+   * Map an 802.15.4 address to the Mac64Address used by the bridge.
+   * Extended addresses are used as they are.  A short address is expanded
+   * to PAN:00ff:fe00:short as in RFC 4944 section 6, except the broadcast
+   * address which maps to the broadcast address of the bridge.
+   *
+   * \param pan the PAN identifier of the address
+   * \param mode the addressing mode
+   * \param address the address as stored in SocketFrame
+   * \returns the 64-bit address
+   */
+  static Mac64Address GetMac64Address (uint16_t pan, uint8_t mode, uint64_t address);
+
+  /**
+   * \param frame a parsed frame
+   * \returns the source address as a Mac64Address
+   */
+  static Mac64Address GetSource (const SocketFrame &frame);
+
+  /**
+   * \param frame a parsed frame
+   * \returns the destination address as a Mac64Address
+   */
+  static Mac64Address GetDestination (const SocketFrame &frame);
+};
+
+} // namespace ns3
+
+#endif /* SOCKET_FRAME_PARSER_H */
@@ -0,0 +1,1018 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <algorithm>
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+#include "socket-io-service.h"
+#include "socket-bridge-protocol.h"
+
+//
+// The io_uring backend needs the kernel header of 6.0 or later; the system
+// calls are made directly, without liburing.
+//
+#if defined (HAVE_IO_URING) && defined (__NR_io_uring_setup) && defined (IORING_RECV_MULTISHOT)
+#define SOCKET_IO_URING 1
+#endif
+
+NS_LOG_COMPONENT_DEFINE ("SocketIoService");
+
+namespace ns3 {
+
+const uint32_t SocketIoService::RING_ENTRIES;
+const uint32_t SocketIoService::RECV_BUFFERS;
+const uint32_t SocketIoService::CHUNK_SIZE;
+
+/* The request an io_uring completion belongs to, in the upper half of its
+   user data; the lower half holds the slot */
+enum IoRequest
+{
+  IO_RECV = 1,
+  IO_SEND,
+  IO_CANCEL,
+  IO_STOP,
+  IO_PROBE
+};
+
+/* The epoll data of the eventfd waking up the EPOLL thread */
+static const uint32_t IO_WAKEUP = 0xffffffff;
+/* The group of the buffers registered for receives */
+static const uint16_t IO_BUFFER_GROUP = 0;
+
+static uint64_t
+IoUserData (IoRequest request, uint32_t id)
+{
+  return ((uint64_t)request << 32) | id;
+}
+
+SocketIoService *
+SocketIoService::Get (Backend backend)
+{
+  static SocketIoService epoll (EPOLL);
+  static SocketIoService uring (URING);
+
+  if (backend == URING)
+    {
+      if (!uring.m_setup)
+        {
+          uring.m_supported = uring.Setup ();
+          uring.m_setup = true;
+          if (!uring.m_supported)
+            {
+              NS_LOG_WARN ("io_uring with multishot receives is not supported, falling back to epoll");
+            }
+        }
+      if (uring.m_supported)
+        {
+          return &uring;
+        }
+    }
+  return &epoll;
+}
+
+SocketIoService::SocketIoService (Backend backend)
+  : m_backend (backend),
+    m_setup (false),
+    m_supported (false),
+    m_pid (0),
+    m_active (0),
+    m_stopping (false),
+    m_stopReaped (false),
+    m_flushScheduled (false),
+    m_sendPool (0),
+    m_thread (0),
+    m_epoll (-1),
+    m_wakeup (-1),
+    m_ring (-1),
+    m_sqMap (0),
+    m_sqMapSize (0),
+    m_cqMap (0),
+    m_cqMapSize (0),
+    m_sqes (0),
+    m_sqeEntries (0),
+    m_sqHead (0),
+    m_sqTailShared (0),
+    m_sqArray (0),
+    m_sqMask (0),
+    m_sqTail (0),
+    m_sqSubmitted (0),
+    m_cqHead (0),
+    m_cqTail (0),
+    m_cqMask (0),
+    m_cqes (0),
+    m_bufRing (0),
+    m_bufs (0),
+    m_bufTail (0),
+    m_syscalls (0),
+    m_reads (0),
+    m_writes (0)
+{
+}
+
+SocketIoService::~SocketIoService ()
+{
+  /* A thread still serving sockets at exit keeps its instance */
+  if (m_thread == 0)
+    {
+      Teardown ();
+    }
+}
+
+SocketIoService::Backend
+SocketIoService::GetBackend (void) const
+{
+  return m_backend;
+}
+
+bool
+SocketIoService::Setup (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_pid = getpid ();
+  if (m_backend == EPOLL)
+    {
+      m_epoll = epoll_create (64);
+      m_wakeup = eventfd (0, 0);
+      if (m_epoll < 0 || m_wakeup < 0)
+        {
+          NS_LOG_WARN ("epoll_create() or eventfd() failed, errno = " << strerror (errno));
+          Teardown ();
+          return false;
+        }
+      struct epoll_event event;
+      memset (&event, 0, sizeof (event));
+      event.events = EPOLLIN;
+      event.data.u32 = IO_WAKEUP;
+      epoll_ctl (m_epoll, EPOLL_CTL_ADD, m_wakeup, &event);
+      return true;
+    }
+
+#ifdef SOCKET_IO_URING
+  struct io_uring_params params;
+  memset (&params, 0, sizeof (params));
+  m_ring = syscall (__NR_io_uring_setup, RING_ENTRIES, &params);
+  if (m_ring < 0)
+    {
+      NS_LOG_LOGIC ("io_uring_setup() failed, errno = " << strerror (errno));
+      m_ring = -1;
+      return false;
+    }
+
+  m_sqMapSize = params.sq_off.array + params.sq_entries * sizeof (uint32_t);
+  m_cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+  bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single)
+    {
+      m_sqMapSize = m_cqMapSize = std::max (m_sqMapSize, m_cqMapSize);
+    }
+  m_sqMap = mmap (0, m_sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQ_RING);
+  m_cqMap = single ? m_sqMap : mmap (0, m_cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_CQ_RING);
+  m_sqeEntries = params.sq_entries;
+  m_sqes = (struct io_uring_sqe *)mmap (0, m_sqeEntries * sizeof (struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQES);
+  if (m_sqMap == MAP_FAILED || m_cqMap == MAP_FAILED || m_sqes == MAP_FAILED)
+    {
+      NS_LOG_WARN ("mapping the io_uring failed, errno = " << strerror (errno));
+      m_sqMap = m_sqMap == MAP_FAILED ? 0 : m_sqMap;
+      m_cqMap = m_cqMap == MAP_FAILED ? 0 : m_cqMap;
+      m_sqes = m_sqes == MAP_FAILED ? 0 : m_sqes;
+      Teardown ();
+      return false;
+    }
+
+  uint8_t *sq = (uint8_t *)m_sqMap;
+  m_sqHead = (volatile uint32_t *)(sq + params.sq_off.head);
+  m_sqTailShared = (volatile uint32_t *)(sq + params.sq_off.tail);
+  m_sqMask = *(uint32_t *)(sq + params.sq_off.ring_mask);
+  m_sqArray = (uint32_t *)(sq + params.sq_off.array);
+  m_sqTail = m_sqSubmitted = *m_sqTailShared;
+  uint8_t *cq = (uint8_t *)m_cqMap;
+  m_cqHead = (volatile uint32_t *)(cq + params.cq_off.head);
+  m_cqTail = (volatile uint32_t *)(cq + params.cq_off.tail);
+  m_cqMask = *(uint32_t *)(cq + params.cq_off.ring_mask);
+  m_cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+  //
+  // The kernel picks a buffer from the ring for every receive, so sockets
+  // need no buffer of their own while they wait for data.
+  //
+  void *ring = mmap (0, RECV_BUFFERS * sizeof (struct io_uring_buf), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ring == MAP_FAILED)
+    {
+      Teardown ();
+      return false;
+    }
+  m_bufRing = (struct io_uring_buf *)ring;
+  struct io_uring_buf_reg reg;
+  memset (&reg, 0, sizeof (reg));
+  reg.ring_addr = (uintptr_t)m_bufRing;
+  reg.ring_entries = RECV_BUFFERS;
+  reg.bgid = IO_BUFFER_GROUP;
+  if (syscall (__NR_io_uring_register, m_ring, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+      NS_LOG_LOGIC ("registering the buffer ring failed, errno = " << strerror (errno));
+      Teardown ();
+      return false;
+    }
+  m_bufs = (uint8_t *)malloc (RECV_BUFFERS * SocketBufferPool::BUFFER_SIZE);
+  NS_ABORT_MSG_IF (m_bufs == 0, "malloc() failed");
+  m_bufTail = 0;
+  for (uint32_t i = 0; i < RECV_BUFFERS; i++)
+    {
+      RecycleBuffer (i);
+    }
+  PublishBuffers ();
+
+  if (!ProbeUring ())
+    {
+      Teardown ();
+      return false;
+    }
+  m_sendPool = new SocketBufferPool (RING_ENTRIES);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void
+SocketIoService::Teardown (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_epoll != -1)
+    {
+      close (m_epoll);
+      m_epoll = -1;
+    }
+  if (m_wakeup != -1)
+    {
+      close (m_wakeup);
+      m_wakeup = -1;
+    }
+
+#ifdef SOCKET_IO_URING
+  if (m_sqes != 0)
+    {
+      munmap (m_sqes, m_sqeEntries * sizeof (struct io_uring_sqe));
+    }
+  if (m_cqMap != 0 && m_cqMap != m_sqMap)
+    {
+      munmap (m_cqMap, m_cqMapSize);
+    }
+  if (m_sqMap != 0)
+    {
+      munmap (m_sqMap, m_sqMapSize);
+    }
+  if (m_ring != -1)
+    {
+      close (m_ring);
+    }
+  if (m_bufRing != 0)
+    {
+      munmap (m_bufRing, RECV_BUFFERS * sizeof (struct io_uring_buf));
+    }
+#endif
+  m_sqes = 0;
+  m_sqMap = 0;
+  m_cqMap = 0;
+  m_ring = -1;
+  m_bufRing = 0;
+  free (m_bufs);
+  m_bufs = 0;
+  delete m_sendPool;
+  m_sendPool = 0;
+}
+
+bool
+SocketIoService::ProbeUring (void)
+{
+  NS_LOG_FUNCTION (this);
+
+#ifdef SOCKET_IO_URING
+  //
+  // Kernels before 6.0 reject the multishot flag only once the receive is
+  // submitted, so receive a byte and the end of the stream on a socket
+  // pair: a supported receive completes twice, the first time with more to
+  // come.
+  //
+  int sockets[2];
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets) < 0)
+    {
+      return false;
+    }
+  uint8_t byte = 0;
+  ssize_t written = write (sockets[1], &byte, 1);
+  shutdown (sockets[1], SHUT_WR);
+
+  struct io_uring_sqe *sqe = GetSqe ();
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = sockets[0];
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = IO_BUFFER_GROUP;
+  sqe->user_data = IoUserData (IO_PROBE, 0);
+  Submit ();
+
+  bool supported = false;
+  bool done = written != 1;
+  while (!done)
+    {
+      if (syscall (__NR_io_uring_enter, m_ring, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+        {
+          break;
+        }
+      uint32_t head = *m_cqHead;
+      uint32_t tail = *m_cqTail;
+      __sync_synchronize ();
+      while (head != tail)
+        {
+          struct io_uring_cqe *cqe = &m_cqes[head & m_cqMask];
+          if (cqe->res > 0)
+            {
+              supported = (cqe->flags & IORING_CQE_F_MORE) != 0;
+              RecycleBuffer (cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            }
+          if (!(cqe->flags & IORING_CQE_F_MORE))
+            {
+              done = true;
+            }
+          head++;
+        }
+      __sync_synchronize ();
+      *m_cqHead = head;
+    }
+  PublishBuffers ();
+
+  close (sockets[0]);
+  close (sockets[1]);
+  return supported && done;
+#else
+  return false;
+#endif
+}
+
+uint32_t
+SocketIoService::Add (int fd, bool framed, SocketBufferPool *pool, Callback<void, uint8_t *, ssize_t> callback)
+{
+  NS_LOG_FUNCTION (this << fd << framed);
+
+  if (m_thread == 0)
+    {
+      //
+      // A forked run shares the epoll or io_uring instance with its parent,
+      // so it creates its own.
+      //
+      if (m_setup && m_pid != getpid ())
+        {
+          Teardown ();
+          m_setup = false;
+        }
+      if (!m_setup)
+        {
+          m_supported = Setup ();
+          m_setup = true;
+        }
+      NS_ABORT_MSG_IF (!m_supported, "SocketIoService::Add(): backend not supported");
+    }
+
+  uint32_t id;
+  {
+    CriticalSection cs (m_mutex);
+    id = m_slots.size ();
+    m_slots.push_back (Slot ());
+    Slot &slot = m_slots.back ();
+    slot.fd = fd;
+    slot.active = true;
+    slot.open = true;
+    slot.framed = framed;
+    slot.pool = pool;
+    slot.callback = callback;
+    slot.partialLen = 0;
+    slot.recvArmed = false;
+    m_active++;
+
+    if (m_backend == EPOLL)
+      {
+        struct epoll_event event;
+        memset (&event, 0, sizeof (event));
+        event.events = EPOLLIN;
+        event.data.u32 = id;
+        NS_ABORT_MSG_IF (epoll_ctl (m_epoll, EPOLL_CTL_ADD, fd, &event) < 0,
+                         "SocketIoService::Add(): epoll_ctl() failed, errno = " << strerror (errno));
+      }
+    else
+      {
+        ArmRecv (id);
+        Submit ();
+      }
+  }
+
+  if (m_thread == 0)
+    {
+      m_stopReaped = false;
+      m_thread = Create<SystemThread> (MakeCallback (&SocketIoService::Run, this));
+      m_thread->Start ();
+    }
+  return id;
+}
+
+void
+SocketIoService::Remove (uint32_t id)
+{
+  NS_LOG_FUNCTION (this << id);
+
+  {
+    CriticalSection cs (m_mutex);
+    Slot &slot = m_slots[id];
+    NS_ASSERT (slot.active);
+    slot.active = false;
+    if (m_backend == EPOLL)
+      {
+        struct epoll_event event;
+        memset (&event, 0, sizeof (event));
+        if (slot.open)
+          {
+            epoll_ctl (m_epoll, EPOLL_CTL_DEL, slot.fd, &event);
+          }
+      }
+    else if (slot.recvArmed)
+      {
+#ifdef SOCKET_IO_URING
+        struct io_uring_sqe *sqe = GetSqe ();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = IoUserData (IO_RECV, id);
+        sqe->user_data = IoUserData (IO_CANCEL, id);
+        Submit ();
+#endif
+      }
+  }
+
+  //
+  // The caller may close the socket once this returns, so the messages
+  // queued for it must have been written.
+  //
+  while (m_backend == URING)
+    {
+      {
+        CriticalSection cs (m_mutex);
+        Slot &slot = m_slots[id];
+        if (slot.inflight.empty ())
+          {
+            if (slot.staged.empty ())
+              {
+                break;
+              }
+            FlushSlot (id);
+            Submit ();
+          }
+      }
+      sched_yield ();
+    }
+
+  bool last;
+  {
+    CriticalSection cs (m_mutex);
+    last = (--m_active == 0);
+    if (last)
+      {
+        m_stopping = true;
+        if (m_backend == EPOLL)
+          {
+            uint64_t one = 1;
+            ssize_t written = write (m_wakeup, &one, sizeof (one));
+            NS_ABORT_MSG_IF (written != sizeof (one), "SocketIoService::Remove(): write() failed");
+          }
+        else
+          {
+#ifdef SOCKET_IO_URING
+            struct io_uring_sqe *sqe = GetSqe ();
+            sqe->opcode = IORING_OP_NOP;
+            sqe->user_data = IoUserData (IO_STOP, 0);
+            Submit ();
+#endif
+          }
+      }
+  }
+
+  if (last)
+    {
+      m_thread->Join ();
+      m_thread = 0;
+      m_stopping = false;
+      m_flushScheduled = false;
+      m_dirty.clear ();
+      m_slots.clear ();
+    }
+}
+
+bool
+SocketIoService::Send (uint32_t id, const uint8_t *buf, uint32_t len)
+{
+  if (m_backend != URING)
+    {
+      return false;
+    }
+  NS_ASSERT (len <= SocketBufferPool::BUFFER_SIZE);
+
+  CriticalSection cs (m_mutex);
+  Slot &slot = m_slots[id];
+  if (!slot.active)
+    {
+      return false;
+    }
+  Message message;
+  message.buf = m_sendPool->Allocate ();
+  message.len = len;
+  memcpy (message.buf, buf, len);
+  if (slot.staged.empty ())
+    {
+      m_dirty.push_back (id);
+    }
+  slot.staged.push_back (message);
+
+  //
+  // Everything sent at the current time goes out with one system call,
+  // after the events already scheduled for now.
+  //
+  if (!m_flushScheduled)
+    {
+      m_flushScheduled = true;
+      Simulator::ScheduleNow (&SocketIoService::FlushEvent, this);
+    }
+  return true;
+}
+
+void
+SocketIoService::FlushEvent (SocketIoService *service)
+{
+  service->Flush ();
+}
+
+void
+SocketIoService::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  CriticalSection cs (m_mutex);
+  m_flushScheduled = false;
+  for (std::vector<uint32_t>::const_iterator i = m_dirty.begin (); i != m_dirty.end (); ++i)
+    {
+      //
+      // Sockets with messages in flight are flushed when those complete,
+      // so that messages for one socket are never written concurrently.
+      //
+      if (m_slots[*i].inflight.empty ())
+        {
+          FlushSlot (*i);
+        }
+    }
+  m_dirty.clear ();
+  Submit ();
+}
+
+uint32_t
+SocketIoService::GetSocketMemoryUsage (void) const
+{
+  return sizeof (Slot);
+}
+
+uint64_t
+SocketIoService::GetSyscalls (void) const
+{
+  return m_syscalls;
+}
+
+uint64_t
+SocketIoService::GetReads (void) const
+{
+  return m_reads;
+}
+
+uint64_t
+SocketIoService::GetWrites (void) const
+{
+  return m_writes;
+}
+
+void
+SocketIoService::Run (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_backend == EPOLL)
+    {
+      RunEpoll ();
+    }
+  else
+    {
+      RunUring ();
+    }
+}
+
+void
+SocketIoService::RunEpoll (void)
+{
+  struct epoll_event events[64];
+  uint8_t chunk[CHUNK_SIZE];
+
+  for (;;)
+    {
+      int n = epoll_wait (m_epoll, events, 64, -1);
+      __sync_fetch_and_add (&m_syscalls, 1);
+      if (n < 0)
+        {
+          NS_ABORT_MSG_IF (errno != EINTR, "SocketIoService::RunEpoll(): epoll_wait() failed, errno = " << strerror (errno));
+          continue;
+        }
+
+      CriticalSection cs (m_mutex);
+      for (int i = 0; i < n; i++)
+        {
+          uint32_t id = events[i].data.u32;
+          if (id == IO_WAKEUP)
+            {
+              uint64_t count;
+              ssize_t len = read (m_wakeup, &count, sizeof (count));
+              __sync_fetch_and_add (&m_syscalls, 1);
+              if (m_stopping && len == sizeof (count))
+                {
+                  return;
+                }
+              continue;
+            }
+
+          Slot &slot = m_slots[id];
+          if (!slot.active || !slot.open)
+            {
+              continue;
+            }
+          //
+          // One read per ready socket; epoll reports it again if more is
+          // left.  A RAW read takes one frame at most, like the reader
+          // thread.
+          //
+          ssize_t len = recv (slot.fd, chunk, slot.framed ? CHUNK_SIZE : SocketBufferPool::BUFFER_SIZE, MSG_DONTWAIT);
+          __sync_fetch_and_add (&m_syscalls, 1);
+          if (len > 0)
+            {
+              Deliver (slot, chunk, len);
+            }
+          else if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+            {
+              NS_LOG_INFO ("SocketIoService::RunEpoll(): socket " << slot.fd << " done");
+              slot.open = false;
+              epoll_ctl (m_epoll, EPOLL_CTL_DEL, slot.fd, &events[i]);
+              __sync_fetch_and_add (&m_syscalls, 1);
+            }
+        }
+    }
+}
+
+void
+SocketIoService::RunUring (void)
+{
+#ifdef SOCKET_IO_URING
+  for (;;)
+    {
+      int n = syscall (__NR_io_uring_enter, m_ring, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+      __sync_fetch_and_add (&m_syscalls, 1);
+      NS_ABORT_MSG_IF (n < 0 && errno != EINTR, "SocketIoService::RunUring(): io_uring_enter() failed, errno = " << strerror (errno));
+
+      CriticalSection cs (m_mutex);
+      if (Reap ())
+        {
+          m_stopReaped = true;
+        }
+      Submit ();
+      if (m_stopping && m_stopReaped && IsIdle ())
+        {
+          return;
+        }
+    }
+#endif
+}
+
+void
+SocketIoService::Deliver (Slot &slot, const uint8_t *data, uint32_t len)
+{
+  if (!slot.framed)
+    {
+      uint8_t *buf = Allocate (slot, len);
+      memcpy (buf, data, len);
+      __sync_fetch_and_add (&m_reads, 1);
+      slot.callback (buf, len);
+      return;
+    }
+
+  while (len > 0)
+    {
+      //
+      // Messages that arrived whole go straight to their buffer.
+      //
+      uint32_t total = SBP_HEADER_LEN + (len >= SBP_HEADER_LEN ? sbp_header_length (data) : 0);
+      if (slot.partialLen == 0 && len >= SBP_HEADER_LEN && len >= total)
+        {
+          uint8_t *buf = Allocate (slot, total);
+          memcpy (buf, data, total);
+          data += total;
+          len -= total;
+          __sync_fetch_and_add (&m_reads, 1);
+          slot.callback (buf, total);
+          continue;
+        }
+
+      uint32_t want = slot.partialLen < SBP_HEADER_LEN ? SBP_HEADER_LEN : SBP_HEADER_LEN + sbp_header_length (slot.partial);
+      uint32_t n = std::min (want - slot.partialLen, len);
+      memcpy (slot.partial + slot.partialLen, data, n);
+      slot.partialLen += n;
+      data += n;
+      len -= n;
+      if (slot.partialLen >= SBP_HEADER_LEN)
+        {
+          want = SBP_HEADER_LEN + sbp_header_length (slot.partial);
+        }
+      if (slot.partialLen == want)
+        {
+          uint8_t *buf = Allocate (slot, want);
+          memcpy (buf, slot.partial, want);
+          slot.partialLen = 0;
+          __sync_fetch_and_add (&m_reads, 1);
+          slot.callback (buf, want);
+        }
+    }
+}
+
+uint8_t *
+SocketIoService::Allocate (Slot &slot, uint32_t len)
+{
+  if (slot.pool != 0)
+    {
+      return slot.pool->Allocate ();
+    }
+  uint8_t *buf = (uint8_t *)malloc (len);
+  NS_ABORT_MSG_IF (buf == 0, "malloc() failed");
+  return buf;
+}
+
+struct io_uring_sqe *
+SocketIoService::GetSqe (void)
+{
+#ifdef SOCKET_IO_URING
+  if (m_sqTail - m_sqSubmitted >= m_sqeEntries)
+    {
+      Submit ();
+    }
+  uint32_t index = m_sqTail & m_sqMask;
+  struct io_uring_sqe *sqe = &m_sqes[index];
+  memset (sqe, 0, sizeof (*sqe));
+  m_sqArray[index] = index;
+  m_sqTail++;
+  return sqe;
+#else
+  return 0;
+#endif
+}
+
+void
+SocketIoService::Submit (void)
+{
+#ifdef SOCKET_IO_URING
+  uint32_t pending = m_sqTail - m_sqSubmitted;
+  if (pending == 0)
+    {
+      return;
+    }
+  __sync_synchronize ();
+  *m_sqTailShared = m_sqTail;
+  while (pending > 0)
+    {
+      int n = syscall (__NR_io_uring_enter, m_ring, pending, 0, 0, NULL, 0);
+      __sync_fetch_and_add (&m_syscalls, 1);
+      if (n < 0)
+        {
+          if (errno == EAGAIN || errno == EBUSY)
+            {
+              //
+              // The completion queue is full; make room, this thread holds
+              // the lock the I/O thread would need to.
+              //
+              Reap ();
+              continue;
+            }
+          NS_ABORT_MSG_IF (errno != EINTR, "SocketIoService::Submit(): io_uring_enter() failed, errno = " << strerror (errno));
+          continue;
+        }
+      m_sqSubmitted += n;
+      pending -= n;
+    }
+#endif
+}
+
+void
+SocketIoService::ArmRecv (uint32_t id)
+{
+#ifdef SOCKET_IO_URING
+  struct io_uring_sqe *sqe = GetSqe ();
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = m_slots[id].fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = IO_BUFFER_GROUP;
+  sqe->user_data = IoUserData (IO_RECV, id);
+  m_slots[id].recvArmed = true;
+#endif
+}
+
+void
+SocketIoService::FlushSlot (uint32_t id)
+{
+#ifdef SOCKET_IO_URING
+  Slot &slot = m_slots[id];
+  uint32_t count = std::min<uint32_t> (slot.staged.size (), m_sqeEntries);
+  if (count == 0)
+    {
+      return;
+    }
+  //
+  // The messages are linked so that each one is written once the previous
+  // one has been; a chain must not be split across two submissions.
+  //
+  if (m_sqeEntries - (m_sqTail - m_sqSubmitted) < count)
+    {
+      Submit ();
+    }
+  for (uint32_t i = 0; i < count; i++)
+    {
+      const Message &message = slot.staged[i];
+      struct io_uring_sqe *sqe = GetSqe ();
+      sqe->opcode = IORING_OP_SEND;
+      sqe->fd = slot.fd;
+      sqe->addr = (uintptr_t)message.buf;
+      sqe->len = message.len;
+      sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+      if (i + 1 < count)
+        {
+          sqe->flags = IOSQE_IO_LINK;
+        }
+      sqe->user_data = IoUserData (IO_SEND, id);
+      slot.inflight.push_back (message);
+    }
+  slot.staged.erase (slot.staged.begin (), slot.staged.begin () + count);
+#endif
+}
+
+bool
+SocketIoService::Reap (void)
+{
+  bool stop = false;
+#ifdef SOCKET_IO_URING
+  bool recycled = false;
+  uint32_t head = *m_cqHead;
+  uint32_t tail = *m_cqTail;
+  __sync_synchronize ();
+  while (head != tail)
+    {
+      struct io_uring_cqe *cqe = &m_cqes[head & m_cqMask];
+      IoRequest request = (IoRequest)(cqe->user_data >> 32);
+      uint32_t id = (uint32_t)cqe->user_data;
+      int32_t res = cqe->res;
+      uint32_t flags = cqe->flags;
+      head++;
+
+      if (request == IO_RECV)
+        {
+          Slot &slot = m_slots[id];
+          if (res > 0)
+            {
+              uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+              if (slot.active && slot.open)
+                {
+                  Deliver (slot, m_bufs + bid * SocketBufferPool::BUFFER_SIZE, res);
+                }
+              RecycleBuffer (bid);
+              recycled = true;
+            }
+          if (!(flags & IORING_CQE_F_MORE))
+            {
+              //
+              // The receive ends at the end of the stream, on an error or
+              // when it was cancelled, and when the kernel ran out of
+              // buffers; only the latter is re-armed.
+              //
+              slot.recvArmed = false;
+              if (res == 0 || (res < 0 && res != -ENOBUFS))
+                {
+                  NS_LOG_INFO ("SocketIoService::Reap(): socket " << slot.fd << " done, res = " << res);
+                  slot.open = false;
+                }
+              else if (slot.active)
+                {
+                  ArmRecv (id);
+                }
+            }
+        }
+      else if (request == IO_SEND)
+        {
+          Slot &slot = m_slots[id];
+          NS_ASSERT (!slot.inflight.empty ());
+          m_sendPool->Free (slot.inflight.front ().buf);
+          slot.inflight.pop_front ();
+          if (res > 0)
+            {
+              __sync_fetch_and_add (&m_writes, 1);
+            }
+          else
+            {
+              NS_LOG_WARN ("SocketIoService::Reap(): write to socket " << slot.fd << " failed, res = " << res);
+            }
+          if (slot.inflight.empty () && !slot.staged.empty ())
+            {
+              FlushSlot (id);
+            }
+        }
+      else if (request == IO_STOP)
+        {
+          stop = true;
+        }
+    }
+  __sync_synchronize ();
+  *m_cqHead = head;
+  if (recycled)
+    {
+      PublishBuffers ();
+    }
+#endif
+  return stop;
+}
+
+void
+SocketIoService::RecycleBuffer (uint16_t bid)
+{
+#ifdef SOCKET_IO_URING
+  struct io_uring_buf *buf = &m_bufRing[m_bufTail & (RECV_BUFFERS - 1)];
+  buf->addr = (uintptr_t)(m_bufs + bid * SocketBufferPool::BUFFER_SIZE);
+  buf->len = SocketBufferPool::BUFFER_SIZE;
+  buf->bid = bid;
+  m_bufTail++;
+#endif
+}
+
+void
+SocketIoService::PublishBuffers (void)
+{
+#ifdef SOCKET_IO_URING
+  //
+  // The tail of the ring overlays the reserved field of its first buffer.
+  //
+  __sync_synchronize ();
+  *(volatile uint16_t *)&m_bufRing[0].resv = m_bufTail;
+#endif
+}
+
+bool
+SocketIoService::IsIdle (void) const
+{
+  for (std::vector<Slot>::const_iterator i = m_slots.begin (); i != m_slots.end (); ++i)
+    {
+      if (i->recvArmed || !i->inflight.empty ())
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+} // namespace ns3
@@ -0,0 +1,302 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_IO_SERVICE_H
+#define SOCKET_IO_SERVICE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <deque>
+#include <vector>
+
+#include "ns3/callback.h"
+#include "ns3/ptr.h"
+#include "ns3/system-mutex.h"
+#include "ns3/system-thread.h"
+
+#include "socket-buffer-pool.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf;
+
+namespace ns3 {
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Reads the sockets of many SocketBridges from one I/O thread.
+ *
+ * With the default THREAD backend every bridge has a reader thread that
+ * blocks in select() and read() for each frame.  A SocketIoService instead
+ * serves all sockets registered with it from a single thread and hands
+ * every frame (RAW) or message (FRAMED) to the read callback of its socket
+ * like the reader thread would, in a buffer from the socket's pool.
+ *
+ * The EPOLL backend waits for all sockets with one epoll_wait() and reads
+ * each ready socket once, taking all messages it holds at once in FRAMED
+ * mode.  The URING backend keeps a multishot receive per socket in an
+ * io_uring, with the data landing in a ring of buffers registered with the
+ * kernel, and reaps the completions of all sockets with one
+ * io_uring_enter().  It also takes over writes (see Send): the messages
+ * written during a simulation event are submitted together once the
+ * simulator thread is done with the current time.  URING falls back to
+ * EPOLL when the kernel lacks io_uring, provided buffer rings (5.19) or
+ * multishot receives (6.0), or the module was built without
+ * linux/io_uring.h.
+ *
+ * There is one service per backend and process.  Its thread runs while
+ * sockets are registered.  Add, Remove, Send and Flush must only be called
+ * from the simulator thread.
+ */
+class SocketIoService
+{
+public:
+  enum Backend
+  {
+    EPOLL,
+    URING
+  };
+
+  /**
+   * The number of submission queue entries of the io_uring
+   */
+  static const uint32_t RING_ENTRIES = 1024;
+  /**
+   * The number of buffers the kernel receives into; a power of two
+   */
+  static const uint32_t RECV_BUFFERS = 1024;
+  /**
+   * The bytes a FRAMED socket is read in at a time by the EPOLL backend
+   */
+  static const uint32_t CHUNK_SIZE = 4096;
+
+  /**
+   * \param backend the backend wanted
+   * \returns the service of that backend, or the EPOLL service if URING is
+   *          not supported
+   */
+  static SocketIoService *Get (Backend backend);
+
+  /**
+   * \returns the backend of the service
+   */
+  Backend GetBackend (void) const;
+
+  /**
+   * Start serving a socket.  Reading stops at the end of the stream or on
+   * an error.
+   *
+   * \param fd the socket
+   * \param framed true to deliver one message of socket-bridge-protocol.h
+   *        per callback instead of whatever the socket holds
+   * \param pool the pool to take the buffers passed to the callback from,
+   *        or 0 to allocate them with malloc
+   * \param callback invoked on the I/O thread for every frame or message
+   * \returns the id of the socket
+   */
+  uint32_t Add (int fd, bool framed, SocketBufferPool *pool, Callback<void, uint8_t *, ssize_t> callback);
+
+  /**
+   * Stop serving a socket.  Messages passed to Send are written out first.
+   * No callback runs for the socket once this returns, so its pool and fd
+   * may be released.
+   *
+   * \param id the id returned by Add
+   */
+  void Remove (uint32_t id);
+
+  /**
+   * Queue a message for the socket, to be written in order with the other
+   * messages queued for it.  A Flush of all queued messages is scheduled
+   * for the current simulation time.
+   *
+   * \param id the id returned by Add
+   * \param buf the message
+   * \param len the length of the message, at most
+   *        SocketBufferPool::BUFFER_SIZE
+   * \returns false if the backend does not write (EPOLL); the caller must
+   *          write the message itself
+   */
+  bool Send (uint32_t id, const uint8_t *buf, uint32_t len);
+
+  /**
+   * Submit the messages queued by Send with one system call.
+   */
+  void Flush (void);
+
+  /**
+   * \returns the bytes the service holds for every socket registered
+   */
+  uint32_t GetSocketMemoryUsage (void) const;
+
+  /**
+   * \returns the system calls made by the service so far
+   */
+  uint64_t GetSyscalls (void) const;
+
+  /**
+   * \returns the frames and messages passed to read callbacks so far
+   */
+  uint64_t GetReads (void) const;
+
+  /**
+   * \returns the messages written by the kernel for Send so far
+   */
+  uint64_t GetWrites (void) const;
+
+private:
+  explicit SocketIoService (Backend backend);
+  ~SocketIoService ();
+  SocketIoService (const SocketIoService &);
+  SocketIoService &operator = (const SocketIoService &);
+
+  /**
+   * A message queued or submitted by Send
+   */
+  struct Message
+  {
+    uint8_t *buf;
+    uint32_t len;
+  };
+
+  /**
+   * A registered socket.  Slots are only reused once no request of the
+   * io_uring refers to them anymore.
+   */
+  struct Slot
+  {
+    int fd;
+    /* false once removed; no callback runs for an inactive slot */
+    bool active;
+    /* false after the end of the stream or an error */
+    bool open;
+    bool framed;
+    SocketBufferPool *pool;
+    Callback<void, uint8_t *, ssize_t> callback;
+    /* start of a message split across reads (FRAMED) */
+    uint8_t partial[SocketBufferPool::BUFFER_SIZE];
+    uint32_t partialLen;
+    /* a multishot receive is outstanding (URING) */
+    bool recvArmed;
+    /* messages waiting for Flush, and submitted ones in completion order */
+    std::vector<Message> staged;
+    std::deque<Message> inflight;
+  };
+
+  /**
+   * Create the epoll or io_uring instance.
+   *
+   * \returns false if the backend is not supported
+   */
+  bool Setup (void);
+  void Teardown (void);
+  /**
+   * Check with a socket pair that multishot receives work.
+   */
+  bool ProbeUring (void);
+
+  void Run (void);
+  void RunEpoll (void);
+  void RunUring (void);
+
+  /**
+   * Cut data read from a slot into frames or messages and pass them to its
+   * callback.
+   */
+  void Deliver (Slot &slot, const uint8_t *data, uint32_t len);
+  uint8_t *Allocate (Slot &slot, uint32_t len);
+
+  /**
+   * io_uring submission queue handling, with m_mutex held.
+   */
+  struct io_uring_sqe *GetSqe (void);
+  void Submit (void);
+  void ArmRecv (uint32_t id);
+  void FlushSlot (uint32_t id);
+  /**
+   * Handle all completions.
+   *
+   * \returns true if the stop request has completed
+   */
+  bool Reap (void);
+  void RecycleBuffer (uint16_t bid);
+  void PublishBuffers (void);
+  /**
+   * \returns true if no request refers to any slot anymore
+   */
+  bool IsIdle (void) const;
+
+  /**
+   * Called by the event scheduled by Send.
+   */
+  static void FlushEvent (SocketIoService *service);
+
+  Backend m_backend;
+  bool m_setup;
+  bool m_supported;
+  /* the process the instance was created in; a forked run recreates it */
+  pid_t m_pid;
+
+  std::vector<Slot> m_slots;
+  uint32_t m_active;
+  bool m_stopping;
+  /* the I/O thread has seen the stop request */
+  bool m_stopReaped;
+  bool m_flushScheduled;
+  std::vector<uint32_t> m_dirty;
+  SocketBufferPool *m_sendPool;
+  Ptr<SystemThread> m_thread;
+  /* held by the I/O thread while it handles events, and by the simulator
+     thread while it changes the slots or submits */
+  SystemMutex m_mutex;
+
+  /* EPOLL */
+  int m_epoll;
+  int m_wakeup;
+
+  /* URING */
+  int m_ring;
+  void *m_sqMap;
+  uint32_t m_sqMapSize;
+  void *m_cqMap;
+  uint32_t m_cqMapSize;
+  struct io_uring_sqe *m_sqes;
+  uint32_t m_sqeEntries;
+  volatile uint32_t *m_sqHead;
+  volatile uint32_t *m_sqTailShared;
+  uint32_t *m_sqArray;
+  uint32_t m_sqMask;
+  uint32_t m_sqTail;
+  uint32_t m_sqSubmitted;
+  volatile uint32_t *m_cqHead;
+  volatile uint32_t *m_cqTail;
+  uint32_t m_cqMask;
+  struct io_uring_cqe *m_cqes;
+  /* the ring of receive buffers, addressed as an array of io_uring_buf:
+     the C++ layout of io_uring_buf_ring differs from the kernel's */
+  struct io_uring_buf *m_bufRing;
+  uint8_t *m_bufs;
+  uint16_t m_bufTail;
+
+  volatile uint64_t m_syscalls;
+  volatile uint64_t m_reads;
+  volatile uint64_t m_writes;
+};
+
+} // namespace ns3
+
+#endif /* SOCKET_IO_SERVICE_H */
@@ -0,0 +1,190 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <math.h>
+
+#include "socket-latency-histogram.h"
+
+namespace ns3 {
+
+const uint32_t SocketLatencyHistogram::SUB_BUCKET_BITS;
+const uint32_t SocketLatencyHistogram::SUB_BUCKETS;
+const uint32_t SocketLatencyHistogram::MAX_EXPONENT;
+const uint32_t SocketLatencyHistogram::BUCKETS;
+
+SocketLatencyHistogram::SocketLatencyHistogram ()
+{
+  Reset ();
+}
+
+uint32_t
+SocketLatencyHistogram::GetIndex (uint64_t value)
+{
+  if (value < SUB_BUCKETS)
+    {
+      return value;
+    }
+  uint32_t exponent = 63 - __builtin_clzll (value);
+  if (exponent > MAX_EXPONENT)
+    {
+      return BUCKETS - 1;
+    }
+  uint32_t sub = (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+  return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t
+SocketLatencyHistogram::GetLowestValue (uint32_t index)
+{
+  if (index < SUB_BUCKETS)
+    {
+      return index;
+    }
+  uint32_t exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+  uint64_t sub = index % SUB_BUCKETS;
+  return (SUB_BUCKETS + sub) << (exponent - SUB_BUCKET_BITS);
+}
+
+void
+SocketLatencyHistogram::Record (uint64_t value)
+{
+  if (m_counts.empty ())
+    {
+      m_counts.resize (BUCKETS, 0);
+    }
+  m_counts[GetIndex (value)]++;
+  m_count++;
+  m_sum += value;
+  if (value < m_min)
+    {
+      m_min = value;
+    }
+  if (value > m_max)
+    {
+      m_max = value;
+    }
+}
+
+void
+SocketLatencyHistogram::Merge (const SocketLatencyHistogram &other)
+{
+  if (other.m_count == 0)
+    {
+      return;
+    }
+  if (m_counts.empty ())
+    {
+      m_counts.resize (BUCKETS, 0);
+    }
+  for (uint32_t i = 0; i < BUCKETS; i++)
+    {
+      m_counts[i] += other.m_counts[i];
+    }
+  m_count += other.m_count;
+  m_sum += other.m_sum;
+  if (other.m_min < m_min)
+    {
+      m_min = other.m_min;
+    }
+  if (other.m_max > m_max)
+    {
+      m_max = other.m_max;
+    }
+}
+
+void
+SocketLatencyHistogram::Reset (void)
+{
+  m_counts.clear ();
+  m_count = 0;
+  m_min = ~(uint64_t)0;
+  m_max = 0;
+  m_sum = 0.0;
+}
+
+uint64_t
+SocketLatencyHistogram::GetCount (void) const
+{
+  return m_count;
+}
+
+uint32_t
+SocketLatencyHistogram::GetMemoryUsage (void) const
+{
+  return m_counts.capacity () * sizeof (uint32_t);
+}
+
+uint64_t
+SocketLatencyHistogram::GetMin (void) const
+{
+  return m_count ? m_min : 0;
+}
+
+uint64_t
+SocketLatencyHistogram::GetMax (void) const
+{
+  return m_max;
+}
+
+double
+SocketLatencyHistogram::GetMean (void) const
+{
+  return m_count ? m_sum / m_count : 0.0;
+}
+
+uint64_t
+SocketLatencyHistogram::GetPercentile (double percentile) const
+{
+  if (m_count == 0)
+    {
+      return 0;
+    }
+  uint64_t target = (uint64_t)ceil (percentile / 100.0 * m_count);
+  if (target == 0)
+    {
+      target = 1;
+    }
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < BUCKETS; i++)
+    {
+      seen += m_counts[i];
+      if (seen >= target)
+        {
+          if (i == BUCKETS - 1)
+            {
+              return m_max;
+            }
+          uint64_t highest = GetLowestValue (i + 1) - 1;
+          return highest < m_max ? highest : m_max;
+        }
+    }
+  return m_max;
+}
+
+void
+SocketLatencyHistogram::Print (std::ostream &os) const
+{
+  os << "count=" << GetCount ()
+     << " min=" << GetMin ()
+     << " mean=" << GetMean ()
+     << " p50=" << GetPercentile (50)
+     << " p90=" << GetPercentile (90)
+     << " p99=" << GetPercentile (99)
+     << " p99.9=" << GetPercentile (99.9)
+     << " max=" << GetMax ();
+}
+
+} // namespace ns3
@@ -0,0 +1,111 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_LATENCY_HISTOGRAM_H
+#define SOCKET_LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <vector>
+#include <ostream>
+
+namespace ns3 {
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Log-linear latency histogram in the style of HdrHistogram.
+ *
+ * Values below 16 are counted exactly.  Above that every power of two is
+ * split into 16 linear sub-buckets, so any recorded value is known to
+ * within 1/16 (6.25%) whatever its magnitude.  Values beyond 2^44 are
+ * counted in the last bucket.  The counters are only allocated with the
+ * first recorded value.
+ */
+class SocketLatencyHistogram
+{
+public:
+  SocketLatencyHistogram ();
+
+  /**
+   * \param value the value to record, typically nanoseconds
+   */
+  void Record (uint64_t value);
+
+  /**
+   * Add all values recorded by another histogram.
+   *
+   * \param other the histogram to merge
+   */
+  void Merge (const SocketLatencyHistogram &other);
+
+  /**
+   * Forget all recorded values.
+   */
+  void Reset (void);
+
+  uint64_t GetCount (void) const;
+  uint64_t GetMin (void) const;
+  uint64_t GetMax (void) const;
+  double GetMean (void) const;
+
+  /**
+   * \param percentile the percentile, between 0 and 100
+   * \returns the highest value equivalent to the value below which the
+   *          given percentage of the recorded values fall
+   */
+  uint64_t GetPercentile (double percentile) const;
+
+  /**
+   * \returns the bytes of heap held by the buckets, which are only
+   *          allocated by the first value recorded
+   */
+  uint32_t GetMemoryUsage (void) const;
+
+  /**
+   * Print count, min, mean, p50, p90, p99, p99.9 and max on one line.
+   *
+   * \param os the output stream
+   */
+  void Print (std::ostream &os) const;
+
+  /**
+   * \param value a value
+   * \returns the index of the bucket counting the value
+   */
+  static uint32_t GetIndex (uint64_t value);
+
+  /**
+   * \param index a bucket index
+   * \returns the lowest value counted by the bucket
+   */
+  static uint64_t GetLowestValue (uint32_t index);
+
+private:
+  static const uint32_t SUB_BUCKET_BITS = 4;
+  static const uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const uint32_t MAX_EXPONENT = 44;
+  static const uint32_t BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+  std::vector<uint32_t> m_counts;
+  uint64_t m_count;
+  uint64_t m_min;
+  uint64_t m_max;
+  double m_sum;
+};
+
+} // namespace ns3
+
+#endif /* SOCKET_LATENCY_HISTOGRAM_H */
@@ -0,0 +1,141 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <time.h>
+
+#include "socket-latency-tag.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (SocketLatencyTag);
+
+SocketLatencyTag::SocketLatencyTag ()
+  : m_source (0)
+{
+  for (uint32_t i = 0; i < STAGES; i++)
+    {
+      m_timestamps[i] = 0;
+    }
+}
+
+TypeId
+SocketLatencyTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SocketLatencyTag")
+    .SetParent<Tag> ()
+    .AddConstructor<SocketLatencyTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+SocketLatencyTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+SocketLatencyTag::GetSerializedSize (void) const
+{
+  return STAGES * sizeof (uint64_t) + sizeof (uint32_t);
+}
+
+void
+SocketLatencyTag::Serialize (TagBuffer i) const
+{
+  for (uint32_t s = 0; s < STAGES; s++)
+    {
+      i.WriteU64 (m_timestamps[s]);
+    }
+  i.WriteU32 (m_source);
+}
+
+void
+SocketLatencyTag::Deserialize (TagBuffer i)
+{
+  for (uint32_t s = 0; s < STAGES; s++)
+    {
+      m_timestamps[s] = i.ReadU64 ();
+    }
+  m_source = i.ReadU32 ();
+}
+
+void
+SocketLatencyTag::Print (std::ostream &os) const
+{
+  os << "source=" << m_source;
+  for (uint32_t s = 1; s < STAGES; s++)
+    {
+      os << " stage" << s << "=" << GetInterval ((Stage)(s - 1), (Stage)s) << "ns";
+    }
+}
+
+void
+SocketLatencyTag::SetTimestamp (Stage stage, uint64_t ns)
+{
+  m_timestamps[stage] = ns;
+}
+
+uint64_t
+SocketLatencyTag::GetTimestamp (Stage stage) const
+{
+  return m_timestamps[stage];
+}
+
+uint64_t
+SocketLatencyTag::GetInterval (Stage from, Stage to) const
+{
+  if (m_timestamps[from] == 0 || m_timestamps[to] < m_timestamps[from])
+    {
+      return 0;
+    }
+  return m_timestamps[to] - m_timestamps[from];
+}
+
+void
+SocketLatencyTag::SetSource (uint32_t node)
+{
+  m_source = node;
+}
+
+uint32_t
+SocketLatencyTag::GetSource (void) const
+{
+  return m_source;
+}
+
+uint64_t
+SocketLatencyTag::GetWallClockNs (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+bool
+SocketLatencyTag::Stamp (Ptr<Packet> packet, Stage stage)
+{
+  SocketLatencyTag tag;
+  if (!packet->RemovePacketTag (tag))
+    {
+      return false;
+    }
+  tag.SetTimestamp (stage, GetWallClockNs ());
+  packet->AddPacketTag (tag);
+  return true;
+}
+
+} // namespace ns3
@@ -0,0 +1,114 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_LATENCY_TAG_H
+#define SOCKET_LATENCY_TAG_H
+
+#include "ns3/tag.h"
+#include "ns3/packet.h"
+
+#include <stdint.h>
+#include <ostream>
+
+namespace ns3 {
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Packet tag carrying wall-clock timestamps of a frame as it crosses
+ * the bridge from one external process to another.
+ *
+ * All timestamps are CLOCK_MONOTONIC nanoseconds, which is shared by every
+ * thread and process on the host, so stages stamped on different nodes can
+ * be compared directly.  A timestamp of zero means the stage was not reached.
+ */
+class SocketLatencyTag : public Tag
+{
+public:
+  /**
+   * The stages of the path between two external processes.
+   */
+  enum Stage
+  {
+    READ,       /**< the read thread got the frame from the socket (DoRead) */
+    FORWARD,    /**< the event scheduled by ReadCallback ran in the simulator */
+    RX_START,   /**< the receiving PHY started receiving after propagation */
+    RX_END,     /**< the receiving PHY finished receiving (EndReceive) */
+    WRITE,      /**< the frame was written to the receiver's socket */
+    STAGES      /**< number of stages */
+  };
+
+  SocketLatencyTag ();
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  /**
+   * \param stage the stage to stamp
+   * \param ns the wall-clock time in nanoseconds, see GetWallClockNs
+   */
+  void SetTimestamp (Stage stage, uint64_t ns);
+
+  /**
+   * \param stage the stage
+   * \returns the wall-clock time the stage was reached, or 0
+   */
+  uint64_t GetTimestamp (Stage stage) const;
+
+  /**
+   * \param from the first stage
+   * \param to the second stage
+   * \returns the time in nanoseconds between the two stages, or 0 if either
+   *          stage was not reached
+   */
+  uint64_t GetInterval (Stage from, Stage to) const;
+
+  /**
+   * \param node the id of the node the frame was read from
+   */
+  void SetSource (uint32_t node);
+
+  /**
+   * \returns the id of the node the frame was read from
+   */
+  uint32_t GetSource (void) const;
+
+  /**
+   * \returns the current CLOCK_MONOTONIC time in nanoseconds
+   */
+  static uint64_t GetWallClockNs (void);
+
+  /**
+   * Stamp a stage on the latency tag of a packet, if it carries one.
+   *
+   * \param packet the packet
+   * \param stage the stage to stamp with the current wall-clock time
+   * \returns true if the packet carries a latency tag
+   */
+  static bool Stamp (Ptr<Packet> packet, Stage stage);
+
+private:
+  uint64_t m_timestamps[STAGES];
+  uint32_t m_source;
+};
+
+} // namespace ns3
+
+#endif /* SOCKET_LATENCY_TAG_H */
@@ -0,0 +1,189 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_MPSC_QUEUE_H
+#define SOCKET_MPSC_QUEUE_H
+
+#include <stdint.h>
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Bounded lock-free queue for many producer threads and one consumer
+ * thread.
+ *
+ * Each cell carries a sequence number telling producers and the consumer
+ * whether it is free or holds a value, so neither side ever takes a lock or
+ * waits for the other (D. Vyukov's bounded queue).  Push fails instead of
+ * blocking when the queue is full, which keeps the simulator thread out of
+ * any wait when it is a producer.
+ *
+ * The capacity is rounded up to a power of two.
+ */
+template <typename T>
+class SocketMpscQueue
+{
+public:
+  /**
+   * \param capacity the minimum number of values the queue can hold
+   */
+  explicit SocketMpscQueue (uint32_t capacity);
+  ~SocketMpscQueue ();
+
+  /**
+   * \param value the value to append
+   * \returns false if the queue is full
+   *
+   * May be called concurrently from any number of threads.
+   */
+  bool Push (const T &value);
+
+  /**
+   * \param value receives the oldest value
+   * \returns false if the queue is empty
+   *
+   * Must only be called from a single consumer thread.
+   */
+  bool Pop (T &value);
+
+  /**
+   * \returns an estimate of the number of queued values
+   */
+  uint32_t GetSize (void) const;
+
+  /**
+   * \returns the number of values the queue can hold
+   */
+  uint32_t GetCapacity (void) const;
+
+private:
+  SocketMpscQueue (const SocketMpscQueue &);
+  SocketMpscQueue &operator = (const SocketMpscQueue &);
+
+  struct Cell
+  {
+    volatile uint32_t sequence;
+    T value;
+  };
+
+  Cell *m_cells;
+  uint32_t m_mask;
+  /* keep producer and consumer positions on separate cache lines */
+  char m_pad0[64];
+  volatile uint32_t m_enqueuePos;
+  char m_pad1[64];
+  volatile uint32_t m_dequeuePos;
+  char m_pad2[64];
+};
+
+template <typename T>
+SocketMpscQueue<T>::SocketMpscQueue (uint32_t capacity)
+  : m_enqueuePos (0),
+    m_dequeuePos (0)
+{
+  uint32_t size = 2;
+  while (size < capacity)
+    {
+      size <<= 1;
+    }
+  m_mask = size - 1;
+  m_cells = new Cell[size];
+  for (uint32_t i = 0; i < size; i++)
+    {
+      m_cells[i].sequence = i;
+    }
+}
+
+template <typename T>
+SocketMpscQueue<T>::~SocketMpscQueue ()
+{
+  delete [] m_cells;
+}
+
+template <typename T>
+bool
+SocketMpscQueue<T>::Push (const T &value)
+{
+  Cell *cell;
+  uint32_t pos = m_enqueuePos;
+  for (;;)
+    {
+      cell = &m_cells[pos & m_mask];
+      uint32_t seq = cell->sequence;
+      __sync_synchronize ();
+      int32_t dif = (int32_t)seq - (int32_t)pos;
+      if (dif == 0)
+        {
+          if (__sync_bool_compare_and_swap (&m_enqueuePos, pos, pos + 1))
+            {
+              break;
+            }
+          pos = m_enqueuePos;
+        }
+      else if (dif < 0)
+        {
+          return false;
+        }
+      else
+        {
+          pos = m_enqueuePos;
+        }
+    }
+  cell->value = value;
+  __sync_synchronize ();
+  cell->sequence = pos + 1;
+  return true;
+}
+
+template <typename T>
+bool
+SocketMpscQueue<T>::Pop (T &value)
+{
+  uint32_t pos = m_dequeuePos;
+  Cell *cell = &m_cells[pos & m_mask];
+  uint32_t seq = cell->sequence;
+  __sync_synchronize ();
+  if ((int32_t)seq - (int32_t)(pos + 1) < 0)
+    {
+      return false;
+    }
+  value = cell->value;
+  __sync_synchronize ();
+  cell->sequence = pos + m_mask + 1;
+  m_dequeuePos = pos + 1;
+  return true;
+}
+
+template <typename T>
+uint32_t
+SocketMpscQueue<T>::GetSize (void) const
+{
+  return m_enqueuePos - m_dequeuePos;
+}
+
+template <typename T>
+uint32_t
+SocketMpscQueue<T>::GetCapacity (void) const
+{
+  return m_mask + 1;
+}
+
+} // namespace ns3
+
+#endif /* SOCKET_MPSC_QUEUE_H */
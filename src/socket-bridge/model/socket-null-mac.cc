@@ -18,6 +18,10 @@
  * Author: Mathieu Lacage <mathieu.lacage@sophia.inria.fr>
  */
 
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include "ns3/simulator.h"
+
 #include "socket-null-mac.h"
 
 namespace ns3 {
@@ -38,18 +42,69 @@ SocketNullMac::GetTypeId (void)
                      "A packet has been received by this device, has been passed up from the physical layer "
                      "and is being forwarded up the local protocol stack.  This is a non-promiscuous trace,",
                      MakeTraceSourceAccessor (&SocketNullMac::m_macRxTrace))
-#if 0
-    // Not currently implemented in this device
+    .AddTraceSource ("MacPromiscRx",
+                     "A packet has been received by this device, has been passed up from the physical layer "
+                     "and is about to be processed.  This is a promiscuous trace,",
+                     MakeTraceSourceAccessor (&SocketNullMac::m_macPromiscRxTrace))
+    .AddAttribute ("Promiscuous",
+                   "Deliver every received frame to the socket.  When false, frames addressed "
+                   "to other nodes are dropped.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&SocketNullMac::SetPromiscuous,
+                                        &SocketNullMac::GetPromiscuous),
+                   MakeBooleanChecker ())
+    .AddAttribute ("PanId",
+                   "The PAN identifier of the node, 0xffff to learn it from the frames it sends.",
+                   UintegerValue (0xffff),
+                   MakeUintegerAccessor (&SocketNullMac::SetPanId,
+                                         &SocketNullMac::GetPanId),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("ShortAddress",
+                   "The short address of the node, 0xfffe if it only uses its extended address "
+                   "or 0xffff to learn it from the frames it sends.",
+                   UintegerValue (0xffff),
+                   MakeUintegerAccessor (&SocketNullMac::SetShortAddress,
+                                         &SocketNullMac::GetShortAddress),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("AutoAck",
+                   "Acknowledge frames addressed to the node from within ns-3 and drop the ACKs "
+                   "sent by the node.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&SocketNullMac::SetAutoAck,
+                                        &SocketNullMac::GetAutoAck),
+                   MakeBooleanChecker ())
+    .AddAttribute ("AckFcs",
+                   "Append a frame check sequence to the ACKs generated when AutoAck is set.  "
+                   "Off by default, as the frames exchanged with the external processes carry no FCS.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&SocketNullMac::m_ackFcs),
+                   MakeBooleanChecker ())
+    .AddTraceSource ("MacTxDrop",
+                     "A packet has been dropped by this device before transmission because it is an "
+                     "ACK and AutoAck is set.",
+                     MakeTraceSourceAccessor (&SocketNullMac::m_macTxDropTrace))
+    .AddTraceSource ("MacRxDrop",
+                     "A packet has been received by this device and dropped because it is addressed "
+                     "to another node.",
+                     MakeTraceSourceAccessor (&SocketNullMac::m_macRxDropTrace))
     .AddTraceSource ("Sniffer",
                      "Trace source simulating a non-promiscuous packet sniffer attached to the device",
                      MakeTraceSourceAccessor (&SocketNullMac::m_snifferTrace))
-#endif
   ;
 
   return tid;
 }
 
 SocketNullMac::SocketNullMac ()
+  : m_promiscuous (true),
+    m_panIdKnown (false),
+    m_panId (0),
+    m_shortAddressKnown (false),
+    m_shortAddress (0),
+    m_extendedAddressKnown (false),
+    m_extendedAddress (0),
+    m_autoAck (false),
+    m_ackFcs (false)
 {
   //NS_LOG_FUNCTION_NOARGS ();
 }
@@ -69,6 +124,15 @@ void
 SocketNullMac::SetAddress (Mac64Address address)
 {
   m_macAddr = address;
+  /* The extended address of the node, most significant byte first */
+  uint8_t buf[8];
+  address.CopyTo (buf);
+  m_extendedAddress = 0;
+  for (int i = 0; i < 8; i++)
+    {
+      m_extendedAddress = (m_extendedAddress << 8) | buf[i];
+    }
+  m_extendedAddressKnown = true;
 }
 
 void
@@ -86,6 +150,24 @@ SocketNullMac::NotifyRx (Ptr<const Packet> packet)
 void 
 SocketNullMac::Enqueue (Ptr<const Packet> packet)
 {
+  if (!m_promiscuous || m_autoAck)
+    {
+      uint8_t buf[SocketFrameParser::MAX_HEADER_LENGTH];
+      uint32_t len = packet->CopyData (buf, sizeof (buf));
+      SocketFrame frame;
+      if (SocketFrameParser::Parse (buf, len, frame))
+        {
+          if (m_autoAck && frame.frameType == SocketFrame::ACK)
+            {
+              /* The radio acknowledges in hardware */
+              m_macTxDropTrace (packet);
+              return;
+            }
+          LearnAddresses (frame);
+        }
+    }
+  NotifyTx (packet);
+  m_snifferTrace (packet);
   /* Forward packet to lower layers without processing */
   m_phy->SendPacket(packet); 
 }
@@ -106,9 +188,186 @@ SocketNullMac::SetBridge (Ptr<SocketBridge> bridge)
   m_bridge = bridge;
 }
 
+void
+SocketNullMac::SetPromiscuous (bool promiscuous)
+{
+  m_promiscuous = promiscuous;
+}
+
+bool
+SocketNullMac::GetPromiscuous (void) const
+{
+  return m_promiscuous;
+}
+
+void
+SocketNullMac::SetPanId (uint16_t panId)
+{
+  m_panIdKnown = (panId != SocketFrameParser::BROADCAST_SHORT);
+  m_panId = panId;
+}
+
+uint16_t
+SocketNullMac::GetPanId (void) const
+{
+  return m_panIdKnown ? m_panId : SocketFrameParser::BROADCAST_SHORT;
+}
+
+void
+SocketNullMac::SetShortAddress (uint16_t address)
+{
+  m_shortAddressKnown = (address != SocketFrameParser::BROADCAST_SHORT);
+  m_shortAddress = address;
+}
+
+uint16_t
+SocketNullMac::GetShortAddress (void) const
+{
+  return m_shortAddressKnown ? m_shortAddress : SocketFrameParser::BROADCAST_SHORT;
+}
+
+void
+SocketNullMac::SetAutoAck (bool autoAck)
+{
+  m_autoAck = autoAck;
+}
+
+bool
+SocketNullMac::GetAutoAck (void) const
+{
+  return m_autoAck;
+}
+
+void
+SocketNullMac::LearnAddresses (const SocketFrame &frame)
+{
+  if (frame.frameType == SocketFrame::ACK || frame.srcMode == SocketFrame::ADDR_NONE)
+    {
+      return;
+    }
+  /* Configured addresses take precedence over learned ones */
+  if (!m_panIdKnown)
+    {
+      SetPanId (frame.srcPan);
+    }
+  if (frame.srcMode == SocketFrame::ADDR_SHORT && !m_shortAddressKnown)
+    {
+      SetShortAddress (frame.srcAddress);
+    }
+  else if (frame.srcMode == SocketFrame::ADDR_EXTENDED && !m_extendedAddressKnown)
+    {
+      m_extendedAddressKnown = true;
+      m_extendedAddress = frame.srcAddress;
+    }
+}
+
+bool
+SocketNullMac::IsForThisNode (const SocketFrame &frame) const
+{
+  switch (frame.dstMode)
+    {
+    case SocketFrame::ADDR_SHORT:
+      if (m_panIdKnown && frame.dstPan != m_panId && frame.dstPan != SocketFrameParser::BROADCAST_SHORT)
+        {
+          return false;
+        }
+      return frame.dstAddress == SocketFrameParser::BROADCAST_SHORT
+             || !m_shortAddressKnown
+             || (frame.dstAddress == m_shortAddress && m_shortAddress != SocketFrameParser::NO_SHORT_ADDRESS);
+    case SocketFrame::ADDR_EXTENDED:
+      if (m_panIdKnown && frame.dstPan != m_panId && frame.dstPan != SocketFrameParser::BROADCAST_SHORT)
+        {
+          return false;
+        }
+      return !m_extendedAddressKnown || frame.dstAddress == m_extendedAddress;
+    default:
+      /* ACKs and frames to the PAN coordinator */
+      return true;
+    }
+}
+
+bool
+SocketNullMac::IsUnicastToThisNode (const SocketFrame &frame) const
+{
+  if (m_panIdKnown && frame.dstPan != m_panId)
+    {
+      return false;
+    }
+  switch (frame.dstMode)
+    {
+    case SocketFrame::ADDR_SHORT:
+      return m_shortAddressKnown && frame.dstAddress == m_shortAddress
+             && m_shortAddress != SocketFrameParser::NO_SHORT_ADDRESS;
+    case SocketFrame::ADDR_EXTENDED:
+      return m_extendedAddressKnown && frame.dstAddress == m_extendedAddress;
+    default:
+      return false;
+    }
+}
+
+/* IEEE Std 802.15.4-2006 section 7.2.1.9: ITU-T CRC-16, least significant bit first */
+static uint16_t
+CalculateFcs (const uint8_t *buf, uint32_t len)
+{
+  uint16_t crc = 0;
+  for (uint32_t i = 0; i < len; i++)
+    {
+      crc ^= buf[i];
+      for (int bit = 0; bit < 8; bit++)
+        {
+          crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+        }
+    }
+  return crc;
+}
+
+void
+SocketNullMac::SendAck (uint8_t sequence)
+{
+  /* IEEE Std 802.15.4-2006 section 7.2.2.3: frame control, sequence number and FCS */
+  uint8_t ack[5];
+  ack[0] = SocketFrame::ACK;
+  ack[1] = 0;
+  ack[2] = sequence;
+  uint32_t len = 3;
+  if (m_ackFcs)
+    {
+      uint16_t fcs = CalculateFcs (ack, 3);
+      ack[3] = fcs & 0xff;
+      ack[4] = fcs >> 8;
+      len = 5;
+    }
+  Ptr<Packet> packet = Create<Packet> (ack, len);
+  m_snifferTrace (packet);
+  m_phy->SendPacket (packet);
+}
+
 void 
 SocketNullMac::Receive (Ptr<Packet> packet)
 {
+  m_macPromiscRxTrace (packet);
+  if (!m_promiscuous || m_autoAck)
+    {
+      uint8_t buf[SocketFrameParser::MAX_HEADER_LENGTH];
+      uint32_t len = packet->CopyData (buf, sizeof (buf));
+      SocketFrame frame;
+      /* Let the node decide what to do with frames we do not understand */
+      if (SocketFrameParser::Parse (buf, len, frame))
+        {
+          if (m_autoAck && frame.ackRequest && IsUnicastToThisNode (frame)
+              && (frame.frameType == SocketFrame::DATA || frame.frameType == SocketFrame::COMMAND))
+            {
+              // IEEE Std 802.15.4-2006 section 7.5.6.4.2: aTurnaroundTime is 12 symbols
+              Time turnaround = NanoSeconds (m_phy->GetSymbolDuration ().GetNanoSeconds () * 12);
+              Simulator::Schedule (turnaround, &SocketNullMac::SendAck, this, frame.sequence);
+            }
+          if (!m_promiscuous && !IsForThisNode (frame))
+            {
+              m_macRxDropTrace (packet);
+              return;
+            }
+        }
+    }
   /* Optionally Strip unnecessary ns-3 information before passing to socket */
   ForwardUp (packet);
 }
@@ -118,6 +377,13 @@ SocketNullMac::ForwardUp (Ptr<Packet> packet)
 {
   Address nullSource = Address();
   Address nullDest = Address();
+  NotifyRx (packet);
+  m_snifferTrace (packet);
+  if (m_bridge == 0)
+    {
+      /* Headless MAC, e.g. in a channel benchmark */
+      return;
+    }
   /*  Pass to socket bridge */
   m_bridge->ReceiveFromBridgedDevice(m_bridge, packet, 0, nullSource, nullDest, NetDevice::PACKET_HOST);
   //NS_LOG_FUNCTION(this << packet);
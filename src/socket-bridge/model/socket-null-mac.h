@@ -28,12 +28,35 @@
 
 #include "socket-contiki-phy.h"
 #include "socket-bridge.h"
+#include "socket-frame-parser.h"
 
 namespace ns3 {
 
 class SocketContikiPhy;
 class SocketBridge;
 
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Null MAC between a SocketBridge and a SocketContikiPhy.
+ *
+ * Frames are passed through unmodified.  The MAC also plays the part of the
+ * frame filtering and acknowledgment hardware of an 802.15.4 radio:
+ *
+ * - When it is not promiscuous, received frames addressed to another node
+ *   are dropped before they are written to the socket.  Broadcast frames and
+ *   frames without a destination address (e.g. ACKs) are always delivered,
+ *   as are unicast frames while the node's own address of that kind is not
+ *   known.
+ * - With AutoAck set, data and command frames requesting an acknowledgment
+ *   and addressed to this node are acknowledged from within ns-3 exactly
+ *   aTurnaroundTime (12 symbols) after their reception ended, and ACKs sent
+ *   by the node itself are dropped.
+ *
+ * The node's addresses are configured like radio registers (SetPanId,
+ * SetShortAddress, SetAddress).  Addresses that have not been configured are
+ * learned from the first frames the node sends.
+ */
 class SocketNullMac : public Object
 {
 public:
@@ -57,6 +80,50 @@ public:
    */
   void Enqueue (Ptr<const Packet> packet);
 
+  /**
+   * \param promiscuous true to deliver every received frame to the socket,
+   *        false to drop frames addressed to other nodes
+   */
+  void SetPromiscuous (bool promiscuous);
+
+  /**
+   * \returns true if every received frame is delivered to the socket
+   */
+  bool GetPromiscuous (void) const;
+
+  /**
+   * \param panId the PAN identifier of the node
+   */
+  void SetPanId (uint16_t panId);
+
+  /**
+   * \returns the PAN identifier of the node, 0xffff if unknown
+   */
+  uint16_t GetPanId (void) const;
+
+  /**
+   * \param address the short address of the node; 0xfffe means the node
+   *        only uses its extended address, 0xffff that the short address
+   *        is learned from the frames the node sends
+   */
+  void SetShortAddress (uint16_t address);
+
+  /**
+   * \returns the short address of the node, 0xffff if unknown
+   */
+  uint16_t GetShortAddress (void) const;
+
+  /**
+   * \param autoAck true to acknowledge frames addressed to the node from
+   *        within ns-3
+   */
+  void SetAutoAck (bool autoAck);
+
+  /**
+   * \returns true if frames are acknowledged from within ns-3
+   */
+  bool GetAutoAck (void) const;
+
   /**
    * \param phy the physical layer attached to this MAC.
    */
@@ -85,12 +152,36 @@ public:
   void Receive (Ptr<Packet> packet);
   
   /**
-   * Packet is forwarded through the socket and out of the ns-3 domain
+   * Packet is forwarded through the socket and out of the ns-3 domain.
+   * Without a bridge the packet only reaches the trace sources.
    */
   void ForwardUp (Ptr<Packet> packet);
 
   
 private:
+  /**
+   * Learn the addresses of the node that have not been configured from a
+   * frame it sends.
+   */
+  void LearnAddresses (const SocketFrame &frame);
+
+  /**
+   * \param frame a parsed frame
+   * \returns true if the frame is to be delivered to the node
+   */
+  bool IsForThisNode (const SocketFrame &frame) const;
+
+  /**
+   * \param frame a parsed frame
+   * \returns true if the frame is addressed to this node and not broadcast
+   */
+  bool IsUnicastToThisNode (const SocketFrame &frame) const;
+
+  /**
+   * Transmit an ACK frame for the given sequence number.
+   */
+  void SendAck (uint8_t sequence);
+
   /**
    * The trace source fired when packets come into the "top" of the device
    * at the L3/L2 transition, before being queued for transmission.
@@ -133,6 +224,14 @@ private:
    */
   TracedCallback<Ptr<const Packet> > m_macRxDropTrace;
 
+  /**
+   * The trace source fired for every frame sent or delivered by this device,
+   * like a non-promiscuous packet sniffer attached to the device.
+   *
+   * \see class CallBackTraceSource
+   */
+  TracedCallback<Ptr<const Packet> > m_snifferTrace;
+
   /**
    * Stores the MAC address assigned to this MAC layer
    */
@@ -148,6 +247,31 @@ private:
    */
   Ptr<SocketBridge> m_bridge;
 
+  /**
+   * Deliver every received frame
+   */
+  bool m_promiscuous;
+
+  /**
+   * Addresses learned from the frames sent by the node
+   */
+  bool m_panIdKnown;
+  uint16_t m_panId;
+  bool m_shortAddressKnown;
+  uint16_t m_shortAddress;
+  bool m_extendedAddressKnown;
+  uint64_t m_extendedAddress;
+
+  /**
+   * Acknowledge frames from within ns-3
+   */
+  bool m_autoAck;
+
+  /**
+   * Append a frame check sequence to generated ACKs, off to match the
+   * frames of the external processes, which carry none
+   */
+  bool m_ackFcs;
 
 };
 
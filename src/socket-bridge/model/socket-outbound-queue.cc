@@ -0,0 +1,92 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "socket-outbound-queue.h"
+
+namespace ns3 {
+
+const uint32_t SocketOutboundQueue::FRAMES;
+const uint32_t SocketOutboundQueue::LIMIT;
+
+SocketOutboundQueue::SocketOutboundQueue ()
+  : m_last (Seconds (0)),
+    m_interval (1e18)
+{
+}
+
+bool
+SocketOutboundQueue::AddFrame (Time now, const uint8_t *buf, uint32_t len)
+{
+  //
+  // Frames of one simulation time count as an interval of 0, so a dense
+  // cell quickly brings the average down and a quiet one brings it up.
+  //
+  m_interval += ((now - m_last).GetNanoSeconds () - m_interval) / 8;
+  m_last = now;
+
+  m_messages.insert (m_messages.end (), buf, buf + len);
+  return m_messages.size () >= LIMIT;
+}
+
+void
+SocketOutboundQueue::AddMessage (const uint8_t *buf, uint32_t len)
+{
+  m_messages.insert (m_messages.end (), buf, buf + len);
+}
+
+Time
+SocketOutboundQueue::GetDelay (Time window) const
+{
+  double ns = window.GetNanoSeconds ();
+  if (m_interval >= ns)
+    {
+      return Seconds (0);
+    }
+  double delay = m_interval * (FRAMES - 1);
+  return NanoSeconds ((int64_t)(delay < ns ? delay : ns));
+}
+
+bool
+SocketOutboundQueue::IsEmpty (void) const
+{
+  return m_messages.empty ();
+}
+
+const uint8_t *
+SocketOutboundQueue::GetData (void) const
+{
+  return m_messages.empty () ? 0 : &m_messages[0];
+}
+
+uint32_t
+SocketOutboundQueue::GetSize (void) const
+{
+  return m_messages.size ();
+}
+
+void
+SocketOutboundQueue::Clear (void)
+{
+  m_messages.clear ();
+}
+
+uint32_t
+SocketOutboundQueue::GetMemoryUsage (void) const
+{
+  return m_messages.capacity ();
+}
+
+} // namespace ns3
@@ -0,0 +1,114 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_OUTBOUND_QUEUE_H
+#define SOCKET_OUTBOUND_QUEUE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief The messages a SocketBridge gathers for its process, to be written
+ * to the socket together.
+ *
+ * Messages are kept in the order they are added.  The queue also keeps a
+ * moving average of the interval between the frames added, from which it
+ * tells how long the first frame should wait for others.  The bridge
+ * schedules and makes the write.
+ */
+class SocketOutboundQueue
+{
+public:
+  /**
+   * The number of frames the adaptive coalescing window is sized to gather
+   */
+  static const uint32_t FRAMES = 8;
+  /**
+   * The bytes of messages that are written without waiting further
+   */
+  static const uint32_t LIMIT = 4096;
+
+  SocketOutboundQueue ();
+
+  /**
+   * Append a data message and account for its time in the mean interval
+   * between frames.
+   *
+   * \param now the simulation time of the frame
+   * \param buf the message
+   * \param len the length of the message
+   * \returns true if LIMIT is reached and the queue should be written now
+   */
+  bool AddFrame (Time now, const uint8_t *buf, uint32_t len);
+
+  /**
+   * Append a control or time message, which does not count as a frame.
+   *
+   * \param buf the message
+   * \param len the length of the message
+   */
+  void AddMessage (const uint8_t *buf, uint32_t len);
+
+  /**
+   * \param window the longest time a frame may wait
+   * \returns the time to wait for more frames after the first one queued:
+   *          long enough for FRAMES frames at the mean interval between
+   *          frames, at most window, and none if not even one more frame is
+   *          expected within the window.
+   */
+  Time GetDelay (Time window) const;
+
+  /**
+   * \returns true if no message is queued
+   */
+  bool IsEmpty (void) const;
+
+  /**
+   * \returns the queued messages, valid until the next call to a non-const
+   *          method
+   */
+  const uint8_t *GetData (void) const;
+
+  /**
+   * \returns the bytes of queued messages
+   */
+  uint32_t GetSize (void) const;
+
+  /**
+   * Drop the queued messages once written.  The mean interval is kept.
+   */
+  void Clear (void);
+
+  /**
+   * \returns the bytes of heap held by the queue
+   */
+  uint32_t GetMemoryUsage (void) const;
+
+private:
+  std::vector<uint8_t> m_messages;
+  Time m_last;
+  double m_interval;
+};
+
+} // namespace ns3
+
+#endif /* SOCKET_OUTBOUND_QUEUE_H */
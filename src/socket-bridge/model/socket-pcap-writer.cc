@@ -0,0 +1,363 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sstream>
+#include <iomanip>
+
+#include "socket-pcap-writer.h"
+
+NS_LOG_COMPONENT_DEFINE ("SocketPcapWriter");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (SocketPcapWriter);
+
+const uint32_t SocketPcapWriter::LINKTYPE_IEEE802_15_4_NOFCS;
+const uint32_t SocketPcapWriter::SNAPLEN;
+
+TypeId
+SocketPcapWriter::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SocketPcapWriter")
+    .SetParent<Object> ()
+    .AddConstructor<SocketPcapWriter> ()
+    .AddAttribute ("QueueSize",
+                   "The number of frames that can be waiting for the writer thread.",
+                   UintegerValue (65536),
+                   MakeUintegerAccessor (&SocketPcapWriter::m_queueSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("BufferSize",
+                   "The size in bytes of the write buffer of each file.",
+                   UintegerValue (1 << 20),
+                   MakeUintegerAccessor (&SocketPcapWriter::m_bufferSize),
+                   MakeUintegerChecker<uint32_t> (4096))
+    .AddAttribute ("RotateSize",
+                   "Start a new file once a file reaches this many bytes (0 disables rotation).",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&SocketPcapWriter::m_rotateSize),
+                   MakeUintegerChecker<uint64_t> ())
+  ;
+  return tid;
+}
+
+SocketPcapWriter::SocketPcapWriter ()
+  : m_queue (0),
+    m_thread (0),
+    m_running (false),
+    m_drops (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+SocketPcapWriter::~SocketPcapWriter ()
+{
+  NS_LOG_FUNCTION (this);
+  Close ();
+}
+
+void
+SocketPcapWriter::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Close ();
+  Object::DoDispose ();
+}
+
+Ptr<SocketPcapFile>
+SocketPcapWriter::CreateFile (std::string name)
+{
+  NS_LOG_FUNCTION (this << name);
+
+  if (m_queue == 0)
+    {
+      m_queue = new SocketMpscQueue<Record> (m_queueSize);
+    }
+
+  uint32_t id;
+  {
+    CriticalSection cs (m_filesMutex);
+    File file;
+    file.name = name;
+    file.fp = 0;
+    file.buffer = (char *)malloc (m_bufferSize);
+    NS_ABORT_MSG_IF (file.buffer == 0, "malloc() failed");
+    file.bytes = 0;
+    file.index = 0;
+    OpenFile (file);
+    id = m_files.size ();
+    m_files.push_back (file);
+  }
+
+  if (!m_running)
+    {
+      m_running = true;
+      m_thread = Create<SystemThread> (MakeCallback (&SocketPcapWriter::Run, this));
+      m_thread->Start ();
+    }
+
+  return CreateObject<SocketPcapFile> (this, id);
+}
+
+void
+SocketPcapWriter::Close (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_running)
+    {
+      m_running = false;
+      m_thread->Join ();
+      m_thread = 0;
+    }
+
+  for (std::vector<File>::iterator i = m_files.begin (); i != m_files.end (); ++i)
+    {
+      CloseFile (*i);
+      free (i->buffer);
+      i->buffer = 0;
+    }
+  m_files.clear ();
+
+  if (m_drops)
+    {
+      NS_LOG_WARN ("SocketPcapWriter dropped " << m_drops << " frames, consider a larger QueueSize");
+    }
+
+  delete m_queue;
+  m_queue = 0;
+}
+
+void
+SocketPcapWriter::PrepareFork (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_running)
+    {
+      m_running = false;
+      m_thread->Join ();
+      m_thread = 0;
+    }
+  for (std::vector<File>::iterator i = m_files.begin (); i != m_files.end (); ++i)
+    {
+      fflush (i->fp);
+    }
+}
+
+void
+SocketPcapWriter::CompleteFork (std::string suffix)
+{
+  NS_LOG_FUNCTION (this << suffix);
+
+  if (!suffix.empty ())
+    {
+      //
+      // The inherited streams share their file offsets with the original
+      // process.  Nothing is buffered after PrepareFork, so closing them
+      // writes nothing.
+      //
+      for (std::vector<File>::iterator i = m_files.begin (); i != m_files.end (); ++i)
+        {
+          CloseFile (*i);
+          i->name += suffix;
+          i->index = 0;
+          OpenFile (*i);
+        }
+    }
+  if (!m_files.empty () && !m_running)
+    {
+      m_running = true;
+      m_thread = Create<SystemThread> (MakeCallback (&SocketPcapWriter::Run, this));
+      m_thread->Start ();
+    }
+}
+
+uint64_t
+SocketPcapWriter::GetDrops (void) const
+{
+  return m_drops;
+}
+
+void
+SocketPcapWriter::Enqueue (uint32_t file, Ptr<const Packet> packet)
+{
+  if (!m_running)
+    {
+      return;
+    }
+
+  Record record;
+  record.file = file;
+  record.origLen = packet->GetSize ();
+  record.capLen = record.origLen < SNAPLEN ? record.origLen : SNAPLEN;
+  record.timeUs = Simulator::Now ().GetMicroSeconds ();
+  packet->CopyData (record.data, record.capLen);
+
+  if (!m_queue->Push (record))
+    {
+      __sync_fetch_and_add (&m_drops, 1);
+    }
+}
+
+void
+SocketPcapWriter::Run (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Record record;
+  for (;;)
+    {
+      //
+      // Sample the flag before draining so that every record queued before
+      // Close is written out.
+      //
+      bool running = m_running;
+      __sync_synchronize ();
+
+      uint32_t n = 0;
+      {
+        CriticalSection cs (m_filesMutex);
+        while (m_queue->Pop (record))
+          {
+            WriteRecord (record);
+            n++;
+          }
+      }
+
+      if (n == 0)
+        {
+          if (!running)
+            {
+              break;
+            }
+          usleep (1000);
+        }
+    }
+}
+
+void
+SocketPcapWriter::WriteRecord (const Record &record)
+{
+  File &file = m_files[record.file];
+
+  if (m_rotateSize && file.bytes > 24 && file.bytes + 16 + record.capLen > m_rotateSize)
+    {
+      CloseFile (file);
+      file.index++;
+      OpenFile (file);
+    }
+
+  uint32_t header[4];
+  header[0] = record.timeUs / 1000000;
+  header[1] = record.timeUs % 1000000;
+  header[2] = record.capLen;
+  header[3] = record.origLen;
+  fwrite (header, sizeof (header), 1, file.fp);
+  fwrite (record.data, record.capLen, 1, file.fp);
+  file.bytes += sizeof (header) + record.capLen;
+}
+
+void
+SocketPcapWriter::OpenFile (File &file)
+{
+  std::ostringstream oss;
+  oss << file.name;
+  if (m_rotateSize)
+    {
+      oss << "-" << std::setw (3) << std::setfill ('0') << file.index;
+    }
+  oss << ".pcap";
+
+  file.fp = fopen (oss.str ().c_str (), "wb");
+  NS_ABORT_MSG_IF (file.fp == 0, "SocketPcapWriter::OpenFile(): cannot open " << oss.str () << ", errno = " << strerror (errno));
+  setvbuf (file.fp, file.buffer, _IOFBF, m_bufferSize);
+
+  /* PCAP global header, host byte order */
+  uint32_t magic = 0xa1b2c3d4;
+  uint16_t version[2] = { 2, 4 };
+  int32_t thiszone = 0;
+  uint32_t sigfigs = 0;
+  uint32_t snaplen = SNAPLEN;
+  uint32_t network = LINKTYPE_IEEE802_15_4_NOFCS;
+  fwrite (&magic, sizeof (magic), 1, file.fp);
+  fwrite (version, sizeof (version), 1, file.fp);
+  fwrite (&thiszone, sizeof (thiszone), 1, file.fp);
+  fwrite (&sigfigs, sizeof (sigfigs), 1, file.fp);
+  fwrite (&snaplen, sizeof (snaplen), 1, file.fp);
+  fwrite (&network, sizeof (network), 1, file.fp);
+  file.bytes = 24;
+}
+
+void
+SocketPcapWriter::CloseFile (File &file)
+{
+  if (file.fp != 0)
+    {
+      fclose (file.fp);
+      file.fp = 0;
+    }
+}
+
+NS_OBJECT_ENSURE_REGISTERED (SocketPcapFile);
+
+TypeId
+SocketPcapFile::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SocketPcapFile")
+    .SetParent<Object> ()
+  ;
+  return tid;
+}
+
+SocketPcapFile::SocketPcapFile ()
+  : m_writer (0),
+    m_file (0)
+{
+}
+
+SocketPcapFile::SocketPcapFile (Ptr<SocketPcapWriter> writer, uint32_t file)
+  : m_writer (writer),
+    m_file (file)
+{
+}
+
+SocketPcapFile::~SocketPcapFile ()
+{
+}
+
+void
+SocketPcapFile::DoDispose (void)
+{
+  m_writer = 0;
+  Object::DoDispose ();
+}
+
+void
+SocketPcapFile::Write (Ptr<const Packet> packet)
+{
+  m_writer->Enqueue (m_file, packet);
+}
+
+} // namespace ns3
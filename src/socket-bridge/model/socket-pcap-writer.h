@@ -0,0 +1,186 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_PCAP_WRITER_H
+#define SOCKET_PCAP_WRITER_H
+
+#include "ns3/object.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/system-thread.h"
+#include "ns3/system-mutex.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "socket-mpsc-queue.h"
+
+namespace ns3 {
+
+class SocketPcapFile;
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Writes 802.15.4 frames to PCAP files from a background thread.
+ *
+ * Trace sinks running in the simulator thread only copy the frame into a
+ * fixed-size record and push it onto a lock-free queue; they never block
+ * and never touch the file system.  A single writer thread shared by all
+ * files of this writer drains the queue into large stdio buffers.  When the
+ * queue is full the record is dropped and counted rather than stalling the
+ * realtime loop.
+ *
+ * Files are written with LINKTYPE_IEEE802_15_4_NOFCS, since the frames
+ * exchanged with the external processes carry no FCS, and can optionally be
+ * rotated once they reach a given size.
+ */
+class SocketPcapWriter : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * PCAP link type for IEEE 802.15.4 frames without the FCS
+   */
+  static const uint32_t LINKTYPE_IEEE802_15_4_NOFCS = 230;
+
+  /**
+   * Largest frame captured, the 802.15.4 aMaxPHYPacketSize plus one byte
+   */
+  static const uint32_t SNAPLEN = 128;
+
+  SocketPcapWriter ();
+  virtual ~SocketPcapWriter ();
+
+  /**
+   * \param name the file name without the .pcap extension
+   * \returns a file whose Write method can be connected to a packet trace source
+   *
+   * The writer thread is started with the first file.
+   */
+  Ptr<SocketPcapFile> CreateFile (std::string name);
+
+  /**
+   * Flush and close all files and stop the writer thread.  Frames queued
+   * before the call are written out.
+   */
+  void Close (void);
+
+  /**
+   * Write out the queued frames and stop the writer thread before ns-3
+   * forks (see SocketBridgeHelper::Fork).  Frames enqueued until
+   * CompleteFork are dropped.
+   */
+  void PrepareFork (void);
+
+  /**
+   * Start the writer thread again after ns-3 forked.
+   *
+   * \param suffix empty in the original process; in a forked run, appended
+   *        to the names of all files, which are then written anew so that
+   *        the runs do not share them
+   */
+  void CompleteFork (std::string suffix);
+
+  /**
+   * \returns the number of frames dropped because the queue was full
+   */
+  uint64_t GetDrops (void) const;
+
+  /**
+   * \internal
+   *
+   * Queue a frame for the given file.  Called by SocketPcapFile.
+   */
+  void Enqueue (uint32_t file, Ptr<const Packet> packet);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  struct Record
+  {
+    uint32_t file;
+    uint32_t origLen;
+    uint32_t capLen;
+    int64_t timeUs;
+    uint8_t data[SNAPLEN];
+  };
+
+  struct File
+  {
+    std::string name;
+    FILE *fp;
+    char *buffer;
+    uint64_t bytes;
+    uint32_t index;
+  };
+
+  void Run (void);
+  void WriteRecord (const Record &record);
+  void OpenFile (File &file);
+  void CloseFile (File &file);
+
+  SocketMpscQueue<Record> *m_queue;
+  std::vector<File> m_files;
+  SystemMutex m_filesMutex;
+  Ptr<SystemThread> m_thread;
+  volatile bool m_running;
+  volatile uint64_t m_drops;
+
+  uint32_t m_queueSize;
+  uint32_t m_bufferSize;
+  uint64_t m_rotateSize;
+};
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief A PCAP file written by a SocketPcapWriter.
+ *
+ * Connect Write to a trace source with a Ptr<const Packet> signature, e.g.
+ * the Sniffer trace source of SocketNullMac or the Tx trace source of
+ * SocketChannel.
+ */
+class SocketPcapFile : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  SocketPcapFile ();
+  SocketPcapFile (Ptr<SocketPcapWriter> writer, uint32_t file);
+  virtual ~SocketPcapFile ();
+
+  /**
+   * \param packet the frame to capture
+   */
+  void Write (Ptr<const Packet> packet);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  Ptr<SocketPcapWriter> m_writer;
+  uint32_t m_file;
+};
+
+} // namespace ns3
+
+#endif /* SOCKET_PCAP_WRITER_H */
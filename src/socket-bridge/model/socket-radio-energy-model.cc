@@ -0,0 +1,252 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "socket-radio-energy-model.h"
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/double.h"
+#include "ns3/trace-source-accessor.h"
+
+NS_LOG_COMPONENT_DEFINE ("SocketRadioEnergyModel");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (SocketRadioEnergyModel);
+
+const uint32_t SocketRadioEnergyModel::MODES;
+const uint32_t SocketRadioEnergyModel::STATES;
+
+/*
+ * Currents in ampere per PhyMode, in the order of SocketContikiPhy::State:
+ * IDLE, TX, RX, SLEEP.  IDLE is the radio on and listening for a preamble,
+ * so it draws the receive current; the radio only leaves it for SLEEP when
+ * turned off.
+ */
+static const double g_defaultCurrentA[4][4] = {
+  /* DSSS_BPSK, AT86RF212: RX_ON, TX at +5 dBm, RX_ON, SLEEP */
+  { 0.0092, 0.018, 0.0092, 0.0000002 },
+  /* DSSS_O_QPSK_MHz, AT86RF212 */
+  { 0.0092, 0.018, 0.0092, 0.0000002 },
+  /* DSSS_O_QPSK_GHz, CC2420: RX, TX at 0 dBm, RX, power down */
+  { 0.0188, 0.0174, 0.0188, 0.00000002 },
+  /* PSSS_ASK, AT86RF212 */
+  { 0.0092, 0.018, 0.0092, 0.0000002 }
+};
+
+TypeId
+SocketRadioEnergyModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SocketRadioEnergyModel")
+    .SetParent<DeviceEnergyModel> ()
+    .AddConstructor<SocketRadioEnergyModel> ()
+    .AddAttribute ("SupplyVoltage",
+                   "The supply voltage in volt used when no energy source is set.",
+                   DoubleValue (3.0),
+                   MakeDoubleAccessor (&SocketRadioEnergyModel::m_supplyVoltage),
+                   MakeDoubleChecker<double> (0.0))
+    .AddTraceSource ("TotalEnergyConsumption",
+                     "The energy consumed by the radio up to its last state change in joule.",
+                     MakeTraceSourceAccessor (&SocketRadioEnergyModel::m_totalEnergy))
+  ;
+  return tid;
+}
+
+SocketRadioEnergyModel::SocketRadioEnergyModel ()
+  : m_supplyVoltage (3.0),
+    m_mode (SocketContikiPhy::DSSS_O_QPSK_GHz),
+    m_state (SocketContikiPhy::IDLE),
+    m_totalEnergy (0.0)
+{
+  NS_LOG_FUNCTION (this);
+  for (uint32_t mode = 0; mode < MODES; mode++)
+    {
+      for (uint32_t state = 0; state < STATES; state++)
+        {
+          m_currentA[mode][state] = g_defaultCurrentA[mode][state];
+        }
+    }
+  for (uint32_t state = 0; state < STATES; state++)
+    {
+      m_stateEnergy[state] = 0;
+    }
+}
+
+SocketRadioEnergyModel::~SocketRadioEnergyModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+SocketRadioEnergyModel::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_phy = 0;
+  m_source = 0;
+  m_energyDepletionCallback = MakeNullCallback<void> ();
+  DeviceEnergyModel::DoDispose ();
+}
+
+void
+SocketRadioEnergyModel::SetPhy (Ptr<SocketContikiPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  NS_ASSERT (m_phy == 0);
+  m_phy = phy;
+  m_mode = phy->GetMode ();
+  m_state = phy->GetState ();
+  m_lastUpdate = Simulator::Now ();
+  phy->TraceConnectWithoutContext ("PhyState", MakeCallback (&SocketRadioEnergyModel::NotifyStateChange, this));
+  phy->TraceConnectWithoutContext ("PhyMode", MakeCallback (&SocketRadioEnergyModel::NotifyModeChange, this));
+}
+
+Ptr<SocketContikiPhy>
+SocketRadioEnergyModel::GetPhy (void) const
+{
+  return m_phy;
+}
+
+void
+SocketRadioEnergyModel::SetCurrents (SocketContikiPhy::PhyMode mode, double txA, double rxA, double idleA, double sleepA)
+{
+  NS_LOG_FUNCTION (this << mode << txA << rxA << idleA << sleepA);
+  NS_ASSERT (mode < MODES);
+  /* Account for the current state with the old currents first */
+  ChangeState (m_state);
+  m_currentA[mode][SocketContikiPhy::TX] = txA;
+  m_currentA[mode][SocketContikiPhy::RX] = rxA;
+  m_currentA[mode][SocketContikiPhy::IDLE] = idleA;
+  m_currentA[mode][SocketContikiPhy::SLEEP] = sleepA;
+}
+
+double
+SocketRadioEnergyModel::GetStateCurrentA (SocketContikiPhy::State state) const
+{
+  NS_ASSERT (state < STATES);
+  uint32_t mode = m_phy != 0 ? m_phy->GetMode () : SocketContikiPhy::DSSS_O_QPSK_GHz;
+  return m_currentA[mode][state];
+}
+
+Time
+SocketRadioEnergyModel::GetStateTime (SocketContikiPhy::State state) const
+{
+  NS_ASSERT (state < STATES);
+  if (state == m_state)
+    {
+      return m_stateTime[state] + (Simulator::Now () - m_lastUpdate);
+    }
+  return m_stateTime[state];
+}
+
+double
+SocketRadioEnergyModel::GetStateEnergy (SocketContikiPhy::State state) const
+{
+  NS_ASSERT (state < STATES);
+  if (state == m_state)
+    {
+      return m_stateEnergy[state] + GetPendingEnergy ();
+    }
+  return m_stateEnergy[state];
+}
+
+void
+SocketRadioEnergyModel::SetEnergyDepletionCallback (EnergyDepletionCallback callback)
+{
+  m_energyDepletionCallback = callback;
+}
+
+void
+SocketRadioEnergyModel::SetEnergySource (Ptr<EnergySource> source)
+{
+  NS_LOG_FUNCTION (this << source);
+  ChangeState (m_state);
+  m_source = source;
+}
+
+double
+SocketRadioEnergyModel::GetTotalEnergyConsumption (void) const
+{
+  return m_totalEnergy + GetPendingEnergy ();
+}
+
+void
+SocketRadioEnergyModel::ChangeState (int newState)
+{
+  NS_LOG_FUNCTION (this << newState);
+  NS_ASSERT (newState >= 0 && (uint32_t)newState < STATES);
+
+  double energy = GetPendingEnergy ();
+  m_stateTime[m_state] += Simulator::Now () - m_lastUpdate;
+  m_stateEnergy[m_state] += energy;
+  m_totalEnergy += energy;
+  m_lastUpdate = Simulator::Now ();
+  m_state = (SocketContikiPhy::State)newState;
+  if (m_phy != 0)
+    {
+      m_mode = m_phy->GetMode ();
+    }
+
+  if (m_source != 0)
+    {
+      /* The source integrates the previous current and picks up the new one */
+      m_source->UpdateEnergySource ();
+    }
+}
+
+void
+SocketRadioEnergyModel::HandleEnergyDepletion (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_LOG_DEBUG ("energy depleted at " << Simulator::Now ());
+  if (!m_energyDepletionCallback.IsNull ())
+    {
+      m_energyDepletionCallback ();
+    }
+}
+
+double
+SocketRadioEnergyModel::DoGetCurrentA (void) const
+{
+  return m_currentA[m_mode][m_state];
+}
+
+void
+SocketRadioEnergyModel::NotifyStateChange (SocketContikiPhy::State oldState, SocketContikiPhy::State newState)
+{
+  ChangeState (newState);
+}
+
+void
+SocketRadioEnergyModel::NotifyModeChange (SocketContikiPhy::PhyMode oldMode, SocketContikiPhy::PhyMode newMode)
+{
+  /* Bill the time so far at the currents of the old mode */
+  ChangeState (m_state);
+}
+
+double
+SocketRadioEnergyModel::GetPendingEnergy (void) const
+{
+  Time duration = Simulator::Now () - m_lastUpdate;
+  return duration.GetSeconds () * DoGetCurrentA () * GetSupplyVoltage ();
+}
+
+double
+SocketRadioEnergyModel::GetSupplyVoltage (void) const
+{
+  return m_source != 0 ? m_source->GetSupplyVoltage () : m_supplyVoltage;
+}
+
+} // namespace ns3
@@ -0,0 +1,158 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_RADIO_ENERGY_MODEL_H
+#define SOCKET_RADIO_ENERGY_MODEL_H
+
+#include "ns3/device-energy-model.h"
+#include "ns3/energy-source.h"
+#include "ns3/nstime.h"
+#include "ns3/callback.h"
+#include "ns3/traced-value.h"
+
+#include "socket-contiki-phy.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief A DeviceEnergyModel for the radio of a SocketContikiPhy.
+ *
+ * The model follows the PhyState and PhyMode trace sources of the PHY and
+ * draws the current of the PHY state from a table per
+ * SocketContikiPhy::PhyMode.  The energy of a state is integrated when the
+ * PHY leaves it or changes mode, so no event is scheduled however long the
+ * simulation runs.  The defaults are typical datasheet values of a CC2420
+ * for DSSS_O_QPSK_GHz and of an AT86RF212 for the sub-GHz modes; SetCurrents
+ * replaces them.  IDLE is the radio listening, which draws the receive
+ * current of the transceiver.
+ *
+ * With an EnergySource the supply voltage comes from the source, which is
+ * notified of every state change.  Without one the SupplyVoltage attribute
+ * is used and the model only accounts.
+ */
+class SocketRadioEnergyModel : public DeviceEnergyModel
+{
+public:
+  /**
+   * Callback invoked when the energy source is depleted.
+   */
+  typedef Callback<void> EnergyDepletionCallback;
+
+  static TypeId GetTypeId (void);
+
+  SocketRadioEnergyModel ();
+  virtual ~SocketRadioEnergyModel ();
+
+  /**
+   * Follow the state of a PHY, starting from its current state.
+   *
+   * \param phy the PHY whose radio is modelled
+   */
+  void SetPhy (Ptr<SocketContikiPhy> phy);
+
+  /**
+   * \returns the PHY whose radio is modelled
+   */
+  Ptr<SocketContikiPhy> GetPhy (void) const;
+
+  /**
+   * Replace the currents drawn in a mode.
+   *
+   * \param mode the PHY mode
+   * \param txA the current in TX in ampere
+   * \param rxA the current in RX in ampere
+   * \param idleA the current in IDLE in ampere
+   * \param sleepA the current in SLEEP in ampere
+   */
+  void SetCurrents (SocketContikiPhy::PhyMode mode, double txA, double rxA, double idleA, double sleepA);
+
+  /**
+   * \param state a PHY state
+   * \returns the current drawn in that state in the current mode of the PHY
+   */
+  double GetStateCurrentA (SocketContikiPhy::State state) const;
+
+  /**
+   * \param state a PHY state
+   * \returns the time spent in that state so far
+   */
+  Time GetStateTime (SocketContikiPhy::State state) const;
+
+  /**
+   * \param state a PHY state
+   * \returns the energy consumed in that state so far in joule
+   */
+  double GetStateEnergy (SocketContikiPhy::State state) const;
+
+  /**
+   * \param callback invoked when the energy source is depleted
+   */
+  void SetEnergyDepletionCallback (EnergyDepletionCallback callback);
+
+  // Inherited from DeviceEnergyModel
+  virtual void SetEnergySource (Ptr<EnergySource> source);
+  virtual double GetTotalEnergyConsumption (void) const;
+  virtual void ChangeState (int newState);
+  virtual void HandleEnergyDepletion (void);
+
+private:
+  virtual void DoDispose (void);
+  virtual double DoGetCurrentA (void) const;
+
+  /**
+   * Sink of the PhyState trace source of the PHY.
+   */
+  void NotifyStateChange (SocketContikiPhy::State oldState, SocketContikiPhy::State newState);
+
+  /**
+   * Sink of the PhyMode trace source of the PHY.
+   */
+  void NotifyModeChange (SocketContikiPhy::PhyMode oldMode, SocketContikiPhy::PhyMode newMode);
+
+  /**
+   * \returns the energy consumed since the last state change in joule
+   */
+  double GetPendingEnergy (void) const;
+
+  double GetSupplyVoltage (void) const;
+
+  static const uint32_t MODES = 4;
+  static const uint32_t STATES = 4;
+
+  Ptr<SocketContikiPhy> m_phy;
+  Ptr<EnergySource> m_source;
+  double m_supplyVoltage;
+  double m_currentA[MODES][STATES];
+  /**
+   * The mode the time since the last update is billed at.
+   */
+  SocketContikiPhy::PhyMode m_mode;
+  SocketContikiPhy::State m_state;
+  Time m_lastUpdate;
+  Time m_stateTime[STATES];
+  double m_stateEnergy[STATES];
+  /**
+   * The energy consumed up to the last state change in joule.
+   */
+  TracedValue<double> m_totalEnergy;
+  EnergyDepletionCallback m_energyDepletionCallback;
+};
+
+} // namespace ns3
+
+#endif /* SOCKET_RADIO_ENERGY_MODEL_H */
@@ -0,0 +1,232 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/realtime-simulator-impl.h"
+#include "ns3/boolean.h"
+#include "ns3/trace-source-accessor.h"
+
+#include <algorithm>
+
+#include "socket-realtime-monitor.h"
+#include "socket-bridge.h"
+
+NS_LOG_COMPONENT_DEFINE ("SocketRealtimeMonitor");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (SocketRealtimeMonitor);
+
+TypeId
+SocketRealtimeMonitor::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SocketRealtimeMonitor")
+    .SetParent<Object> ()
+    .AddConstructor<SocketRealtimeMonitor> ()
+    .AddAttribute ("Interval",
+                   "The time between two samples.",
+                   TimeValue (MilliSeconds (10)),
+                   MakeTimeAccessor (&SocketRealtimeMonitor::m_interval),
+                   MakeTimeChecker ())
+    .AddAttribute ("LagThreshold",
+                   "The lag behind the wall clock above which the simulation is overloaded.",
+                   TimeValue (MilliSeconds (10)),
+                   MakeTimeAccessor (&SocketRealtimeMonitor::m_threshold),
+                   MakeTimeChecker ())
+    .AddAttribute ("ShedLoad",
+                   "Drop frames read by the bridges while the simulation is overloaded.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&SocketRealtimeMonitor::m_shedLoad),
+                   MakeBooleanChecker ())
+    .AddTraceSource ("Sample",
+                     "The lag behind the wall clock and the frames pending in all bridges.",
+                     MakeTraceSourceAccessor (&SocketRealtimeMonitor::m_sampleTrace))
+    .AddTraceSource ("Overload",
+                     "The simulation has become overloaded (true) or has recovered (false).",
+                     MakeTraceSourceAccessor (&SocketRealtimeMonitor::m_overloadTrace))
+  ;
+  return tid;
+}
+
+SocketRealtimeMonitor::SocketRealtimeMonitor ()
+  : m_realtime (false),
+    m_overloaded (false),
+    m_lag (Seconds (0)),
+    m_samples (0),
+    m_overloadSamples (0),
+    m_overloads (0),
+    m_pendingSum (0),
+    m_pendingMax (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+SocketRealtimeMonitor::~SocketRealtimeMonitor ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+SocketRealtimeMonitor::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Stop ();
+  m_bridges.clear ();
+  Object::DoDispose ();
+}
+
+void
+SocketRealtimeMonitor::AddBridge (Ptr<SocketBridge> bridge)
+{
+  NS_LOG_FUNCTION (this << bridge);
+  m_bridges.push_back (bridge);
+}
+
+void
+SocketRealtimeMonitor::Start (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_realtime = (DynamicCast<RealtimeSimulatorImpl> (Simulator::GetImplementation ()) != 0);
+  if (!m_realtime)
+    {
+      NS_LOG_WARN ("SocketRealtimeMonitor::Start(): not a realtime simulation, only sampling pending frames");
+    }
+  m_sampleEvent.Cancel ();
+  m_sampleEvent = Simulator::ScheduleNow (&SocketRealtimeMonitor::Sample, this);
+}
+
+void
+SocketRealtimeMonitor::Stop (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_sampleEvent.Cancel ();
+  SetOverloaded (false);
+}
+
+Time
+SocketRealtimeMonitor::GetLag (void) const
+{
+  return m_lag;
+}
+
+bool
+SocketRealtimeMonitor::IsOverloaded (void) const
+{
+  return m_overloaded;
+}
+
+void
+SocketRealtimeMonitor::Sample (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Time lag = m_lag;
+  if (m_realtime)
+    {
+      Ptr<RealtimeSimulatorImpl> impl = DynamicCast<RealtimeSimulatorImpl> (Simulator::GetImplementation ());
+      lag = impl->RealtimeNow () - Simulator::Now ();
+    }
+
+  uint32_t pending = 0;
+  for (std::vector<Ptr<SocketBridge> >::const_iterator i = m_bridges.begin (); i != m_bridges.end (); ++i)
+    {
+      pending += (*i)->GetPendingFrames ();
+    }
+
+  AddSample (lag, pending);
+  m_sampleEvent = Simulator::Schedule (m_interval, &SocketRealtimeMonitor::Sample, this);
+}
+
+void
+SocketRealtimeMonitor::AddSample (Time lag, uint32_t pending)
+{
+  NS_LOG_FUNCTION (this << lag << pending);
+
+  m_lag = lag;
+  m_samples++;
+  m_pendingSum += pending;
+  m_pendingMax = std::max (m_pendingMax, pending);
+  /* The simulation may run slightly ahead of the wall clock; that is no lag */
+  m_lagHistogram.Record (m_lag.IsStrictlyPositive () ? m_lag.GetNanoSeconds () : 0);
+  m_sampleTrace (m_lag, pending);
+
+  NS_LOG_LOGIC ("SocketRealtimeMonitor::AddSample(): lag " << m_lag << ", " << pending << " frames pending");
+
+  /* Leave the overloaded state with hysteresis so shedding does not flap */
+  if (m_lag > m_threshold)
+    {
+      SetOverloaded (true);
+    }
+  else if (m_lag < NanoSeconds (m_threshold.GetNanoSeconds () / 2))
+    {
+      SetOverloaded (false);
+    }
+  if (m_overloaded)
+    {
+      m_overloadSamples++;
+    }
+}
+
+void
+SocketRealtimeMonitor::SetOverloaded (bool overloaded)
+{
+  if (overloaded == m_overloaded)
+    {
+      return;
+    }
+  m_overloaded = overloaded;
+  if (overloaded)
+    {
+      m_overloads++;
+      NS_LOG_WARN ("SocketRealtimeMonitor: simulation lags " << m_lag << " behind the wall clock at " << Simulator::Now ());
+    }
+  if (m_shedLoad)
+    {
+      for (std::vector<Ptr<SocketBridge> >::const_iterator i = m_bridges.begin (); i != m_bridges.end (); ++i)
+        {
+          (*i)->SetShedLoad (overloaded);
+        }
+    }
+  m_overloadTrace (overloaded, m_lag);
+}
+
+void
+SocketRealtimeMonitor::PrintSummary (std::ostream &os) const
+{
+  uint64_t shed = 0;
+  for (std::vector<Ptr<SocketBridge> >::const_iterator i = m_bridges.begin (); i != m_bridges.end (); ++i)
+    {
+      shed += (*i)->GetShedFrames ();
+    }
+
+  os << "SocketRealtimeMonitor: " << m_samples << " samples of " << m_bridges.size () << " bridges";
+  if (!m_realtime)
+    {
+      os << " (not realtime)";
+    }
+  os << std::endl;
+  os << "  lag ns: ";
+  m_lagHistogram.Print (os);
+  os << std::endl;
+  os << "  overloaded " << m_overloads << " times for " << m_overloadSamples << " samples"
+     << " (threshold " << m_threshold << ")" << std::endl;
+  os << "  pending frames mean=" << (m_samples ? (double)m_pendingSum / m_samples : 0.0)
+     << " max=" << m_pendingMax << std::endl;
+  os << "  frames shed " << shed << std::endl;
+}
+
+} // namespace ns3
@@ -0,0 +1,146 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_REALTIME_MONITOR_H
+#define SOCKET_REALTIME_MONITOR_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/event-id.h"
+#include "ns3/traced-callback.h"
+
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+#include "socket-latency-histogram.h"
+
+namespace ns3 {
+
+class SocketBridge;
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Samples how far a realtime simulation lags behind the wall clock.
+ *
+ * Every Interval the monitor compares the wall clock of the
+ * RealtimeSimulatorImpl with the simulation time and sums the frames that
+ * the bridges have read from their sockets but not yet forwarded into the
+ * simulation.  Once the lag exceeds LagThreshold the simulation is
+ * overloaded: the Overload trace source fires and, with ShedLoad set, the
+ * bridges drop frames as they are read until the lag has fallen below half
+ * the threshold again.
+ *
+ * Under any other simulator implementation the lag is always zero and only
+ * the pending frames are sampled.
+ */
+class SocketRealtimeMonitor : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  SocketRealtimeMonitor ();
+  virtual ~SocketRealtimeMonitor ();
+
+  /**
+   * \param bridge a bridge whose pending frames are sampled and which sheds
+   *        load while the simulation is overloaded
+   */
+  void AddBridge (Ptr<SocketBridge> bridge);
+
+  /**
+   * Start sampling at the current simulation time.
+   */
+  void Start (void);
+
+  /**
+   * Stop sampling and stop shedding load.
+   */
+  void Stop (void);
+
+  /**
+   * Account for one sample: record it, fire the trace sources and enter or
+   * leave the overloaded state.  Called every Interval once started.
+   *
+   * \param lag the lag of the simulation behind the wall clock
+   * \param pending the frames pending in all bridges
+   */
+  void AddSample (Time lag, uint32_t pending);
+
+  /**
+   * \returns the lag of the last sample
+   */
+  Time GetLag (void) const;
+
+  /**
+   * \returns true while the lag is above the threshold
+   */
+  bool IsOverloaded (void) const;
+
+  /**
+   * Print the lag percentiles, the time spent overloaded, the pending
+   * frames and the frames shed by the bridges.
+   *
+   * \param os the output stream
+   */
+  void PrintSummary (std::ostream &os) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  void Sample (void);
+  void SetOverloaded (bool overloaded);
+
+  Time m_interval;
+  Time m_threshold;
+  bool m_shedLoad;
+
+  std::vector<Ptr<SocketBridge> > m_bridges;
+  EventId m_sampleEvent;
+  bool m_realtime;
+  bool m_overloaded;
+  Time m_lag;
+
+  SocketLatencyHistogram m_lagHistogram;
+  uint64_t m_samples;
+  uint64_t m_overloadSamples;
+  uint64_t m_overloads;
+  uint64_t m_pendingSum;
+  uint32_t m_pendingMax;
+
+  /**
+   * The trace source fired for every sample with the lag and the frames
+   * pending in all bridges.
+   *
+   * \see class CallBackTraceSource
+   */
+  TracedCallback<Time, uint32_t> m_sampleTrace;
+
+  /**
+   * The trace source fired when the simulation becomes overloaded (true) and
+   * when it has recovered (false), with the lag of the sample.
+   *
+   * \see class CallBackTraceSource
+   */
+  TracedCallback<bool, Time> m_overloadTrace;
+};
+
+} // namespace ns3
+
+#endif /* SOCKET_REALTIME_MONITOR_H */
@@ -0,0 +1,231 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+
+#include "ns3/abort.h"
+#include "ns3/log.h"
+#include "socket-replay-log.h"
+
+NS_LOG_COMPONENT_DEFINE ("SocketReplayLog");
+
+namespace ns3 {
+
+const uint8_t SocketReplayFormat::VERSION;
+const uint32_t SocketReplayFormat::HEADER_SIZE;
+const uint32_t SocketReplayFormat::MAX_RECORD;
+
+static const char MAGIC[4] = { 'S', 'B', 'R', 'L' };
+
+/* Large enough that appending is a memcpy most of the time */
+static const size_t LOG_BUFFER_SIZE = 65536;
+
+SocketRecordLog::SocketRecordLog ()
+  : m_fp (0),
+    m_lastNs (0),
+    m_records (0),
+    m_rejected (0)
+{
+}
+
+SocketRecordLog::~SocketRecordLog ()
+{
+  Close ();
+}
+
+bool
+SocketRecordLog::Open (std::string filename, uint8_t protocol, Mac64Address address)
+{
+  NS_LOG_FUNCTION (filename << (uint32_t)protocol << address);
+
+  Close ();
+  m_fp = fopen (filename.c_str (), "wb");
+  if (m_fp == 0)
+    {
+      return false;
+    }
+  setvbuf (m_fp, NULL, _IOFBF, LOG_BUFFER_SIZE);
+
+  uint8_t header[SocketReplayFormat::HEADER_SIZE];
+  memcpy (header, MAGIC, sizeof (MAGIC));
+  header[4] = SocketReplayFormat::VERSION;
+  header[5] = protocol;
+  address.CopyTo (header + 6);
+  fwrite (header, sizeof (header), 1, m_fp);
+  m_lastNs = 0;
+  m_records = 0;
+  m_rejected = 0;
+  return true;
+}
+
+void
+SocketRecordLog::PutVarint (uint64_t value)
+{
+  while (value >= 0x80)
+    {
+      putc ((value & 0x7f) | 0x80, m_fp);
+      value >>= 7;
+    }
+  putc (value, m_fp);
+}
+
+bool
+SocketRecordLog::Append (Time time, const uint8_t *buf, uint32_t len)
+{
+  if (len > SocketReplayFormat::MAX_RECORD)
+    {
+      NS_LOG_WARN ("SocketRecordLog::Append(): buffer of " << len << " bytes not recorded");
+      m_rejected++;
+      return false;
+    }
+  if (m_fp == 0)
+    {
+      return true;
+    }
+  int64_t ns = time.GetNanoSeconds ();
+  NS_ASSERT_MSG (ns >= m_lastNs, "SocketRecordLog::Append(): records out of order");
+  PutVarint (ns - m_lastNs);
+  PutVarint (len);
+  fwrite (buf, len, 1, m_fp);
+  m_lastNs = ns;
+  m_records++;
+  return true;
+}
+
+void
+SocketRecordLog::Close (void)
+{
+  if (m_fp != 0)
+    {
+      fclose (m_fp);
+      m_fp = 0;
+    }
+}
+
+uint64_t
+SocketRecordLog::GetRecords (void) const
+{
+  return m_records;
+}
+
+uint64_t
+SocketRecordLog::GetRejected (void) const
+{
+  return m_rejected;
+}
+
+SocketReplayLog::SocketReplayLog ()
+  : m_fp (0),
+    m_protocol (0),
+    m_lastNs (0)
+{
+}
+
+SocketReplayLog::~SocketReplayLog ()
+{
+  Close ();
+}
+
+bool
+SocketReplayLog::Open (std::string filename)
+{
+  NS_LOG_FUNCTION (filename);
+
+  Close ();
+  m_fp = fopen (filename.c_str (), "rb");
+  if (m_fp == 0)
+    {
+      return false;
+    }
+  setvbuf (m_fp, NULL, _IOFBF, LOG_BUFFER_SIZE);
+
+  uint8_t header[SocketReplayFormat::HEADER_SIZE];
+  if (fread (header, sizeof (header), 1, m_fp) != 1
+      || memcmp (header, MAGIC, sizeof (MAGIC)) != 0
+      || header[4] != SocketReplayFormat::VERSION)
+    {
+      NS_LOG_WARN ("SocketReplayLog::Open(): " << filename << " is not a replay log");
+      Close ();
+      return false;
+    }
+  m_protocol = header[5];
+  m_address.CopyFrom (header + 6);
+  m_lastNs = 0;
+  return true;
+}
+
+uint8_t
+SocketReplayLog::GetProtocol (void) const
+{
+  return m_protocol;
+}
+
+Mac64Address
+SocketReplayLog::GetAddress (void) const
+{
+  return m_address;
+}
+
+bool
+SocketReplayLog::GetVarint (uint64_t &value)
+{
+  value = 0;
+  for (uint32_t shift = 0; shift < 64; shift += 7)
+    {
+      int c = getc (m_fp);
+      if (c == EOF)
+        {
+          return false;
+        }
+      value |= (uint64_t)(c & 0x7f) << shift;
+      if ((c & 0x80) == 0)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+bool
+SocketReplayLog::Next (Time &time, uint8_t *buf, uint32_t &len)
+{
+  if (m_fp == 0)
+    {
+      return false;
+    }
+  uint64_t delta, length;
+  if (!GetVarint (delta) || !GetVarint (length) || length > SocketReplayFormat::MAX_RECORD
+      || fread (buf, 1, length, m_fp) != length)
+    {
+      return false;
+    }
+  m_lastNs += delta;
+  time = NanoSeconds (m_lastNs);
+  len = length;
+  return true;
+}
+
+void
+SocketReplayLog::Close (void)
+{
+  if (m_fp != 0)
+    {
+      fclose (m_fp);
+      m_fp = 0;
+    }
+}
+
+} // namespace ns3
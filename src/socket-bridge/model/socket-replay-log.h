@@ -0,0 +1,167 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOCKET_REPLAY_LOG_H
+#define SOCKET_REPLAY_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+#include "ns3/nstime.h"
+#include "ns3/mac64-address.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Format of the logs of frames read by a SocketBridge, written by
+ * SocketRecordLog and read by SocketReplayLog.
+ *
+ * A log starts with a header of HEADER_SIZE bytes: the magic "SBRL", the
+ * format version, the Protocol of the bridge and the extended address it
+ * was given.  Every record that follows is the simulation time elapsed
+ * since the previous record in nanoseconds and the length of the buffer,
+ * both as LEB128 varints, followed by the buffer exactly as read from the
+ * socket (a frame, or a message of socket-bridge-protocol.h).  A frame of
+ * 40 bytes read less than 2 ms after the previous one takes 44 bytes.
+ */
+class SocketReplayFormat
+{
+public:
+  static const uint8_t VERSION = 1;
+  static const uint32_t HEADER_SIZE = 14;
+  /**
+   * The largest buffer of a record
+   */
+  static const uint32_t MAX_RECORD = 257;
+};
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Appends the frames read by a SocketBridge to a log, for
+ * SocketReplayLog.
+ *
+ * Records are appended from the simulator thread through a stdio buffer,
+ * in order of simulation time.
+ */
+class SocketRecordLog
+{
+public:
+  SocketRecordLog ();
+  ~SocketRecordLog ();
+
+  /**
+   * Create the log and write its header.
+   *
+   * \param filename the log file name
+   * \param protocol the SocketBridge::Protocol of the buffers
+   * \param address the extended address of the bridge
+   * \returns false if the file cannot be created
+   */
+  bool Open (std::string filename, uint8_t protocol, Mac64Address address);
+
+  /**
+   * Buffers longer than MAX_RECORD bytes, which a RAW bridge without an
+   * ingress pool can read, are not recorded: they are counted by
+   * GetRejected instead.
+   *
+   * \param time the simulation time at which the buffer entered the simulation
+   * \param buf the buffer read from the socket
+   * \param len its length
+   * \returns false if the buffer is longer than MAX_RECORD bytes
+   */
+  bool Append (Time time, const uint8_t *buf, uint32_t len);
+
+  /**
+   * Flush and close the log.
+   */
+  void Close (void);
+
+  /**
+   * \returns the number of records appended
+   */
+  uint64_t GetRecords (void) const;
+
+  /**
+   * \returns the number of buffers too long to be recorded
+   */
+  uint64_t GetRejected (void) const;
+
+private:
+  void PutVarint (uint64_t value);
+
+  FILE *m_fp;
+  int64_t m_lastNs;
+  uint64_t m_records;
+  uint64_t m_rejected;
+};
+
+/**
+ * \ingroup socket-bridge
+ *
+ * \brief Reads back a log written by SocketRecordLog.
+ */
+class SocketReplayLog
+{
+public:
+  SocketReplayLog ();
+  ~SocketReplayLog ();
+
+  /**
+   * Open the log and read its header.
+   *
+   * \param filename the log file name
+   * \returns false if the file cannot be read or is not a log
+   */
+  bool Open (std::string filename);
+
+  /**
+   * \returns the SocketBridge::Protocol the log was recorded with
+   */
+  uint8_t GetProtocol (void) const;
+
+  /**
+   * \returns the extended address of the recorded bridge
+   */
+  Mac64Address GetAddress (void) const;
+
+  /**
+   * Read the next record.
+   *
+   * \param time set to the simulation time of the record
+   * \param buf a buffer of at least MAX_RECORD bytes
+   * \param len set to the length of the record
+   * \returns false at the end of the log, or if the last record is truncated
+   */
+  bool Next (Time &time, uint8_t *buf, uint32_t &len);
+
+  void Close (void);
+
+private:
+  bool GetVarint (uint64_t &value);
+
+  FILE *m_fp;
+  uint8_t m_protocol;
+  Mac64Address m_address;
+  int64_t m_lastNs;
+};
+
+} // namespace ns3
+
+#endif /* SOCKET_REPLAY_LOG_H */
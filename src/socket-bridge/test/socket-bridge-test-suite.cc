@@ -2,10 +2,33 @@
 
 // Include a header file from your module to test.
 #include "ns3/socket-bridge.h"
+#include "ns3/socket-bridge-helper.h"
+#include "ns3/socket-latency-histogram.h"
+#include "ns3/socket-realtime-monitor.h"
+#include "ns3/socket-buffer-pool.h"
+#include "ns3/socket-outbound-queue.h"
+#include "ns3/socket-bridge-inbox.h"
+#include "ns3/socket-io-service.h"
+#include "ns3/socket-replay-log.h"
+#include "ns3/socket-pcap-writer.h"
+#include "ns3/socket-event-trace.h"
+#include "ns3/socket-frame-parser.h"
+#include "ns3/socket-channel.h"
+#include "ns3/socket-channel-header.h"
+#include "ns3/socket-contiki-phy.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/constant-velocity-mobility-model.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/socket-radio-energy-model.h"
 
 // An essential include is test.h
 #include "ns3/test.h"
 
+#include <fstream>
+#include <sys/stat.h>
+
 // Do not put your test classes in namespace ns3.  You may find it useful
 // to use the using directive to access the ns3 namespace directly
 using namespace ns3;
@@ -46,6 +69,1578 @@ SocketBridgeTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+// Check that the latency histogram keeps percentiles within its 1/16 precision
+class SocketLatencyHistogramTestCase : public TestCase
+{
+public:
+  SocketLatencyHistogramTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SocketLatencyHistogramTestCase::SocketLatencyHistogramTestCase ()
+  : TestCase ("Check SocketLatencyHistogram percentiles")
+{
+}
+
+void
+SocketLatencyHistogramTestCase::DoRun (void)
+{
+  SocketLatencyHistogram histogram;
+  NS_TEST_ASSERT_MSG_EQ (histogram.GetCount (), 0, "empty histogram has values");
+  NS_TEST_ASSERT_MSG_EQ (histogram.GetPercentile (50), 0, "empty histogram has a median");
+
+  for (uint64_t value = 1; value <= 1000000; value++)
+    {
+      histogram.Record (value);
+    }
+  NS_TEST_ASSERT_MSG_EQ (histogram.GetCount (), 1000000, "values lost");
+  NS_TEST_ASSERT_MSG_EQ (histogram.GetMin (), 1, "wrong minimum");
+  NS_TEST_ASSERT_MSG_EQ (histogram.GetMax (), 1000000, "wrong maximum");
+  NS_TEST_ASSERT_MSG_EQ_TOL (histogram.GetMean (), 500000.5, 0.1, "wrong mean");
+  NS_TEST_ASSERT_MSG_EQ_TOL (histogram.GetPercentile (50), 500000, 500000 / 16, "median out of precision");
+  NS_TEST_ASSERT_MSG_EQ_TOL (histogram.GetPercentile (99), 990000, 990000 / 16, "p99 out of precision");
+
+  for (uint64_t value = 0; value < 16; value++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (SocketLatencyHistogram::GetLowestValue (SocketLatencyHistogram::GetIndex (value)), value,
+                             "small values are not exact");
+    }
+
+  SocketLatencyHistogram other;
+  other.Record (5000000);
+  histogram.Merge (other);
+  NS_TEST_ASSERT_MSG_EQ (histogram.GetCount (), 1000001, "merge lost values");
+  NS_TEST_ASSERT_MSG_EQ (histogram.GetMax (), 5000000, "merge lost maximum");
+}
+
+// Check that 802.15.4 headers and 6LoWPAN dispatches are parsed correctly
+class SocketFrameParserTestCase : public TestCase
+{
+public:
+  SocketFrameParserTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SocketFrameParserTestCase::SocketFrameParserTestCase ()
+  : TestCase ("Check SocketFrameParser")
+{
+}
+
+void
+SocketFrameParserTestCase::DoRun (void)
+{
+  SocketFrame frame;
+
+  // Data, PAN ID compression, short addresses, IPHC
+  const uint8_t shortIphc[] = { 0x41, 0x88, 0x01, 0xcd, 0xab, 0x02, 0x00, 0x01, 0x00, 0x7a, 0x33 };
+  NS_TEST_ASSERT_MSG_EQ (SocketFrameParser::Parse (shortIphc, sizeof (shortIphc), frame), true, "valid frame rejected");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)frame.frameType, (uint32_t)SocketFrame::DATA, "wrong frame type");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)frame.sequence, 1, "wrong sequence number");
+  NS_TEST_ASSERT_MSG_EQ (frame.srcPan, 0xabcd, "source PAN not taken from destination PAN");
+  NS_TEST_ASSERT_MSG_EQ (frame.headerLength, 9, "wrong header length");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)frame.dispatch, (uint32_t)SocketFrame::DISPATCH_IPHC, "wrong dispatch");
+  NS_TEST_ASSERT_MSG_EQ (SocketFrameParser::GetProtocol (frame), 0x86DD, "IPHC is not IPv6");
+  NS_TEST_ASSERT_MSG_EQ (SocketFrameParser::GetDestination (frame), Mac64Address ("ab:cd:00:ff:fe:00:00:02"), "wrong destination");
+  NS_TEST_ASSERT_MSG_EQ (SocketFrameParser::GetSource (frame), Mac64Address ("ab:cd:00:ff:fe:00:00:01"), "wrong source");
+
+  // Data, ack request, extended addresses with separate PAN IDs, uncompressed IPv6
+  const uint8_t extended[] = { 0x21, 0xcc, 0x02, 0xcd, 0xab,
+                               0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01,
+                               0x34, 0x12,
+                               0x18, 0x17, 0x16, 0x15, 0x14, 0x13, 0x12, 0x11,
+                               0x41, 0x60 };
+  NS_TEST_ASSERT_MSG_EQ (SocketFrameParser::Parse (extended, sizeof (extended), frame), true, "valid frame rejected");
+  NS_TEST_ASSERT_MSG_EQ (frame.ackRequest, true, "ack request not set");
+  NS_TEST_ASSERT_MSG_EQ (frame.srcPan, 0x1234, "wrong source PAN");
+  NS_TEST_ASSERT_MSG_EQ (frame.headerLength, 23, "wrong header length");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)frame.dispatch, (uint32_t)SocketFrame::DISPATCH_IPV6, "wrong dispatch");
+  NS_TEST_ASSERT_MSG_EQ (SocketFrameParser::GetDestination (frame), Mac64Address ("01:02:03:04:05:06:07:08"), "wrong destination");
+  NS_TEST_ASSERT_MSG_EQ (SocketFrameParser::GetSource (frame), Mac64Address ("11:12:13:14:15:16:17:18"), "wrong source");
+
+  // Broadcast destination
+  const uint8_t broadcast[] = { 0x41, 0x88, 0x03, 0xcd, 0xab, 0xff, 0xff, 0x01, 0x00, 0xc0, 0xa0 };
+  NS_TEST_ASSERT_MSG_EQ (SocketFrameParser::Parse (broadcast, sizeof (broadcast), frame), true, "valid frame rejected");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)frame.dispatch, (uint32_t)SocketFrame::DISPATCH_FRAG1, "wrong dispatch");
+  NS_TEST_ASSERT_MSG_EQ (SocketFrameParser::GetDestination (frame), Mac64Address ("ff:ff:ff:ff:ff:ff:ff:ff"), "broadcast not mapped");
+
+  // Acknowledgment has no addresses
+  const uint8_t ack[] = { 0x02, 0x00, 0x2a };
+  NS_TEST_ASSERT_MSG_EQ (SocketFrameParser::Parse (ack, sizeof (ack), frame), true, "ack rejected");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)frame.frameType, (uint32_t)SocketFrame::ACK, "wrong frame type");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)frame.dstMode, (uint32_t)SocketFrame::ADDR_NONE, "ack has a destination");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)frame.dispatch, (uint32_t)SocketFrame::DISPATCH_NONE, "ack has a dispatch");
+
+  // Truncated header and reserved addressing mode
+  NS_TEST_ASSERT_MSG_EQ (SocketFrameParser::Parse (shortIphc, 7, frame), false, "truncated frame accepted");
+  const uint8_t reserved[] = { 0x41, 0x84, 0x01, 0xcd, 0xab, 0x02, 0x00, 0x01, 0x00 };
+  NS_TEST_ASSERT_MSG_EQ (SocketFrameParser::Parse (reserved, sizeof (reserved), frame), false, "reserved mode accepted");
+}
+
+// Check that the range used for culling follows the transmit power
+class SocketChannelRangeTestCase : public TestCase
+{
+public:
+  SocketChannelRangeTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SocketChannelRangeTestCase::SocketChannelRangeTestCase ()
+  : TestCase ("Check SocketChannel range culling")
+{
+}
+
+void
+SocketChannelRangeTestCase::DoRun (void)
+{
+  Ptr<SocketChannel> channel = CreateObject<SocketChannel> ();
+  channel->SetPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  Ptr<SocketContikiPhy> phy = CreateObject<SocketContikiPhy> ();
+  phy->SetMode (SocketContikiPhy::DSSS_O_QPSK_GHz);
+  phy->SetChannel (channel);
+
+  // Log distance: 46.6777 dB at 1 m plus 30 dB per decade, -85 dBm threshold
+  NS_TEST_ASSERT_MSG_EQ_TOL (channel->GetMaxRange (0.0), 18.94, 0.05, "wrong range at 0 dBm");
+  NS_TEST_ASSERT_MSG_EQ_TOL (channel->GetMaxRange (65.0), 2780.0, 5.0, "wrong range at 65 dBm");
+
+  // The cached ranges follow the threshold and the loss model
+  phy->SetEdThreshold (-95.0);
+  NS_TEST_ASSERT_MSG_EQ_TOL (channel->GetMaxRange (0.0), 40.8, 0.1, "range not widened by a lower threshold");
+  phy->SetMode (SocketContikiPhy::DSSS_O_QPSK_GHz);
+  NS_TEST_ASSERT_MSG_EQ_TOL (channel->GetMaxRange (0.0), 18.94, 0.05, "range not restored with the mode");
+  Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel> ();
+  loss->SetPathLossExponent (2.0);
+  channel->SetPropagationLossModel (loss);
+  NS_TEST_ASSERT_MSG_EQ_TOL (channel->GetMaxRange (0.0), 82.4, 0.1, "range not updated with the loss model");
+  channel->SetPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+
+  // The most sensitive PHY on the channel sets the range
+  phy->SetEdThreshold (-95.0);
+  Ptr<SocketContikiPhy> other = CreateObject<SocketContikiPhy> ();
+  other->SetMode (SocketContikiPhy::DSSS_O_QPSK_GHz);
+  other->SetChannel (channel);
+  NS_TEST_ASSERT_MSG_EQ_TOL (channel->GetMaxRange (0.0), 40.8, 0.1, "threshold of the most sensitive PHY not used");
+
+  // Islands: a chain of hops within range, a pair and a lone node
+  std::vector<Vector> positions;
+  positions.push_back (Vector (0.0, 0.0, 0.0));
+  positions.push_back (Vector (100.0, 0.0, 0.0));
+  positions.push_back (Vector (10.0, 0.0, 0.0));
+  positions.push_back (Vector (20.0, 14.0, 0.0));
+  positions.push_back (Vector (-1000.0, 0.0, 0.0));
+  positions.push_back (Vector (105.0, 0.0, 0.0));
+  std::vector<uint32_t> islands = SocketChannel::FindIslands (positions, 18.0);
+  static const uint32_t expected[] = { 0, 1, 0, 0, 2, 1 };
+  for (uint32_t i = 0; i < positions.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (islands[i], expected[i], "wrong island of position " << i);
+    }
+}
+
+// Check that range culling follows nodes moving between course changes
+class SocketChannelMobilityTestCase : public TestCase
+{
+public:
+  SocketChannelMobilityTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Receive (Ptr<Packet> packet);
+
+  uint32_t m_received;
+};
+
+SocketChannelMobilityTestCase::SocketChannelMobilityTestCase ()
+  : TestCase ("Check SocketChannel mobility cache"),
+    m_received (0)
+{
+}
+
+void
+SocketChannelMobilityTestCase::Receive (Ptr<Packet> packet)
+{
+  m_received++;
+}
+
+void
+SocketChannelMobilityTestCase::DoRun (void)
+{
+  Ptr<SocketChannel> channel = CreateObject<SocketChannel> ();
+  channel->SetPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+  channel->SetAttribute ("RangeCulling", BooleanValue (true));
+
+  Ptr<ConstantPositionMobilityModel> senderMobility = CreateObject<ConstantPositionMobilityModel> ();
+  senderMobility->SetPosition (Vector (0.0, 0.0, 0.0));
+  Ptr<SocketContikiPhy> sender = CreateObject<SocketContikiPhy> ();
+  sender->SetTxPowerDbm (0.0);
+  sender->SetMobility (senderMobility);
+  sender->SetChannel (channel);
+
+  // 18.94 m range at 0 dBm; the receiver passes the sender at 10 m/s
+  Ptr<ConstantVelocityMobilityModel> receiverMobility = CreateObject<ConstantVelocityMobilityModel> ();
+  receiverMobility->SetPosition (Vector (30.0, 0.0, 0.0));
+  receiverMobility->SetVelocity (Vector (-10.0, 0.0, 0.0));
+  Ptr<SocketContikiPhy> receiver = CreateObject<SocketContikiPhy> ();
+  receiver->SetMobility (receiverMobility);
+  receiver->SetChannel (channel);
+  receiver->SetReceiveOkCallback (MakeCallback (&SocketChannelMobilityTestCase::Receive, this));
+
+  // At 30 m, 10 m, -10 m and, once stopped, still at -25 m
+  for (uint32_t k = 0; k < 4; k++)
+    {
+      Simulator::Schedule (Seconds (2.0 * k), &SocketContikiPhy::SendPacket, sender, Create<Packet> (20));
+    }
+  Simulator::Schedule (Seconds (5.5), &ConstantVelocityMobilityModel::SetVelocity, receiverMobility, Vector (0.0, 0.0, 0.0));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_received, 2, "positions between course changes not extrapolated");
+}
+
+// Check the frames SocketChannel hands to PHYs owned by another rank
+class SocketChannelRemoteTestCase : public TestCase
+{
+public:
+  SocketChannelRemoteTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void SendRemote (Ptr<Packet> packet, Time rxTime, uint32_t node, uint32_t ifIndex);
+  void Receive (Ptr<Packet> packet);
+
+  std::vector<Ptr<Packet> > m_remote;
+  Time m_rxTime;
+  uint32_t m_node;
+  uint32_t m_ifIndex;
+  uint32_t m_received;
+  uint32_t m_receivedSize;
+};
+
+SocketChannelRemoteTestCase::SocketChannelRemoteTestCase ()
+  : TestCase ("Check SocketChannel frames to other ranks"),
+    m_node (0),
+    m_ifIndex (0),
+    m_received (0),
+    m_receivedSize (0)
+{
+}
+
+void
+SocketChannelRemoteTestCase::SendRemote (Ptr<Packet> packet, Time rxTime, uint32_t node, uint32_t ifIndex)
+{
+  m_remote.push_back (packet);
+  m_rxTime = rxTime;
+  m_node = node;
+  m_ifIndex = ifIndex;
+}
+
+void
+SocketChannelRemoteTestCase::Receive (Ptr<Packet> packet)
+{
+  m_received++;
+  m_receivedSize = packet->GetSize ();
+}
+
+void
+SocketChannelRemoteTestCase::DoRun (void)
+{
+  Ptr<SocketChannel> channel = CreateObject<SocketChannel> ();
+  Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel> ();
+  Ptr<ConstantSpeedPropagationDelayModel> delay = CreateObject<ConstantSpeedPropagationDelayModel> ();
+  channel->SetPropagationLossModel (loss);
+  channel->SetPropagationDelayModel (delay);
+  channel->SetRemoteSendCallback (MakeCallback (&SocketChannelRemoteTestCase::SendRemote, this));
+
+  // Two PHYs on this rank at 0 m and 10 m, one on rank 1 at 300 m
+  static const double x[] = { 0.0, 10.0, 300.0 };
+  static const uint32_t systemId[] = { 0, 0, 1 };
+  Ptr<Node> nodes[3];
+  Ptr<ConstantPositionMobilityModel> mobility[3];
+  Ptr<SocketContikiPhy> phys[3];
+  uint32_t ifIndex = 0;
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      nodes[i] = CreateObject<Node> (systemId[i]);
+      Ptr<SimpleNetDevice> device = CreateObject<SimpleNetDevice> ();
+      ifIndex = nodes[i]->AddDevice (device);
+      mobility[i] = CreateObject<ConstantPositionMobilityModel> ();
+      mobility[i]->SetPosition (Vector (x[i], 0.0, 0.0));
+      phys[i] = CreateObject<SocketContikiPhy> ();
+      phys[i]->SetDevice (device);
+      phys[i]->SetMode (SocketContikiPhy::DSSS_O_QPSK_GHz);
+      phys[i]->SetMobility (mobility[i]);
+      phys[i]->SetChannel (channel);
+    }
+  phys[2]->SetReceiveOkCallback (MakeCallback (&SocketChannelRemoteTestCase::Receive, this));
+
+  // The pair crossing ranks closest together sets the lookahead
+  Time lookAhead = delay->GetDelay (mobility[1], mobility[2]);
+  NS_TEST_ASSERT_MSG_EQ (channel->GetLookAhead (), lookAhead, "lookahead is not the 10 m to 300 m delay");
+
+  // The header carries the receive power and the channel unchanged
+  Ptr<Packet> packet = Create<Packet> (20);
+  SocketChannelHeader header;
+  header.SetRxPowerDbm (-71.25);
+  header.SetChannelNumber (15);
+  packet->AddHeader (header);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 20 + header.GetSerializedSize (), "wrong header size");
+  SocketChannelHeader copy;
+  packet->RemoveHeader (copy);
+  NS_TEST_ASSERT_MSG_EQ (copy.GetRxPowerDbm (), -71.25, "receive power not kept");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)copy.GetChannelNumber (), 15, "channel not kept");
+
+  // Only the frame to rank 1 is handed over, with its receive power and time
+  phys[1]->SetRadioOn (false);
+  phys[0]->SendPacket (Create<Packet> (20));
+  NS_TEST_ASSERT_MSG_EQ (m_remote.size (), 1, "wrong number of frames to rank 1");
+  NS_TEST_ASSERT_MSG_EQ (m_node, nodes[2]->GetId (), "wrong destination node");
+  NS_TEST_ASSERT_MSG_EQ (m_ifIndex, ifIndex, "wrong destination device");
+  NS_TEST_ASSERT_MSG_EQ (m_rxTime, delay->GetDelay (mobility[0], mobility[2]), "wrong receive time");
+  NS_TEST_ASSERT_MSG_EQ (channel->GetLateFrames (), 0, "frame above the lookahead delivered late");
+  Ptr<Packet> remote = m_remote[0]->Copy ();
+  remote->RemoveHeader (copy);
+  NS_TEST_ASSERT_MSG_EQ (copy.GetRxPowerDbm (), loss->CalcRxPower (phys[0]->GetTxPowerDbm (), mobility[0], mobility[2]),
+                         "wrong receive power");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)copy.GetChannelNumber (), 26, "wrong channel");
+
+  // Rank 1 receives it as sent, unless it is tuned to another channel
+  Simulator::Schedule (m_rxTime, &SocketContikiPhy::ReceiveRemote, phys[2], m_remote[0]->Copy ());
+  Simulator::Schedule (Seconds (1.0), &SocketContikiPhy::SetChannelNumber, phys[2], 11);
+  Simulator::Schedule (Seconds (1.0), &SocketContikiPhy::ReceiveRemote, phys[2], m_remote[0]->Copy ());
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_received, 1, "wrong number of frames received from rank 0");
+  NS_TEST_ASSERT_MSG_EQ (m_receivedSize, 20, "header not removed");
+
+  m_remote.clear ();
+  Simulator::Destroy ();
+}
+
+// Check the encoding of the framed protocol and the reassembly of messages
+// by the reader thread
+class SocketBridgeFramedReadTestCase : public TestCase
+{
+public:
+  SocketBridgeFramedReadTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Read (uint8_t *buf, ssize_t len);
+
+  volatile uint32_t m_messages;
+  volatile uint32_t m_errors;
+};
+
+SocketBridgeFramedReadTestCase::SocketBridgeFramedReadTestCase ()
+  : TestCase ("Check the framed protocol and its reader"),
+    m_messages (0),
+    m_errors (0)
+{
+}
+
+void
+SocketBridgeFramedReadTestCase::Read (uint8_t *buf, ssize_t len)
+{
+  /* Message i is of type i % 3 and carries 2 * i bytes of value i */
+  uint32_t i = m_messages;
+  if (len != (ssize_t)(SBP_HEADER_LEN + 2 * i) || sbp_header_version (buf) != SBP_VERSION ||
+      sbp_header_type (buf) != i % 3 || sbp_header_length (buf) != 2 * i)
+    {
+      m_errors++;
+    }
+  for (uint32_t j = 0; j < 2 * i && len == (ssize_t)(SBP_HEADER_LEN + 2 * i); j++)
+    {
+      if (buf[SBP_HEADER_LEN + j] != i)
+        {
+          m_errors++;
+        }
+    }
+  free (buf);
+  m_messages++;
+}
+
+void
+SocketBridgeFramedReadTestCase::DoRun (void)
+{
+  // Header: version in the top 3 bits, type in the lower 5, then the length
+  uint8_t header[SBP_HEADER_LEN];
+  sbp_write_header (header, SBP_TYPE_TIME, 255);
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)header[0], (SBP_VERSION << 5) | SBP_TYPE_TIME, "wrong first header byte");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)header[1], 255u, "wrong length byte");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)sbp_header_version (header), (uint32_t)SBP_VERSION, "wrong version");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)sbp_header_type (header), (uint32_t)SBP_TYPE_TIME, "wrong type");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)sbp_header_length (header), 255u, "wrong length");
+
+  // Fields are in network byte order
+  uint8_t field[8];
+  sbp_put_u16 (field, 0xabcd);
+  NS_TEST_ASSERT_MSG_EQ (field[0] == 0xab && field[1] == 0xcd, true, "u16 not in network byte order");
+  NS_TEST_ASSERT_MSG_EQ (sbp_get_u16 (field), 0xabcd, "wrong u16");
+  sbp_put_u32 (field, 0x01020304);
+  NS_TEST_ASSERT_MSG_EQ (field[0] == 0x01 && field[3] == 0x04, true, "u32 not in network byte order");
+  NS_TEST_ASSERT_MSG_EQ (sbp_get_u32 (field), 0x01020304u, "wrong u32");
+  sbp_put_u64 (field, 0x0102030405060708ULL);
+  NS_TEST_ASSERT_MSG_EQ (field[0] == 0x01 && field[7] == 0x08, true, "u64 not in network byte order");
+  NS_TEST_ASSERT_MSG_EQ (sbp_get_u64 (field), 0x0102030405060708ULL, "wrong u64");
+
+  int sockets[2];
+  NS_TEST_ASSERT_MSG_EQ (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), 0, "socketpair() failed");
+
+  uint8_t stream[100 * (SBP_HEADER_LEN + 198)];
+  uint32_t length = 0;
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      sbp_write_header (stream + length, i % 3, 2 * i);
+      memset (stream + length + SBP_HEADER_LEN, i, 2 * i);
+      length += SBP_HEADER_LEN + 2 * i;
+    }
+
+  Ptr<SocketBridgeFdReader> reader = Create<SocketBridgeFdReader> ();
+  reader->SetFramed (true);
+  reader->Start (sockets[0], MakeCallback (&SocketBridgeFramedReadTestCase::Read, this), 0);
+
+  // Write in pieces of 5 bytes so that headers and payloads are split
+  for (uint32_t offset = 0; offset < length; offset += 5)
+    {
+      uint32_t piece = length - offset < 5 ? length - offset : 5;
+      NS_TEST_ASSERT_MSG_EQ (write (sockets[1], stream + offset, piece), (ssize_t)piece, "write() failed");
+      if (offset % 500 == 0)
+        {
+          usleep (1000);
+        }
+    }
+  // A truncated message is not delivered once the socket is closed
+  NS_TEST_ASSERT_MSG_EQ (write (sockets[1], stream, SBP_HEADER_LEN), (ssize_t)SBP_HEADER_LEN, "write() failed");
+  for (uint32_t wait = 0; m_messages < 100 && wait < 5000; wait++)
+    {
+      usleep (1000);
+    }
+  close (sockets[1]);
+  reader->Stop ();
+  close (sockets[0]);
+
+  NS_TEST_ASSERT_MSG_EQ (m_messages, 100u, "messages lost");
+  NS_TEST_ASSERT_MSG_EQ (m_errors, 0u, "messages garbled");
+  NS_TEST_ASSERT_MSG_EQ (reader->GetAllocations (), 100u, "wrong number of buffers allocated");
+}
+
+// Check the dispatch of the control messages of the framed protocol, fed to
+// a bridge from a replay log
+class SocketBridgeControlTestCase : public TestCase
+{
+public:
+  SocketBridgeControlTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SocketBridgeControlTestCase::SocketBridgeControlTestCase ()
+  : TestCase ("Check the control messages of the framed protocol")
+{
+}
+
+/* Append a control message to a log */
+static void
+AppendControl (SocketRecordLog &record, Time time, uint8_t subtype, const uint8_t *args, uint8_t len)
+{
+  uint8_t message[SBP_HEADER_LEN + SBP_MAX_PAYLOAD];
+  sbp_write_header (message, SBP_TYPE_CONTROL, len + 1);
+  message[SBP_HEADER_LEN] = subtype;
+  memcpy (message + SBP_HEADER_LEN + 1, args, len);
+  record.Append (time, message, SBP_HEADER_LEN + 1 + len);
+}
+
+void
+SocketBridgeControlTestCase::DoRun (void)
+{
+  std::string filename = CreateTempDirFilename ("socket-bridge-control.sbrl");
+  SocketRecordLog record;
+  NS_TEST_ASSERT_MSG_EQ (record.Open (filename, SocketBridge::FRAMED, Mac64Address ("00:00:00:00:00:00:00:01")), true,
+                         "cannot create log");
+  static const uint8_t panId[] = { 0xab, 0xcd };
+  static const uint8_t shortAddress[] = { 0x00, 0x02 };
+  static const uint8_t on[] = { 1 };
+  static const uint8_t off[] = { 0 };
+  static const uint8_t channel[] = { 15 };
+  static const uint8_t txPower[] = { 0xfd };
+  static const uint8_t cca[] = { SocketContikiPhy::CCA_CARRIER, 0xba };
+  AppendControl (record, MilliSeconds (1), SBP_CTRL_SET_PAN_ID, panId, sizeof (panId));
+  AppendControl (record, MilliSeconds (1), SBP_CTRL_SET_SHORT_ADDR, shortAddress, sizeof (shortAddress));
+  AppendControl (record, MilliSeconds (1), SBP_CTRL_SET_AUTO_ACK, on, sizeof (on));
+  AppendControl (record, MilliSeconds (1), SBP_CTRL_SET_PROMISCUOUS, off, sizeof (off));
+  AppendControl (record, MilliSeconds (1), SBP_CTRL_SET_CHANNEL, channel, sizeof (channel));
+  AppendControl (record, MilliSeconds (1), SBP_CTRL_SET_TX_POWER, txPower, sizeof (txPower));
+  AppendControl (record, MilliSeconds (1), SBP_CTRL_SET_CCA, cca, sizeof (cca));
+  // Arguments of the wrong length and unknown values are ignored
+  static const uint8_t twoBytes[] = { 20, 0 };
+  static const uint8_t badCca[] = { 4, 0 };
+  AppendControl (record, MilliSeconds (2), SBP_CTRL_SET_CHANNEL, twoBytes, sizeof (twoBytes));
+  AppendControl (record, MilliSeconds (2), SBP_CTRL_SET_PAN_ID, on, sizeof (on));
+  AppendControl (record, MilliSeconds (2), SBP_CTRL_SET_TX_POWER, 0, 0);
+  AppendControl (record, MilliSeconds (2), SBP_CTRL_SET_CCA, badCca, sizeof (badCca));
+  AppendControl (record, MilliSeconds (2), SBP_CTRL_STATS_REQUEST, on, sizeof (on));
+  AppendControl (record, MilliSeconds (2), 0x1f, on, sizeof (on));
+  // Requests are answered to no process on replay
+  AppendControl (record, MilliSeconds (2), SBP_CTRL_CCA_REQUEST, 0, 0);
+  AppendControl (record, MilliSeconds (2), SBP_CTRL_STATS_REQUEST, 0, 0);
+  AppendControl (record, MilliSeconds (3), SBP_CTRL_SET_RADIO, off, sizeof (off));
+  record.Close ();
+
+  NodeContainer nodes;
+  nodes.Create (1);
+  SocketBridgeHelper helper;
+  helper.SetAttribute ("Protocol", StringValue ("FRAMED"));
+  helper.SetAttribute ("ReplayFile", StringValue (filename));
+  helper.Install (nodes, "socket-bridge-replayed", "MACPHYOVERLAY");
+  Ptr<SocketBridge> bridge = DynamicCast<SocketBridge> (nodes.Get (0)->GetDevice (0));
+  Ptr<SocketNullMac> mac = bridge->GetMac ();
+  Ptr<SocketContikiPhy> phy = bridge->GetPhy ();
+  Simulator::Stop (MilliSeconds (10));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (mac->GetPanId (), 0xabcd, "PAN ID not set");
+  NS_TEST_ASSERT_MSG_EQ (mac->GetShortAddress (), 0x0002, "short address not set");
+  NS_TEST_ASSERT_MSG_EQ (mac->GetAutoAck (), true, "auto-ACK not set");
+  NS_TEST_ASSERT_MSG_EQ (mac->GetPromiscuous (), false, "promiscuous mode not set");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)phy->GetChannelNumber (), 15u, "channel not set or set by a bad message");
+  NS_TEST_ASSERT_MSG_EQ (phy->GetTxPowerDbm (), -3.0, "transmit power not set or set by a bad message");
+  NS_TEST_ASSERT_MSG_EQ (phy->GetCcaMode (), SocketContikiPhy::CCA_CARRIER, "CCA mode not set or set by a bad message");
+  NS_TEST_ASSERT_MSG_EQ (phy->GetCcaThreshold (), -70.0, "CCA threshold not set");
+  NS_TEST_ASSERT_MSG_EQ (phy->IsRadioOn (), false, "radio not turned off");
+
+  bridge = 0;
+  mac = 0;
+  phy = 0;
+  Simulator::Destroy ();
+}
+
+// Check the clear channel assessment of SocketContikiPhy
+class SocketContikiPhyCcaTestCase : public TestCase
+{
+public:
+  SocketContikiPhyCcaTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Assess (Ptr<SocketContikiPhy> phy, SocketContikiPhy::CcaMode mode, bool expected, std::string what);
+  void Receive (Ptr<Packet> packet);
+};
+
+SocketContikiPhyCcaTestCase::SocketContikiPhyCcaTestCase ()
+  : TestCase ("Check SocketContikiPhy clear channel assessment")
+{
+}
+
+void
+SocketContikiPhyCcaTestCase::Assess (Ptr<SocketContikiPhy> phy, SocketContikiPhy::CcaMode mode, bool expected, std::string what)
+{
+  phy->SetCcaMode (mode);
+  NS_TEST_EXPECT_MSG_EQ (phy->IsChannelClear (), expected, "wrong CCA in mode " << mode << " " << what);
+}
+
+void
+SocketContikiPhyCcaTestCase::Receive (Ptr<Packet> packet)
+{
+}
+
+void
+SocketContikiPhyCcaTestCase::DoRun (void)
+{
+  Ptr<SocketContikiPhy> phy = CreateObject<SocketContikiPhy> ();
+  phy->SetReceiveOkCallback (MakeCallback (&SocketContikiPhyCcaTestCase::Receive, this));
+  // 20 bytes take 800 us at 250 kb/s
+  Simulator::Schedule (MilliSeconds (1), &SocketContikiPhy::StartReceivePacket, phy, Create<Packet> (20), -60.0);
+  Simulator::Schedule (MilliSeconds (3), &SocketContikiPhy::StartReceivePacket, phy, Create<Packet> (20), -80.0);
+  Simulator::Schedule (MilliSeconds (5), &SocketContikiPhy::StartReceivePacket, phy, Create<Packet> (20), -60.0);
+  Simulator::Schedule (MilliSeconds (5) + MicroSeconds (100), &SocketContikiPhy::SetRadioOn, phy, false);
+  Simulator::Schedule (MilliSeconds (5) + MicroSeconds (200), &SocketContikiPhy::SetRadioOn, phy, true);
+
+  static const SocketContikiPhy::CcaMode modes[] = {
+    SocketContikiPhy::CCA_ENERGY, SocketContikiPhy::CCA_CARRIER, SocketContikiPhy::CCA_CARRIER_AND_ENERGY
+  };
+  // Idle, a frame above the -77 dBm threshold and one between it and the
+  // -85 dBm energy detection threshold.  Turning the radio off aborts the
+  // reception, but the energy of the frame is still on the channel.
+  static const bool idle[] = { true, true, true };
+  static const bool strong[] = { false, false, false };
+  static const bool weak[] = { true, false, true };
+  static const bool aborted[] = { false, true, true };
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      Simulator::Schedule (MicroSeconds (500), &SocketContikiPhyCcaTestCase::Assess, this, phy, modes[i], idle[i], "when idle");
+      Simulator::Schedule (MicroSeconds (1400), &SocketContikiPhyCcaTestCase::Assess, this, phy, modes[i], strong[i], "during a strong frame");
+      Simulator::Schedule (MicroSeconds (1900), &SocketContikiPhyCcaTestCase::Assess, this, phy, modes[i], idle[i], "after a strong frame");
+      Simulator::Schedule (MicroSeconds (3400), &SocketContikiPhyCcaTestCase::Assess, this, phy, modes[i], weak[i], "during a weak frame");
+      Simulator::Schedule (MicroSeconds (5150), &SocketContikiPhyCcaTestCase::Assess, this, phy, modes[i], false, "with the radio off");
+      Simulator::Schedule (MicroSeconds (5400), &SocketContikiPhyCcaTestCase::Assess, this, phy, modes[i], aborted[i], "with the radio on again");
+    }
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+// Check that an idle bridge stays within its memory budget
+class SocketBridgeMemoryTestCase : public TestCase
+{
+public:
+  SocketBridgeMemoryTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SocketBridgeMemoryTestCase::SocketBridgeMemoryTestCase ()
+  : TestCase ("Check SocketBridge memory usage")
+{
+}
+
+void
+SocketBridgeMemoryTestCase::DoRun (void)
+{
+  // A process that reads and ignores whatever its bridge writes
+  std::string path = CreateTempDirFilename ("socket-bridge-sink.sh");
+  std::ofstream script (path.c_str ());
+  script << "#!/bin/sh" << std::endl << "exec cat > /dev/null" << std::endl;
+  script.close ();
+  NS_TEST_ASSERT_MSG_EQ (chmod (path.c_str (), 0755), 0, "cannot make " << path << " executable");
+
+  // One node read by the shared EPOLL service, one by its own thread
+  NodeContainer nodes;
+  nodes.Create (2);
+  SocketBridgeHelper helper;
+  helper.SetAttribute ("IoBackend", EnumValue (SocketBridge::EPOLL));
+  helper.Install (NodeContainer (nodes.Get (0)), path, "MACPHYOVERLAY");
+  helper.SetAttribute ("IoBackend", EnumValue (SocketBridge::THREAD));
+  helper.Install (NodeContainer (nodes.Get (1)), path, "MACPHYOVERLAY");
+  Simulator::Stop (MilliSeconds (10));
+  Simulator::Run ();
+
+  Ptr<SocketBridge> shared = DynamicCast<SocketBridge> (nodes.Get (0)->GetDevice (0));
+  Ptr<SocketBridge> threaded = DynamicCast<SocketBridge> (nodes.Get (1)->GetDevice (0));
+  NS_TEST_ASSERT_MSG_EQ (threaded->GetReaderStackSize (), 65536u, "wrong default reader stack size");
+  NS_TEST_ASSERT_MSG_LT (shared->GetMemoryUsage (), 16384u, "idle node with a shared reader holds too much memory");
+  // The stack of a reader thread alone exceeds the budget
+  NS_TEST_ASSERT_MSG_GT (threaded->GetMemoryUsage (), shared->GetMemoryUsage () + 65535,
+                         "reader stack not counted");
+
+  // The latency histograms only allocate their buckets once used
+  SocketLatencyHistogram histogram;
+  NS_TEST_ASSERT_MSG_EQ (histogram.GetMemoryUsage (), 0u, "unused histogram allocated its buckets");
+  histogram.Record (1000);
+  NS_TEST_ASSERT_MSG_GT (histogram.GetMemoryUsage (), 0u, "histogram did not allocate its buckets");
+
+  // Buffers of frames read from the socket are recycled
+  SocketBufferPool pool (4);
+  uint8_t *buf = pool.Allocate ();
+  pool.Free (buf);
+  NS_TEST_ASSERT_MSG_EQ (pool.Allocate () == buf, true, "freed buffer was not reused");
+  NS_TEST_ASSERT_MSG_EQ (pool.GetAllocations (), 1, "pool allocated more than one buffer");
+  pool.Free (buf);
+
+  shared = 0;
+  threaded = 0;
+  Simulator::Destroy ();
+}
+
+// Check that SocketOutboundQueue adapts the coalescing delay to the interval
+// between frames and keeps control replies behind the frames gathered
+class SocketOutboundQueueTestCase : public TestCase
+{
+public:
+  SocketOutboundQueueTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SocketOutboundQueueTestCase::SocketOutboundQueueTestCase ()
+  : TestCase ("Check SocketOutboundQueue")
+{
+}
+
+void
+SocketOutboundQueueTestCase::DoRun (void)
+{
+  SocketOutboundQueue queue;
+  uint8_t frame[SBP_HEADER_LEN + 10];
+  sbp_write_header (frame, SBP_TYPE_DATA, 10);
+  memset (frame + SBP_HEADER_LEN, 0xaa, 10);
+
+  // Until frames come in no frame waits for others
+  NS_TEST_ASSERT_MSG_EQ (queue.GetDelay (MilliSeconds (1)), Seconds (0), "delay without frames");
+
+  // Frames 10 us apart are gathered for 7 intervals, at most the window
+  for (uint32_t i = 0; i < 400; i++)
+    {
+      if (queue.AddFrame (MicroSeconds (10 * i), frame, sizeof (frame)))
+        {
+          queue.Clear ();
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (queue.GetDelay (MilliSeconds (1)), MicroSeconds (70), "delay not adapted to dense frames");
+  NS_TEST_ASSERT_MSG_EQ (queue.GetDelay (MicroSeconds (50)), MicroSeconds (50), "delay exceeds the window");
+  NS_TEST_ASSERT_MSG_EQ (queue.GetDelay (MicroSeconds (5)), Seconds (0), "delay although no frame is expected");
+  NS_TEST_ASSERT_MSG_EQ (queue.GetDelay (Seconds (0)), Seconds (0), "delay with no window");
+
+  // Frames of one simulation time bring the average down
+  Time now = MicroSeconds (4000);
+  for (uint32_t i = 0; i < 8; i++)
+    {
+      queue.AddFrame (now, frame, sizeof (frame));
+    }
+  NS_TEST_ASSERT_MSG_LT (queue.GetDelay (MilliSeconds (1)), MicroSeconds (70), "frames of one time not counted");
+
+  // Frames 10 ms apart are never delayed
+  queue.Clear ();
+  for (uint32_t i = 1; i <= 100; i++)
+    {
+      queue.AddFrame (now + MilliSeconds (10 * i), frame, sizeof (frame));
+    }
+  NS_TEST_ASSERT_MSG_EQ (queue.GetDelay (MilliSeconds (1)), Seconds (0), "delay not adapted to sparse frames");
+
+  // A reply goes behind the frames gathered before it and is no frame
+  queue.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (queue.IsEmpty (), true, "cleared queue not empty");
+  Time last = now + MilliSeconds (1000);
+  uint8_t first[SBP_HEADER_LEN + 1];
+  sbp_write_header (first, SBP_TYPE_DATA, 1);
+  first[SBP_HEADER_LEN] = 1;
+  uint8_t second[SBP_HEADER_LEN + 1];
+  sbp_write_header (second, SBP_TYPE_DATA, 1);
+  second[SBP_HEADER_LEN] = 2;
+  uint8_t reply[SBP_HEADER_LEN + 13];
+  memset (reply, 0, sizeof (reply));
+  sbp_write_header (reply, SBP_TYPE_CONTROL, 13);
+  reply[SBP_HEADER_LEN] = SBP_CTRL_STATS;
+  queue.AddFrame (last, first, sizeof (first));
+  queue.AddFrame (last, second, sizeof (second));
+  Time delay = queue.GetDelay (MilliSeconds (100));
+  queue.AddMessage (reply, sizeof (reply));
+  NS_TEST_ASSERT_MSG_EQ (queue.GetDelay (MilliSeconds (100)), delay, "reply counted as a frame");
+  NS_TEST_ASSERT_MSG_EQ (queue.GetSize (), sizeof (first) + sizeof (second) + sizeof (reply), "wrong size");
+  const uint8_t *data = queue.GetData ();
+  NS_TEST_ASSERT_MSG_EQ (memcmp (data, first, sizeof (first)), 0, "first frame not first");
+  NS_TEST_ASSERT_MSG_EQ (memcmp (data + sizeof (first), second, sizeof (second)), 0, "second frame not second");
+  NS_TEST_ASSERT_MSG_EQ (memcmp (data + sizeof (first) + sizeof (second), reply, sizeof (reply)), 0,
+                         "reply not behind the frames");
+
+  // The queue asks to be written once LIMIT is reached
+  queue.Clear ();
+  uint32_t frames = 0;
+  while (!queue.AddFrame (last, frame, sizeof (frame)))
+    {
+      frames++;
+    }
+  NS_TEST_ASSERT_MSG_EQ (frames, (SocketOutboundQueue::LIMIT - 1) / sizeof (frame), "LIMIT not reached in time");
+  NS_TEST_ASSERT_MSG_GT (queue.GetMemoryUsage (), SocketOutboundQueue::LIMIT - 1, "memory usage not counted");
+}
+
+// Check that SocketRealtimeMonitor sheds load above the lag threshold and
+// recovers below half of it
+class SocketRealtimeMonitorTestCase : public TestCase
+{
+public:
+  SocketRealtimeMonitorTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Overload (bool overloaded, Time lag);
+
+  Ptr<SocketBridge> m_bridge;
+  std::vector<bool> m_overloaded;
+  std::vector<Time> m_lags;
+  std::vector<bool> m_shedding;
+};
+
+SocketRealtimeMonitorTestCase::SocketRealtimeMonitorTestCase ()
+  : TestCase ("Check SocketRealtimeMonitor")
+{
+}
+
+void
+SocketRealtimeMonitorTestCase::Overload (bool overloaded, Time lag)
+{
+  m_overloaded.push_back (overloaded);
+  m_lags.push_back (lag);
+  m_shedding.push_back (m_bridge->GetShedLoad ());
+}
+
+void
+SocketRealtimeMonitorTestCase::DoRun (void)
+{
+  // The simulator does not run, so the bridge never starts
+  m_bridge = CreateObject<SocketBridge> ();
+  Ptr<SocketRealtimeMonitor> monitor = CreateObject<SocketRealtimeMonitor> ();
+  monitor->SetAttribute ("LagThreshold", TimeValue (MilliSeconds (20)));
+  monitor->SetAttribute ("ShedLoad", BooleanValue (true));
+  monitor->AddBridge (m_bridge);
+  monitor->TraceConnectWithoutContext ("Overload", MakeCallback (&SocketRealtimeMonitorTestCase::Overload, this));
+
+  // Lags as a stalled simulation catching up would sample them
+  int64_t lags[] = { 5, 20, 25, 60, 15, 10, 9, 15, 0 };
+  bool overloaded[] = { false, false, true, true, true, true, false, false, false };
+  for (uint32_t i = 0; i < sizeof (lags) / sizeof (lags[0]); i++)
+    {
+      monitor->AddSample (MilliSeconds (lags[i]), i);
+      NS_TEST_ASSERT_MSG_EQ (monitor->IsOverloaded (), overloaded[i], "wrong state after a lag of " << lags[i] << " ms");
+      NS_TEST_ASSERT_MSG_EQ (m_bridge->GetShedLoad (), overloaded[i], "wrong shedding after a lag of " << lags[i] << " ms");
+    }
+
+  NS_TEST_ASSERT_MSG_EQ (m_overloaded.size (), 2, "overload did not start and end once");
+  NS_TEST_ASSERT_MSG_EQ (m_overloaded[0], true, "overload not detected");
+  NS_TEST_ASSERT_MSG_EQ (m_lags[0], MilliSeconds (25), "overloaded at the wrong lag");
+  NS_TEST_ASSERT_MSG_EQ (m_shedding[0], true, "bridge not shedding load");
+  NS_TEST_ASSERT_MSG_EQ (m_overloaded[1], false, "no recovery");
+  NS_TEST_ASSERT_MSG_EQ (m_lags[1], MilliSeconds (9), "recovered at the wrong lag");
+  NS_TEST_ASSERT_MSG_EQ (m_shedding[1], false, "bridge still shedding load");
+
+  // Without ShedLoad the bridges are left alone
+  monitor->SetAttribute ("ShedLoad", BooleanValue (false));
+  monitor->AddSample (MilliSeconds (30), 0);
+  NS_TEST_ASSERT_MSG_EQ (monitor->IsOverloaded (), true, "overload not detected");
+  NS_TEST_ASSERT_MSG_EQ (m_bridge->GetShedLoad (), false, "bridge shedding load without ShedLoad");
+
+  monitor->Stop ();
+  monitor = 0;
+  m_bridge = 0;
+  Simulator::Destroy ();
+}
+
+// Check that only the first frame after a drain schedules the next one
+class SocketBridgeInboxTestCase : public TestCase
+{
+public:
+  SocketBridgeInboxTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SocketBridgeInboxTestCase::SocketBridgeInboxTestCase ()
+  : TestCase ("Check SocketBridgeInbox")
+{
+}
+
+void
+SocketBridgeInboxTestCase::DoRun (void)
+{
+  SocketBridgeInbox *inbox = SocketBridgeInbox::Get ();
+  NS_TEST_ASSERT_MSG_EQ (inbox->GetSize (), 0u, "inbox not empty");
+  inbox->Disarm ();
+
+  uint8_t bufs[3];
+  SocketBridgeInbox::Frame frame;
+  frame.bridge = 0;
+  frame.readNs = 0;
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      frame.buf = &bufs[i];
+      frame.len = i + 1;
+      NS_TEST_ASSERT_MSG_EQ (inbox->Push (frame), true, "push failed");
+      NS_TEST_ASSERT_MSG_EQ (inbox->Arm (), i == 0, "drain armed by the wrong frame");
+    }
+  NS_TEST_ASSERT_MSG_EQ (inbox->GetSize (), 3u, "wrong number of queued frames");
+
+  inbox->Disarm ();
+  uint64_t batches = inbox->GetBatches ();
+  uint32_t popped = 0;
+  while (inbox->Pop (frame))
+    {
+      NS_TEST_ASSERT_MSG_EQ (frame.buf, &bufs[popped], "frames out of order");
+      NS_TEST_ASSERT_MSG_EQ (frame.len, (ssize_t)(popped + 1), "wrong frame length");
+      popped++;
+    }
+  inbox->AddBatch (popped);
+  NS_TEST_ASSERT_MSG_EQ (popped, 3u, "frames lost");
+  NS_TEST_ASSERT_MSG_EQ (inbox->GetBatches (), batches + 1, "batch not counted");
+
+  // A frame pushed after the drain started arms the next drain
+  NS_TEST_ASSERT_MSG_EQ (inbox->Arm (), true, "drain not re-armed");
+  inbox->Disarm ();
+}
+
+// Check that the EPOLL service cuts a stream into messages of
+// socket-bridge-protocol.h, however it was written
+class SocketIoServiceTestCase : public TestCase
+{
+public:
+  SocketIoServiceTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Read (uint8_t *buf, ssize_t len);
+
+  volatile uint32_t m_messages;
+  volatile uint32_t m_errors;
+};
+
+SocketIoServiceTestCase::SocketIoServiceTestCase ()
+  : TestCase ("Check SocketIoService"),
+    m_messages (0),
+    m_errors (0)
+{
+}
+
+void
+SocketIoServiceTestCase::Read (uint8_t *buf, ssize_t len)
+{
+  /* Message i carries i bytes of value i */
+  uint32_t i = m_messages;
+  if (len != (ssize_t)(SBP_HEADER_LEN + i) || sbp_header_length (buf) != i)
+    {
+      m_errors++;
+    }
+  for (uint32_t j = 0; j < i && len == (ssize_t)(SBP_HEADER_LEN + i); j++)
+    {
+      if (buf[SBP_HEADER_LEN + j] != i)
+        {
+          m_errors++;
+        }
+    }
+  free (buf);
+  m_messages++;
+}
+
+void
+SocketIoServiceTestCase::DoRun (void)
+{
+  int sockets[2];
+  NS_TEST_ASSERT_MSG_EQ (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), 0, "socketpair() failed");
+
+  uint8_t stream[100 * (SBP_HEADER_LEN + 100)];
+  uint32_t length = 0;
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      sbp_write_header (stream + length, SBP_TYPE_DATA, i);
+      memset (stream + length + SBP_HEADER_LEN, i, i);
+      length += SBP_HEADER_LEN + i;
+    }
+
+  SocketIoService *io = SocketIoService::Get (SocketIoService::EPOLL);
+  NS_TEST_ASSERT_MSG_EQ (io->GetBackend (), SocketIoService::EPOLL, "wrong backend");
+  uint32_t id = io->Add (sockets[0], true, 0, MakeCallback (&SocketIoServiceTestCase::Read, this));
+  NS_TEST_ASSERT_MSG_EQ (io->Send (id, stream, 1), false, "EPOLL took over a write");
+
+  // Write in pieces of 7 bytes so that headers and payloads are split
+  for (uint32_t offset = 0; offset < length; offset += 7)
+    {
+      uint32_t piece = length - offset < 7 ? length - offset : 7;
+      NS_TEST_ASSERT_MSG_EQ (write (sockets[1], stream + offset, piece), (ssize_t)piece, "write() failed");
+      if (offset % 700 == 0)
+        {
+          usleep (1000);
+        }
+    }
+  for (uint32_t wait = 0; m_messages < 100 && wait < 5000; wait++)
+    {
+      usleep (1000);
+    }
+  io->Remove (id);
+  close (sockets[0]);
+  close (sockets[1]);
+
+  NS_TEST_ASSERT_MSG_EQ (m_messages, 100u, "messages lost");
+  NS_TEST_ASSERT_MSG_EQ (m_errors, 0u, "messages garbled");
+}
+
+// Check that recorded frames are replayed with their times
+class SocketReplayLogTestCase : public TestCase
+{
+public:
+  SocketReplayLogTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SocketReplayLogTestCase::SocketReplayLogTestCase ()
+  : TestCase ("Check SocketRecordLog and SocketReplayLog")
+{
+}
+
+void
+SocketReplayLogTestCase::DoRun (void)
+{
+  std::string filename = CreateTempDirFilename ("socket-replay-log.sbrl");
+  Mac64Address address ("00:00:00:00:00:00:00:2a");
+  uint8_t frame[SocketReplayFormat::MAX_RECORD];
+  for (uint32_t i = 0; i < sizeof (frame); i++)
+    {
+      frame[i] = i;
+    }
+
+  SocketRecordLog record;
+  NS_TEST_ASSERT_MSG_EQ (record.Open (filename, SocketBridge::FRAMED, address), true, "cannot create log");
+  record.Append (MicroSeconds (1500), frame, 40);
+  record.Append (MicroSeconds (1500), frame, 1);
+  record.Append (Seconds (600), frame, sizeof (frame));
+  // A RAW read without an ingress pool can exceed MAX_RECORD; it is rejected
+  uint8_t chunk[SocketBridgeFdReader::RAW_READ_SIZE];
+  memset (chunk, 0, sizeof (chunk));
+  NS_TEST_ASSERT_MSG_EQ (record.Append (Seconds (601), chunk, sizeof (chunk)), false, "oversize buffer recorded");
+  record.Close ();
+  NS_TEST_ASSERT_MSG_EQ (record.GetRecords (), 3, "wrong number of records");
+  NS_TEST_ASSERT_MSG_EQ (record.GetRejected (), 1, "oversize buffer not counted");
+
+  SocketReplayLog replay;
+  NS_TEST_ASSERT_MSG_EQ (replay.Open (filename), true, "cannot read log");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)replay.GetProtocol (), (uint32_t)SocketBridge::FRAMED, "wrong protocol");
+  NS_TEST_ASSERT_MSG_EQ (replay.GetAddress (), address, "wrong address");
+
+  uint8_t buf[SocketReplayFormat::MAX_RECORD];
+  Time time;
+  uint32_t len;
+  NS_TEST_ASSERT_MSG_EQ (replay.Next (time, buf, len), true, "missing first record");
+  NS_TEST_ASSERT_MSG_EQ (time, MicroSeconds (1500), "wrong time of first record");
+  NS_TEST_ASSERT_MSG_EQ (len, 40, "wrong length of first record");
+  NS_TEST_ASSERT_MSG_EQ (memcmp (buf, frame, len), 0, "wrong first record");
+  NS_TEST_ASSERT_MSG_EQ (replay.Next (time, buf, len), true, "missing second record");
+  NS_TEST_ASSERT_MSG_EQ (time, MicroSeconds (1500), "wrong time of second record");
+  NS_TEST_ASSERT_MSG_EQ (len, 1, "wrong length of second record");
+  NS_TEST_ASSERT_MSG_EQ (replay.Next (time, buf, len), true, "missing third record");
+  NS_TEST_ASSERT_MSG_EQ (time, Seconds (600), "wrong time of third record");
+  NS_TEST_ASSERT_MSG_EQ (memcmp (buf, frame, sizeof (frame)), 0, "wrong third record");
+  NS_TEST_ASSERT_MSG_EQ (replay.Next (time, buf, len), false, "record past the end of the log");
+  replay.Close ();
+
+  // Frames less than 2 ms apart take four bytes besides the frame
+  FILE *fp = fopen (filename.c_str (), "rb");
+  fseek (fp, 0, SEEK_END);
+  long size = ftell (fp);
+  fclose (fp);
+  NS_TEST_ASSERT_MSG_EQ (size, (long)(SocketReplayFormat::HEADER_SIZE + 4 + 40 + 2 + 1 + 8 + sizeof (frame)),
+                         "log is not compact");
+}
+
+// Check the lock-free queue and the files of SocketPcapWriter
+class SocketPcapWriterTestCase : public TestCase
+{
+public:
+  SocketPcapWriterTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SocketPcapWriterTestCase::SocketPcapWriterTestCase ()
+  : TestCase ("Check SocketPcapWriter and SocketMpscQueue")
+{
+}
+
+void
+SocketPcapWriterTestCase::DoRun (void)
+{
+  // The capacity is rounded up to a power of two; Push fails when full
+  SocketMpscQueue<uint32_t> queue (5);
+  NS_TEST_ASSERT_MSG_EQ (queue.GetCapacity (), 8u, "capacity not rounded up");
+  uint32_t value;
+  for (uint32_t round = 0; round < 3; round++)
+    {
+      for (uint32_t i = 0; i < 8; i++)
+        {
+          NS_TEST_ASSERT_MSG_EQ (queue.Push (round * 8 + i), true, "push failed");
+        }
+      NS_TEST_ASSERT_MSG_EQ (queue.Push (0), false, "push to a full queue");
+      NS_TEST_ASSERT_MSG_EQ (queue.GetSize (), 8u, "wrong number of queued values");
+      for (uint32_t i = 0; i < 8; i++)
+        {
+          NS_TEST_ASSERT_MSG_EQ (queue.Pop (value), true, "pop failed");
+          NS_TEST_ASSERT_MSG_EQ (value, round * 8 + i, "values out of order");
+        }
+      NS_TEST_ASSERT_MSG_EQ (queue.Pop (value), false, "pop from an empty queue");
+    }
+
+  // Two 40 byte frames per file: 24 bytes of header and 16 + 40 per frame
+  std::string name = CreateTempDirFilename ("socket-pcap-writer");
+  Ptr<SocketPcapWriter> writer = CreateObject<SocketPcapWriter> ();
+  writer->SetAttribute ("RotateSize", UintegerValue (24 + 2 * (16 + 40)));
+  Ptr<SocketPcapFile> file = writer->CreateFile (name);
+  uint8_t frame[200];
+  for (uint32_t i = 0; i < sizeof (frame); i++)
+    {
+      frame[i] = i;
+    }
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      file->Write (Create<Packet> (frame, 40));
+    }
+  // Longer than SNAPLEN, so truncated, and in a file of its own
+  file->Write (Create<Packet> (frame, sizeof (frame)));
+  writer->Close ();
+  NS_TEST_ASSERT_MSG_EQ (writer->GetDrops (), 0, "frames dropped");
+
+  static const long sizes[] = { 24 + 2 * 56, 24 + 56, 24 + 16 + SocketPcapWriter::SNAPLEN };
+  for (uint32_t k = 0; k < 3; k++)
+    {
+      std::ostringstream oss;
+      oss << name << "-00" << k << ".pcap";
+      FILE *fp = fopen (oss.str ().c_str (), "rb");
+      NS_TEST_ASSERT_MSG_NE (fp, 0, "missing " << oss.str ());
+      uint32_t header[6];
+      NS_TEST_ASSERT_MSG_EQ (fread (header, sizeof (header), 1, fp), 1, "missing global header");
+      NS_TEST_ASSERT_MSG_EQ (header[0], 0xa1b2c3d4, "wrong magic");
+      NS_TEST_ASSERT_MSG_EQ (header[4], SocketPcapWriter::SNAPLEN, "wrong snaplen");
+      // LINKTYPE_IEEE802_15_4_NOFCS: the frames of the processes carry no FCS
+      NS_TEST_ASSERT_MSG_EQ (header[5], 230u, "wrong link type");
+      uint32_t record[4];
+      uint8_t data[SocketPcapWriter::SNAPLEN];
+      NS_TEST_ASSERT_MSG_EQ (fread (record, sizeof (record), 1, fp), 1, "missing record");
+      NS_TEST_ASSERT_MSG_EQ (fread (data, record[2], 1, fp), 1, "missing frame");
+      NS_TEST_ASSERT_MSG_EQ (memcmp (data, frame, record[2]), 0, "wrong frame");
+      if (k == 2)
+        {
+          NS_TEST_ASSERT_MSG_EQ (record[2], SocketPcapWriter::SNAPLEN, "frame not truncated");
+          NS_TEST_ASSERT_MSG_EQ (record[3], sizeof (frame), "wrong original length");
+        }
+      else
+        {
+          NS_TEST_ASSERT_MSG_EQ (record[2], 40, "wrong captured length");
+        }
+      fseek (fp, 0, SEEK_END);
+      NS_TEST_ASSERT_MSG_EQ (ftell (fp), sizes[k], "wrong size of " << oss.str ());
+      fclose (fp);
+    }
+}
+
+// Check that events are written as fixed records
+class SocketEventTraceTestCase : public TestCase
+{
+public:
+  SocketEventTraceTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SocketEventTraceTestCase::SocketEventTraceTestCase ()
+  : TestCase ("Check SocketEventTrace")
+{
+}
+
+void
+SocketEventTraceTestCase::DoRun (void)
+{
+  std::string filename = CreateTempDirFilename ("socket-event-trace.sbet");
+  Ptr<SocketEventTrace> trace = CreateObject<SocketEventTrace> ();
+  NS_TEST_ASSERT_MSG_EQ (trace->Open (filename), true, "cannot create trace");
+  Ptr<SocketEventProbe> probe = trace->CreateProbe (7);
+  Ptr<Packet> packet = Create<Packet> (40);
+  // More than one buffer, so that full buffers are written on the way
+  uint32_t events = SocketEventTrace::BUFFER_RECORDS + 2;
+  for (uint32_t i = 0; i < events - 1; i++)
+    {
+      probe->Tx (packet);
+    }
+  probe->Queue (42, 3);
+  NS_TEST_ASSERT_MSG_EQ (trace->GetRecords (), SocketEventTrace::BUFFER_RECORDS, "full buffer not written");
+  trace->Close ();
+  NS_TEST_ASSERT_MSG_EQ (trace->GetRecords (), events, "wrong number of records");
+
+  // Events of threads still writing after the trace closed are dropped
+  for (uint32_t i = 0; i < SocketEventTrace::BUFFER_RECORDS; i++)
+    {
+      probe->Tx (packet);
+    }
+  NS_TEST_ASSERT_MSG_EQ (trace->GetRecords (), events, "records written after close");
+
+  FILE *fp = fopen (filename.c_str (), "rb");
+  struct set_header header;
+  NS_TEST_ASSERT_MSG_EQ (fread (&header, sizeof (header), 1, fp), 1, "missing header");
+  NS_TEST_ASSERT_MSG_EQ (header.record_len, SET_RECORD_LEN, "wrong record length");
+  struct set_record record;
+  NS_TEST_ASSERT_MSG_EQ (fread (&record, sizeof (record), 1, fp), 1, "missing first record");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)record.type, SET_EVENT_TX, "wrong type of first record");
+  NS_TEST_ASSERT_MSG_EQ (record.node, 7, "wrong node");
+  NS_TEST_ASSERT_MSG_EQ (record.uid, packet->GetUid (), "wrong UID");
+  NS_TEST_ASSERT_MSG_EQ (record.size, 40, "wrong size");
+  fseek (fp, -(long)sizeof (record), SEEK_END);
+  NS_TEST_ASSERT_MSG_EQ (fread (&record, sizeof (record), 1, fp), 1, "missing last record");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)record.type, SET_EVENT_QUEUE, "wrong type of last record");
+  NS_TEST_ASSERT_MSG_EQ (record.value, 3, "wrong queue length");
+  NS_TEST_ASSERT_MSG_EQ (ftell (fp), (long)(SET_HEADER_LEN + events * SET_RECORD_LEN), "wrong trace size");
+  fclose (fp);
+
+  probe = 0;
+  trace = 0;
+  Simulator::Destroy ();
+}
+
+// Check that the frame duration tables match the formula
+class SocketContikiPhyTxDurationTestCase : public TestCase
+{
+public:
+  SocketContikiPhyTxDurationTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SocketContikiPhyTxDurationTestCase::SocketContikiPhyTxDurationTestCase ()
+  : TestCase ("Check SocketContikiPhy frame durations")
+{
+}
+
+void
+SocketContikiPhyTxDurationTestCase::DoRun (void)
+{
+  Ptr<SocketContikiPhy> phy = CreateObject<SocketContikiPhy> ();
+  for (uint32_t mode = SocketContikiPhy::DSSS_BPSK; mode <= SocketContikiPhy::PSSS_ASK; mode++)
+    {
+      phy->SetMode ((SocketContikiPhy::PhyMode)mode);
+      for (uint32_t size = 0; size <= SocketContikiPhy::MAX_PSDU_SIZE + 1; size++)
+        {
+          NS_TEST_ASSERT_MSG_EQ (phy->CalculateTxDuration (size),
+                                 MicroSeconds (SocketContikiPhy::CalculateReferenceTxDuration ((SocketContikiPhy::PhyMode)mode, size)),
+                                 "table differs from formula in mode " << mode << " for " << size << " bytes");
+        }
+    }
+
+  // 2450 MHz: 128 us synchronization header, 16 us per 4 bit symbol, 2 SFD symbols
+  phy->SetMode (SocketContikiPhy::DSSS_O_QPSK_GHz);
+  NS_TEST_ASSERT_MSG_EQ (phy->CalculateTxDuration (127), MicroSeconds (4224), "wrong duration of a 127 byte frame");
+  // 868 MHz BPSK: 1600 us preamble, 50 us per bit, 8 SFD symbols
+  phy->SetMode (SocketContikiPhy::DSSS_BPSK);
+  NS_TEST_ASSERT_MSG_EQ (phy->CalculateTxDuration (20), MicroSeconds (10000), "wrong duration of a 20 byte frame");
+  NS_TEST_ASSERT_MSG_EQ (phy->GetEdThreshold (), -92.0, "wrong energy detection threshold");
+  // 868 MHz O-QPSK: 320 us synchronization header, 40 us per 4 bit symbol
+  phy->SetMode (SocketContikiPhy::DSSS_O_QPSK_MHz);
+  NS_TEST_ASSERT_MSG_EQ (phy->CalculateTxDuration (20), MicroSeconds (2000), "wrong duration of a 20 byte frame");
+  NS_TEST_ASSERT_MSG_EQ (phy->GetSymbolDuration (), MicroSeconds (40), "wrong symbol duration");
+  // 868 MHz ASK: 160 us synchronization header, 80 us per 20 bit symbol
+  phy->SetMode (SocketContikiPhy::PSSS_ASK);
+  NS_TEST_ASSERT_MSG_EQ (phy->CalculateTxDuration (20), MicroSeconds (880), "wrong duration of a 20 byte frame");
+  NS_TEST_ASSERT_MSG_EQ (phy->GetEdThreshold (), -85.0, "wrong energy detection threshold");
+  NS_TEST_ASSERT_MSG_EQ (SocketContikiPhy::GetTxDurationUs<SocketContikiPhy::PSSS_ASK> (20), 880, "wrong duration of a 20 byte frame");
+}
+
+// Check that the radio energy model integrates the PHY states
+class SocketRadioEnergyModelTestCase : public TestCase
+{
+public:
+  SocketRadioEnergyModelTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SocketRadioEnergyModelTestCase::SocketRadioEnergyModelTestCase ()
+  : TestCase ("Check SocketRadioEnergyModel")
+{
+}
+
+void
+SocketRadioEnergyModelTestCase::DoRun (void)
+{
+  Ptr<SocketChannel> channel = CreateObject<SocketChannel> ();
+  channel->SetPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+
+  Ptr<SocketNullMac> macs[2];
+  Ptr<SocketContikiPhy> phys[2];
+  Ptr<SocketRadioEnergyModel> models[2];
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+      mobility->SetPosition (Vector (5.0 * i, 0.0, 0.0));
+      macs[i] = CreateObject<SocketNullMac> ();
+      phys[i] = CreateObject<SocketContikiPhy> ();
+      macs[i]->SetPhy (phys[i]);
+      phys[i]->SetMode (SocketContikiPhy::DSSS_O_QPSK_GHz);
+      phys[i]->SetMobility (mobility);
+      phys[i]->SetChannel (channel);
+      models[i] = CreateObject<SocketRadioEnergyModel> ();
+      models[i]->SetPhy (phys[i]);
+    }
+
+  // 20 bytes at 250 kb/s: 128 us synchronization header plus 42 symbols of 16 us
+  Simulator::Schedule (Seconds (0.5), &SocketNullMac::Enqueue, macs[0], Create<Packet> (20));
+  // The second frame is not received by the sleeping radio
+  Simulator::Schedule (Seconds (0.6), &SocketContikiPhy::SetRadioOn, phys[1], false);
+  Simulator::Schedule (Seconds (0.7), &SocketNullMac::Enqueue, macs[0], Create<Packet> (20));
+  // The sender is listening at the AT86RF212 receive current from then on
+  Simulator::Schedule (Seconds (0.8), &SocketContikiPhy::SetMode, phys[0], SocketContikiPhy::DSSS_BPSK);
+  Simulator::Stop (Seconds (1.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (models[0]->GetStateTime (SocketContikiPhy::TX), MicroSeconds (1600), "wrong TX time");
+  NS_TEST_ASSERT_MSG_EQ (models[1]->GetStateTime (SocketContikiPhy::RX), MicroSeconds (800), "wrong RX time");
+  NS_TEST_ASSERT_MSG_EQ (models[1]->GetStateTime (SocketContikiPhy::TX), Seconds (0), "receiver transmitted");
+  NS_TEST_ASSERT_MSG_EQ (models[1]->GetStateTime (SocketContikiPhy::SLEEP), Seconds (0.4), "wrong SLEEP time");
+  NS_TEST_ASSERT_MSG_EQ_TOL (models[0]->GetStateEnergy (SocketContikiPhy::TX), 0.0174 * 3.0 * 1600e-6, 1e-12, "wrong TX energy");
+  // Listening draws the receive current
+  double idle = 0.0188 * 3.0 * (0.8 - 1600e-6) + 0.0092 * 3.0 * 0.2;
+  NS_TEST_ASSERT_MSG_EQ_TOL (models[0]->GetStateEnergy (SocketContikiPhy::IDLE), idle, 1e-9, "mode change not billed");
+  NS_TEST_ASSERT_MSG_EQ_TOL (models[0]->GetTotalEnergyConsumption (), idle + 0.0174 * 3.0 * 1600e-6, 1e-9, "wrong total energy");
+
+  Simulator::Destroy ();
+}
+
+// Check the ACKs generated by SocketNullMac
+class SocketNullMacAutoAckTestCase : public TestCase
+{
+public:
+  SocketNullMacAutoAckTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void DataReceived (Ptr<const Packet> packet);
+  void AckReceived (Ptr<const Packet> packet);
+  void TxDropped (Ptr<const Packet> packet);
+  void RxDropped (Ptr<const Packet> packet);
+  void EnableAckFcs (Ptr<SocketNullMac> mac);
+
+  std::vector<Time> m_dataRxTimes;
+  std::vector<Time> m_ackTimes;
+  std::vector<Ptr<const Packet> > m_acks;
+  uint32_t m_txDrops;
+  uint32_t m_rxDrops;
+};
+
+SocketNullMacAutoAckTestCase::SocketNullMacAutoAckTestCase ()
+  : TestCase ("Check SocketNullMac AutoAck"),
+    m_txDrops (0),
+    m_rxDrops (0)
+{
+}
+
+void
+SocketNullMacAutoAckTestCase::DataReceived (Ptr<const Packet> packet)
+{
+  m_dataRxTimes.push_back (Simulator::Now ());
+}
+
+void
+SocketNullMacAutoAckTestCase::AckReceived (Ptr<const Packet> packet)
+{
+  m_ackTimes.push_back (Simulator::Now ());
+  m_acks.push_back (packet);
+}
+
+void
+SocketNullMacAutoAckTestCase::TxDropped (Ptr<const Packet> packet)
+{
+  m_txDrops++;
+}
+
+void
+SocketNullMacAutoAckTestCase::RxDropped (Ptr<const Packet> packet)
+{
+  m_rxDrops++;
+}
+
+void
+SocketNullMacAutoAckTestCase::EnableAckFcs (Ptr<SocketNullMac> mac)
+{
+  mac->SetAttribute ("AckFcs", BooleanValue (true));
+}
+
+void
+SocketNullMacAutoAckTestCase::DoRun (void)
+{
+  Ptr<SocketChannel> channel = CreateObject<SocketChannel> ();
+  channel->SetPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+
+  Ptr<SocketNullMac> macs[2];
+  Ptr<SocketContikiPhy> phys[2];
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+      mobility->SetPosition (Vector (5.0 * i, 0.0, 0.0));
+      macs[i] = CreateObject<SocketNullMac> ();
+      phys[i] = CreateObject<SocketContikiPhy> ();
+      macs[i]->SetPhy (phys[i]);
+      phys[i]->SetMode (SocketContikiPhy::DSSS_O_QPSK_GHz);
+      phys[i]->SetMobility (mobility);
+      phys[i]->SetChannel (channel);
+    }
+  macs[1]->SetPanId (0xabcd);
+  macs[1]->SetShortAddress (0x0002);
+  macs[1]->SetAutoAck (true);
+  macs[1]->TraceConnectWithoutContext ("MacRx", MakeCallback (&SocketNullMacAutoAckTestCase::DataReceived, this));
+  macs[1]->TraceConnectWithoutContext ("MacTxDrop", MakeCallback (&SocketNullMacAutoAckTestCase::TxDropped, this));
+  macs[1]->TraceConnectWithoutContext ("MacRxDrop", MakeCallback (&SocketNullMacAutoAckTestCase::RxDropped, this));
+  macs[0]->TraceConnectWithoutContext ("MacPromiscRx", MakeCallback (&SocketNullMacAutoAckTestCase::AckReceived, this));
+
+  /* Data, ack request, PAN ID compression, short addresses 0x0001 to 0x0002, IPHC */
+  static const uint8_t data[] = {
+    0x61, 0x88, 0x07, 0xcd, 0xab, 0x02, 0x00, 0x01, 0x00,
+    0x7a, 0x33, 0x3a
+  };
+  /* The ACK the node sends itself, which the radio would have sent */
+  static const uint8_t ack[] = { 0x02, 0x00, 0x07 };
+  /* As data, to 0xfffe */
+  static const uint8_t noShort[] = {
+    0x61, 0x88, 0x08, 0xcd, 0xab, 0xfe, 0xff, 0x01, 0x00,
+    0x7a, 0x33, 0x3a
+  };
+  Simulator::Schedule (Seconds (0.5), &SocketNullMac::Enqueue, macs[0], Create<Packet> (data, sizeof (data)));
+  Simulator::Schedule (Seconds (0.6), &SocketNullMac::Enqueue, macs[1], Create<Packet> (ack, sizeof (ack)));
+  // A node without a short address neither acknowledges nor accepts frames to 0xfffe
+  Simulator::Schedule (Seconds (0.7), &SocketNullMac::SetShortAddress, macs[1], SocketFrameParser::NO_SHORT_ADDRESS);
+  Simulator::Schedule (Seconds (0.7), &SocketNullMac::SetPromiscuous, macs[1], false);
+  Simulator::Schedule (Seconds (0.8), &SocketNullMac::Enqueue, macs[0], Create<Packet> (noShort, sizeof (noShort)));
+  // With AckFcs the ACK carries the FCS the processes leave out
+  Simulator::Schedule (Seconds (0.9), &SocketNullMac::SetShortAddress, macs[1], 0x0002);
+  Simulator::Schedule (Seconds (0.9), &SocketNullMacAutoAckTestCase::EnableAckFcs, this, macs[1]);
+  Simulator::Schedule (Seconds (0.95), &SocketNullMac::Enqueue, macs[0], Create<Packet> (data, sizeof (data)));
+  Simulator::Stop (Seconds (1.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_acks.size (), 2, "wrong number of ACKs");
+  NS_TEST_ASSERT_MSG_EQ (m_dataRxTimes.size (), 2, "wrong number of frames received");
+  // Frame control and sequence number, without an FCS like the frames of the processes
+  uint8_t buf[8];
+  NS_TEST_ASSERT_MSG_EQ (m_acks[0]->CopyData (buf, sizeof (buf)), 3, "wrong ACK length");
+  NS_TEST_ASSERT_MSG_EQ (memcmp (buf, ack, sizeof (ack)), 0, "wrong ACK");
+  // aTurnaroundTime is 12 symbols of 16 us, then the ACK and 5 m of propagation
+  Time ackEnd = m_dataRxTimes[0] + MicroSeconds (192) + phys[1]->CalculateTxDuration (3);
+  NS_TEST_ASSERT_MSG_EQ_TOL ((m_ackTimes[0] - ackEnd).GetNanoSeconds (), 17, 1, "wrong ACK timing");
+  // Then the ITU-T CRC-16 of both
+  NS_TEST_ASSERT_MSG_EQ (m_acks[1]->CopyData (buf, sizeof (buf)), 5, "wrong ACK length with AckFcs");
+  static const uint8_t expected[] = { 0x02, 0x00, 0x07, 0x07, 0xc1 };
+  NS_TEST_ASSERT_MSG_EQ (memcmp (buf, expected, sizeof (expected)), 0, "wrong ACK with AckFcs");
+  ackEnd = m_dataRxTimes[1] + MicroSeconds (192) + phys[1]->CalculateTxDuration (5);
+  NS_TEST_ASSERT_MSG_EQ_TOL ((m_ackTimes[1] - ackEnd).GetNanoSeconds (), 17, 1, "wrong ACK timing with AckFcs");
+  NS_TEST_ASSERT_MSG_EQ (m_txDrops, 1, "ACK of the node not dropped");
+  NS_TEST_ASSERT_MSG_EQ (m_rxDrops, 1, "frame to 0xfffe not dropped");
+  NS_TEST_ASSERT_MSG_EQ (macs[1]->GetShortAddress (), SocketFrameParser::NO_SHORT_ADDRESS, "wrong short address");
+
+  m_acks.clear ();
+  Simulator::Destroy ();
+}
+
+// Check which received frames a non-promiscuous SocketNullMac delivers
+class SocketNullMacFilterTestCase : public TestCase
+{
+public:
+  SocketNullMacFilterTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Delivered (Ptr<const Packet> packet);
+  void Dropped (Ptr<const Packet> packet);
+  bool IsDelivered (Ptr<SocketNullMac> mac, Ptr<Packet> packet);
+
+  uint32_t m_delivered;
+  uint32_t m_dropped;
+};
+
+SocketNullMacFilterTestCase::SocketNullMacFilterTestCase ()
+  : TestCase ("Check SocketNullMac address filtering"),
+    m_delivered (0),
+    m_dropped (0)
+{
+}
+
+void
+SocketNullMacFilterTestCase::Delivered (Ptr<const Packet> packet)
+{
+  m_delivered++;
+}
+
+void
+SocketNullMacFilterTestCase::Dropped (Ptr<const Packet> packet)
+{
+  m_dropped++;
+}
+
+bool
+SocketNullMacFilterTestCase::IsDelivered (Ptr<SocketNullMac> mac, Ptr<Packet> packet)
+{
+  uint32_t delivered = m_delivered;
+  uint32_t dropped = m_dropped;
+  mac->Receive (packet);
+  NS_ASSERT (m_delivered + m_dropped == delivered + dropped + 1);
+  return m_delivered > delivered;
+}
+
+/* Data frame with PAN ID compression, short addresses and an IPHC payload */
+static Ptr<Packet>
+CreateShortFrame (uint16_t pan, uint16_t dst, uint16_t src)
+{
+  uint8_t buf[] = {
+    0x41, 0x88, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x7a, 0x33, 0x3a
+  };
+  buf[3] = pan & 0xff;
+  buf[4] = pan >> 8;
+  buf[5] = dst & 0xff;
+  buf[6] = dst >> 8;
+  buf[7] = src & 0xff;
+  buf[8] = src >> 8;
+  return Create<Packet> (buf, sizeof (buf));
+}
+
+/* As CreateShortFrame, with extended addresses sharing their last byte */
+static Ptr<Packet>
+CreateExtendedFrame (uint16_t pan, uint8_t dst, uint8_t src)
+{
+  uint8_t buf[] = {
+    0x41, 0xcc, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x7a, 0x33, 0x3a
+  };
+  buf[3] = pan & 0xff;
+  buf[4] = pan >> 8;
+  buf[5] = dst;
+  buf[13] = src;
+  return Create<Packet> (buf, sizeof (buf));
+}
+
+void
+SocketNullMacFilterTestCase::DoRun (void)
+{
+  Ptr<SocketChannel> channel = CreateObject<SocketChannel> ();
+  channel->SetPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+  Ptr<SocketNullMac> mac = CreateObject<SocketNullMac> ();
+  Ptr<SocketContikiPhy> phy = CreateObject<SocketContikiPhy> ();
+  mac->SetPhy (phy);
+  phy->SetMobility (CreateObject<ConstantPositionMobilityModel> ());
+  phy->SetChannel (channel);
+  mac->TraceConnectWithoutContext ("MacRx", MakeCallback (&SocketNullMacFilterTestCase::Delivered, this));
+  mac->TraceConnectWithoutContext ("MacRxDrop", MakeCallback (&SocketNullMacFilterTestCase::Dropped, this));
+
+  // Promiscuous by default, and unfiltered until the addresses are known
+  NS_TEST_ASSERT_MSG_EQ (IsDelivered (mac, CreateShortFrame (0xabcd, 0x0005, 0x0001)), true, "promiscuous MAC dropped a frame");
+  mac->SetPromiscuous (false);
+  NS_TEST_ASSERT_MSG_EQ (IsDelivered (mac, CreateShortFrame (0xabcd, 0x0005, 0x0001)), true, "frame dropped before the address is known");
+
+  // Learn the PAN ID and short address from a frame the node sends
+  mac->Enqueue (CreateShortFrame (0xabcd, 0xffff, 0x0002));
+  NS_TEST_ASSERT_MSG_EQ (mac->GetPanId (), 0xabcd, "PAN ID not learned");
+  NS_TEST_ASSERT_MSG_EQ (mac->GetShortAddress (), 0x0002, "short address not learned");
+  NS_TEST_ASSERT_MSG_EQ (IsDelivered (mac, CreateShortFrame (0xabcd, 0x0005, 0x0001)), false, "frame to another node delivered");
+  NS_TEST_ASSERT_MSG_EQ (IsDelivered (mac, CreateShortFrame (0xabcd, 0x0002, 0x0001)), true, "frame to the node dropped");
+  NS_TEST_ASSERT_MSG_EQ (IsDelivered (mac, CreateShortFrame (0xabcd, 0xffff, 0x0001)), true, "broadcast dropped");
+  NS_TEST_ASSERT_MSG_EQ (IsDelivered (mac, CreateShortFrame (0x1234, 0x0002, 0x0001)), false, "frame to another PAN delivered");
+  NS_TEST_ASSERT_MSG_EQ (IsDelivered (mac, CreateShortFrame (0xffff, 0x0002, 0x0001)), true, "frame to the broadcast PAN dropped");
+  static const uint8_t ack[] = { 0x02, 0x00, 0x01 };
+  NS_TEST_ASSERT_MSG_EQ (IsDelivered (mac, Create<Packet> (ack, sizeof (ack))), true, "ACK dropped");
+
+  // Extended addresses are learned separately
+  NS_TEST_ASSERT_MSG_EQ (IsDelivered (mac, CreateExtendedFrame (0xabcd, 0x05, 0x01)), true, "frame dropped before the address is known");
+  mac->Enqueue (CreateExtendedFrame (0xabcd, 0x01, 0x02));
+  NS_TEST_ASSERT_MSG_EQ (IsDelivered (mac, CreateExtendedFrame (0xabcd, 0x05, 0x01)), false, "frame to another node delivered");
+  NS_TEST_ASSERT_MSG_EQ (IsDelivered (mac, CreateExtendedFrame (0xabcd, 0x02, 0x01)), true, "frame to the node dropped");
+
+  // Configured addresses take precedence over learned ones
+  mac->SetShortAddress (0x0007);
+  mac->Enqueue (CreateShortFrame (0xabcd, 0xffff, 0x0002));
+  NS_TEST_ASSERT_MSG_EQ (mac->GetShortAddress (), 0x0007, "configured short address overridden");
+  NS_TEST_ASSERT_MSG_EQ (IsDelivered (mac, CreateShortFrame (0xabcd, 0x0002, 0x0001)), false, "frame to the learned address delivered");
+
+  Simulator::Destroy ();
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -60,6 +1655,26 @@ SocketBridgeTestSuite::SocketBridgeTestSuite ()
   : TestSuite ("SocketBridge", UNIT)
 {
   AddTestCase (new SocketBridgeTestCase1);
+  AddTestCase (new SocketLatencyHistogramTestCase);
+  AddTestCase (new SocketFrameParserTestCase);
+  AddTestCase (new SocketChannelRangeTestCase);
+  AddTestCase (new SocketChannelMobilityTestCase);
+  AddTestCase (new SocketChannelRemoteTestCase);
+  AddTestCase (new SocketBridgeMemoryTestCase);
+  AddTestCase (new SocketOutboundQueueTestCase);
+  AddTestCase (new SocketRealtimeMonitorTestCase);
+  AddTestCase (new SocketBridgeInboxTestCase);
+  AddTestCase (new SocketIoServiceTestCase);
+  AddTestCase (new SocketBridgeFramedReadTestCase);
+  AddTestCase (new SocketBridgeControlTestCase);
+  AddTestCase (new SocketReplayLogTestCase);
+  AddTestCase (new SocketPcapWriterTestCase);
+  AddTestCase (new SocketEventTraceTestCase);
+  AddTestCase (new SocketContikiPhyTxDurationTestCase);
+  AddTestCase (new SocketContikiPhyCcaTestCase);
+  AddTestCase (new SocketRadioEnergyModelTestCase);
+  AddTestCase (new SocketNullMacAutoAckTestCase);
+  AddTestCase (new SocketNullMacFilterTestCase);
 }
 
 // Do not forget to allocate an instance of this TestSuite